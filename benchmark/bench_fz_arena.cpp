@@ -0,0 +1,58 @@
+#include <vector>
+
+#include "fz/allocator.hpp"
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+
+namespace {
+
+using Shape = std::vector<fz::SizeType>;
+using HeapArray = fz::Array<double>;
+using ScratchArray =
+    fz::Array<double, Shape, Shape, fz::ArenaAllocator<double>>;
+
+constexpr int TEMPORARIES = 8;
+
+auto shapeOf(const fz::bench::State& state) -> Shape {
+  switch (state.arg()) {
+    case 0:
+      return {8, 8};
+    case 1:
+      return {32, 32, 32};
+    default:
+      return {128, 128, 16};
+  }
+}
+
+// one solver step: a handful of scratch fields that die at the end of it
+template <typename ArrayType>
+auto step(const Shape& shape) -> double {
+  double sum = 0.0;
+  for (int t = 0; t < TEMPORARIES; ++t) {
+    auto scratch = ArrayType::empty(shape);
+    *scratch.data() = static_cast<double>(t);
+    sum += *scratch.data();
+  }
+  return sum;
+}
+
+auto scratchHeap(fz::bench::State& state) -> void {
+  const auto shape = shapeOf(state);
+  for (auto _ : state) {
+    fz::bench::doNotOptimize(step<HeapArray>(shape));
+  }
+}
+
+auto scratchArena(fz::bench::State& state) -> void {
+  const auto shape = shapeOf(state);
+  for (auto _ : state) {
+    fz::ArenaScope scope;
+    fz::bench::doNotOptimize(step<ScratchArray>(shape));
+  }
+}
+
+}  // namespace
+
+// argument: 8x8, 32x32x32 or 128x128x16 doubles
+FZ_BENCHMARK_ARGS(scratchHeap, 0, 1, 2);
+FZ_BENCHMARK_ARGS(scratchArena, 0, 1, 2);
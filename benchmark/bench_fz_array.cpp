@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/cow_array.hpp"
+
+namespace {
+
+using Shape = std::vector<fz::SizeType>;
+
+// argument: edge of a cube of doubles, 16^3 fits in L1/L2, 256^3 in DRAM
+auto cube(const fz::bench::State& state) -> Shape {
+  const auto n = static_cast<fz::SizeType>(state.arg());
+  return {n, n, n};
+}
+
+auto filled(const Shape& shape) -> fz::Array<double> {
+  auto arr = fz::Array<double>::empty(shape);
+  std::fill(arr.begin(), arr.end(), 1.0);
+  return arr;
+}
+
+auto arrayConstructEmpty(fz::bench::State& state) -> void {
+  const auto shape = cube(state);
+  for (auto _ : state) {
+    auto arr = fz::Array<double>::empty(shape);
+    fz::bench::doNotOptimize(arr.data());
+  }
+}
+
+auto arrayConstructZeros(fz::bench::State& state) -> void {
+  const auto shape = cube(state);
+  for (auto _ : state) {
+    auto arr = fz::Array<double>::zeros(shape);
+    fz::bench::doNotOptimize(arr.data());
+    fz::bench::clobberMemory();
+  }
+}
+
+// what zeros() saves: writing the zeros by hand; large calloc'd blocks are
+// fresh pages that the kernel only zeroes when they are first touched
+auto arrayConstructFillZeros(fz::bench::State& state) -> void {
+  const auto shape = cube(state);
+  for (auto _ : state) {
+    auto arr = fz::Array<double>::empty(shape);
+    std::fill(arr.begin(), arr.end(), 0.0);
+    fz::bench::doNotOptimize(arr.data());
+    fz::bench::clobberMemory();
+  }
+}
+
+// small arrays as particle and material code makes them: 3-vectors from an
+// initializer list and 3 x 3 tensors, a thousand per iteration. The Heap
+// variants use std::vector metadata and an allocator that never stores
+// elements inline, which is what every Array used to cost.
+using HeapArray =
+    fz::Array<double, Shape, Shape, fz::AlignedAllocator<double, 16>>;
+
+constexpr fz::SizeType SMALL_BATCH = 1000;
+
+template <typename A>
+auto smallVectors(fz::bench::State& state) -> void {
+  for (auto _ : state) {
+    for (fz::SizeType i = 0; i < SMALL_BATCH; ++i) {
+      A vec{1.0, 2.0, static_cast<double>(i)};
+      fz::bench::doNotOptimize(vec.data());
+    }
+  }
+}
+
+template <typename A>
+auto smallTensors(fz::bench::State& state) -> void {
+  for (auto _ : state) {
+    for (fz::SizeType i = 0; i < SMALL_BATCH; ++i) {
+      auto tensor = A::empty({3, 3});
+      tensor(1, 1) = static_cast<double>(i);
+      auto moved = std::move(tensor);
+      fz::bench::doNotOptimize(moved.data());
+    }
+  }
+}
+
+auto arraySmallVector(fz::bench::State& state) -> void {
+  smallVectors<fz::Array<double>>(state);
+}
+
+auto arraySmallVectorHeap(fz::bench::State& state) -> void {
+  smallVectors<HeapArray>(state);
+}
+
+auto arraySmallTensor(fz::bench::State& state) -> void {
+  smallTensors<fz::Array<double>>(state);
+}
+
+auto arraySmallTensorHeap(fz::bench::State& state) -> void {
+  smallTensors<HeapArray>(state);
+}
+
+auto arrayIndexOperator(fz::bench::State& state) -> void {
+  auto arr = filled(cube(state));
+  const auto n = arr.shape()[0];
+  state.setBytesProcessed(arr.size() * sizeof(double));
+  for (auto _ : state) {
+    double sum = 0.0;
+    for (fz::SizeType k = 0; k < n; ++k) {
+      for (fz::SizeType j = 0; j < n; ++j) {
+        for (fz::SizeType i = 0; i < n; ++i) {
+          sum += arr(i, j, k);
+        }
+      }
+    }
+    fz::bench::doNotOptimize(sum);
+  }
+}
+
+// the same walk with the offsets computed by hand, the floor for operator()
+auto arrayIndexRawPointer(fz::bench::State& state) -> void {
+  auto arr = filled(cube(state));
+  const auto n = arr.shape()[0];
+  state.setBytesProcessed(arr.size() * sizeof(double));
+  for (auto _ : state) {
+    const double* p = arr.data();
+    double sum = 0.0;
+    for (fz::SizeType k = 0; k < n; ++k) {
+      for (fz::SizeType j = 0; j < n; ++j) {
+        for (fz::SizeType i = 0; i < n; ++i) {
+          sum += p[i + n * (j + n * k)];
+        }
+      }
+    }
+    fz::bench::doNotOptimize(sum);
+  }
+}
+
+auto arrayReshape(fz::bench::State& state) -> void {
+  auto arr = filled(cube(state));
+  const auto n = arr.shape()[0];
+  const Shape flat{n * n, n};
+  const auto original = arr.shape();
+  for (auto _ : state) {
+    arr.reshape(flat);
+    arr.reshape(original);
+    fz::bench::doNotOptimize(arr);
+  }
+}
+
+// alternates between two sizes, so every call reallocates
+auto arrayResize(fz::bench::State& state) -> void {
+  const auto shape = cube(state);
+  const Shape half{shape[0], shape[1], shape[2] / 2};
+  auto arr = fz::Array<double>::empty(shape);
+  for (auto _ : state) {
+    arr.resize(half);
+    arr.resize(shape);
+    fz::bench::doNotOptimize(arr.data());
+  }
+}
+
+auto arrayCopy(fz::bench::State& state) -> void {
+  const auto arr = filled(cube(state));
+  state.setBytesProcessed(2 * arr.size() * sizeof(double));
+  for (auto _ : state) {
+    auto other = arr;
+    fz::bench::doNotOptimize(other.data());
+  }
+}
+
+auto arrayCopyAssign(fz::bench::State& state) -> void {
+  const auto arr = filled(cube(state));
+  auto other = fz::Array<double>::emptyLike(arr);
+  state.setBytesProcessed(2 * arr.size() * sizeof(double));
+  for (auto _ : state) {
+    other = arr;
+    fz::bench::doNotOptimize(other.data());
+  }
+}
+
+// a copy that is never written: shares the buffer instead
+auto arrayCopyCow(fz::bench::State& state) -> void {
+  const fz::CowArray<double> arr = filled(cube(state));
+  for (auto _ : state) {
+    auto other = arr;
+    fz::bench::doNotOptimize(std::as_const(other).data());
+  }
+}
+
+// a shared copy that is then written once: pays the deep copy after all
+auto arrayCopyCowWrite(fz::bench::State& state) -> void {
+  const fz::CowArray<double> arr = filled(cube(state));
+  state.setBytesProcessed(2 * arr.size() * sizeof(double));
+  for (auto _ : state) {
+    auto other = arr;
+    other.data()[0] = 2.0;
+    fz::bench::doNotOptimize(std::as_const(other).data());
+  }
+}
+
+auto arrayMove(fz::bench::State& state) -> void {
+  auto arr = filled(cube(state));
+  for (auto _ : state) {
+    auto other = std::move(arr);
+    arr = std::move(other);
+    fz::bench::doNotOptimize(arr.data());
+  }
+}
+
+}  // namespace
+
+FZ_BENCHMARK_ARGS(arrayConstructEmpty, 16, 256);
+FZ_BENCHMARK_ARGS(arrayConstructZeros, 16, 256);
+FZ_BENCHMARK_ARGS(arrayConstructFillZeros, 16, 256);
+FZ_BENCHMARK(arraySmallVector);
+FZ_BENCHMARK(arraySmallVectorHeap);
+FZ_BENCHMARK(arraySmallTensor);
+FZ_BENCHMARK(arraySmallTensorHeap);
+FZ_BENCHMARK_ARGS(arrayIndexOperator, 16, 256);
+FZ_BENCHMARK_ARGS(arrayIndexRawPointer, 16, 256);
+FZ_BENCHMARK_ARGS(arrayReshape, 16, 256);
+FZ_BENCHMARK_ARGS(arrayResize, 16, 256);
+FZ_BENCHMARK_ARGS(arrayCopy, 16, 256);
+FZ_BENCHMARK_ARGS(arrayCopyAssign, 16, 256);
+FZ_BENCHMARK_ARGS(arrayCopyCow, 16, 256);
+FZ_BENCHMARK_ARGS(arrayCopyCowWrite, 16, 256);
+FZ_BENCHMARK_ARGS(arrayMove, 16, 256);
@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+
+namespace {
+
+constexpr std::size_t N = 128;
+
+template <typename ArrayType>
+auto sweep(fz::bench::State& state) -> void {
+  auto arr = ArrayType::empty({N, N, N});
+  std::fill(arr.begin(), arr.end(), 0.0);
+  state.setBytesProcessed(2 * arr.size() * sizeof(double));
+  for (auto _ : state) {
+    double sum = 0.0;
+    for (std::size_t k = 0; k < N; ++k) {
+      for (std::size_t j = 0; j < N; ++j) {
+        for (std::size_t i = 0; i < N; ++i) {
+          arr(i, j, k) += 1.0;
+          sum += arr(i, j, k);
+        }
+      }
+    }
+    fz::bench::doNotOptimize(sum);
+  }
+}
+
+// Array operator()(i, j, k) over 128^3, shape held in a vector vs an array
+auto sweepDynamicRank(fz::bench::State& state) -> void {
+  sweep<fz::Array<double>>(state);
+}
+
+auto sweepFixedRank(fz::bench::State& state) -> void {
+  sweep<fz::FixedRankArray<double, 3>>(state);
+}
+
+}  // namespace
+
+FZ_BENCHMARK(sweepDynamicRank);
+FZ_BENCHMARK(sweepFixedRank);
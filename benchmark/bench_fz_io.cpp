@@ -0,0 +1,207 @@
+#include <cmath>
+#include <filesystem>
+#include <numeric>
+#include <sstream>
+#include <string>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/io.hpp"
+
+namespace {
+
+// argument: MiB of doubles
+auto checkpoint(const fz::bench::State& state) -> fz::Array<double> {
+  const auto n = static_cast<fz::SizeType>(state.arg()) << 17;
+  auto arr = fz::Array<double>::empty({n / 256, 256});
+  std::iota(arr.begin(), arr.end(), 0.0);
+  return arr;
+}
+
+auto checkpointPath() -> std::string {
+  return (std::filesystem::temp_directory_path() / "fz_bench_io.npy").string();
+}
+
+auto npySave(fz::bench::State& state) -> void {
+  const auto arr = checkpoint(state);
+  const auto path = checkpointPath();
+  for (auto _ : state) {
+    fz::saveNpy(path, arr);
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+  std::filesystem::remove(path);
+}
+
+auto npyLoad(fz::bench::State& state) -> void {
+  const auto path = checkpointPath();
+  fz::saveNpy(path, checkpoint(state));
+  fz::SizeType bytes = 0;
+  for (auto _ : state) {
+    auto arr = fz::loadNpy<double>(path);
+    bytes = arr.size() * sizeof(double);
+    fz::bench::doNotOptimize(arr.data());
+  }
+  state.setBytesProcessed(bytes);
+  std::filesystem::remove(path);
+}
+
+// map and touch one element per page: what a restart pays before compute
+auto npyMap(fz::bench::State& state) -> void {
+  const auto path = checkpointPath();
+  fz::saveNpy(path, checkpoint(state));
+  fz::SizeType bytes = 0;
+  for (auto _ : state) {
+    const auto mapped = fz::mapNpy<const double>(path);
+    double sum = 0.0;
+    for (fz::SizeType i = 0; i < mapped.size(); i += 512) {
+      sum += mapped.data()[i];
+    }
+    bytes = mapped.size() * sizeof(double);
+    fz::bench::doNotOptimize(sum);
+  }
+  state.setBytesProcessed(bytes);
+  std::filesystem::remove(path);
+}
+
+auto chunkedPath() -> std::string {
+  return (std::filesystem::temp_directory_path() / "fz_bench_io.fzc").string();
+}
+
+// 64 MiB in 1 MiB chunks
+auto chunkedInput() -> fz::ChunkedArray<double> {
+  const auto path = chunkedPath();
+  auto arr = fz::Array<double>::empty({1024, 8192});
+  std::iota(arr.begin(), arr.end(), 0.0);
+  fz::saveChunked(path, arr, {1024, 128});
+  return fz::ChunkedArray<double>::open(path);
+}
+
+auto work(const double* data, fz::SizeType n) -> double {
+  double sum = 0.0;
+  for (fz::SizeType i = 0; i < n; ++i) {
+    sum += std::sqrt(data[i]);
+  }
+  return sum;
+}
+
+auto chunkedBlocking(fz::bench::State& state) -> void {
+  const auto chunked = chunkedInput();
+  auto buffer = fz::Array<double>::empty({chunked.chunkCapacity()});
+  for (auto _ : state) {
+    double sum = 0.0;
+    for (fz::SizeType k = 0; k < chunked.chunkCount(); ++k) {
+      chunked.readChunk(k, buffer.data());
+      sum += work(buffer.data(), buffer.size());
+    }
+    fz::bench::doNotOptimize(sum);
+  }
+  state.setBytesProcessed(chunked.chunkCount() * buffer.size() *
+                          sizeof(double));
+  std::filesystem::remove(chunkedPath());
+}
+
+// argument: buffers in the prefetch ring
+auto chunkedPrefetch(fz::bench::State& state) -> void {
+  const auto chunked = chunkedInput();
+  const auto depth = static_cast<fz::SizeType>(state.arg());
+  for (auto _ : state) {
+    double sum = 0.0;
+    fz::forEachChunk(
+        chunked,
+        [&](const fz::Chunk<double>& chunk) {
+          sum += work(chunk.view.data(), chunk.view.size());
+        },
+        depth);
+    fz::bench::doNotOptimize(sum);
+  }
+  state.setBytesProcessed(chunked.chunkCount() * chunked.chunkCapacity() *
+                          sizeof(double));
+  std::filesystem::remove(chunkedPath());
+}
+
+// a solver step's worth of compute between checkpoints
+auto relax(fz::Array<double>& field) -> void {
+  for (int sweep = 0; sweep < 4; ++sweep) {
+    for (auto& v : field) {
+      v = 0.5 * v + std::sqrt(v + 1.0);
+    }
+  }
+  fz::bench::clobberMemory();
+}
+
+// argument: MiB per checkpoint; the step runs on a separate 8 MiB field
+auto checkpointBlocking(fz::bench::State& state) -> void {
+  const auto arr = checkpoint(state);
+  auto field = fz::Array<double>::zeros({1 << 20});
+  const auto path = checkpointPath();
+  for (auto _ : state) {
+    fz::saveNpy(path, arr);
+    relax(field);
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+  std::filesystem::remove(path);
+}
+
+// argument: as above, with the checkpoint draining during the step
+auto checkpointAsync(fz::bench::State& state) -> void {
+  const auto arr = checkpoint(state);
+  auto field = fz::Array<double>::zeros({1 << 20});
+  const auto path = checkpointPath();
+  fz::AsyncIo io;
+  for (auto _ : state) {
+    auto handle = fz::saveNpyAsync(io, path, arr);
+    relax(field);
+    handle.wait();
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+  std::filesystem::remove(path);
+}
+
+// 8 MiB of doubles as CSV: an ostream loop against the to_chars formatter
+auto csvInput() -> fz::Array<double> {
+  auto arr = fz::Array<double>::empty({1 << 17, 8});
+  for (fz::SizeType i = 0; i < arr.size(); ++i) {
+    arr.data()[i] = std::sqrt(static_cast<double>(i));
+  }
+  return arr;
+}
+
+auto csvStream(fz::bench::State& state) -> void {
+  const auto arr = csvInput();
+  std::ostringstream os;
+  os.precision(17);
+  for (auto _ : state) {
+    os.str("");
+    for (fz::SizeType i = 0; i < arr.shape()[0]; ++i) {
+      for (fz::SizeType j = 0; j < arr.shape()[1]; ++j) {
+        os << (j == 0 ? "" : ",") << arr(i, j);
+      }
+      os << '\n';
+    }
+    fz::bench::doNotOptimize(os.tellp());
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+}
+
+auto csvWrite(fz::bench::State& state) -> void {
+  const auto arr = csvInput();
+  std::ostringstream os;
+  for (auto _ : state) {
+    os.str("");
+    fz::writeCsv(os, arr);
+    fz::bench::doNotOptimize(os.tellp());
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+}
+
+}  // namespace
+
+FZ_BENCHMARK_ARGS(npySave, 1, 64);
+FZ_BENCHMARK_ARGS(npyLoad, 1, 64);
+FZ_BENCHMARK_ARGS(npyMap, 1, 64);
+FZ_BENCHMARK(chunkedBlocking);
+FZ_BENCHMARK_ARGS(chunkedPrefetch, 2, 3);
+FZ_BENCHMARK_ARGS(checkpointBlocking, 64);
+FZ_BENCHMARK_ARGS(checkpointAsync, 64);
+FZ_BENCHMARK(csvStream);
+FZ_BENCHMARK(csvWrite);
@@ -0,0 +1,84 @@
+#include <cstddef>
+#include <numeric>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/layout.hpp"
+
+namespace {
+
+// argument: edge of a square matrix of doubles; 2048^2 is 32 MiB
+auto matrix(const fz::bench::State& state) -> fz::Array<double> {
+  const auto n = static_cast<fz::SizeType>(state.arg());
+  auto arr = fz::Array<double>::empty({n, n});
+  std::iota(arr.begin(), arr.end(), 0.0);
+  return arr;
+}
+
+// the element-by-element loop the blocked kernels replace
+auto transposeNaive(fz::bench::State& state) -> void {
+  const auto arr = matrix(state);
+  auto out = fz::Array<double>::empty(arr.shape());
+  const auto n = arr.shape()[0];
+  for (auto _ : state) {
+    for (fz::SizeType j = 0; j < n; ++j) {
+      for (fz::SizeType i = 0; i < n; ++i) {
+        out(j, i) = arr(i, j);
+      }
+    }
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+}
+
+auto transposeBlocked(fz::bench::State& state) -> void {
+  const auto arr = matrix(state);
+  for (auto _ : state) {
+    auto out = fz::transpose(arr);
+    fz::bench::doNotOptimize(out.data());
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+}
+
+auto transposeSquareInPlace(fz::bench::State& state) -> void {
+  auto arr = matrix(state);
+  for (auto _ : state) {
+    fz::transposeInPlace(arr);
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+}
+
+// a C-order matrix brought to Fortran order, out of place and in place
+auto relayoutCopy(fz::bench::State& state) -> void {
+  const auto arr = fz::toLayout(matrix(state), fz::Layout::kRowMajor);
+  for (auto _ : state) {
+    auto out = fz::toLayout(arr, fz::Layout::kColumnMajor);
+    fz::bench::doNotOptimize(out.data());
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+}
+
+// argument: rows of a 1024-column matrix, so the in-place path follows
+// cycles instead of swapping tiles
+auto relayoutInPlace(fz::bench::State& state) -> void {
+  const auto rows = static_cast<fz::SizeType>(state.arg());
+  auto arr = fz::Array<double>::empty({rows, 1024});
+  std::iota(arr.begin(), arr.end(), 0.0);
+  auto layout = fz::Layout::kRowMajor;
+  for (auto _ : state) {
+    fz::relayout(arr, layout);
+    layout = layout == fz::Layout::kRowMajor ? fz::Layout::kColumnMajor
+                                             : fz::Layout::kRowMajor;
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(arr.size() * sizeof(double));
+}
+
+}  // namespace
+
+FZ_BENCHMARK_ARGS(transposeNaive, 512, 2048);
+FZ_BENCHMARK_ARGS(transposeBlocked, 512, 2048);
+FZ_BENCHMARK_ARGS(transposeSquareInPlace, 512, 2048);
+FZ_BENCHMARK_ARGS(relayoutCopy, 512, 2048);
+FZ_BENCHMARK_ARGS(relayoutInPlace, 512, 2048);
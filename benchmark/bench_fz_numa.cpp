@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/parallel/numa.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/parallel/thread_pool.hpp"
+
+namespace {
+
+// three 128 MiB vectors, far beyond the last-level cache
+constexpr fz::SizeType N = fz::SizeType{1} << 24;
+
+const fz::ParallelOptions STATIC{.schedule = fz::Schedule::kStatic};
+
+// STREAM triad a = b + s * c on the global pool, static schedule. Only the
+// placement of the pages differs between the variants; on a single-node
+// machine they all run at the same speed.
+template <typename A>
+auto triad(fz::bench::State& state, A& a, const A& b, const A& c) -> void {
+  auto* pa = a.data();
+  const auto* pb = b.data();
+  const auto* pc = c.data();
+  for (auto _ : state) {
+    fz::parallelFor(
+        0, N,
+        [&](fz::SizeType lo, fz::SizeType hi) {
+          for (auto i = lo; i < hi; ++i) {
+            pa[i] = pb[i] + 3.0 * pc[i];
+          }
+        },
+        STATIC);
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(3 * N * sizeof(double));
+}
+
+// what a plain Array gets: one thread touches every page, all on its node
+auto numaTriadSerialInit(fz::bench::State& state) -> void {
+  auto a = fz::Array<double>::empty({N});
+  auto b = fz::Array<double>::empty({N});
+  auto c = fz::Array<double>::empty({N});
+  std::fill(a.begin(), a.end(), 0.0);
+  std::fill(b.begin(), b.end(), 1.0);
+  std::fill(c.begin(), c.end(), 2.0);
+  triad(state, a, b, c);
+}
+
+template <fz::NumaPolicy Policy>
+auto numaTriad(fz::bench::State& state) -> void {
+  const fz::NumaAllocator<double> alloc{{.policy = Policy}};
+  auto a = fz::NumaArray<double>::zeros({N}, alloc);
+  auto b = fz::NumaArray<double>::zeros({N}, alloc);
+  auto c = fz::NumaArray<double>::zeros({N}, alloc);
+  // written by the static schedule, as a solver's initialisation would be
+  fz::parallelFor(
+      0, N,
+      [&](fz::SizeType i) {
+        a.data()[i] = 0.0;
+        b.data()[i] = 1.0;
+        c.data()[i] = 2.0;
+      },
+      STATIC);
+  triad(state, a, b, c);
+}
+
+auto numaTriadFirstTouch(fz::bench::State& state) -> void {
+  numaTriad<fz::NumaPolicy::kFirstTouch>(state);
+}
+
+auto numaTriadInterleave(fz::bench::State& state) -> void {
+  numaTriad<fz::NumaPolicy::kInterleave>(state);
+}
+
+}  // namespace
+
+FZ_BENCHMARK(numaTriadSerialInit);
+FZ_BENCHMARK(numaTriadFirstTouch);
+FZ_BENCHMARK(numaTriadInterleave);
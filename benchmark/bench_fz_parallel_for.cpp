@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/parallel/thread_pool.hpp"
+
+namespace {
+
+constexpr std::size_t N = 256;
+
+using Field = fz::FixedRankArray<double, 3>;
+
+// argument: number of threads, the scaling is read across the arguments
+template <typename Step>
+auto scaling(fz::bench::State& state, Step step) -> void {
+  const auto threads = static_cast<fz::SizeType>(state.arg());
+  if (fz::ThreadPool::defaultConcurrency() < threads) {
+    state.skip("not enough cores");
+    return;
+  }
+  auto x = Field::empty({N, N, N});
+  auto y = Field::empty({N, N, N});
+  std::fill(x.begin(), x.end(), 0.25);
+  std::fill(y.begin(), y.end(), 1.0);
+  fz::ThreadPool pool{threads};
+  state.setBytesProcessed(2 * x.size() * sizeof(double));
+  for (auto _ : state) {
+    step(y, x, pool);
+    fz::bench::clobberMemory();
+  }
+}
+
+// light work per element: bandwidth bound
+auto axpy(fz::bench::State& state) -> void {
+  scaling(state, [](Field& y, const Field& x, fz::ThreadPool& pool) {
+    fz::parallelFor(
+        0, y.size(),
+        [&](fz::SizeType lo, fz::SizeType hi) {
+          for (auto i = lo; i < hi; ++i) {
+            y.data()[i] += 0.5 * x.data()[i];
+          }
+        },
+        {.pool = &pool});
+  });
+}
+
+// heavy work per element, iterated through N-D blocks
+auto transcendental(fz::bench::State& state) -> void {
+  scaling(state, [](Field& y, const Field& x, fz::ThreadPool& pool) {
+    fz::parallelFor(
+        y,
+        [&](const auto& block) {
+          block.forEach([&](const auto& index) {
+            auto v = x(index[0], index[1], index[2]);
+            y(index[0], index[1], index[2]) = std::sin(v) * std::exp(-v);
+          });
+        },
+        {.pool = &pool});
+  });
+}
+
+}  // namespace
+
+FZ_BENCHMARK_ARGS(axpy, 1, 2, 4, 8, 16);
+FZ_BENCHMARK_ARGS(transcendental, 1, 2, 4, 8, 16);
@@ -0,0 +1,29 @@
+#include "fz/bench/harness.hpp"
+#include "fz/parallel/profiler.hpp"
+
+namespace {
+
+// cost of one zone, opened and closed; the buffer is emptied outside the
+// timed span before it fills up
+auto profileZone(fz::bench::State& state) -> void {
+  auto& profiler = fz::Profiler::instance();
+  profiler.clear();
+  fz::SizeType recorded = 0;
+  for (auto _ : state) {
+    {
+      fz::ProfileZone zone{"zone"};
+      fz::bench::clobberMemory();
+    }
+    if (++recorded == fz::ProfileBuffer::CAPACITY) {
+      state.pauseTiming();
+      profiler.clear();
+      recorded = 0;
+      state.resumeTiming();
+    }
+  }
+  profiler.clear();
+}
+
+}  // namespace
+
+FZ_BENCHMARK(profileZone);
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <string>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/simd/simd.hpp"
+
+namespace {
+
+// L2-resident and DRAM-resident
+constexpr std::int64_t SMALL = 1 << 15;
+constexpr std::int64_t LARGE = 1 << 25;
+
+auto input(fz::bench::State& state, double value) -> fz::Array<double> {
+  auto x = fz::Array<double>::empty({static_cast<fz::SizeType>(state.arg())});
+  std::fill(x.begin(), x.end(), value);
+  return x;
+}
+
+auto stdReduce(fz::bench::State& state) -> void {
+  auto x = input(state, 1.5);
+  state.setBytesProcessed(x.size() * sizeof(double));
+  for (auto _ : state) {
+    fz::bench::doNotOptimize(std::reduce(x.begin(), x.end()));
+  }
+}
+
+// every kernel at the best isa the machine has
+template <typename Kernel>
+auto simdKernel(fz::bench::State& state, fz::SizeType streams, Kernel kernel)
+    -> void {
+  auto x = input(state, 1.5);
+  auto y = input(state, 0.5);
+  state.setBytesProcessed(streams * x.size() * sizeof(double));
+  for (auto _ : state) {
+    fz::bench::doNotOptimize(kernel(x, y));
+  }
+}
+
+auto simdSum(fz::bench::State& state) -> void {
+  simdKernel(state, 1, [](const auto& x, const auto&) {
+    return fz::simd::sum(x);
+  });
+}
+
+auto simdSumReproducible(fz::bench::State& state) -> void {
+  simdKernel(state, 1, [](const auto& x, const auto&) {
+    return fz::simd::sum(x, fz::simd::Reduction::kReproducible);
+  });
+}
+
+auto simdDot(fz::bench::State& state) -> void {
+  simdKernel(state, 2, [](const auto& x, const auto& y) {
+    return fz::simd::dot(x, y);
+  });
+}
+
+// the scalar fallback, for the speedup of the vector paths
+auto scalarSum(fz::bench::State& state) -> void {
+  const auto detected = fz::simd::activeIsa();
+  fz::simd::setActiveIsa(fz::simd::Isa::kScalar);
+  simdSum(state);
+  fz::simd::setActiveIsa(detected);
+}
+
+}  // namespace
+
+FZ_BENCHMARK_ARGS(stdReduce, SMALL, LARGE);
+FZ_BENCHMARK_ARGS(scalarSum, SMALL, LARGE);
+FZ_BENCHMARK_ARGS(simdSum, SMALL, LARGE);
+FZ_BENCHMARK_ARGS(simdSumReproducible, SMALL, LARGE);
+FZ_BENCHMARK_ARGS(simdDot, SMALL, LARGE);
@@ -0,0 +1,191 @@
+#include <cmath>
+#include <cstddef>
+#include <random>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/sparse.hpp"
+
+namespace {
+
+// right-hand sides of the spmm variants
+constexpr fz::SizeType K = 8;
+
+// 5-point Laplacian on a square grid of n points: a band of five diagonals
+auto banded(fz::SizeType n) -> fz::CsrMatrix<double> {
+  const auto m = static_cast<fz::SizeType>(std::sqrt(static_cast<double>(n)));
+  fz::CooMatrix<double> coo{m * m, m * m};
+  coo.reserve(5 * m * m);
+  for (fz::SizeType j = 0; j < m; ++j) {
+    for (fz::SizeType i = 0; i < m; ++i) {
+      const auto row = i + j * m;
+      coo.add(row, row, 4.0);
+      if (0 < i) {
+        coo.add(row, row - 1, -1.0);
+      }
+      if (i + 1 < m) {
+        coo.add(row, row + 1, -1.0);
+      }
+      if (0 < j) {
+        coo.add(row, row - m, -1.0);
+      }
+      if (j + 1 < m) {
+        coo.add(row, row + m, -1.0);
+      }
+    }
+  }
+  return fz::CsrMatrix<double>{coo};
+}
+
+// 16 uniformly scattered entries per row: every read of x misses the cache
+// once x does not fit
+auto random(fz::SizeType n) -> fz::CsrMatrix<double> {
+  std::mt19937_64 gen{42};
+  std::uniform_int_distribution<fz::SizeType> col{0, n - 1};
+  fz::CooMatrix<double> coo{n, n};
+  coo.reserve(16 * n);
+  for (fz::SizeType row = 0; row < n; ++row) {
+    for (int k = 0; k < 16; ++k) {
+      coo.add(row, col(gen), 1.0);
+    }
+  }
+  return fz::CsrMatrix<double>{coo};
+}
+
+// values and column indices once, x and y once per right-hand side
+auto bytes(const fz::CsrMatrix<double>& a, fz::SizeType k) -> fz::SizeType {
+  return a.nnz() * (sizeof(double) + sizeof(fz::SparseIndex)) +
+         k * (a.rows() + a.cols()) * sizeof(double);
+}
+
+auto operand(fz::SizeType n, fz::SizeType k,
+             fz::Layout layout = fz::Layout::kColumnMajor)
+    -> fz::Array<double> {
+  auto x = fz::Array<double>::empty({n, k}, layout);
+  for (fz::SizeType i = 0; i < x.size(); ++i) {
+    x.data()[i] = static_cast<double>(i % 13);
+  }
+  return x;
+}
+
+// the loop everyone writes first: serial, one row at a time
+template <auto Pattern>
+auto sparseNaive(fz::bench::State& state) -> void {
+  const auto a = Pattern(static_cast<fz::SizeType>(state.arg()));
+  const auto x = operand(a.cols(), 1);
+  auto y = fz::Array<double>::empty({a.rows()});
+  const auto* offsets = a.rowOffsets().data();
+  const auto* columns = a.columns().data();
+  const auto* values = a.values().data();
+  for (auto _ : state) {
+    for (fz::SizeType row = 0; row < a.rows(); ++row) {
+      double sum = 0;
+      for (auto k = offsets[row]; k < offsets[row + 1]; ++k) {
+        sum += values[k] * x.data()[columns[k]];
+      }
+      y.data()[row] = sum;
+    }
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(bytes(a, 1));
+}
+
+template <typename Matrix, auto Pattern>
+auto sparseSpmv(fz::bench::State& state) -> void {
+  const auto csr = Pattern(static_cast<fz::SizeType>(state.arg()));
+  const Matrix a{csr};
+  const auto x = operand(a.cols(), 1);
+  auto y = fz::Array<double>::empty({a.rows()});
+  for (auto _ : state) {
+    fz::spmv(a, x, y);
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(bytes(csr, 1));
+}
+
+template <typename Matrix, auto Pattern,
+          fz::Layout Layout = fz::Layout::kColumnMajor>
+auto sparseSpmm(fz::bench::State& state) -> void {
+  const auto csr = Pattern(static_cast<fz::SizeType>(state.arg()));
+  const Matrix a{csr};
+  const auto x = operand(a.cols(), K, Layout);
+  auto y = fz::Array<double>::empty({a.rows(), K}, Layout);
+  for (auto _ : state) {
+    fz::spmm(a, x, y);
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(bytes(csr, K));
+}
+
+using Csr = fz::CsrMatrix<double>;
+using Sell = fz::SellMatrix<double>;
+
+auto sparseBandedNaive(fz::bench::State& state) -> void {
+  sparseNaive<banded>(state);
+}
+
+auto sparseBandedCsr(fz::bench::State& state) -> void {
+  sparseSpmv<Csr, banded>(state);
+}
+
+auto sparseBandedSell(fz::bench::State& state) -> void {
+  sparseSpmv<Sell, banded>(state);
+}
+
+auto sparseBandedCsrSpmm(fz::bench::State& state) -> void {
+  sparseSpmm<Csr, banded>(state);
+}
+
+auto sparseBandedSellSpmm(fz::bench::State& state) -> void {
+  sparseSpmm<Sell, banded>(state);
+}
+
+auto sparseBandedCsrSpmmRows(fz::bench::State& state) -> void {
+  sparseSpmm<Csr, banded, fz::Layout::kRowMajor>(state);
+}
+
+auto sparseRandomNaive(fz::bench::State& state) -> void {
+  sparseNaive<random>(state);
+}
+
+auto sparseRandomCsr(fz::bench::State& state) -> void {
+  sparseSpmv<Csr, random>(state);
+}
+
+auto sparseRandomSell(fz::bench::State& state) -> void {
+  sparseSpmv<Sell, random>(state);
+}
+
+auto sparseRandomCsrSpmm(fz::bench::State& state) -> void {
+  sparseSpmm<Csr, random>(state);
+}
+
+auto sparseRandomSellSpmm(fz::bench::State& state) -> void {
+  sparseSpmm<Sell, random>(state);
+}
+
+auto sparseRandomCsrSpmmRows(fz::bench::State& state) -> void {
+  sparseSpmm<Csr, random, fz::Layout::kRowMajor>(state);
+}
+
+auto sparseRandomSellSpmmRows(fz::bench::State& state) -> void {
+  sparseSpmm<Sell, random, fz::Layout::kRowMajor>(state);
+}
+
+}  // namespace
+
+// argument: rows; 2^16 keeps x in L2, 2^20 rows of x (8 MiB) and the matrix
+// (60-190 MiB) do not fit in the last-level cache
+FZ_BENCHMARK_ARGS(sparseBandedNaive, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseBandedCsr, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseBandedSell, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseBandedCsrSpmm, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseBandedSellSpmm, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseBandedCsrSpmmRows, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseRandomNaive, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseRandomCsr, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseRandomSell, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseRandomCsrSpmm, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseRandomSellSpmm, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseRandomCsrSpmmRows, 1 << 16, 1 << 20);
+FZ_BENCHMARK_ARGS(sparseRandomSellSpmmRows, 1 << 16, 1 << 20);
@@ -0,0 +1,86 @@
+#include <cstddef>
+#include <utility>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/stencil.hpp"
+
+namespace {
+
+using Grid = fz::FixedRankArray<double, 3>;
+
+constexpr fz::SizeType STEPS = 8;
+
+// argument: edge of the cubic grid including a one-point halo; 64^3 doubles
+// fit in L2/L3, two 256^3 grids (256 MiB) do not fit in the last-level cache
+auto grid(const fz::bench::State& state) -> Grid {
+  const auto n = static_cast<fz::SizeType>(state.arg());
+  auto arr = Grid::empty({n, n, n});
+  for (fz::SizeType i = 0; i < arr.size(); ++i) {
+    arr.data()[i] = static_cast<double>(i % 97);
+  }
+  return arr;
+}
+
+const auto HEAT = fz::makeStencil<3>(1, [](const auto& u) {
+  return u(0, 0, 0) + 0.1 * (u(-1, 0, 0) + u(1, 0, 0) + u(0, -1, 0) +
+                             u(0, 1, 0) + u(0, 0, -1) + u(0, 0, 1) -
+                             6 * u(0, 0, 0));
+});
+
+auto bytes(const Grid& u) -> fz::SizeType {
+  // a read and a write of every point per step
+  return 2 * STEPS * u.size() * sizeof(double);
+}
+
+// the loop the engine replaces: element access, one pass per step
+auto stencilNaive(fz::bench::State& state) -> void {
+  auto u = grid(state);
+  auto v = u;
+  const auto n = u.shape()[0];
+  for (auto _ : state) {
+    for (fz::SizeType s = 0; s < STEPS; ++s) {
+      for (fz::SizeType k = 1; k + 1 < n; ++k) {
+        for (fz::SizeType j = 1; j + 1 < n; ++j) {
+          for (fz::SizeType i = 1; i + 1 < n; ++i) {
+            v(i, j, k) = u(i, j, k) +
+                         0.1 * (u(i - 1, j, k) + u(i + 1, j, k) +
+                                u(i, j - 1, k) + u(i, j + 1, k) +
+                                u(i, j, k - 1) + u(i, j, k + 1) -
+                                6 * u(i, j, k));
+          }
+        }
+      }
+      std::swap(u, v);
+    }
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(bytes(u));
+}
+
+template <fz::SizeType Block>
+auto stencilAdvance(fz::bench::State& state) -> void {
+  auto u = grid(state);
+  auto scratch = u;
+  for (auto _ : state) {
+    fz::advanceStencil(HEAT, u, scratch, STEPS,
+                       {.boundary = fz::Boundary::kClamp,
+                        .time_block = Block});
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(bytes(u));
+}
+
+auto stencilStepwise(fz::bench::State& state) -> void {
+  stencilAdvance<1>(state);
+}
+
+auto stencilTemporalBlocked(fz::bench::State& state) -> void {
+  stencilAdvance<STEPS>(state);
+}
+
+}  // namespace
+
+FZ_BENCHMARK_ARGS(stencilNaive, 64, 256);
+FZ_BENCHMARK_ARGS(stencilStepwise, 64, 256);
+FZ_BENCHMARK_ARGS(stencilTemporalBlocked, 64, 256);
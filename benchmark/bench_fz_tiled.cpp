@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/bench/harness.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/tiled.hpp"
+
+namespace {
+
+using Dense = fz::FixedRankArray<double, 3>;
+template <fz::TileOrder Order>
+using Tiled = fz::TiledArray<double, 3, 8, Order>;
+
+// 7-point: centre and faces; 27-point: plus edges and corners
+constexpr std::array<double, 4> WEIGHTS = {0.4, 0.1, 0.0, 0.0};
+constexpr std::array<double, 4> WEIGHTS27 = {0.3, 0.06, 0.02, 0.005};
+
+// argument: edge of the cubic grid; 64^3 doubles fit in L2/L3, 256^3
+// (128 MiB a grid) is larger than the last-level cache
+auto grid(const fz::bench::State& state) -> Dense {
+  const auto n = static_cast<fz::SizeType>(state.arg());
+  auto arr = Dense::empty({n, n, n});
+  for (fz::SizeType i = 0; i < arr.size(); ++i) {
+    arr.data()[i] = static_cast<double>(i % 97);
+  }
+  return arr;
+}
+
+// one output point from a block with strides 1, sy, sz around c
+template <bool Full>
+inline auto point(const double* c, fz::SizeType sy, fz::SizeType sz)
+    -> double {
+  if constexpr (!Full) {
+    return WEIGHTS[0] * c[0] +
+           WEIGHTS[1] * (c[-1] + c[1] + c[-static_cast<std::ptrdiff_t>(sy)] +
+                         c[sy] + c[-static_cast<std::ptrdiff_t>(sz)] + c[sz]);
+  } else {
+    double sum = 0.0;
+    for (int z = -1; z <= 1; ++z) {
+      for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+          const auto ring = (x != 0) + (y != 0) + (z != 0);
+          sum += WEIGHTS27[ring] *
+                 c[x + y * static_cast<std::ptrdiff_t>(sy) +
+                   z * static_cast<std::ptrdiff_t>(sz)];
+        }
+      }
+    }
+    return sum;
+  }
+}
+
+// interior sweep over the linear layout, one z-plane per task
+template <bool Full>
+auto denseStencil(fz::bench::State& state) -> void {
+  const auto in = grid(state);
+  auto out = Dense::zeros(in.shape());
+  const auto n = in.shape()[0];
+  const auto sy = n;
+  const auto sz = n * n;
+  for (auto _ : state) {
+    fz::parallelFor(1, n - 1, [&](fz::SizeType k) {
+      for (fz::SizeType j = 1; j + 1 < n; ++j) {
+        const auto* src = in.data() + j * sy + k * sz;
+        auto* dst = out.data() + j * sy + k * sz;
+        for (fz::SizeType i = 1; i + 1 < n; ++i) {
+          dst[i] = point<Full>(src + i, sy, sz);
+        }
+      }
+    });
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(in.size() * sizeof(double));
+}
+
+// brick by brick: gather the brick and a one-element halo into a small dense
+// block, then run the same point kernel on it
+template <bool Full, fz::TileOrder Order>
+auto tiledStencil(fz::bench::State& state) -> void {
+  using Arr = Tiled<Order>;
+  using Tile = typename Arr::Tile;
+  constexpr auto EDGE = Arr::EDGE;
+  constexpr fz::SizeType SIDE = EDGE + 2;
+  const auto in = Arr::from(grid(state));
+  auto out = Arr::zeros(in.shape());
+  const auto n = in.shape()[0];
+  for (auto _ : state) {
+    fz::parallelFor(0, out.tileCount(), [&](fz::SizeType b) {
+      thread_local std::vector<double> block(SIDE * SIDE * SIDE);
+      const auto tile = out.tile(b);
+      in.gather(b, 1, block.data(), Full);
+      std::array<fz::SizeType, 3> lo{};
+      std::array<fz::SizeType, 3> hi{};
+      for (fz::SizeType d = 0; d < 3; ++d) {
+        lo[d] = tile.origin()[d] == 0 ? 1 : 0;
+        hi[d] = std::min(EDGE, n - 1 - tile.origin()[d]);
+      }
+      for (auto k = lo[2]; k < hi[2]; ++k) {
+        for (auto j = lo[1]; j < hi[1]; ++j) {
+          const auto* src = block.data() + 1 + (j + 1) * SIDE +
+                            (k + 1) * SIDE * SIDE;
+          auto* dst =
+              tile.data() + Tile::spread(1, j) + Tile::spread(2, k);
+          for (auto i = lo[0]; i < hi[0]; ++i) {
+            dst[Tile::spread(0, i)] = point<Full>(src + i, SIDE, SIDE * SIDE);
+          }
+        }
+      }
+    });
+    fz::bench::clobberMemory();
+  }
+  state.setBytesProcessed(in.size() * sizeof(double));
+}
+
+auto stencil7Dense(fz::bench::State& state) -> void {
+  denseStencil<false>(state);
+}
+
+auto stencil7Tiled(fz::bench::State& state) -> void {
+  tiledStencil<false, fz::TileOrder::kLinear>(state);
+}
+
+auto stencil7Morton(fz::bench::State& state) -> void {
+  tiledStencil<false, fz::TileOrder::kMorton>(state);
+}
+
+auto stencil27Dense(fz::bench::State& state) -> void {
+  denseStencil<true>(state);
+}
+
+auto stencil27Tiled(fz::bench::State& state) -> void {
+  tiledStencil<true, fz::TileOrder::kLinear>(state);
+}
+
+auto stencil27Morton(fz::bench::State& state) -> void {
+  tiledStencil<true, fz::TileOrder::kMorton>(state);
+}
+
+}  // namespace
+
+FZ_BENCHMARK_ARGS(stencil7Dense, 64, 256);
+FZ_BENCHMARK_ARGS(stencil7Tiled, 64, 256);
+FZ_BENCHMARK_ARGS(stencil7Morton, 64, 256);
+FZ_BENCHMARK_ARGS(stencil27Dense, 64, 256);
+FZ_BENCHMARK_ARGS(stencil27Tiled, 64, 256);
+FZ_BENCHMARK_ARGS(stencil27Morton, 64, 256);
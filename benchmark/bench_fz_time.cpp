@@ -0,0 +1,39 @@
+#include <chrono>
+
+#include "fz/bench/harness.hpp"
+#include "fz/util/time.hpp"
+
+namespace {
+
+// cost of one clock read
+template <typename Clock>
+auto clockNow(fz::bench::State& state) -> void {
+  for (auto _ : state) {
+    fz::bench::doNotOptimize(Clock::now());
+  }
+}
+
+auto steadyClockNow(fz::bench::State& state) -> void {
+  clockNow<std::chrono::steady_clock>(state);
+}
+
+auto highResolutionClockNow(fz::bench::State& state) -> void {
+  clockNow<std::chrono::high_resolution_clock>(state);
+}
+
+auto tscClockNow(fz::bench::State& state) -> void {
+  clockNow<fz::TscClock>(state);
+}
+
+auto tscClockTicks(fz::bench::State& state) -> void {
+  for (auto _ : state) {
+    fz::bench::doNotOptimize(fz::TscClock::ticks());
+  }
+}
+
+}  // namespace
+
+FZ_BENCHMARK(steadyClockNow);
+FZ_BENCHMARK(highResolutionClockNow);
+FZ_BENCHMARK(tscClockNow);
+FZ_BENCHMARK(tscClockTicks);
@@ -0,0 +1,5 @@
+#include "fz/bench/harness.hpp"
+
+auto main(int argc, char** argv) -> int {
+  return fz::bench::main(argc, argv);
+}
@@ -1,180 +1,411 @@
-// #ifndef __FZ_ALLOCATOR_H__
-// #define __FZ_ALLOCATOR_H__
-
-// #include <cstddef>
-// #include <iostream>
-// #include <limits>
-// #include <new>
-// #include <sstream>
-
-// #include "fz/memory.hpp"
-
-// namespace fz {
-
-// #if FZ_DEBUG
-// #define FZ_DEBUG_PRINT(x) std::cout << (x) << '\n'
-// #else
-// #define FZ_DEBUG_PRINT(x)
-// #endif
-
-// template <typename T>
-// class Allocator {
-//  public:
-//   using value_type = T;
-//   using pointer = T*;
-//   using const_pointer = const T*;
-//   using reference = T&;
-//   using const_reference = const T&;
-//   using size_type = std::size_t;
-//   using difference_type = std::ptrdiff_t;
-
-//   template <typename U>
-//   struct Rebind {
-//     using other = Allocator<U>;
-//   };
-
-//  public:
-//   Allocator();
-
-//   Allocator(const Allocator& other);
-
-//   Allocator(Allocator&& other) noexcept;
-
-//   ~Allocator() = default;
-
-//  public:
-//   // basic functions
-
-//   /**
-//    * @brief Allocate memory for n objects of type T
-//    *
-//    * @param n: The number of objects to allocate memory for
-//    * @param hint: A pointer to a nearby memory location that might help the
-//    * @return pointer: A pointer to the first object in the allocated memory
-//    */
-//   auto allocate(size_type n, const void* hint = nullptr) -> pointer;
-
-//   /**
-//    * @brief Deallocate memory for n objects of type T
-//    *
-//    * @param p: A pointer to the first object in the allocated memory
-//    * @param n: The number of objects to deallocate memory for
-//    */
-//   auto deallocate(pointer p, size_type n) -> void;
-
-//   /**
-//    * @brief Deconstruct the object pointed to by p
-//    *
-//    * @param p: A pointer to the object to destroy
-//    */
-//   auto destroy(pointer p) -> void;
-
-//  public:
-//   // template <typename... Args>
-//   // auto constructAt(pointer p, Args&&... args) -> void;
-
-//   // [[nodiscard]] auto maxSize() const -> size_type;
-
-//   // [[nodiscard]] auto address(reference x) const -> pointer;
-
-//   // [[nodiscard]] auto constAddress(const_reference x) const -> const_pointer;
-
-//  private:
-//   static auto fzAllocate(size_type n, T* hint) -> pointer;
-
-//   static auto fzDeallocate(pointer p) -> void;
-
-//   template <typename... Args>
-//   static auto fzConstructAt(pointer p, Args&&... args) -> void;
-
-//   static auto fzDestroy(pointer p) -> void;
-// };
-
-// template <typename T>
-// auto Allocator<T>::fzAllocate(size_type n, T* hint) -> pointer {
-//   std::stringstream ss;
-//   ss << "Allocating memory for " << n << " objects of type "
-//      << typeid(T).name();
-//   FZ_DEBUG_PRINT(ss.str());
-//   std::set_new_handler(nullptr);
-//   auto p = MallocAlloc::allocate(n);
-
-//   ss.str("");
-//   ss << "Memory allocated at " << p;
-//   FZ_DEBUG_PRINT(ss.str());
-//   return static_cast<pointer>(p);
-// }
-
-// template <typename T>
-// void Allocator<T>::fzDeallocate(pointer p) {
-//   std::stringstream ss;
-//   ss << "Deallocating memory at " << p;
-//   FZ_DEBUG_PRINT(ss.str());
-//   MallocAlloc::deallocate(p);
-// }
-
-// template <typename T>
-// template <typename... Args>
-// void Allocator<T>::fzConstructAt(pointer p, Args&&... args) {
-//   std::stringstream ss;
-//   ss << "Constructing object at " << p;
-//   FZ_DEBUG_PRINT(ss.str());
-//   fz::construct(p, std::forward<Args>(args)...);
-// }
-
-// template <typename T>
-// void Allocator<T>::fzDestroy(pointer p) {
-//   std::stringstream ss;
-//   ss << "Destroying object at " << p;
-//   FZ_DEBUG_PRINT(ss.str());
-//   fz::destroy(p);
-// }
-
-// template <typename T>
-// Allocator<T>::Allocator() = default;
-
-// template <typename T>
-// Allocator<T>::Allocator(const Allocator& other) = default;
-
-// template <typename T>
-// Allocator<T>::Allocator(Allocator&& other) noexcept = default;
-
-// template <typename T>
-// auto Allocator<T>::allocate(size_type n, const void* hint) -> pointer {
-//   return fzAllocate(n, static_cast<T*>(const_cast<void*>(hint)));
-// }
-
-// template <typename T>
-// auto Allocator<T>::deallocate(pointer p, size_type n) -> void {
-//   fzDeallocate(p);
-// }
-
-// template <typename T>
-// auto Allocator<T>::destroy(pointer p) -> void {
-//   fzDestroy(p);
-// }
-
-// // template <typename T>
-// // template <typename... Args>
-// // auto Allocator<T>::constructAt(pointer p, Args&&... args) -> void {
-// //   fzConstructAt(p, std::forward<Args>(args)...);
-// // }
-
-// // template <typename T>
-// // auto Allocator<T>::maxSize() const -> size_type {
-// //   return std::numeric_limits<size_type>::max() / sizeof(T);
-// // }
-
-// // template <typename T>
-// // auto Allocator<T>::address(reference x) const -> pointer {
-// //   return &x;
-// // }
-
-// // template <typename T>
-// // auto Allocator<T>::constAddress(const_reference x) const -> const_pointer {
-// //   return &x;
-// // }
-
-// }  // namespace fz
-
-// #endif  // __FZ_ALLOCATOR_H__
+#ifndef __FZ_ALLOCATOR_H__
+#define __FZ_ALLOCATOR_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#include "fz/memory.hpp"
+
+namespace fz {
+
+#ifndef FZ_DEFAULT_ALIGNMENT
+// one cache line, and the width of an AVX-512 load
+#define FZ_DEFAULT_ALIGNMENT 64
+#endif
+
+template <typename T>
+class Allocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using is_always_equal = std::true_type;
+
+  template <typename U>
+  struct rebind {  // NOLINT(readability-identifier-naming)
+    using other = Allocator<U>;
+  };
+
+ public:
+  Allocator();
+
+  Allocator(const Allocator& other);
+
+  Allocator(Allocator&& other) noexcept;
+
+  template <typename U>
+  Allocator(const Allocator<U>& /*other*/) noexcept {}  // NOLINT
+
+  auto operator=(const Allocator& other) -> Allocator& = default;
+
+  auto operator=(Allocator&& other) noexcept -> Allocator& = default;
+
+  ~Allocator() = default;
+
+ public:
+  // basic functions
+
+  /**
+   * @brief Allocate memory for n objects of type T
+   *
+   * @param n: The number of objects to allocate memory for
+   * @param hint: A pointer to a nearby memory location that might help the
+   * @return pointer: A pointer to the first object in the allocated memory
+   */
+  auto allocate(size_type n, const void* hint = nullptr) -> pointer;
+
+  /**
+   * @brief Memory for n objects of type T, all bytes zero. Large blocks are
+   * fresh pages the kernel zeroes on first touch, so nothing is written here.
+   */
+  auto allocateZeroed(size_type n) -> pointer;
+
+  /**
+   * @brief Deallocate memory for n objects of type T
+   *
+   * @param p: A pointer to the first object in the allocated memory
+   * @param n: The number of objects to deallocate memory for
+   */
+  auto deallocate(pointer p, size_type n) -> void;
+
+  /**
+   * @brief Deconstruct the object pointed to by p
+   *
+   * @param p: A pointer to the object to destroy
+   */
+  auto destroy(pointer p) -> void;
+
+ public:
+  template <typename... Args>
+  auto constructAt(pointer p, Args&&... args) -> void;
+
+  [[nodiscard]] auto maxSize() const -> size_type;
+
+  [[nodiscard]] auto address(reference x) const -> pointer;
+
+  [[nodiscard]] auto constAddress(const_reference x) const -> const_pointer;
+
+  template <typename U>
+  friend auto operator==(const Allocator& /*lhs*/,
+                         const Allocator<U>& /*rhs*/) -> bool {
+    return true;
+  }
+
+ private:
+  static auto fzAllocate(size_type n, T* hint) -> pointer;
+
+  static auto fzDeallocate(pointer p) -> void;
+
+  template <typename... Args>
+  static auto fzConstructAt(pointer p, Args&&... args) -> void;
+
+  static auto fzDestroy(pointer p) -> void;
+};
+
+template <typename T>
+auto Allocator<T>::fzAllocate(size_type n, T* /*hint*/) -> pointer {
+  if (std::numeric_limits<size_type>::max() / sizeof(T) < n) {
+    throw std::bad_array_new_length();
+  }
+  return static_cast<pointer>(MallocAlloc::allocate(n * sizeof(T)));
+}
+
+template <typename T>
+void Allocator<T>::fzDeallocate(pointer p) {
+  MallocAlloc::deallocate(p);
+}
+
+template <typename T>
+template <typename... Args>
+void Allocator<T>::fzConstructAt(pointer p, Args&&... args) {
+  fz::construct(p, std::forward<Args>(args)...);
+}
+
+template <typename T>
+void Allocator<T>::fzDestroy(pointer p) {
+  fz::destroy(p);
+}
+
+template <typename T>
+Allocator<T>::Allocator() = default;
+
+template <typename T>
+Allocator<T>::Allocator(const Allocator& other) = default;
+
+template <typename T>
+Allocator<T>::Allocator(Allocator&& other) noexcept = default;
+
+template <typename T>
+auto Allocator<T>::allocate(size_type n, const void* hint) -> pointer {
+  return fzAllocate(n, static_cast<T*>(const_cast<void*>(hint)));
+}
+
+template <typename T>
+auto Allocator<T>::allocateZeroed(size_type n) -> pointer {
+  if (std::numeric_limits<size_type>::max() / sizeof(T) < n) {
+    throw std::bad_array_new_length();
+  }
+  return static_cast<pointer>(MallocAlloc::allocateZeroed(n * sizeof(T)));
+}
+
+template <typename T>
+auto Allocator<T>::deallocate(pointer p, size_type /*n*/) -> void {
+  fzDeallocate(p);
+}
+
+template <typename T>
+auto Allocator<T>::destroy(pointer p) -> void {
+  fzDestroy(p);
+}
+
+template <typename T>
+template <typename... Args>
+auto Allocator<T>::constructAt(pointer p, Args&&... args) -> void {
+  fzConstructAt(p, std::forward<Args>(args)...);
+}
+
+template <typename T>
+auto Allocator<T>::maxSize() const -> size_type {
+  return std::numeric_limits<size_type>::max() / sizeof(T);
+}
+
+template <typename T>
+auto Allocator<T>::address(reference x) const -> pointer {
+  return &x;
+}
+
+template <typename T>
+auto Allocator<T>::constAddress(const_reference x) const -> const_pointer {
+  return &x;
+}
+
+/**
+ * @brief Every allocation starts on an Alignment-byte boundary, so the first
+ * element of an Array is safe for aligned SIMD loads and never shares a cache
+ * line with a neighbouring buffer.
+ */
+template <typename T, std::size_t Alignment = FZ_DEFAULT_ALIGNMENT>
+class AlignedAllocator {
+  static_assert((Alignment & (Alignment - 1)) == 0,
+                "Alignment must be a power of two");
+  static_assert(alignof(T) <= Alignment, "Alignment too small for T");
+
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using size_type = std::size_t;
+  using is_always_equal = std::true_type;
+
+  static constexpr size_type ALIGNMENT = Alignment;
+
+  template <typename U>
+  struct rebind {  // NOLINT(readability-identifier-naming)
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+ public:
+  AlignedAllocator() = default;
+
+  template <typename U>
+  AlignedAllocator(  // NOLINT
+      const AlignedAllocator<U, Alignment>& /*other*/) noexcept {}
+
+  auto allocate(size_type n) -> pointer {
+    if (std::numeric_limits<size_type>::max() / sizeof(T) < n) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<pointer>(
+        AlignedAlloc::allocate(n * sizeof(T), Alignment));
+  }
+
+  auto deallocate(pointer p, size_type /*n*/) -> void {
+    AlignedAlloc::deallocate(p, Alignment);
+  }
+
+  template <typename U>
+  friend auto operator==(const AlignedAllocator& /*lhs*/,
+                         const AlignedAllocator<U, Alignment>& /*rhs*/)
+      -> bool {
+    return true;
+  }
+};
+
+/**
+ * @brief Huge-page backed storage for multi-GB fields, see HugePageAlloc.
+ * Requests below one huge page fall back to cache-line aligned memory so
+ * small Arrays do not each pin 2 MiB.
+ */
+template <typename T>
+class HugePageAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using size_type = std::size_t;
+  using is_always_equal = std::true_type;
+
+ public:
+  HugePageAllocator() = default;
+
+  template <typename U>
+  HugePageAllocator(  // NOLINT
+      const HugePageAllocator<U>& /*other*/) noexcept {}
+
+  auto allocate(size_type n) -> pointer {
+    if (std::numeric_limits<size_type>::max() / sizeof(T) < n) {
+      throw std::bad_array_new_length();
+    }
+    const auto bytes = n * sizeof(T);
+    if (bytes < HugePageAlloc::HUGE_PAGE_SIZE) {
+      return static_cast<pointer>(
+          AlignedAlloc::allocate(bytes, FZ_DEFAULT_ALIGNMENT));
+    }
+    return static_cast<pointer>(HugePageAlloc::allocate(bytes));
+  }
+
+  // huge-page requests are fresh mappings and already read as zero
+  auto allocateZeroed(size_type n) -> pointer {
+    auto p = allocate(n);
+#ifdef __linux__
+    if (HugePageAlloc::HUGE_PAGE_SIZE <= n * sizeof(T)) {
+      return p;
+    }
+#endif
+    std::memset(p, 0, n * sizeof(T));
+    return p;
+  }
+
+  auto deallocate(pointer p, size_type n) -> void {
+    const auto bytes = n * sizeof(T);
+    if (bytes < HugePageAlloc::HUGE_PAGE_SIZE) {
+      AlignedAlloc::deallocate(p, FZ_DEFAULT_ALIGNMENT);
+      return;
+    }
+    HugePageAlloc::deallocate(p, bytes);
+  }
+
+  template <typename U>
+  friend auto operator==(const HugePageAllocator& /*lhs*/,
+                         const HugePageAllocator<U>& /*rhs*/) -> bool {
+    return true;
+  }
+};
+
+/**
+ * @brief Allocates from the arena of the ArenaScope active at construction;
+ * deallocate is free and the memory returns when that scope closes. Built
+ * outside any scope it falls back to the heap, so a default-constructed
+ * Array stays safe anywhere.
+ *
+ * Storage lifetime follows the destination: copies bind to the scope active
+ * where they are made, and assignment never adopts the source's arena, so a
+ * result copied out of a scope survives it.
+ */
+template <typename T>
+class ArenaAllocator {
+  static constexpr std::size_t ALIGNMENT =
+      std::max<std::size_t>(alignof(T), FZ_DEFAULT_ALIGNMENT);
+  static_assert(ALIGNMENT <= MonotonicArena::CHUNK_ALIGNMENT,
+                "Over-aligned type for the arena");
+
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using size_type = std::size_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using is_always_equal = std::false_type;
+
+ public:
+  ArenaAllocator() noexcept : _arena{ArenaScope::active()} {}
+
+  explicit ArenaAllocator(MonotonicArena* arena) noexcept : _arena{arena} {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept  // NOLINT
+      : _arena{other.arena()} {}
+
+  [[nodiscard]] auto select_on_container_copy_construction() const  // NOLINT
+      -> ArenaAllocator {
+    return ArenaAllocator{};
+  }
+
+  auto allocate(size_type n) -> pointer {
+    if (std::numeric_limits<size_type>::max() / sizeof(T) < n) {
+      throw std::bad_array_new_length();
+    }
+    if (_arena == nullptr) {
+      return static_cast<pointer>(MallocAlloc::allocate(n * sizeof(T)));
+    }
+    return static_cast<pointer>(_arena->allocate(n * sizeof(T), ALIGNMENT));
+  }
+
+  auto deallocate(pointer p, size_type /*n*/) -> void {
+    if (_arena == nullptr) {
+      MallocAlloc::deallocate(p);
+    }
+  }
+
+  [[nodiscard]] auto arena() const -> MonotonicArena* { return _arena; }
+
+  template <typename U>
+  friend auto operator==(const ArenaAllocator& lhs,
+                         const ArenaAllocator<U>& rhs) -> bool {
+    return lhs.arena() == rhs.arena();
+  }
+
+ private:
+  MonotonicArena* _arena;
+};
+
+/**
+ * @brief Recycles storage through BufferCache, so resize and emptyLike in a
+ * steady-state loop reuse buffers instead of going back to the system.
+ */
+template <typename T>
+class CachingAllocator {
+  static_assert(alignof(T) <= BufferCache::ALIGNMENT,
+                "Over-aligned type for the buffer cache");
+
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using size_type = std::size_t;
+  using is_always_equal = std::true_type;
+
+ public:
+  CachingAllocator() = default;
+
+  template <typename U>
+  CachingAllocator(  // NOLINT
+      const CachingAllocator<U>& /*other*/) noexcept {}
+
+  auto allocate(size_type n) -> pointer {
+    if (std::numeric_limits<size_type>::max() / sizeof(T) < n) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<pointer>(
+        BufferCache::instance().allocate(n * sizeof(T)));
+  }
+
+  auto deallocate(pointer p, size_type n) -> void {
+    BufferCache::instance().deallocate(p, n * sizeof(T));
+  }
+
+  template <typename U>
+  friend auto operator==(const CachingAllocator& /*lhs*/,
+                         const CachingAllocator<U>& /*rhs*/) -> bool {
+    return true;
+  }
+};
+
+}  // namespace fz
+
+#endif  // __FZ_ALLOCATOR_H__
@@ -12,69 +12,149 @@
 #ifndef __FZ_ARRAY_H__
 #define __FZ_ARRAY_H__
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
 #include <initializer_list>
+#include <memory>
 #include <numeric>
 #include <ranges>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+#include "fz/allocator.hpp"
+#include "fz/array_base.hpp"
+#include "fz/array_view.hpp"
+
 namespace fz {
 
-#ifdef __FZ_ARRAY_HETERO_COMPUTATION__
-#define __FZ_ARRAY_DUAL__ __HOST__ __DEVICE__
-#else
-#define __FZ_ARRAY_DUAL__
+#ifndef FZ_INLINE_BYTES
+// arrays whose elements fit in this many bytes keep them inside the object;
+// 72 holds a 3 x 3 tensor of doubles
+#define FZ_INLINE_BYTES 72
 #endif
 
-using SizeType = std::size_t;
+/**
+ * @brief Owning dense array. Element storage comes from Alloc, e.g.
+ * AlignedAllocator for SIMD-friendly buffers or HugePageAllocator for
+ * multi-GB grids. The allocator follows the std::allocator_traits rules: it is
+ * selected on copy construction, moved with the array, and propagated on
+ * assignment as the allocator asks.
+ *
+ * Elements are stored column-major unless the array is created with
+ * Layout::kRowMajor; resize and reshape keep the layout. begin() and end()
+ * run over the storage in memory order.
+ *
+ * Small arrays never touch the heap: with the default allocator, elements
+ * that fit in FZ_INLINE_BYTES live inside the object, and ShapeVector keeps
+ * shapes and strides of rank <= FZ_INLINE_RANK inline. Moving such an array
+ * moves its elements, so views and pointers into it do not survive a move.
+ */
+template <typename T, Range Shape = ShapeVector, Range Stride = ShapeVector,
+          typename Alloc = Allocator<T>>
+class Array {
+ public:
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+  using allocator_type = Alloc;
+  using View = ArrayView<T, Shape, Stride>;
+  using ConstView = ArrayView<const T, Shape, Stride>;
+
+  // elements stored inside the object rather than taken from Alloc; only
+  // the default allocator, since the others promise alignment or placement
+  static constexpr SizeType INLINE_CAPACITY =
+      std::is_same_v<Alloc, Allocator<T>> &&
+              std::is_nothrow_move_constructible_v<T>
+          ? FZ_INLINE_BYTES / sizeof(T)
+          : 0;
 
-template <typename T>
-__FZ_ARRAY_DUAL__ concept Range = requires(T t) {
-  std::ranges::begin(t);
-  std::ranges::end(t);
-  { t.size() } -> std::convertible_to<SizeType>;
-};
+ public:
+  static auto empty(Shape shape, const Alloc &alloc = Alloc{}) -> Array;
 
-// support for array-like objects
-// operations: size, shape, strides, (), []
-template <typename T>
-__FZ_ARRAY_DUAL__ concept ArrayConcept = requires(T t) {
-  { t.shape() } -> Range;
-  { t.strides() } -> Range;
-  { t(0) } -> std::convertible_to<T &>;
-  { t[0] } -> std::convertible_to<T &>;
-};
+  // value-initialised elements; zero-byte types such as double come from
+  // the allocator's zeroed memory (calloc, fresh pages) without a fill pass
+  static auto zeros(Shape shape, const Alloc &alloc = Alloc{}) -> Array;
 
-template <typename T, Range Shape = std::vector<SizeType>,
-          Range Stride = std::vector<SizeType>>
-class Array {
- public:
-  static auto empty(Shape shape) -> Array;
+  static auto empty(Shape shape, Layout layout, const Alloc &alloc = Alloc{})
+      -> Array;
 
-  static auto zeros(Shape shape) -> Array;
+  static auto zeros(Shape shape, Layout layout, const Alloc &alloc = Alloc{})
+      -> Array;
 
+  /**
+   * @brief Uninitialised array with the shape, strides and allocator of arr.
+   */
   static auto emptyLike(const Array &arr) -> Array;
 
  public:
   Array() = default;
 
-  Array(std::initializer_list<T> data);
+  explicit Array(const Alloc &alloc);
+
+  Array(std::initializer_list<T> data, const Alloc &alloc = Alloc{})
+    requires(!FixedSizeRange<Shape> || std::tuple_size_v<Shape> == 1);
 
   Array(const Array &other);
 
   auto operator=(const Array &other) -> Array &;
 
+  /**
+   * @brief Materialise an expression (see expression.hpp), a view or another
+   * Array in a single pass. The result takes the layout of a source Array
+   * and is column-major otherwise.
+   */
+  template <ExpressionConcept E>
+    requires(!std::is_same_v<E, Array>)
+  Array(const E &expr);  // NOLINT
+
+  /**
+   * @brief Evaluate an expression into this array. Storage is reused when the
+   * shapes already match, so `a = b * c + d` allocates nothing. The
+   * evaluation is then in place: the expression may read this array only at
+   * the element being written, as in `a = 2 * a + b`, and reading it through
+   * a transposed or shifted view needs a copy first. A change of shape
+   * evaluates into new storage, so `a = 2 * a.view().slice(0, 1, 3)` is
+   * fine.
+   */
+  template <ExpressionConcept E>
+    requires(!std::is_same_v<E, Array>)
+  auto operator=(const E &expr) -> Array &;
+
   Array(Array &&other) noexcept;
 
-  auto operator=(Array &&other) noexcept -> Array &;
+  auto operator=(Array &&other) noexcept(
+      std::allocator_traits<Alloc>::propagate_on_container_move_assignment::
+          value ||
+      std::allocator_traits<Alloc>::is_always_equal::value) -> Array &;
 
   ~Array();
 
  public:
   __FZ_ARRAY_DUAL__ [[nodiscard]] auto size() const -> SizeType;
 
-  __FZ_ARRAY_DUAL__ auto shape() const -> Shape;
+  __FZ_ARRAY_DUAL__ auto shape() const -> const Shape &;
+
+  __FZ_ARRAY_DUAL__ auto strides() const -> const Stride &;
 
-  __FZ_ARRAY_DUAL__ auto strides() const -> Stride;
+  __FZ_ARRAY_DUAL__ auto layout() const -> Layout;
+
+  /**
+   * @brief Whether the elements are stored first index fastest, like a
+   * contiguous ArrayView. False for row-major arrays of rank > 1.
+   */
+  __FZ_ARRAY_DUAL__ [[nodiscard]] auto isContiguous() const -> bool;
+
+  /**
+   * @brief Whether data()[0, size()) are exactly the elements, in whatever
+   * order. Always true: an Array owns a dense buffer in either layout.
+   */
+  __FZ_ARRAY_DUAL__ [[nodiscard]] auto isDense() const -> bool {
+    return true;
+  }
 
   template <typename... Args>
   __FZ_ARRAY_DUAL__ auto operator()(Args &&...args) -> T &;
@@ -98,196 +178,355 @@ class Array {
 
   __FZ_ARRAY_DUAL__ auto end() -> T *;
 
-  // TODO(franzero): implement const_iterator
+  __FZ_ARRAY_DUAL__ auto begin() const -> const T *;
+
+  __FZ_ARRAY_DUAL__ auto end() const -> const T *;
+
+  __FZ_ARRAY_DUAL__ auto data() -> T *;
+
+  __FZ_ARRAY_DUAL__ auto data() const -> const T *;
+
+  [[nodiscard]] auto getAllocator() const -> Alloc;
 
-  // __FZ_ARRAY_DUAL__ auto begin() const -> const_iterator;
+  /**
+   * @brief Non-owning view over the whole array. No element storage is
+   * allocated; the view is invalidated by resize, reshape and destruction.
+   */
+  __FZ_ARRAY_DUAL__ auto view() -> View;
 
-  // __FZ_ARRAY_DUAL__ auto end() const -> const_iterator;
+  __FZ_ARRAY_DUAL__ auto view() const -> ConstView;
 
   __FZ_ARRAY_DUAL__ auto resize(Shape shape) -> void;
 
   __FZ_ARRAY_DUAL__ auto reshape(Shape shape) -> void;
 
+  /**
+   * @brief Reinterpret the storage with a new shape and layout. No element
+   * moves; see relayout() in layout.hpp to reorder them instead.
+   */
+  __FZ_ARRAY_DUAL__ auto reshape(Shape shape, Layout layout) -> void;
+
+ public:
+  // expression protocol, see ExpressionConcept
+
+  __FZ_ARRAY_DUAL__ auto flat(SizeType i) const -> const T &;
+
+  template <Range S>
+  __FZ_ARRAY_DUAL__ auto flatCompatible(const S &strides) const -> bool;
+
+  template <Range Index>
+  __FZ_ARRAY_DUAL__ auto element(const Index &index) const -> const T &;
+
  private:
+  using AllocTraits = std::allocator_traits<Alloc>;
+
   Shape _shape{};
   Stride _strides{};
   // using Pointer = std::pointer_traits<T *>;
   using Pointer = T *;
   Pointer _begin{};
   Pointer _end{};
+  Layout _layout = Layout::kColumnMajor;
+  [[no_unique_address]] Alloc _allocator{};
+
+  struct NoInlineStorage {};
+  struct InlineStorage {
+    alignas(T) std::byte bytes[INLINE_CAPACITY * sizeof(T)];
+  };
+  [[no_unique_address]] std::conditional_t<
+      INLINE_CAPACITY == 0, NoInlineStorage, InlineStorage> _inline;
+
+  auto inlineData() -> Pointer {
+    if constexpr (INLINE_CAPACITY == 0) {
+      return nullptr;
+    } else {
+      return reinterpret_cast<Pointer>(_inline.bytes);
+    }
+  }
+
+  auto isInline() const -> bool {
+    if constexpr (INLINE_CAPACITY == 0) {
+      return false;
+    } else {
+      return _begin != nullptr &&
+             _begin == reinterpret_cast<const T *>(_inline.bytes);
+    }
+  }
+
+  // take other's elements, which must use storage this array can free
+  auto takeStorage(Array &other) noexcept -> void;
+
+  // storage for n elements, inline when they fit and from _allocator
+  // otherwise, built by construct(p); nullptr for n == 0. construct cleans
+  // up after itself if it throws
+  template <typename Construct>
+  auto allocateStorage(SizeType n, Construct construct) -> Pointer;
+
+  // n default-initialised elements: trivial types are left as they come
+  auto allocateStorage(SizeType n) -> Pointer;
+
+  // n value-initialised elements; types that are all zero bytes come
+  // pre-zeroed from an allocator with allocateZeroed, untouched
+  auto allocateZeroed(SizeType n) -> Pointer;
+
+  // n elements copy- or move-constructed from first
+  template <typename Iterator>
+  auto allocateCopy(Iterator first, SizeType n) -> Pointer;
 
-  template <SizeType dim>
-  __FZ_ARRAY_DUAL__ static auto rawOffset(const Stride &strides) -> SizeType;
+  // destroys the elements and returns a heap buffer to _allocator
+  auto deallocateStorage() -> void;
 
-  template <SizeType dim, typename Arg, typename... Args>
-  __FZ_ARRAY_DUAL__ static auto rawOffset(const Stride &strides, Arg &&arg,
-                                          Args &&...args) -> SizeType;
+  __FZ_ARRAY_DUAL__ static auto shapeSize(const Shape &shape) -> SizeType;
 
-  template <typename Arg, typename... Args>
-  __FZ_ARRAY_DUAL__ static auto dataOffset(const Stride &stride, Arg &&arg,
-                                           Args &&...args) -> SizeType;
+  __FZ_ARRAY_DUAL__ static auto denseStrides(const Shape &shape,
+                                             Layout layout) -> Stride;
 };
 
-template <typename T, Range Shape, Range Stride>
-auto Array<T, Shape, Stride>::emptyLike(const Array &arr) -> Array {
-  Array new_arr;
+template <typename T, Range Shape, Range Stride, typename Alloc>
+auto Array<T, Shape, Stride, Alloc>::emptyLike(const Array &arr) -> Array {
+  Array new_arr(AllocTraits::select_on_container_copy_construction(
+      arr._allocator));
   new_arr._shape = arr._shape;
   new_arr._strides = arr._strides;
-  new_arr._begin = new T[arr.size()];
+  new_arr._layout = arr._layout;
+  new_arr._begin = new_arr.allocateStorage(arr.size());
   new_arr._end = new_arr._begin + arr.size();
   return new_arr;
 }
 
-template <typename T, Range Shape, Range Stride>
-auto Array<T, Shape, Stride>::empty(Shape shape) -> Array {
-  Array arr;
-  arr._shape = shape;
-  arr._strides = shape;
-  std::reverse(arr._strides.begin(), arr._strides.end());
-  arr._strides[0] = 1;
-  for (SizeType i = 1; i < arr._strides.size(); ++i) {
-    arr._strides[i] = arr._strides[i - 1] * arr._shape[i - 1];
-  }
-  auto size = static_cast<SizeType>(
-      std::reduce(shape.begin(), shape.end(), 1, std::multiplies<>()));
-  arr._begin = new T[size];
+template <typename T, Range Shape, Range Stride, typename Alloc>
+auto Array<T, Shape, Stride, Alloc>::empty(Shape shape, const Alloc &alloc)
+    -> Array {
+  return empty(std::move(shape), Layout::kColumnMajor, alloc);
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+auto Array<T, Shape, Stride, Alloc>::zeros(Shape shape, const Alloc &alloc)
+    -> Array {
+  return zeros(std::move(shape), Layout::kColumnMajor, alloc);
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+auto Array<T, Shape, Stride, Alloc>::empty(Shape shape, Layout layout,
+                                           const Alloc &alloc) -> Array {
+  Array arr(alloc);
+  arr._strides = denseStrides(shape, layout);
+  arr._layout = layout;
+  auto size = shapeSize(shape);
+  arr._shape = std::move(shape);
+  arr._begin = arr.allocateStorage(size);
   arr._end = arr._begin + size;
   return arr;
 }
 
-template <typename T, Range Shape, Range Stride>
-auto Array<T, Shape, Stride>::zeros(Shape shape) -> Array {
-  Array arr;
-  arr._shape = shape;
-  arr._strides = shape;
-  std::reverse(arr._strides.begin(), arr._strides.end());
-  arr._strides[0] = 1;
-  for (SizeType i = 1; i < arr._strides.size(); ++i) {
-    arr._strides[i] = arr._strides[i - 1] * arr._shape[i - 1];
-  }
-  auto size = static_cast<SizeType>(
-      std::reduce(shape.begin(), shape.end(), 1, std::multiplies<>()));
-  arr._begin = new T[size];
+template <typename T, Range Shape, Range Stride, typename Alloc>
+auto Array<T, Shape, Stride, Alloc>::zeros(Shape shape, Layout layout,
+                                           const Alloc &alloc) -> Array {
+  Array arr(alloc);
+  arr._strides = denseStrides(shape, layout);
+  arr._layout = layout;
+  auto size = shapeSize(shape);
+  arr._shape = std::move(shape);
+  arr._begin = arr.allocateZeroed(size);
   arr._end = arr._begin + size;
   return arr;
 }
 
-template <typename T, Range Shape, Range Stride>
-Array<T, Shape, Stride>::Array(std::initializer_list<T> data) {
-  _begin = new T[data.size()];
+template <typename T, Range Shape, Range Stride, typename Alloc>
+Array<T, Shape, Stride, Alloc>::Array(const Alloc &alloc) : _allocator{alloc} {}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+Array<T, Shape, Stride, Alloc>::Array(std::initializer_list<T> data,
+                                      const Alloc &alloc)
+  requires(!FixedSizeRange<Shape> || std::tuple_size_v<Shape> == 1)
+    : _allocator{alloc} {
+  _begin = allocateCopy(data.begin(), data.size());
   _end = _begin + data.size();
-  std::copy(data.begin(), data.end(), _begin);
   _shape = {data.size()};
   _strides = {1};
 }
 
-template <typename T, Range Shape, Range Stride>
-Array<T, Shape, Stride>::Array(const Array &other) {
+template <typename T, Range Shape, Range Stride, typename Alloc>
+Array<T, Shape, Stride, Alloc>::Array(const Array &other)
+    : _allocator{AllocTraits::select_on_container_copy_construction(
+          other._allocator)} {
   _shape = other._shape;
   _strides = other._strides;
-  _begin = new T[other.size()];
+  _layout = other._layout;
+  _begin = allocateCopy(other._begin, other.size());
   _end = _begin + other.size();
-  std::copy(other._begin, other._end, _begin);
 }
 
-template <typename T, Range Shape, Range Stride>
-Array<T, Shape, Stride>::Array(Array &&other) noexcept {
+template <typename T, Range Shape, Range Stride, typename Alloc>
+template <ExpressionConcept E>
+  requires(!std::is_same_v<E, Array<T, Shape, Stride, Alloc>>)
+Array<T, Shape, Stride, Alloc>::Array(const E &expr)
+    : Array{empty(detail::toShape<Shape>(expr.shape()),
+                  detail::layoutOf(expr))} {
+  detail::assignExpression(_begin, _shape, _strides, true, expr);
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+template <ExpressionConcept E>
+  requires(!std::is_same_v<E, Array<T, Shape, Stride, Alloc>>)
+inline auto Array<T, Shape, Stride, Alloc>::operator=(const E &expr)
+    -> Array & {
+  if (!std::ranges::equal(_shape, expr.shape())) {
+    // expr may still read the storage resizing would free
+    auto result =
+        empty(detail::toShape<Shape>(expr.shape()), _layout, _allocator);
+    detail::assignExpression(result._begin, result._shape, result._strides,
+                             true, expr);
+    return *this = std::move(result);
+  }
+  detail::assignExpression(_begin, _shape, _strides, true, expr);
+  return *this;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+Array<T, Shape, Stride, Alloc>::Array(Array &&other) noexcept
+    : _allocator{std::move(other._allocator)} {
   _shape = std::move(other._shape);
   _strides = std::move(other._strides);
-  _begin = std::move(other._begin);
-  _end = std::move(other._end);
-  other._begin = nullptr;
-  other._end = nullptr;
+  _layout = other._layout;
+  takeStorage(other);
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::operator=(
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::operator=(
     const Array &other) -> Array & {
   if (this == &other) {
     return *this;
   }
+  if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+    if (!AllocTraits::is_always_equal::value &&
+        _allocator != other._allocator) {
+      // the old buffer belongs to the old allocator
+      deallocateStorage();
+    }
+    _allocator = other._allocator;
+  }
+  if (size() == other.size()) {
+    std::copy(other._begin, other._end, _begin);
+  } else {
+    deallocateStorage();
+    _begin = allocateCopy(other._begin, other.size());
+    _end = _begin + other.size();
+  }
   _shape = other._shape;
   _strides = other._strides;
-  delete[] _begin;
-  _begin = new T[other.size()];
-  _end = _begin + other.size();
-  std::copy(other._begin, other._end, _begin);
+  _layout = other._layout;
   return *this;
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::operator=(
-    Array &&other) noexcept -> Array & {
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::operator=(
+    Array &&other) noexcept(
+    AllocTraits::propagate_on_container_move_assignment::value ||
+    AllocTraits::is_always_equal::value) -> Array & {
   if (this == &other) {
     return *this;
   }
+  constexpr auto steal =
+      AllocTraits::propagate_on_container_move_assignment::value ||
+      AllocTraits::is_always_equal::value;
+  if (steal || _allocator == other._allocator) {
+    deallocateStorage();
+    if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+      _allocator = std::move(other._allocator);
+    }
+    _shape = std::move(other._shape);
+    _strides = std::move(other._strides);
+    _layout = other._layout;
+    takeStorage(other);
+    return *this;
+  }
+
+  // unequal allocators that stay put: the elements have to move instead
+  if (size() == other.size()) {
+    std::move(other._begin, other._end, _begin);
+  } else {
+    deallocateStorage();
+    _begin = allocateCopy(std::make_move_iterator(other._begin), other.size());
+    _end = _begin + other.size();
+  }
   _shape = std::move(other._shape);
   _strides = std::move(other._strides);
-  delete[] _begin;
-  _begin = std::move(other._begin);
-  _end = std::move(other._end);
-  other._begin = nullptr;
-  other._end = nullptr;
+  _layout = other._layout;
+  other.deallocateStorage();
   return *this;
 }
 
-template <typename T, Range Shape, Range Stride>
-Array<T, Shape, Stride>::~Array() {
-  delete[] _begin;
-  _begin = nullptr;
-  _end = nullptr;
+template <typename T, Range Shape, Range Stride, typename Alloc>
+Array<T, Shape, Stride, Alloc>::~Array() {
+  deallocateStorage();
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::size() const
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::size() const
     -> SizeType {
   return static_cast<SizeType>(_end - _begin);
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::shape() const -> Shape {
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::shape() const
+    -> const Shape & {
   return _shape;
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::strides() const
-    -> Stride {
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::strides() const
+    -> const Stride & {
   return _strides;
 }
 
-template <typename T, Range Shape, Range Stride>
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::layout() const
+    -> Layout {
+  return _layout;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::isContiguous()
+    const -> bool {
+  return _layout == Layout::kColumnMajor ||
+         std::count_if(_shape.begin(), _shape.end(),
+                       [](SizeType n) { return n != 1; }) <= 1;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
 template <typename... Args>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::operator()(
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::operator()(
     Args &&...args) -> T & {
-  return _begin[dataOffset(_strides, std::forward<Args>(args)...)];
+  return _begin[detail::dataOffset(_strides, std::forward<Args>(args)...)];
 }
 
-template <typename T, Range Shape, Range Stride>
+template <typename T, Range Shape, Range Stride, typename Alloc>
 template <typename... Args>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::operator()(
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::operator()(
     Args &&...args) const -> const T & {
-  return _begin[dataOffset(_strides, std::forward<Args>(args)...)];
+  return _begin[detail::dataOffset(_strides, std::forward<Args>(args)...)];
 }
 
-template <typename T, Range Shape, Range Stride>
+template <typename T, Range Shape, Range Stride, typename Alloc>
 template <typename Arg>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::operator[](Arg &&arg)
-    -> T & {
-  return _begin[dataOffset(_strides, std::forward<Arg>(arg))];
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::operator[](
+    Arg &&arg) -> T & {
+  return _begin[detail::dataOffset(_strides, std::forward<Arg>(arg))];
 }
 
-template <typename T, Range Shape, Range Stride>
+template <typename T, Range Shape, Range Stride, typename Alloc>
 template <typename Arg>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::operator[](
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::operator[](
     Arg &&arg) const -> const T & {
-  return _begin[dataOffset(_strides, std::forward<Arg>(arg))];
+  return _begin[detail::dataOffset(_strides, std::forward<Arg>(arg))];
 }
 
-template <typename T, Range Shape, Range Stride>
+template <typename T, Range Shape, Range Stride, typename Alloc>
 template <typename... Args>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::at(Args &&...args)
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::at(Args &&...args)
     -> T & {
-  auto &&offset = dataOffset(_strides, std::forward<Args>(args)...);
+  auto offset = detail::dataOffset(_strides, std::forward<Args>(args)...);
   if (size() <= offset) {
     throw std::out_of_range("Index out of range");
   }
@@ -295,11 +534,11 @@ __FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::at(Args &&...args)
   return _begin[offset];
 }
 
-template <typename T, Range Shape, Range Stride>
+template <typename T, Range Shape, Range Stride, typename Alloc>
 template <typename... Args>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::at(Args &&...args) const
-    -> const T & {
-  auto offset = dataOffset(_strides, std::forward<Args>(args)...);
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::at(
+    Args &&...args) const -> const T & {
+  auto offset = detail::dataOffset(_strides, std::forward<Args>(args)...);
   if (size() <= offset) {
     throw std::out_of_range("Index out of range");
   }
@@ -307,83 +546,220 @@ __FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::at(Args &&...args) const
   return _begin[offset];
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::begin() -> T * {
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::begin() -> T * {
   return _begin;
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::end() -> T * {
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::end() -> T * {
   return _begin + size();
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::resize(Shape shape)
-    -> void {
-  auto new_size = static_cast<SizeType>(
-      std::reduce(shape.begin(), shape.end(), 1, std::multiplies<>()));
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::begin() const
+    -> const T * {
+  return _begin;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::end() const
+    -> const T * {
+  return _end;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::data() -> T * {
+  return _begin;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::data() const
+    -> const T * {
+  return _begin;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto Array<T, Shape, Stride, Alloc>::getAllocator() const -> Alloc {
+  return _allocator;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::view() -> View {
+  return View{_begin, _shape, _strides};
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::view() const
+    -> ConstView {
+  return ConstView{_begin, _shape, _strides};
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::resize(
+    Shape shape) -> void {
+  auto new_size = shapeSize(shape);
   if (new_size != size()) {
-    delete[] _begin;
-    _begin = new T[new_size];
+    deallocateStorage();
+    _begin = allocateStorage(new_size);
     _end = _begin + new_size;
   }
 
-  _shape = shape;
-  _strides = shape;
-  std::reverse(_strides.begin(), _strides.end());
-  _strides[0] = 1;
-  for (SizeType i = 1; i < _strides.size(); ++i) {
-    _strides[i] = _strides[i - 1] * _shape[i - 1];
+  _strides = denseStrides(shape, _layout);
+  _shape = std::move(shape);
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::reshape(
+    Shape shape) -> void {
+  auto new_size = shapeSize(shape);
+  if (new_size != size()) {
+    throw std::invalid_argument("Invalid shape");
   }
+
+  _shape = shape;
+  _strides = denseStrides(shape, _layout);
 }
 
-template <typename T, Range Shape, Range Stride>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::reshape(Shape shape)
-    -> void {
-  auto new_size = static_cast<SizeType>(
-      std::reduce(shape.begin(), shape.end(), 1, std::multiplies<>()));
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::reshape(
+    Shape shape, Layout layout) -> void {
+  auto new_size = shapeSize(shape);
   if (new_size != size()) {
     throw std::invalid_argument("Invalid shape");
   }
 
   _shape = shape;
-  _strides = shape;
-  std::reverse(_strides.begin(), _strides.end());
-  _strides[0] = 1;
-  for (SizeType i = 1; i < _strides.size(); ++i) {
-    _strides[i] = _strides[i - 1] * _shape[i - 1];
+  _strides = denseStrides(shape, layout);
+  _layout = layout;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto Array<T, Shape, Stride, Alloc>::takeStorage(
+    Array &other) noexcept -> void {
+  if (other.isInline()) {
+    _begin = inlineData();
+    _end = std::uninitialized_move(other._begin, other._end, _begin);
+    other.deallocateStorage();
+    return;
   }
+  _begin = other._begin;
+  _end = other._end;
+  other._begin = nullptr;
+  other._end = nullptr;
 }
 
-template <typename T, Range Shape, Range Stride>
-template <typename Arg, typename... Args>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::dataOffset(
-    const Stride &stride, Arg &&arg, Args &&...args) -> SizeType {
-  constexpr std::size_t nargs = sizeof...(Args) + 1;
-  auto stride_size = static_cast<SizeType>(stride.size());
-  if (nargs == stride.size()) {
-    return rawOffset<static_cast<SizeType>(0)>(stride, std::forward<Arg>(arg),
-                                               std::forward<Args>(args)...);
+template <typename T, Range Shape, Range Stride, typename Alloc>
+template <typename Construct>
+inline auto Array<T, Shape, Stride, Alloc>::allocateStorage(
+    SizeType n, Construct construct) -> Pointer {
+  if (n == 0) {
+    return nullptr;
   }
+  const auto in_object = n <= INLINE_CAPACITY;
+  Pointer p = in_object ? inlineData() : AllocTraits::allocate(_allocator, n);
+  try {
+    construct(p);
+  } catch (...) {
+    if (!in_object) {
+      AllocTraits::deallocate(_allocator, p, n);
+    }
+    throw;
+  }
+  return p;
+}
 
-  throw std::invalid_argument("Invalid number of arguments");
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto Array<T, Shape, Stride, Alloc>::allocateStorage(SizeType n)
+    -> Pointer {
+  return allocateStorage(n, [n](Pointer p) {
+    if constexpr (!std::is_trivially_default_constructible_v<T>) {
+      SizeType i = 0;
+      try {
+        for (; i < n; ++i) {
+          ::new (static_cast<void *>(p + i)) T;
+        }
+      } catch (...) {
+        fz::destroy(p, p + i);
+        throw;
+      }
+    }
+  });
 }
 
-template <typename T, Range Shape, Range Stride>
-template <SizeType dim>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::rawOffset(
-    const Stride &strides) -> SizeType {
-  return 0;
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto Array<T, Shape, Stride, Alloc>::allocateZeroed(SizeType n)
+    -> Pointer {
+  if constexpr (ZeroBytesValue<T> &&
+                requires(Alloc &a) { a.allocateZeroed(n); }) {
+    if (INLINE_CAPACITY < n) {
+      return _allocator.allocateZeroed(n);
+    }
+  }
+  return allocateStorage(n,
+                         [n](Pointer p) { fz::uninitializedFillN(p, n, T{}); });
 }
 
-template <typename T, Range Shape, Range Stride>
-template <SizeType dim, typename Arg, typename... Args>
-__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride>::rawOffset(
-    const Stride &strides, Arg &&arg, Args &&...args) -> SizeType {
-  return static_cast<std::ptrdiff_t>(arg) * strides[dim] +
-         rawOffset<dim + 1>(strides, std::forward<Args>(args)...);
+template <typename T, Range Shape, Range Stride, typename Alloc>
+template <typename Iterator>
+inline auto Array<T, Shape, Stride, Alloc>::allocateCopy(Iterator first,
+                                                         SizeType n)
+    -> Pointer {
+  return allocateStorage(
+      n, [&](Pointer p) { fz::uninitializedCopy(first, first + n, p); });
 }
 
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto Array<T, Shape, Stride, Alloc>::deallocateStorage() -> void {
+  if (_begin != nullptr) {
+    fz::destroy(_begin, _end);
+    if (!isInline()) {
+      AllocTraits::deallocate(_allocator, _begin, size());
+    }
+  }
+  _begin = nullptr;
+  _end = nullptr;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::shapeSize(
+    const Shape &shape) -> SizeType {
+  return std::reduce(shape.begin(), shape.end(), static_cast<SizeType>(1),
+                     std::multiplies<>());
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::denseStrides(
+    const Shape &shape, Layout layout) -> Stride {
+  return detail::layoutStrides<Stride>(shape, layout);
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::flat(
+    SizeType i) const -> const T & {
+  return _begin[i];
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+template <Range S>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::flatCompatible(
+    const S &strides) const -> bool {
+  return std::ranges::equal(_strides, strides);
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+template <Range Index>
+__FZ_ARRAY_DUAL__ inline auto Array<T, Shape, Stride, Alloc>::element(
+    const Index &index) const -> const T & {
+  return _begin[detail::indexOffset(_strides, index)];
+}
+
+// Rank fixed at compile time: shape and strides live inline and indexing
+// reduces to an unrolled dot product.
+template <typename T, SizeType Rank, typename Alloc = Allocator<T>>
+using FixedRankArray =
+    Array<T, std::array<SizeType, Rank>, std::array<SizeType, Rank>, Alloc>;
+
 }  // namespace fz
 
 #endif  // __FZ_ARRAY_H__
@@ -0,0 +1,327 @@
+#ifndef __FZ_ARRAY_BASE_H__
+#define __FZ_ARRAY_BASE_H__
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/small_vector.hpp"
+
+namespace fz {
+
+#ifdef __FZ_ARRAY_HETERO_COMPUTATION__
+#define __FZ_ARRAY_DUAL__ __HOST__ __DEVICE__
+#else
+#define __FZ_ARRAY_DUAL__
+#endif
+
+using SizeType = std::size_t;
+
+#ifndef FZ_INLINE_RANK
+// ranks up to this keep their shape and strides inside the Array object
+#define FZ_INLINE_RANK 4
+#endif
+
+// the default shape and stride type of Array and ArrayView
+using ShapeVector = SmallVector<SizeType, FZ_INLINE_RANK>;
+
+/**
+ * @brief Order of the elements of a dense array in memory: column-major
+ * (Fortran) keeps the first index fastest, row-major (C, NumPy's default)
+ * the last.
+ */
+enum class Layout { kColumnMajor, kRowMajor };
+
+template <typename T>
+__FZ_ARRAY_DUAL__ concept Range = requires(T t) {
+  std::ranges::begin(t);
+  std::ranges::end(t);
+  { t.size() } -> std::convertible_to<SizeType>;
+};
+
+// ranges whose length is part of the type, e.g. std::array<SizeType, N>
+template <typename T>
+__FZ_ARRAY_DUAL__ concept FixedSizeRange =
+    Range<T> && requires { std::tuple_size<T>::value; };
+
+// support for array-like objects
+// operations: size, shape, strides, (), []
+template <typename T>
+__FZ_ARRAY_DUAL__ concept ArrayConcept = requires(T t) {
+  { t.size() } -> std::convertible_to<SizeType>;
+  { t.shape() } -> Range;
+  { t.strides() } -> Range;
+  { t(0) } -> std::convertible_to<typename T::reference>;
+  { t[0] } -> std::convertible_to<typename T::reference>;
+};
+
+// anything that can be evaluated element by element, see expression.hpp
+// flat(i): element i in storage order, only valid when flatCompatible(strides)
+// element(index): element at a multi-index, always valid
+template <typename E>
+__FZ_ARRAY_DUAL__ concept ExpressionConcept = requires(const E &e) {
+  { e.shape() } -> Range;
+  { e.size() } -> std::convertible_to<SizeType>;
+  e.flat(SizeType{});
+  { e.flatCompatible(e.shape()) } -> std::convertible_to<bool>;
+  e.element(e.shape());
+};
+
+namespace detail {
+
+template <typename Stride, std::size_t... Is, typename... Args>
+__FZ_ARRAY_DUAL__ inline auto stridedOffset(const Stride &strides,
+                                            std::index_sequence<Is...>,
+                                            Args &&...args) -> SizeType {
+  return ((static_cast<SizeType>(args) * strides[Is]) + ...);
+}
+
+// offset of element (args...) relative to the first element
+template <Range Stride, typename Arg, typename... Args>
+__FZ_ARRAY_DUAL__ inline auto dataOffset(const Stride &strides, Arg &&arg,
+                                         Args &&...args) -> SizeType {
+  constexpr std::size_t nargs = sizeof...(Args) + 1;
+  if constexpr (FixedSizeRange<Stride>) {
+    // the rank is part of the type: no runtime check, no recursion
+    static_assert(nargs == std::tuple_size_v<Stride>,
+                  "Invalid number of arguments");
+  } else {
+    if (nargs != strides.size()) {
+      throw std::invalid_argument("Invalid number of arguments");
+    }
+  }
+
+  return stridedOffset(strides, std::make_index_sequence<nargs>{},
+                       std::forward<Arg>(arg), std::forward<Args>(args)...);
+}
+
+template <Range Shape, Range R>
+inline auto toShape(const R &range) -> Shape {
+  if constexpr (std::is_same_v<Shape, R>) {
+    return range;
+  } else {
+    Shape shape{};
+    if constexpr (FixedSizeRange<Shape>) {
+      if (range.size() != std::tuple_size_v<Shape>) {
+        throw std::invalid_argument("Invalid number of dimensions");
+      }
+    } else {
+      shape.resize(range.size());
+    }
+    std::copy(std::ranges::begin(range), std::ranges::end(range),
+              shape.begin());
+    return shape;
+  }
+}
+
+template <Range Stride, Range Index>
+__FZ_ARRAY_DUAL__ inline auto indexOffset(const Stride &strides,
+                                          const Index &index) -> SizeType {
+  SizeType offset = 0;
+  for (SizeType d = 0; d < strides.size(); ++d) {
+    offset += index[d] * strides[d];
+  }
+  return offset;
+}
+
+// dense strides of shape in the given layout
+template <Range Stride, Range Shape>
+__FZ_ARRAY_DUAL__ inline auto layoutStrides(const Shape &shape, Layout layout)
+    -> Stride {
+  Stride strides{};
+  if constexpr (!FixedSizeRange<Stride>) {
+    strides.resize(shape.size());
+  }
+
+  SizeType stride = 1;
+  for (SizeType i = 0; i < strides.size(); ++i) {
+    const auto d = layout == Layout::kColumnMajor ? i : strides.size() - 1 - i;
+    strides[d] = stride;
+    stride *= shape[d];
+  }
+  return strides;
+}
+
+// the layout of an Array, column-major for anything else
+template <typename E>
+inline auto layoutOf(const E &expr) -> Layout {
+  if constexpr (requires { { expr.layout() } -> std::same_as<Layout>; }) {
+    return expr.layout();
+  } else {
+    return Layout::kColumnMajor;
+  }
+}
+
+// dimensions by increasing stride: walking them fastest first visits the
+// storage in memory order
+template <Range Shape, Range Stride>
+inline auto memoryOrder(const Stride &strides) -> Shape {
+  Shape order{};
+  if constexpr (!FixedSizeRange<Shape>) {
+    order.resize(strides.size());
+  }
+  std::iota(order.begin(), order.end(), SizeType{0});
+  std::stable_sort(order.begin(), order.end(), [&](SizeType a, SizeType b) {
+    return strides[a] < strides[b];
+  });
+  return order;
+}
+
+// edge of the square tiles blockedCopy moves at a time; two 32 x 32 tiles of
+// doubles take 16 KiB, well inside L1
+inline constexpr SizeType COPY_TILE = 32;
+
+/**
+ * @brief dst[i . dst_strides] = src[i . src_strides] for every index i of
+ * shape. When the two sides have different fastest dimensions, e.g. a
+ * transpose or a change of layout, the copy goes tile by tile over those two
+ * dimensions so that neither side strides through memory a line per element.
+ * Otherwise it is a single sweep in memory order.
+ */
+template <typename T, typename U, Range Shape, Range DstStride,
+          Range SrcStride>
+inline auto blockedCopy(T *dst, const DstStride &dst_strides, const U *src,
+                        const SrcStride &src_strides, const Shape &shape)
+    -> void {
+  const auto rank = static_cast<SizeType>(shape.size());
+  SizeType size = 1;
+  for (SizeType d = 0; d < rank; ++d) {
+    size *= shape[d];
+  }
+  if (size == 0) {
+    return;
+  }
+  if (rank == 0) {
+    *dst = static_cast<T>(*src);
+    return;
+  }
+
+  // the fastest dimension of each side, ignoring extents of 1
+  auto fastest = [&](const auto &strides) {
+    SizeType best = 0;
+    for (SizeType d = 1; d < rank; ++d) {
+      if (1 < shape[d] && (shape[best] == 1 || strides[d] < strides[best])) {
+        best = d;
+      }
+    }
+    return best;
+  };
+  const auto a = fastest(src_strides);
+  const auto b = fastest(dst_strides);
+  const bool tiled = a != b;
+
+  // the remaining dimensions, walked in dst memory order around the inner
+  // loops
+  std::vector<SizeType> outer;
+  for (auto d : memoryOrder<std::vector<SizeType>>(dst_strides)) {
+    if (d != a && d != b) {
+      outer.push_back(d);
+    }
+  }
+
+  auto copyInner = [&](T *d0, const U *s0) {
+    if (!tiled) {
+      for (SizeType i = 0; i < shape[b]; ++i) {
+        d0[i * dst_strides[b]] = static_cast<T>(s0[i * src_strides[b]]);
+      }
+      return;
+    }
+    const auto na = shape[a];
+    const auto nb = shape[b];
+    for (SizeType jb = 0; jb < nb; jb += COPY_TILE) {
+      const auto je = std::min(nb, jb + COPY_TILE);
+      for (SizeType ib = 0; ib < na; ib += COPY_TILE) {
+        const auto ie = std::min(na, ib + COPY_TILE);
+        for (auto j = jb; j < je; ++j) {
+          auto *dj = d0 + j * dst_strides[b];
+          const auto *sj = s0 + j * src_strides[b];
+          for (auto i = ib; i < ie; ++i) {
+            dj[i * dst_strides[a]] = static_cast<T>(sj[i * src_strides[a]]);
+          }
+        }
+      }
+    }
+  };
+
+  std::vector<SizeType> index(outer.size(), 0);
+  SizeType dst_offset = 0;
+  SizeType src_offset = 0;
+  while (true) {
+    copyInner(dst + dst_offset, src + src_offset);
+    SizeType k = 0;
+    for (; k < outer.size(); ++k) {
+      const auto d = outer[k];
+      dst_offset += dst_strides[d];
+      src_offset += src_strides[d];
+      if (++index[k] < shape[d]) {
+        break;
+      }
+      dst_offset -= dst_strides[d] * shape[d];
+      src_offset -= src_strides[d] * shape[d];
+      index[k] = 0;
+    }
+    if (k == outer.size()) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Write every element of an expression into strided storage in a
+ * single pass. When the storage and every operand share one dense layout the
+ * loop is a plain linear sweep; a lone Array or view is copied with
+ * blockedCopy; anything else is walked in the storage's memory order.
+ */
+template <typename T, Range Shape, Range Stride, ExpressionConcept E>
+inline auto assignExpression(T *data, const Shape &shape, const Stride &strides,
+                             bool contiguous, const E &expr) -> void {
+  if (!std::ranges::equal(shape, expr.shape())) {
+    throw std::invalid_argument("Shape mismatch");
+  }
+
+  auto size = static_cast<SizeType>(expr.size());
+  if (contiguous && expr.flatCompatible(strides)) {
+    for (SizeType i = 0; i < size; ++i) {
+      data[i] = static_cast<T>(expr.flat(i));
+    }
+    return;
+  }
+  if constexpr (requires {
+                  { expr.data() } -> std::convertible_to<const void *>;
+                  expr.strides();
+                }) {
+    blockedCopy(data, strides, expr.data(), expr.strides(), shape);
+    return;
+  }
+
+  const auto order = memoryOrder<Shape>(strides);
+  Shape index{};
+  if constexpr (!FixedSizeRange<Shape>) {
+    index.resize(shape.size());
+  }
+  SizeType offset = 0;
+  for (SizeType i = 0; i < size; ++i) {
+    data[offset] = static_cast<T>(expr.element(index));
+    for (auto d : order) {
+      offset += strides[d];
+      if (++index[d] < shape[d]) {
+        break;
+      }
+      offset -= strides[d] * shape[d];
+      index[d] = 0;
+    }
+  }
+}
+
+}  // namespace detail
+
+}  // namespace fz
+
+#endif  // __FZ_ARRAY_BASE_H__
@@ -0,0 +1,459 @@
+/**
+ * @file array_view.hpp
+ * @brief Non-owning strided views over Array storage.
+ *
+ */
+
+#ifndef __FZ_ARRAY_VIEW_H__
+#define __FZ_ARRAY_VIEW_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/array_base.hpp"
+
+namespace fz {
+
+/**
+ * @brief A window into storage owned by someone else.
+ *
+ * Element (i0, i1, ...) lives at data[offset + i0 * strides[0] + ...]. Slicing,
+ * transposing and taking sub-blocks only rewrite shape, strides and offset, so
+ * they never touch the elements. Like std::span, constness is shallow: use
+ * ArrayView<const T> for read-only access.
+ */
+template <typename T, Range Shape = ShapeVector, Range Stride = ShapeVector>
+class ArrayView {
+ public:
+  using value_type = std::remove_cv_t<T>;
+  using reference = T &;
+  using pointer = T *;
+
+  class Iterator;
+
+ public:
+  ArrayView() = default;
+
+  ArrayView(T *data, Shape shape, Stride strides, SizeType offset = 0);
+
+  // ArrayView<T> -> ArrayView<const T>
+  template <typename U>
+    requires(std::is_same_v<const U, T> && !std::is_same_v<U, T>)
+  ArrayView(const ArrayView<U, Shape, Stride> &other);  // NOLINT
+
+ public:
+  __FZ_ARRAY_DUAL__ [[nodiscard]] auto size() const -> SizeType;
+
+  __FZ_ARRAY_DUAL__ [[nodiscard]] auto rank() const -> SizeType;
+
+  __FZ_ARRAY_DUAL__ auto shape() const -> const Shape &;
+
+  __FZ_ARRAY_DUAL__ auto strides() const -> const Stride &;
+
+  __FZ_ARRAY_DUAL__ [[nodiscard]] auto offset() const -> SizeType;
+
+  /**
+   * @brief Pointer to element (0, 0, ...).
+   */
+  __FZ_ARRAY_DUAL__ auto data() const -> T *;
+
+  /**
+   * @brief Whether the view covers a dense first-index-fastest block, i.e.
+   * data()[0, size()) are exactly its elements in iteration order.
+   */
+  __FZ_ARRAY_DUAL__ [[nodiscard]] auto isContiguous() const -> bool;
+
+  /**
+   * @brief Whether data()[0, size()) are exactly the view's elements, in any
+   * order: true for row-major and transposed blocks too.
+   */
+  __FZ_ARRAY_DUAL__ [[nodiscard]] auto isDense() const -> bool;
+
+  template <typename... Args>
+  __FZ_ARRAY_DUAL__ auto operator()(Args &&...args) const -> T &;
+
+  template <typename Arg>
+  __FZ_ARRAY_DUAL__ auto operator[](Arg &&arg) const -> T &;
+
+  template <typename... Args>
+  __FZ_ARRAY_DUAL__ auto at(Args &&...args) const -> T &;
+
+  // iterates with the first index fastest, matching Array's storage order
+  __FZ_ARRAY_DUAL__ auto begin() const -> Iterator;
+
+  __FZ_ARRAY_DUAL__ auto end() const -> Iterator;
+
+ public:
+  /**
+   * @brief Elements start, start + step, ... < stop along dim.
+   */
+  auto slice(SizeType dim, SizeType start, SizeType stop,
+             SizeType step = 1) const -> ArrayView;
+
+  /**
+   * @brief The sub-block [starts[d], stops[d]) in every dimension.
+   */
+  auto block(const Shape &starts, const Shape &stops) const -> ArrayView;
+
+  /**
+   * @brief Reverse the order of the dimensions.
+   */
+  auto transpose() const -> ArrayView;
+
+  /**
+   * @brief Dimension d of the result is dimension axes[d] of this view.
+   */
+  auto permute(const Shape &axes) const -> ArrayView;
+
+  /**
+   * @brief Drop dimensions of extent 1. A view with only such dimensions
+   * keeps one of them.
+   */
+  auto squeeze() const -> ArrayView
+    requires(!FixedSizeRange<Shape>);
+
+  /**
+   * @brief Write an expression, Array or other view element by element into
+   * the viewed storage. Plain `=` rebinds the view instead, like std::span.
+   */
+  template <ExpressionConcept E>
+  auto assign(const E &expr) const -> const ArrayView &;
+
+ public:
+  // expression protocol, see ExpressionConcept
+
+  __FZ_ARRAY_DUAL__ auto flat(SizeType i) const -> T &;
+
+  template <Range S>
+  __FZ_ARRAY_DUAL__ auto flatCompatible(const S &strides) const -> bool;
+
+  template <Range Index>
+  __FZ_ARRAY_DUAL__ auto element(const Index &index) const -> T &;
+
+ private:
+  T *_data{};
+  SizeType _offset{};
+  Shape _shape{};
+  Stride _strides{};
+
+  template <typename U, Range S, Range St>
+  friend class ArrayView;
+};
+
+template <typename T, Range Shape, Range Stride>
+class ArrayView<T, Shape, Stride>::Iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::remove_cv_t<T>;
+  using difference_type = std::ptrdiff_t;
+  using pointer = T *;
+  using reference = T &;
+
+ public:
+  Iterator() = default;
+
+  Iterator(const ArrayView *view, SizeType position)
+      : _view{view}, _position{position}, _offset{view->_offset} {
+    if constexpr (!FixedSizeRange<Shape>) {
+      _index.resize(view->_shape.size());
+    }
+  }
+
+  auto operator*() const -> T & { return _view->_data[_offset]; }
+
+  auto operator->() const -> T * { return _view->_data + _offset; }
+
+  auto operator++() -> Iterator & {
+    ++_position;
+    for (SizeType d = 0; d < _index.size(); ++d) {
+      _offset += _view->_strides[d];
+      if (++_index[d] < _view->_shape[d]) {
+        break;
+      }
+      _offset -= _view->_strides[d] * _view->_shape[d];
+      _index[d] = 0;
+    }
+    return *this;
+  }
+
+  auto operator++(int) -> Iterator {
+    auto tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  auto operator==(const Iterator &other) const -> bool {
+    return _position == other._position;
+  }
+
+ private:
+  const ArrayView *_view{};
+  SizeType _position{};
+  SizeType _offset{};
+  Shape _index{};
+};
+
+template <typename T, Range Shape, Range Stride>
+ArrayView<T, Shape, Stride>::ArrayView(T *data, Shape shape, Stride strides,
+                                       SizeType offset)
+    : _data{data},
+      _offset{offset},
+      _shape{std::move(shape)},
+      _strides{std::move(strides)} {
+  if (_shape.size() != _strides.size()) {
+    throw std::invalid_argument("Shape and strides differ in rank");
+  }
+}
+
+template <typename T, Range Shape, Range Stride>
+template <typename U>
+  requires(std::is_same_v<const U, T> && !std::is_same_v<U, T>)
+ArrayView<T, Shape, Stride>::ArrayView(const ArrayView<U, Shape, Stride> &other)
+    : _data{other._data},
+      _offset{other._offset},
+      _shape{other._shape},
+      _strides{other._strides} {}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::size() const
+    -> SizeType {
+  return std::reduce(_shape.begin(), _shape.end(), static_cast<SizeType>(1),
+                     std::multiplies<>());
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::rank() const
+    -> SizeType {
+  return _shape.size();
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::shape() const
+    -> const Shape & {
+  return _shape;
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::strides() const
+    -> const Stride & {
+  return _strides;
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::offset() const
+    -> SizeType {
+  return _offset;
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::data() const -> T * {
+  return _data + _offset;
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::isContiguous() const
+    -> bool {
+  SizeType expected = 1;
+  for (SizeType d = 0; d < _shape.size(); ++d) {
+    if (_shape[d] != 1 && _strides[d] != expected) {
+      return false;
+    }
+    expected *= _shape[d];
+  }
+  return true;
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::isDense() const
+    -> bool {
+  // the non-unit extents, taken in order of stride, must tile the buffer
+  SizeType remaining = 0;
+  for (SizeType d = 0; d < _shape.size(); ++d) {
+    if (_shape[d] == 0) {
+      return true;
+    }
+    remaining += _shape[d] != 1 ? 1 : 0;
+  }
+  SizeType expected = 1;
+  for (; 0 < remaining; --remaining) {
+    SizeType d = 0;
+    while (d < _shape.size() &&
+           (_shape[d] == 1 || static_cast<SizeType>(_strides[d]) != expected)) {
+      ++d;
+    }
+    if (d == _shape.size()) {
+      return false;
+    }
+    expected *= _shape[d];
+  }
+  return true;
+}
+
+template <typename T, Range Shape, Range Stride>
+template <typename... Args>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::operator()(
+    Args &&...args) const -> T & {
+  return _data[_offset +
+               detail::dataOffset(_strides, std::forward<Args>(args)...)];
+}
+
+template <typename T, Range Shape, Range Stride>
+template <typename Arg>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::operator[](
+    Arg &&arg) const -> T & {
+  return _data[_offset + detail::dataOffset(_strides, std::forward<Arg>(arg))];
+}
+
+template <typename T, Range Shape, Range Stride>
+template <typename... Args>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::at(
+    Args &&...args) const -> T & {
+  if (sizeof...(Args) != _shape.size()) {
+    throw std::invalid_argument("Invalid number of arguments");
+  }
+
+  SizeType dim = 0;
+  auto in_range = ((static_cast<SizeType>(args) < _shape[dim++]) && ...);
+  if (!in_range) {
+    throw std::out_of_range("Index out of range");
+  }
+
+  return (*this)(std::forward<Args>(args)...);
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::begin() const
+    -> Iterator {
+  return Iterator{this, 0};
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::end() const
+    -> Iterator {
+  return Iterator{this, size()};
+}
+
+template <typename T, Range Shape, Range Stride>
+inline auto ArrayView<T, Shape, Stride>::slice(SizeType dim, SizeType start,
+                                               SizeType stop,
+                                               SizeType step) const
+    -> ArrayView {
+  if (rank() <= dim) {
+    throw std::out_of_range("Invalid dimension");
+  }
+  if (step == 0 || stop < start || _shape[dim] < stop) {
+    throw std::invalid_argument("Invalid slice");
+  }
+
+  auto view = *this;
+  view._offset += start * _strides[dim];
+  view._shape[dim] = (stop - start + step - 1) / step;
+  view._strides[dim] *= step;
+  return view;
+}
+
+template <typename T, Range Shape, Range Stride>
+inline auto ArrayView<T, Shape, Stride>::block(const Shape &starts,
+                                               const Shape &stops) const
+    -> ArrayView {
+  if (starts.size() != rank() || stops.size() != rank()) {
+    throw std::invalid_argument("Invalid number of arguments");
+  }
+
+  auto view = *this;
+  for (SizeType d = 0; d < rank(); ++d) {
+    if (stops[d] < starts[d] || _shape[d] < stops[d]) {
+      throw std::invalid_argument("Invalid block");
+    }
+    view._offset += starts[d] * _strides[d];
+    view._shape[d] = stops[d] - starts[d];
+  }
+  return view;
+}
+
+template <typename T, Range Shape, Range Stride>
+inline auto ArrayView<T, Shape, Stride>::transpose() const -> ArrayView {
+  auto view = *this;
+  std::reverse(view._shape.begin(), view._shape.end());
+  std::reverse(view._strides.begin(), view._strides.end());
+  return view;
+}
+
+template <typename T, Range Shape, Range Stride>
+inline auto ArrayView<T, Shape, Stride>::permute(const Shape &axes) const
+    -> ArrayView {
+  if (axes.size() != rank()) {
+    throw std::invalid_argument("Invalid number of arguments");
+  }
+
+  auto view = *this;
+  SizeType seen = 0;
+  for (SizeType d = 0; d < rank(); ++d) {
+    auto axis = axes[d];
+    if (rank() <= axis || (seen >> axis & 1U) != 0) {
+      throw std::invalid_argument("Invalid permutation");
+    }
+    seen |= static_cast<SizeType>(1) << axis;
+    view._shape[d] = _shape[axis];
+    view._strides[d] = _strides[axis];
+  }
+  return view;
+}
+
+template <typename T, Range Shape, Range Stride>
+inline auto ArrayView<T, Shape, Stride>::squeeze() const -> ArrayView
+  requires(!FixedSizeRange<Shape>)
+{
+  ArrayView view;
+  view._data = _data;
+  view._offset = _offset;
+  for (SizeType d = 0; d < rank(); ++d) {
+    if (_shape[d] != 1) {
+      view._shape.push_back(_shape[d]);
+      view._strides.push_back(_strides[d]);
+    }
+  }
+  if (view._shape.empty() && 0 < rank()) {
+    view._shape.push_back(1);
+    view._strides.push_back(_strides[0]);
+  }
+  return view;
+}
+
+template <typename T, Range Shape, Range Stride>
+template <ExpressionConcept E>
+inline auto ArrayView<T, Shape, Stride>::assign(const E &expr) const
+    -> const ArrayView & {
+  detail::assignExpression(data(), _shape, _strides, isContiguous(), expr);
+  return *this;
+}
+
+template <typename T, Range Shape, Range Stride>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::flat(
+    SizeType i) const -> T & {
+  return _data[_offset + i];
+}
+
+template <typename T, Range Shape, Range Stride>
+template <Range S>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::flatCompatible(
+    const S &strides) const -> bool {
+  return isContiguous() && std::ranges::equal(_strides, strides);
+}
+
+template <typename T, Range Shape, Range Stride>
+template <Range Index>
+__FZ_ARRAY_DUAL__ inline auto ArrayView<T, Shape, Stride>::element(
+    const Index &index) const -> T & {
+  return _data[_offset + detail::indexOffset(_strides, index)];
+}
+
+}  // namespace fz
+
+#endif  // __FZ_ARRAY_VIEW_H__
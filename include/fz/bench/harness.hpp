@@ -0,0 +1,762 @@
+/**
+ * @file harness.hpp
+ * @brief Statistical micro-benchmark harness.
+ *
+ * A benchmark is a function taking a State and looping over it:
+ *
+ *   auto benchCopy(fz::bench::State& state) -> void {
+ *     auto arr = fz::Array<double>::empty({state.arg()});
+ *     for (auto _ : state) {
+ *       auto copy = arr;
+ *       fz::bench::doNotOptimize(copy.data());
+ *     }
+ *   }
+ *   FZ_BENCHMARK_ARGS(benchCopy, 1 << 10, 1 << 20);
+ *
+ * The harness warms the function up, doubles the iteration count until one
+ * sample takes the minimum sample time, then collects samples with that
+ * count and reports the per-iteration median, p90, p99 and spread. Results
+ * can be written as JSON or CSV and compared against a stored baseline.
+ */
+
+#ifndef __FZ_BENCH_HARNESS_H__
+#define __FZ_BENCH_HARNESS_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/array_base.hpp"
+#include "fz/parallel/perf_counters.hpp"
+#include "fz/parallel/performance.hpp"
+
+namespace fz::bench {
+
+/**
+ * @brief Make the compiler assume value is read, so the computation that
+ * produced it cannot be dropped.
+ */
+template <typename T>
+inline auto doNotOptimize(const T& value) -> void {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink = nullptr;
+  sink = &value;
+#endif
+}
+
+template <typename T>
+inline auto doNotOptimize(T& value) -> void {
+#if defined(__GNUC__) || defined(__clang__)
+  // only scalars may live in a register, anything else is pinned in memory
+  if constexpr (std::is_trivially_copyable_v<T> &&
+                sizeof(T) <= sizeof(void*)) {
+    asm volatile("" : "+m,r"(value) : : "memory");
+  } else {
+    asm volatile("" : : "r"(&value) : "memory");
+  }
+#else
+  static volatile void* sink = nullptr;
+  sink = &value;
+#endif
+}
+
+/**
+ * @brief Make the compiler assume all memory is read and written here, so
+ * pending stores are not elided or moved across the barrier.
+ */
+inline auto clobberMemory() -> void {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#else
+  std::atomic_signal_fence(std::memory_order_acq_rel);
+#endif
+}
+
+/**
+ * @brief Handed to a benchmark for one sample: iterating over it runs the
+ * timed loop.
+ */
+class State {
+ public:
+  // `for (auto _ : state)` does not warn about an unused variable
+  struct [[maybe_unused]] Value {};
+
+  class Iterator {
+   public:
+    Iterator() = default;
+
+    Iterator(State* state, SizeType remaining)
+        : _state{state}, _remaining{remaining} {}
+
+    auto operator*() const -> Value { return {}; }
+
+    auto operator++() -> Iterator& {
+      --_remaining;
+      return *this;
+    }
+
+    auto operator!=(const Iterator&) -> bool {
+      if (_remaining != 0) [[likely]] {
+        return true;
+      }
+      _state->_profile.stop();
+      return false;
+    }
+
+   private:
+    State* _state{};
+    SizeType _remaining{};
+  };
+
+  // counters: also count hardware events, see ExecutionProfile
+  State(SizeType iterations, std::int64_t arg, bool counters = false)
+      : _iterations{iterations}, _arg{arg} {
+    if (counters) {
+      _profile.enableCounters();
+    }
+  }
+
+  auto begin() -> Iterator {
+    _profile.reset();
+    _profile.start();
+    return {this, _iterations};
+  }
+
+  auto end() -> Iterator { return {}; }
+
+  [[nodiscard]] auto iterations() const -> SizeType { return _iterations; }
+
+  // the argument this instance was registered with, 0 when there is none
+  [[nodiscard]] auto arg() const -> std::int64_t { return _arg; }
+
+  // exclude setup inside the loop from the measurement
+  auto pauseTiming() -> void { _profile.stop(); }
+
+  auto resumeTiming() -> void { _profile.start(); }
+
+  // bytes touched by one iteration, reported as a bandwidth
+  auto setBytesProcessed(SizeType bytes) -> void { _bytes = bytes; }
+
+  [[nodiscard]] auto bytesProcessed() const -> SizeType { return _bytes; }
+
+  // call instead of running the loop when the benchmark cannot run here
+  auto skip(std::string reason) -> void { _skipped = std::move(reason); }
+
+  [[nodiscard]] auto skipped() const -> const std::string& { return _skipped; }
+
+  [[nodiscard]] auto profile() const
+      -> const Performance::ExecutionProfile& {
+    return _profile;
+  }
+
+ private:
+  SizeType _iterations;
+  std::int64_t _arg;
+  SizeType _bytes{};
+  std::string _skipped{};
+  Performance::ExecutionProfile _profile;
+};
+
+using Function = std::function<void(State&)>;
+
+struct Benchmark {
+  std::string name;
+  Function function;
+  std::int64_t arg;
+};
+
+inline auto registry() -> std::vector<Benchmark>& {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+/**
+ * @brief Register function once per argument, as "name/arg"; with no
+ * arguments it is registered once as "name". Returns a dummy for static
+ * initialization.
+ */
+inline auto registerBenchmark(std::string name, Function function,
+                              std::initializer_list<std::int64_t> args = {})
+    -> int {
+  if (args.size() == 0) {
+    registry().push_back({std::move(name), std::move(function), 0});
+    return 0;
+  }
+  for (auto arg : args) {
+    registry().push_back({name + "/" + std::to_string(arg), function, arg});
+  }
+  return 0;
+}
+
+/**
+ * @brief Summary of the per-iteration times of a benchmark's samples.
+ */
+struct Stats {
+  std::string name;
+  SizeType iterations{};
+  SizeType samples{};
+  double min_ns{};
+  double median_ns{};
+  double mean_ns{};
+  double stddev_ns{};
+  double p90_ns{};
+  double p99_ns{};
+  // 0 when the benchmark did not set bytes processed
+  double bytes_per_second{};
+  // why the benchmark did not run, empty when it did
+  std::string skipped{};
+  // hardware events per iteration, empty unless counted
+  CounterSample counters{};
+};
+
+/**
+ * @brief Percentile q in [0, 1] of sorted samples, interpolated between the
+ * nearest ranks.
+ */
+inline auto percentile(const std::vector<double>& sorted, double q) -> double {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const auto pos = q * static_cast<double>(sorted.size() - 1);
+  const auto lo = static_cast<SizeType>(pos);
+  const auto hi = std::min(lo + 1, sorted.size() - 1);
+  const auto frac = pos - static_cast<double>(lo);
+  return sorted[lo] + frac * (sorted[hi] - sorted[lo]);
+}
+
+inline auto computeStats(std::string name, std::vector<double> samples_ns,
+                         SizeType iterations, SizeType bytes) -> Stats {
+  Stats stats{.name = std::move(name),
+              .iterations = iterations,
+              .samples = samples_ns.size()};
+  if (samples_ns.empty()) {
+    return stats;
+  }
+  std::sort(samples_ns.begin(), samples_ns.end());
+  const auto n = static_cast<double>(samples_ns.size());
+  stats.min_ns = samples_ns.front();
+  stats.median_ns = percentile(samples_ns, 0.5);
+  stats.p90_ns = percentile(samples_ns, 0.9);
+  stats.p99_ns = percentile(samples_ns, 0.99);
+  stats.mean_ns =
+      std::accumulate(samples_ns.begin(), samples_ns.end(), 0.0) / n;
+  double sq = 0.0;
+  for (auto v : samples_ns) {
+    sq += (v - stats.mean_ns) * (v - stats.mean_ns);
+  }
+  stats.stddev_ns = 1 < samples_ns.size() ? std::sqrt(sq / (n - 1)) : 0.0;
+  if (bytes != 0 && 0.0 < stats.median_ns) {
+    stats.bytes_per_second =
+        static_cast<double>(bytes) / stats.median_ns * 1e9;
+  }
+  return stats;
+}
+
+struct Options {
+  std::string filter{".*"};
+  SizeType samples = 20;
+  std::chrono::nanoseconds min_sample_time{std::chrono::milliseconds{10}};
+  std::chrono::nanoseconds warmup_time{std::chrono::milliseconds{50}};
+  // console, json or csv
+  std::string format{"console"};
+  // empty writes to stdout
+  std::string out{};
+  std::string baseline{};
+  // relative slowdown of the median reported as a regression
+  double threshold = 0.05;
+  // count hardware events while sampling
+  bool counters = false;
+  bool list = false;
+};
+
+namespace detail {
+
+// beyond this an empty loop body is assumed, so calibration ends
+inline constexpr SizeType MAX_ITERATIONS = SizeType{1} << 40;
+
+inline auto runSample(const Benchmark& benchmark, SizeType iterations,
+                      bool counters = false) -> State {
+  State state{iterations, benchmark.arg, counters};
+  benchmark.function(state);
+  return state;
+}
+
+inline auto elapsed(const State& state) -> std::chrono::nanoseconds {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      state.profile().duration());
+}
+
+}  // namespace detail
+
+/**
+ * @brief Warm up, calibrate the iteration count and collect the samples of
+ * one benchmark.
+ */
+inline auto run(const Benchmark& benchmark, const Options& options) -> Stats {
+  using Clock = std::chrono::steady_clock;
+
+  // warm caches, page in buffers and let the clock frequency settle
+  const auto warmup_end = Clock::now() + options.warmup_time;
+  do {
+    auto state = detail::runSample(benchmark, 1);
+    if (!state.skipped().empty()) {
+      return {.name = benchmark.name, .skipped = state.skipped()};
+    }
+  } while (Clock::now() < warmup_end);
+
+  SizeType iterations = 1;
+  while (iterations < detail::MAX_ITERATIONS) {
+    const auto elapsed =
+        detail::elapsed(detail::runSample(benchmark, iterations));
+    if (options.min_sample_time <= elapsed) {
+      break;
+    }
+    // jump close to the target once the sample is long enough to trust
+    SizeType factor = 2;
+    if (std::chrono::microseconds{10} < elapsed) {
+      const auto ratio = 1.2 * static_cast<double>(
+                                   options.min_sample_time.count()) /
+                         static_cast<double>(elapsed.count());
+      factor = std::clamp<SizeType>(static_cast<SizeType>(std::ceil(ratio)),
+                                    2, 10);
+    }
+    iterations *= factor;
+  }
+
+  std::vector<double> samples_ns;
+  samples_ns.reserve(options.samples);
+  SizeType bytes = 0;
+  CounterSample counters;
+  for (SizeType s = 0; s < options.samples; ++s) {
+    const auto state =
+        detail::runSample(benchmark, iterations, options.counters);
+    samples_ns.push_back(static_cast<double>(detail::elapsed(state).count()) /
+                         static_cast<double>(iterations));
+    bytes = state.bytesProcessed();
+    counters += state.profile().counters();
+  }
+  auto stats = computeStats(benchmark.name, std::move(samples_ns), iterations,
+                            bytes);
+  stats.counters = counters.scaled(
+      1.0 / static_cast<double>(iterations * options.samples));
+  return stats;
+}
+
+namespace detail {
+
+inline auto hasCounters(const std::vector<Stats>& results) -> bool {
+  return std::any_of(results.begin(), results.end(),
+                     [](const auto& r) { return !r.counters.empty(); });
+}
+
+inline auto bytesPerCycle(const Stats& r) -> double {
+  return r.counters.bytesPerCycle(r.bytes_per_second * r.median_ns * 1e-9);
+}
+
+inline auto bottleneck(const Stats& r) -> std::string_view {
+  return r.counters.bottleneck(r.bytes_per_second * r.median_ns * 1e-9);
+}
+
+}  // namespace detail
+
+inline auto writeConsoleHeader(std::ostream& os, bool counters = false)
+    -> void {
+  os << std::left << std::setw(40) << "benchmark" << std::right
+     << std::setw(14) << "median ns" << std::setw(14) << "p90 ns"
+     << std::setw(14) << "p99 ns" << std::setw(10) << "stddev%"
+     << std::setw(12) << "iterations" << std::setw(10) << "GB/s";
+  if (counters) {
+    os << std::setw(8) << "IPC" << std::setw(10) << "B/cycle"
+       << "  bottleneck";
+  }
+  os << '\n';
+}
+
+inline auto writeConsoleRow(std::ostream& os, const Stats& r,
+                            bool counters = false) -> void {
+  if (!r.skipped.empty()) {
+    os << std::left << std::setw(40) << r.name << "skipped: " << r.skipped
+       << '\n';
+    return;
+  }
+  const auto spread =
+      0.0 < r.median_ns ? 100.0 * r.stddev_ns / r.median_ns : 0.0;
+  os << std::left << std::setw(40) << r.name << std::right << std::fixed
+     << std::setprecision(2) << std::setw(14) << r.median_ns << std::setw(14)
+     << r.p90_ns << std::setw(14) << r.p99_ns << std::setw(10) << spread
+     << std::setw(12) << r.iterations << std::setw(10);
+  if (0.0 < r.bytes_per_second) {
+    os << r.bytes_per_second * 1e-9;
+  } else {
+    os << "-";
+  }
+  if (counters && !r.counters.empty()) {
+    os << std::setw(8) << r.counters.ipc() << std::setw(10)
+       << detail::bytesPerCycle(r) << "  " << detail::bottleneck(r);
+  } else if (counters) {
+    os << std::setw(8) << "-" << std::setw(10) << "-";
+  }
+  os << '\n';
+  os.unsetf(std::ios_base::floatfield);
+}
+
+inline auto writeConsole(std::ostream& os, const std::vector<Stats>& results)
+    -> void {
+  const auto counters = detail::hasCounters(results);
+  writeConsoleHeader(os, counters);
+  for (const auto& r : results) {
+    writeConsoleRow(os, r, counters);
+  }
+}
+
+inline auto writeJson(std::ostream& os, const std::vector<Stats>& results,
+                      const Options& options) -> void {
+  char date[32] = {};
+  const auto now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+  os << std::setprecision(17);
+  os << "{\n  \"context\": {\n"
+     << "    \"date\": \"" << date << "\",\n"
+     << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+     << "    \"samples\": " << options.samples << ",\n"
+     << "    \"min_sample_time_ns\": " << options.min_sample_time.count()
+     << "\n  },\n  \"benchmarks\": [";
+  const char* separator = "\n";
+  for (const auto& r : results) {
+    if (!r.skipped.empty()) {
+      continue;
+    }
+    os << std::exchange(separator, ",\n") << "    {\"name\": \"" << r.name
+       << "\", \"iterations\": " << r.iterations
+       << ", \"samples\": " << r.samples << ", \"min_ns\": " << r.min_ns
+       << ", \"median_ns\": " << r.median_ns << ", \"mean_ns\": " << r.mean_ns
+       << ", \"stddev_ns\": " << r.stddev_ns << ", \"p90_ns\": " << r.p90_ns
+       << ", \"p99_ns\": " << r.p99_ns
+       << ", \"bytes_per_second\": " << r.bytes_per_second;
+    if (!r.counters.empty()) {
+      // per iteration
+      for (SizeType e = 0; e < PERF_EVENT_COUNT; ++e) {
+        const auto event = static_cast<PerfEvent>(e);
+        if (r.counters.has(event)) {
+          os << ", \"" << perfEventName(event)
+             << "\": " << r.counters.get(event);
+        }
+      }
+      os << ", \"ipc\": " << r.counters.ipc()
+         << ", \"bytes_per_cycle\": " << detail::bytesPerCycle(r)
+         << ", \"bottleneck\": \"" << detail::bottleneck(r) << '"';
+    }
+    os << "}";
+  }
+  os << "\n  ]\n}\n";
+}
+
+inline auto writeCsv(std::ostream& os, const std::vector<Stats>& results)
+    -> void {
+  const auto counters = detail::hasCounters(results);
+  os << std::setprecision(17);
+  os << "name,iterations,samples,min_ns,median_ns,mean_ns,stddev_ns,p90_ns,"
+        "p99_ns,bytes_per_second";
+  if (counters) {
+    for (SizeType e = 0; e < PERF_EVENT_COUNT; ++e) {
+      os << ',' << perfEventName(static_cast<PerfEvent>(e));
+    }
+    os << ",ipc,bytes_per_cycle,bottleneck";
+  }
+  os << '\n';
+  for (const auto& r : results) {
+    if (!r.skipped.empty()) {
+      continue;
+    }
+    os << r.name << ',' << r.iterations << ',' << r.samples << ',' << r.min_ns
+       << ',' << r.median_ns << ',' << r.mean_ns << ',' << r.stddev_ns << ','
+       << r.p90_ns << ',' << r.p99_ns << ',' << r.bytes_per_second;
+    if (counters) {
+      for (SizeType e = 0; e < PERF_EVENT_COUNT; ++e) {
+        os << ',' << r.counters.get(static_cast<PerfEvent>(e));
+      }
+      os << ',' << r.counters.ipc() << ',' << detail::bytesPerCycle(r) << ','
+         << detail::bottleneck(r);
+    }
+    os << '\n';
+  }
+}
+
+/**
+ * @brief Read name -> (median_ns, stddev_ns) from a file written by
+ * writeJson or writeCsv.
+ */
+inline auto parseBaseline(std::string_view text)
+    -> std::map<std::string, std::pair<double, double>> {
+  std::map<std::string, std::pair<double, double>> baseline;
+  const auto first = text.find_first_not_of(" \t\r\n");
+  if (first != std::string_view::npos && text[first] == '{') {
+    static const std::regex entry{
+        R"re(\{"name": "([^"]*)"[^}]*"median_ns": ([^,]+),[^}]*)re"
+        R"re("stddev_ns": ([^,]+),)re"};
+    const std::string str{text};
+    for (auto it = std::sregex_iterator{str.begin(), str.end(), entry};
+         it != std::sregex_iterator{}; ++it) {
+      baseline[(*it)[1]] = {std::stod((*it)[2]), std::stod((*it)[3])};
+    }
+    return baseline;
+  }
+
+  std::istringstream is{std::string{text}};
+  std::string line;
+  std::getline(is, line);
+  std::vector<std::string> header;
+  for (std::istringstream hs{line}; std::getline(hs, line, ',');) {
+    header.push_back(line);
+  }
+  auto column = [&header](std::string_view name) {
+    auto it = std::find(header.begin(), header.end(), name);
+    if (it == header.end()) {
+      throw std::runtime_error("Baseline has no column " + std::string{name});
+    }
+    return static_cast<SizeType>(it - header.begin());
+  };
+  const auto name_col = column("name");
+  const auto median_col = column("median_ns");
+  const auto stddev_col = column("stddev_ns");
+  while (std::getline(is, line)) {
+    std::vector<std::string> fields;
+    for (std::istringstream ls{line}; std::getline(ls, line, ',');) {
+      fields.push_back(line);
+    }
+    if (fields.size() == header.size()) {
+      baseline[fields[name_col]] = {std::stod(fields[median_col]),
+                                    std::stod(fields[stddev_col])};
+    }
+  }
+  return baseline;
+}
+
+/**
+ * @brief A slowdown counts as a regression when the median moved by more
+ * than threshold and by more than twice the noise of either run.
+ */
+inline auto isRegression(const Stats& current, double base_median,
+                         double base_stddev, double threshold) -> bool {
+  if (base_median <= 0.0) {
+    return false;
+  }
+  const auto delta = current.median_ns - base_median;
+  const auto noise = 2.0 * std::max(current.stddev_ns, base_stddev);
+  return threshold * base_median < delta && noise < delta;
+}
+
+/**
+ * @brief Print the change of every benchmark found in the baseline; returns
+ * the number of regressions.
+ */
+inline auto compare(std::ostream& os, const std::vector<Stats>& results,
+                    const std::map<std::string, std::pair<double, double>>&
+                        baseline,
+                    double threshold) -> SizeType {
+  SizeType regressions = 0;
+  os << std::left << std::setw(40) << "benchmark" << std::right
+     << std::setw(14) << "baseline ns" << std::setw(14) << "current ns"
+     << std::setw(10) << "change%" << '\n';
+  for (const auto& r : results) {
+    auto it = baseline.find(r.name);
+    if (it == baseline.end() || !r.skipped.empty()) {
+      continue;
+    }
+    const auto [base_median, base_stddev] = it->second;
+    const auto change =
+        0.0 < base_median ? 100.0 * (r.median_ns / base_median - 1.0) : 0.0;
+    const auto regressed = isRegression(r, base_median, base_stddev, threshold);
+    regressions += regressed ? 1 : 0;
+    os << std::left << std::setw(40) << r.name << std::right << std::fixed
+       << std::setprecision(2) << std::setw(14) << base_median << std::setw(14)
+       << r.median_ns << std::setw(10) << change
+       << (regressed ? "  REGRESSION" : "") << '\n';
+  }
+  os.unsetf(std::ios_base::floatfield);
+  return regressions;
+}
+
+inline auto parseOptions(int argc, char** argv) -> Options {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg{argv[i]};
+    const auto eq = arg.find('=');
+    const auto key = arg.substr(0, eq);
+    const std::string value{eq == std::string_view::npos ? std::string_view{}
+                                                         : arg.substr(eq + 1)};
+    if (key == "--filter") {
+      options.filter = value;
+    } else if (key == "--samples") {
+      options.samples = std::max<SizeType>(std::stoul(value), 1);
+    } else if (key == "--min-sample-time") {
+      options.min_sample_time = std::chrono::duration_cast<
+          std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>{
+          std::stod(value)});
+    } else if (key == "--warmup") {
+      options.warmup_time = std::chrono::duration_cast<
+          std::chrono::nanoseconds>(std::chrono::duration<double, std::milli>{
+          std::stod(value)});
+    } else if (key == "--format") {
+      if (value != "console" && value != "json" && value != "csv") {
+        throw std::invalid_argument("Unknown format " + value);
+      }
+      options.format = value;
+    } else if (key == "--out") {
+      options.out = value;
+    } else if (key == "--baseline") {
+      options.baseline = value;
+    } else if (key == "--threshold") {
+      options.threshold = std::stod(value) / 100.0;
+    } else if (key == "--counters") {
+      options.counters = true;
+    } else if (key == "--list") {
+      options.list = true;
+    } else {
+      throw std::invalid_argument("Unknown option " + std::string{arg});
+    }
+  }
+  return options;
+}
+
+inline constexpr const char* USAGE =
+    "options:\n"
+    "  --filter=REGEX          run the benchmarks whose name matches\n"
+    "  --samples=N             samples per benchmark (20)\n"
+    "  --min-sample-time=MS    calibrate each sample to last this long (10)\n"
+    "  --warmup=MS             warmup time per benchmark (50)\n"
+    "  --format=console|json|csv\n"
+    "  --out=FILE              write the results to FILE\n"
+    "  --baseline=FILE         compare against results from --format=json or"
+    " csv\n"
+    "  --threshold=PERCENT     median slowdown flagged as regression (5)\n"
+    "  --counters              count cycles, instructions and cache, branch\n"
+    "                          and TLB misses, and guess each bottleneck\n"
+    "  --list                  print the benchmark names\n";
+
+/**
+ * @brief Entry point of a benchmark executable: runs the registered
+ * benchmarks and returns 1 if any of them regressed against the baseline.
+ */
+inline auto main(int argc, char** argv) -> int {
+  Options options;
+  try {
+    options = parseOptions(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << '\n' << USAGE;
+    return 2;
+  }
+
+  const std::regex filter{options.filter};
+  std::vector<const Benchmark*> selected;
+  for (const auto& benchmark : registry()) {
+    if (std::regex_search(benchmark.name, filter)) {
+      selected.push_back(&benchmark);
+    }
+  }
+  if (options.list) {
+    for (const auto* benchmark : selected) {
+      std::cout << benchmark->name << '\n';
+    }
+    return 0;
+  }
+
+  if (options.counters) {
+    if (PerfCounters probe; !probe.available()) {
+      std::cerr << "counters unavailable, timing only (" << probe.error()
+                << ")\n";
+      options.counters = false;
+    }
+  }
+
+  // console output to stdout is streamed, everything else is progress
+  const auto stream = options.format == "console" && options.out.empty();
+  auto& progress = stream ? std::cout : std::cerr;
+  writeConsoleHeader(progress, options.counters);
+  std::vector<Stats> results;
+  for (const auto* benchmark : selected) {
+    results.push_back(run(*benchmark, options));
+    writeConsoleRow(progress, results.back(), options.counters);
+  }
+
+  std::ofstream file;
+  if (!options.out.empty()) {
+    file.open(options.out);
+    if (!file) {
+      std::cerr << "Cannot open " << options.out << '\n';
+      return 2;
+    }
+  }
+  std::ostream& os = options.out.empty() ? std::cout : file;
+  if (options.format == "json") {
+    writeJson(os, results, options);
+  } else if (options.format == "csv") {
+    writeCsv(os, results);
+  } else if (!options.out.empty()) {
+    writeConsole(os, results);
+  }
+
+  if (options.baseline.empty()) {
+    return 0;
+  }
+  std::ifstream in{options.baseline};
+  if (!in) {
+    std::cerr << "Cannot open " << options.baseline << '\n';
+    return 2;
+  }
+  std::stringstream text;
+  text << in.rdbuf();
+  const auto regressions =
+      compare(std::cerr, results, parseBaseline(text.str()), options.threshold);
+  if (regressions != 0) {
+    std::cerr << regressions << " regression(s) beyond "
+              << options.threshold * 100.0 << "%\n";
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace fz::bench
+
+#define FZ_BENCH_CONCAT_IMPL(a, b) a##b
+#define FZ_BENCH_CONCAT(a, b) FZ_BENCH_CONCAT_IMPL(a, b)
+
+/**
+ * @brief Register func(State&) under its own name.
+ */
+#define FZ_BENCHMARK(func)                                   \
+  [[maybe_unused]] static const int FZ_BENCH_CONCAT(         \
+      fz_benchmark_registered_, __LINE__) =                  \
+      ::fz::bench::registerBenchmark(#func, func)
+
+/**
+ * @brief Register func(State&) once per argument, read back with
+ * State::arg().
+ */
+#define FZ_BENCHMARK_ARGS(func, ...)                         \
+  [[maybe_unused]] static const int FZ_BENCH_CONCAT(         \
+      fz_benchmark_registered_, __LINE__) =                  \
+      ::fz::bench::registerBenchmark(#func, func, {__VA_ARGS__})
+
+#endif  // __FZ_BENCH_HARNESS_H__
@@ -0,0 +1,328 @@
+/**
+ * @file cow_array.hpp
+ * @brief Array with copy-on-write storage, so copies cost O(1).
+ */
+
+#ifndef __FZ_COW_ARRAY_H__
+#define __FZ_COW_ARRAY_H__
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "fz/allocator.hpp"
+#include "fz/array.hpp"
+#include "fz/array_base.hpp"
+
+namespace fz {
+
+/**
+ * @brief An Array whose copies share one buffer under an atomic reference
+ * count, for arrays passed by value through snapshots, queues and caches.
+ * Copying allocates nothing; the first mutable access to a shared CowArray
+ * gives it a private copy of the buffer. Const access never copies, so read
+ * through const references or read() where a non-const CowArray is shared.
+ *
+ * Mutable references, pointers and views stay valid until the CowArray is
+ * copied, assigned or destroyed; after a copy they would write into the
+ * shared buffer, so take them again. Const views keep pointing into the
+ * buffer they were taken from, which lives as long as a CowArray holds it.
+ * Distinct CowArray objects sharing a buffer may be used from different
+ * threads; a single object is no more thread-safe than an Array.
+ */
+template <typename T, Range Shape = ShapeVector, Range Stride = ShapeVector,
+          typename Alloc = Allocator<T>>
+class CowArray {
+ public:
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+  using allocator_type = Alloc;
+  using ArrayType = Array<T, Shape, Stride, Alloc>;
+  using View = typename ArrayType::View;
+  using ConstView = typename ArrayType::ConstView;
+
+ public:
+  static auto empty(Shape shape, const Alloc &alloc = Alloc{}) -> CowArray {
+    return CowArray{ArrayType::empty(std::move(shape), alloc)};
+  }
+
+  static auto zeros(Shape shape, const Alloc &alloc = Alloc{}) -> CowArray {
+    return CowArray{ArrayType::zeros(std::move(shape), alloc)};
+  }
+
+  static auto empty(Shape shape, Layout layout, const Alloc &alloc = Alloc{})
+      -> CowArray {
+    return CowArray{ArrayType::empty(std::move(shape), layout, alloc)};
+  }
+
+  static auto zeros(Shape shape, Layout layout, const Alloc &alloc = Alloc{})
+      -> CowArray {
+    return CowArray{ArrayType::zeros(std::move(shape), layout, alloc)};
+  }
+
+ public:
+  CowArray() = default;
+
+  // takes over the storage of array without copying it
+  CowArray(ArrayType array)  // NOLINT
+      : _shared{new Shared{std::move(array)}} {}
+
+  CowArray(std::initializer_list<T> data, const Alloc &alloc = Alloc{})
+      : CowArray{ArrayType(data, alloc)} {}
+
+  /**
+   * @brief Materialise an expression, view or Array.
+   */
+  template <ExpressionConcept E>
+    requires(!std::is_same_v<E, CowArray> && !std::is_same_v<E, ArrayType>)
+  CowArray(const E &expr)  // NOLINT
+      : CowArray{ArrayType(expr)} {}
+
+  CowArray(const CowArray &other) noexcept : _shared{other._shared} {
+    retain();
+  }
+
+  auto operator=(const CowArray &other) noexcept -> CowArray & {
+    if (_shared != other._shared) {
+      release();
+      _shared = other._shared;
+      retain();
+    }
+    return *this;
+  }
+
+  CowArray(CowArray &&other) noexcept
+      : _shared{std::exchange(other._shared, nullptr)} {}
+
+  auto operator=(CowArray &&other) noexcept -> CowArray & {
+    if (this != &other) {
+      release();
+      _shared = std::exchange(other._shared, nullptr);
+    }
+    return *this;
+  }
+
+  // takes over the storage of array; other owners keep the old buffer
+  auto operator=(ArrayType &&array) -> CowArray & {
+    return *this = CowArray{std::move(array)};
+  }
+
+  /**
+   * @brief Evaluate an expression into this array. A private buffer of the
+   * right shape is reused; a shared one is left to its other owners and the
+   * result goes into a new buffer, without copying the old contents.
+   */
+  template <ExpressionConcept E>
+    requires(!std::is_same_v<E, CowArray>)
+  auto operator=(const E &expr) -> CowArray & {
+    if (isShared()) {
+      *this = CowArray{ArrayType(expr)};
+    } else {
+      write() = expr;
+    }
+    return *this;
+  }
+
+  ~CowArray() { release(); }
+
+ public:
+  // reading never copies
+
+  [[nodiscard]] auto read() const -> const ArrayType & {
+    return _shared == nullptr ? emptyArray() : _shared->array;
+  }
+
+  [[nodiscard]] auto size() const -> SizeType { return read().size(); }
+
+  auto shape() const -> const Shape & { return read().shape(); }
+
+  auto strides() const -> const Stride & { return read().strides(); }
+
+  auto layout() const -> Layout { return read().layout(); }
+
+  [[nodiscard]] auto isContiguous() const -> bool {
+    return read().isContiguous();
+  }
+
+  [[nodiscard]] auto isDense() const -> bool { return read().isDense(); }
+
+  template <typename... Args>
+  auto operator()(Args &&...args) const -> const T & {
+    return read()(std::forward<Args>(args)...);
+  }
+
+  template <typename Arg>
+  auto operator[](Arg &&arg) const -> const T & {
+    return read()[std::forward<Arg>(arg)];
+  }
+
+  template <typename... Args>
+  auto at(Args &&...args) const -> const T & {
+    return read().at(std::forward<Args>(args)...);
+  }
+
+  auto begin() const -> const T * { return read().begin(); }
+
+  auto end() const -> const T * { return read().end(); }
+
+  auto cbegin() const -> const T * { return read().begin(); }
+
+  auto cend() const -> const T * { return read().end(); }
+
+  auto data() const -> const T * { return read().data(); }
+
+  auto view() const -> ConstView { return read().view(); }
+
+  [[nodiscard]] auto getAllocator() const -> Alloc {
+    return read().getAllocator();
+  }
+
+  // number of CowArrays sharing the buffer, 0 for a default-constructed one
+  [[nodiscard]] auto useCount() const -> SizeType {
+    return _shared == nullptr ? 0
+                              : _shared->refs.load(std::memory_order_acquire);
+  }
+
+  [[nodiscard]] auto isShared() const -> bool { return 1 < useCount(); }
+
+ public:
+  // writing copies a shared buffer first
+
+  /**
+   * @brief The underlying Array, made private to this CowArray first.
+   */
+  auto write() -> ArrayType &;
+
+  template <typename... Args>
+  auto operator()(Args &&...args) -> T & {
+    return write()(std::forward<Args>(args)...);
+  }
+
+  template <typename Arg>
+  auto operator[](Arg &&arg) -> T & {
+    return write()[std::forward<Arg>(arg)];
+  }
+
+  template <typename... Args>
+  auto at(Args &&...args) -> T & {
+    return write().at(std::forward<Args>(args)...);
+  }
+
+  auto begin() -> T * { return write().begin(); }
+
+  auto end() -> T * { return write().end(); }
+
+  auto data() -> T * { return write().data(); }
+
+  auto view() -> View { return write().view(); }
+
+  /**
+   * @brief Array::resize. A shared buffer that changes size is not copied:
+   * the new elements are uninitialised anyway.
+   */
+  auto resize(Shape shape) -> void;
+
+  auto reshape(Shape shape) -> void;
+
+  auto reshape(Shape shape, Layout layout) -> void;
+
+ public:
+  // expression protocol, see ExpressionConcept
+
+  auto flat(SizeType i) const -> const T & { return read().flat(i); }
+
+  template <Range S>
+  auto flatCompatible(const S &strides) const -> bool {
+    return read().flatCompatible(strides);
+  }
+
+  template <Range Index>
+  auto element(const Index &index) const -> const T & {
+    return read().element(index);
+  }
+
+ private:
+  struct Shared {
+    explicit Shared(ArrayType array) : array{std::move(array)} {}
+
+    std::atomic<SizeType> refs{1};
+    ArrayType array;
+  };
+
+  Shared *_shared = nullptr;
+
+  static auto emptyArray() -> const ArrayType & {
+    static const ArrayType empty{};
+    return empty;
+  }
+
+  auto retain() noexcept -> void {
+    if (_shared != nullptr) {
+      _shared->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // the last owner deletes; acq_rel orders every owner's reads before it
+  auto release() noexcept -> void {
+    if (_shared != nullptr &&
+        _shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete _shared;
+    }
+    _shared = nullptr;
+  }
+
+  static auto shapeSize(const Shape &shape) -> SizeType {
+    return std::accumulate(shape.begin(), shape.end(), SizeType{1},
+                           std::multiplies<>{});
+  }
+
+  auto checkSize(const Shape &shape) const -> void {
+    if (shapeSize(shape) != size()) {
+      throw std::invalid_argument("Invalid shape");
+    }
+  }
+};
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto CowArray<T, Shape, Stride, Alloc>::write() -> ArrayType & {
+  if (_shared == nullptr) {
+    _shared = new Shared{ArrayType{}};
+  } else if (isShared()) {
+    auto *copy = new Shared{_shared->array};
+    release();
+    _shared = copy;
+  }
+  return _shared->array;
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto CowArray<T, Shape, Stride, Alloc>::resize(Shape shape) -> void {
+  if (isShared() && shapeSize(shape) != size()) {
+    *this = CowArray{ArrayType::empty(std::move(shape), layout(),
+                                      read().getAllocator())};
+    return;
+  }
+  write().resize(std::move(shape));
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto CowArray<T, Shape, Stride, Alloc>::reshape(Shape shape) -> void {
+  checkSize(shape);
+  write().reshape(std::move(shape));
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto CowArray<T, Shape, Stride, Alloc>::reshape(Shape shape,
+                                                       Layout layout) -> void {
+  checkSize(shape);
+  write().reshape(std::move(shape), layout);
+}
+
+}  // namespace fz
+
+#endif  // __FZ_COW_ARRAY_H__
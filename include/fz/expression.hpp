@@ -0,0 +1,405 @@
+/**
+ * @file expression.hpp
+ * @brief Lazy elementwise arithmetic over Array and ArrayView.
+ *
+ * Operators build a tree of ElementwiseExpression nodes instead of computing
+ * anything. The tree is evaluated element by element when it is assigned to
+ * an Array (or ArrayView::assign), so `a = b * c + d * e` is one fused loop
+ * with no intermediate buffers.
+ */
+
+#ifndef __FZ_EXPRESSION_H__
+#define __FZ_EXPRESSION_H__
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "fz/array.hpp"
+
+namespace fz {
+
+namespace detail {
+
+template <typename T>
+concept ScalarOperand = std::is_arithmetic_v<std::remove_cvref_t<T>>;
+
+template <typename T>
+concept ExpressionOperand =
+    ExpressionConcept<std::remove_cvref_t<T>> || ScalarOperand<T>;
+
+template <typename T>
+concept ViewOperand = requires(const std::remove_cvref_t<T> &v) {
+  v.isContiguous();
+  v.offset();
+};
+
+// a scalar broadcast to every element
+template <typename T>
+class Scalar {
+ public:
+  static constexpr bool is_scalar = true;
+
+  explicit Scalar(T value) : _value{value} {}
+
+  auto flat(SizeType /*i*/) const -> T { return _value; }
+
+  template <Range S>
+  auto flatCompatible(const S & /*strides*/) const -> bool {
+    return true;
+  }
+
+  template <Range Index>
+  auto element(const Index & /*index*/) const -> T {
+    return _value;
+  }
+
+ private:
+  T _value;
+};
+
+template <typename T>
+constexpr bool isScalar = requires { std::remove_cvref_t<T>::is_scalar; };
+
+// Named Arrays are held by reference, temporaries (Arrays, nested
+// expressions) and views by value, so an expression never dangles on its
+// own operands.
+template <typename T>
+using OperandHolder = std::conditional_t<
+    ScalarOperand<T>, Scalar<std::remove_cvref_t<T>>,
+    std::conditional_t<std::is_lvalue_reference_v<T> && !ViewOperand<T>,
+                       const std::remove_reference_t<T> &,
+                       std::remove_cvref_t<T>>>;
+
+template <typename T>
+auto holdOperand(T &&operand) -> OperandHolder<T &&> {
+  if constexpr (ScalarOperand<T>) {
+    return Scalar<std::remove_cvref_t<T>>{operand};
+  } else {
+    return std::forward<T>(operand);
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Applies Op to the corresponding elements of its operands. All
+ * non-scalar operands must have the same shape.
+ */
+template <typename Op, typename... Operands>
+class ElementwiseExpression {
+ public:
+  using value_type = std::remove_cvref_t<std::invoke_result_t<
+      const Op &,
+      decltype(std::declval<const std::remove_cvref_t<Operands> &>().flat(
+          SizeType{}))...>>;
+
+ public:
+  template <typename... Args>
+  explicit ElementwiseExpression(Op op, Args &&...operands);
+
+ public:
+  [[nodiscard]] auto size() const -> SizeType;
+
+  [[nodiscard]] auto shape() const -> decltype(auto);
+
+  auto flat(SizeType i) const -> value_type;
+
+  template <Range S>
+  auto flatCompatible(const S &strides) const -> bool;
+
+  template <Range Index>
+  auto element(const Index &index) const -> value_type;
+
+ private:
+  static constexpr std::size_t SHAPE_OPERAND = [] {
+    constexpr std::array<bool, sizeof...(Operands)> scalars{
+        detail::isScalar<Operands>...};
+    return static_cast<std::size_t>(
+        std::find(scalars.begin(), scalars.end(), false) - scalars.begin());
+  }();
+  static_assert(SHAPE_OPERAND < sizeof...(Operands),
+                "An expression needs at least one array operand");
+
+  Op _op;
+  std::tuple<Operands...> _operands;
+
+  template <std::size_t... Is>
+  auto checkShapes(std::index_sequence<Is...> /*unused*/) const -> bool;
+};
+
+template <typename Op, typename... Operands>
+template <typename... Args>
+ElementwiseExpression<Op, Operands...>::ElementwiseExpression(
+    Op op, Args &&...operands)
+    : _op{std::move(op)}, _operands{std::forward<Args>(operands)...} {
+  if (!checkShapes(std::index_sequence_for<Operands...>{})) {
+    throw std::invalid_argument("Shape mismatch");
+  }
+}
+
+template <typename Op, typename... Operands>
+template <std::size_t... Is>
+auto ElementwiseExpression<Op, Operands...>::checkShapes(
+    std::index_sequence<Is...> /*unused*/) const -> bool {
+  const auto &shape = this->shape();
+  auto same_shape = [&shape](const auto &operand) {
+    if constexpr (detail::isScalar<decltype(operand)>) {
+      return true;
+    } else {
+      return std::ranges::equal(shape, operand.shape());
+    }
+  };
+  return (same_shape(std::get<Is>(_operands)) && ...);
+}
+
+template <typename Op, typename... Operands>
+inline auto ElementwiseExpression<Op, Operands...>::size() const -> SizeType {
+  return std::get<SHAPE_OPERAND>(_operands).size();
+}
+
+template <typename Op, typename... Operands>
+inline auto ElementwiseExpression<Op, Operands...>::shape() const
+    -> decltype(auto) {
+  return std::get<SHAPE_OPERAND>(_operands).shape();
+}
+
+template <typename Op, typename... Operands>
+inline auto ElementwiseExpression<Op, Operands...>::flat(SizeType i) const
+    -> value_type {
+  return std::apply(
+      [this, i](const auto &...operands) {
+        return static_cast<value_type>(_op(operands.flat(i)...));
+      },
+      _operands);
+}
+
+template <typename Op, typename... Operands>
+template <Range S>
+inline auto ElementwiseExpression<Op, Operands...>::flatCompatible(
+    const S &strides) const -> bool {
+  return std::apply(
+      [&strides](const auto &...operands) {
+        return (operands.flatCompatible(strides) && ...);
+      },
+      _operands);
+}
+
+template <typename Op, typename... Operands>
+template <Range Index>
+inline auto ElementwiseExpression<Op, Operands...>::element(
+    const Index &index) const -> value_type {
+  return std::apply(
+      [this, &index](const auto &...operands) {
+        return static_cast<value_type>(_op(operands.element(index)...));
+      },
+      _operands);
+}
+
+template <typename Op, typename... Args>
+inline auto makeExpression(Op op, Args &&...args) {
+  return ElementwiseExpression<Op, detail::OperandHolder<Args &&>...>{
+      std::move(op), detail::holdOperand(std::forward<Args>(args))...};
+}
+
+namespace detail {
+
+template <typename L, typename R>
+concept BinaryOperands =
+    ExpressionOperand<L> && ExpressionOperand<R> &&
+    (!ScalarOperand<L> || !ScalarOperand<R>);
+
+// Arrays and views that can be written through
+template <typename T>
+concept AssignableOperand =
+    ExpressionConcept<T> && !std::is_const_v<T> &&
+    (requires(T &t) { t.resize(t.shape()); } || ViewOperand<T>);
+
+template <typename A, typename E>
+inline auto assignTo(A &target, E &&expr) -> A & {
+  if constexpr (ViewOperand<A>) {
+    target.assign(std::forward<E>(expr));
+  } else {
+    target = std::forward<E>(expr);
+  }
+  return target;
+}
+
+}  // namespace detail
+
+// arithmetic
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator+(L &&lhs, R &&rhs) {
+  return makeExpression(std::plus<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator-(L &&lhs, R &&rhs) {
+  return makeExpression(std::minus<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator*(L &&lhs, R &&rhs) {
+  return makeExpression(std::multiplies<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator/(L &&lhs, R &&rhs) {
+  return makeExpression(std::divides<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto operator-(E &&expr) {
+  return makeExpression(std::negate<>{}, std::forward<E>(expr));
+}
+
+// comparison, producing boolean masks for where()
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator<(L &&lhs, R &&rhs) {
+  return makeExpression(std::less<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator<=(L &&lhs, R &&rhs) {
+  return makeExpression(std::less_equal<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator>(L &&lhs, R &&rhs) {
+  return makeExpression(std::greater<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto operator>=(L &&lhs, R &&rhs) {
+  return makeExpression(std::greater_equal<>{}, std::forward<L>(lhs),
+                        std::forward<R>(rhs));
+}
+
+/**
+ * @brief Elementwise `condition ? on_true : on_false`. Both branches are
+ * evaluated for every element.
+ */
+template <typename C, typename L, typename R>
+  requires(detail::ExpressionOperand<C> && detail::ExpressionOperand<L> &&
+           detail::ExpressionOperand<R>)
+inline auto where(C &&condition, L &&on_true, R &&on_false) {
+  return makeExpression(
+      [](const auto &c, const auto &t, const auto &f) {
+        return static_cast<bool>(c) ? t : f;
+      },
+      std::forward<C>(condition), std::forward<L>(on_true),
+      std::forward<R>(on_false));
+}
+
+// unary math
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto abs(E &&expr) {
+  return makeExpression([](const auto &x) { return std::abs(x); },
+                        std::forward<E>(expr));
+}
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto sqrt(E &&expr) {
+  return makeExpression([](const auto &x) { return std::sqrt(x); },
+                        std::forward<E>(expr));
+}
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto exp(E &&expr) {
+  return makeExpression([](const auto &x) { return std::exp(x); },
+                        std::forward<E>(expr));
+}
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto log(E &&expr) {
+  return makeExpression([](const auto &x) { return std::log(x); },
+                        std::forward<E>(expr));
+}
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto sin(E &&expr) {
+  return makeExpression([](const auto &x) { return std::sin(x); },
+                        std::forward<E>(expr));
+}
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto cos(E &&expr) {
+  return makeExpression([](const auto &x) { return std::cos(x); },
+                        std::forward<E>(expr));
+}
+
+template <typename E>
+  requires ExpressionConcept<std::remove_cvref_t<E>>
+inline auto tanh(E &&expr) {
+  return makeExpression([](const auto &x) { return std::tanh(x); },
+                        std::forward<E>(expr));
+}
+
+template <typename L, typename R>
+  requires detail::BinaryOperands<L, R>
+inline auto pow(L &&base, R &&exponent) {
+  return makeExpression(
+      [](const auto &x, const auto &y) { return std::pow(x, y); },
+      std::forward<L>(base), std::forward<R>(exponent));
+}
+
+// compound assignment, evaluated in place
+
+template <typename A, typename E>
+  requires(detail::AssignableOperand<A> && detail::ExpressionOperand<E>)
+inline auto operator+=(A &target, E &&expr) -> A & {
+  return detail::assignTo(target, target + std::forward<E>(expr));
+}
+
+template <typename A, typename E>
+  requires(detail::AssignableOperand<A> && detail::ExpressionOperand<E>)
+inline auto operator-=(A &target, E &&expr) -> A & {
+  return detail::assignTo(target, target - std::forward<E>(expr));
+}
+
+template <typename A, typename E>
+  requires(detail::AssignableOperand<A> && detail::ExpressionOperand<E>)
+inline auto operator*=(A &target, E &&expr) -> A & {
+  return detail::assignTo(target, target * std::forward<E>(expr));
+}
+
+template <typename A, typename E>
+  requires(detail::AssignableOperand<A> && detail::ExpressionOperand<E>)
+inline auto operator/=(A &target, E &&expr) -> A & {
+  return detail::assignTo(target, target / std::forward<E>(expr));
+}
+
+}  // namespace fz
+
+#endif  // __FZ_EXPRESSION_H__
@@ -1,36 +1,16 @@
-// #ifndef __FZ_IO_H__
-// #define __FZ_IO_H__
+/**
+ * @file io.hpp
+ * @brief Reading and writing arrays: file helpers, .npy checkpoints,
+ * asynchronous I/O, chunked out-of-core storage and text.
+ */
 
-// #include <ostream>
+#ifndef __FZ_IO_H__
+#define __FZ_IO_H__
 
-// #include "array.hpp"
+#include "fz/io/async.hpp"
+#include "fz/io/chunked.hpp"
+#include "fz/io/file.hpp"
+#include "fz/io/npy.hpp"
+#include "fz/io/text.hpp"
 
-// namespace fz {
-
-// // template <typename T>
-// // inline auto operator<<(std::ostream& os, const Array<T>& arr) -> std::ostream& {
-// //   auto shape = arr.shape();
-// //   auto n_dim = shape.size();
-// //   if (n_dim == 0) {
-// //     os << "[]";
-// //     return os;
-// //   }
-// //   os << "[";
-// //   for (auto i = 0; i < shape[0]; ++i) {
-// //     if (n_dim == 1) {
-// //       os << arr(i);
-// //     } else {
-// //       os << arr[i];
-// //     }
-// //     if (i < shape[0] - 1) {
-// //       os << ", ";
-// //     }
-// //   }
-// //   os << "]";
-
-// //   return os;
-// // }
-
-// }  // namespace fz
-
-// #endif  // __FZ_IO_H__
+#endif  // __FZ_IO_H__
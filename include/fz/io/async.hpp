@@ -0,0 +1,826 @@
+/**
+ * @file async.hpp
+ * @brief Asynchronous file I/O, so checkpoints drain while compute goes on.
+ *
+ * AsyncIo queues reads and writes and hands back an IoHandle to wait on.
+ * On Linux 5.6+ the requests go through an io_uring instance (set up with
+ * the raw system calls, no liburing needed) whose completions a single
+ * thread reaps; elsewhere, or where io_uring is disabled, a few threads run
+ * blocking pread/pwrite instead. Either way the submitting thread only
+ * queues work. Files opened with direct = true skip the page cache, which
+ * keeps a multi-GB checkpoint from evicting the working set.
+ *
+ * Buffers must stay alive and unmodified until their handle completes.
+ */
+
+#ifndef __FZ_IO_ASYNC_H__
+#define __FZ_IO_ASYNC_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "fz/allocator.hpp"
+#include "fz/array.hpp"
+#include "fz/io/file.hpp"
+#include "fz/io/npy.hpp"
+#include "fz/layout.hpp"
+
+namespace fz {
+
+enum class IoBackend : std::uint8_t {
+  // io_uring when the kernel offers it, threads otherwise
+  kAuto,
+  kUring,
+  kThreads,
+};
+
+struct AsyncIoOptions {
+  IoBackend backend = IoBackend::kAuto;
+  // requests in flight at once; submitting more waits for a free slot
+  SizeType queue_depth = 64;
+  // workers of the thread backend
+  SizeType threads = 2;
+};
+
+// one write of an AsyncIo batch
+struct IoWrite {
+  const void* data;
+  SizeType size;
+  SizeType offset;
+};
+
+namespace detail {
+
+/**
+ * @brief A thread of its own for the continuations of write batches, which
+ * may sync and rename files: run where completions are reaped, they would
+ * hold up every other request in flight.
+ */
+class Continuations {
+ public:
+  Continuations() : _thread{[this] { run(); }} {}
+
+  // runs what is queued, then stops
+  ~Continuations() {
+    {
+      std::lock_guard lock{_mutex};
+      _stop = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+  }
+
+  Continuations(const Continuations&) = delete;
+  auto operator=(const Continuations&) -> Continuations& = delete;
+
+  auto post(std::function<void()> task) -> void {
+    {
+      std::lock_guard lock{_mutex};
+      _queue.push_back(std::move(task));
+    }
+    _cv.notify_all();
+  }
+
+  // wait until everything posted so far has run
+  auto drain() -> void {
+    std::unique_lock lock{_mutex};
+    _cv.wait(lock, [&] { return _queue.empty() && !_running; });
+  }
+
+ private:
+  auto run() -> void;
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<std::function<void()>> _queue;
+  bool _running = false;
+  bool _stop = false;
+  std::thread _thread;
+};
+
+inline auto Continuations::run() -> void {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock{_mutex};
+      _running = false;
+      _cv.notify_all();
+      _cv.wait(lock, [&] { return _stop || !_queue.empty(); });
+      if (_queue.empty()) {
+        return;
+      }
+      task = std::move(_queue.front());
+      _queue.pop_front();
+      _running = true;
+    }
+    task();
+  }
+}
+
+/**
+ * @brief Completion state shared by the requests of one handle.
+ */
+class IoState : public std::enable_shared_from_this<IoState> {
+ public:
+  // on_complete runs on continuations when given, else where the last
+  // request completes
+  explicit IoState(std::function<void(std::exception_ptr)> on_complete,
+                   Continuations* continuations = nullptr)
+      : _on_complete{std::move(on_complete)}, _continuations{continuations} {}
+
+  auto add() -> void {
+    std::lock_guard lock{_mutex};
+    ++_pending;
+  }
+
+  // one request finished, with error on failure
+  auto complete(std::exception_ptr error) -> void;
+
+  auto wait() -> void {
+    std::unique_lock lock{_mutex};
+    _cv.wait(lock, [&] { return _pending == 0; });
+    if (_error) {
+      std::rethrow_exception(_error);
+    }
+  }
+
+  [[nodiscard]] auto ready() -> bool {
+    std::lock_guard lock{_mutex};
+    return _pending == 0;
+  }
+
+ private:
+  // run the continuation, then wake the waiters
+  auto finish() -> void;
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  // requests outstanding, plus one while the batch is being submitted
+  SizeType _pending = 1;
+  std::exception_ptr _error;
+  std::function<void(std::exception_ptr)> _on_complete;
+  Continuations* _continuations;
+};
+
+inline auto IoState::complete(std::exception_ptr error) -> void {
+  {
+    std::lock_guard lock{_mutex};
+    if (error && !_error) {
+      _error = std::move(error);
+    }
+    if (1 < _pending) {
+      --_pending;
+      return;
+    }
+  }
+  // the last request; nothing else touches the continuation from here on
+  if (_on_complete && _continuations != nullptr) {
+    _continuations->post([self = shared_from_this()] { self->finish(); });
+  } else {
+    finish();
+  }
+}
+
+inline auto IoState::finish() -> void {
+  std::function<void(std::exception_ptr)> on_complete;
+  std::exception_ptr error;
+  {
+    std::lock_guard lock{_mutex};
+    on_complete = std::move(_on_complete);
+    error = _error;
+  }
+  if (on_complete) {
+    try {
+      on_complete(error);
+    } catch (...) {
+      error = error ? error : std::current_exception();
+    }
+  }
+  {
+    std::lock_guard lock{_mutex};
+    _error = std::move(error);
+    _pending = 0;
+  }
+  _cv.notify_all();
+}
+
+struct IoRequest {
+  int fd;
+  bool write;
+  char* data;
+  SizeType size;
+  SizeType offset;
+  const std::string* path;
+  std::shared_ptr<IoState> state;
+};
+
+class IoEngine {
+ public:
+  virtual ~IoEngine() = default;
+
+  // waits for a free slot when queue_depth requests are in flight
+  virtual auto submit(IoRequest request) -> void = 0;
+
+  // wait until nothing is in flight
+  virtual auto drain() -> void = 0;
+};
+
+inline auto ioError(const IoRequest& request, int err) -> std::exception_ptr {
+  return std::make_exception_ptr(std::runtime_error(
+      std::string{request.write ? "cannot write" : "cannot read"} + " '" +
+      *request.path + "': " + std::strerror(err)));
+}
+
+/**
+ * @brief Blocking pread/pwrite on a few dedicated threads.
+ */
+class ThreadIoEngine final : public IoEngine {
+ public:
+  ThreadIoEngine(SizeType threads, SizeType queue_depth)
+      : _queue_depth{std::max<SizeType>(queue_depth, 1)} {
+    for (SizeType i = 0; i < std::max<SizeType>(threads, 1); ++i) {
+      _workers.emplace_back([this] { run(); });
+    }
+  }
+
+  ~ThreadIoEngine() override {
+    {
+      std::lock_guard lock{_mutex};
+      _stop = true;
+    }
+    _cv.notify_all();
+    for (auto& worker : _workers) {
+      worker.join();
+    }
+  }
+
+  auto submit(IoRequest request) -> void override {
+    {
+      std::unique_lock lock{_mutex};
+      _cv.wait(lock, [&] { return _in_flight < _queue_depth; });
+      ++_in_flight;
+      _queue.push_back(std::move(request));
+    }
+    _cv.notify_all();
+  }
+
+  auto drain() -> void override {
+    std::unique_lock lock{_mutex};
+    _cv.wait(lock, [&] { return _in_flight == 0; });
+  }
+
+ private:
+  auto run() -> void;
+
+  SizeType _queue_depth;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::deque<IoRequest> _queue;
+  SizeType _in_flight = 0;
+  bool _stop = false;
+  std::vector<std::thread> _workers;
+};
+
+inline auto ThreadIoEngine::run() -> void {
+  while (true) {
+    IoRequest request;
+    {
+      std::unique_lock lock{_mutex};
+      _cv.wait(lock, [&] { return _stop || !_queue.empty(); });
+      if (_queue.empty()) {
+        return;
+      }
+      request = std::move(_queue.front());
+      _queue.pop_front();
+    }
+    std::exception_ptr error;
+    try {
+      if (request.write) {
+        writeAll(request.fd, request.data, request.size, request.offset,
+                 *request.path);
+      } else {
+        readAll(request.fd, request.data, request.size, request.offset,
+                *request.path);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    request.state->complete(std::move(error));
+    {
+      std::lock_guard lock{_mutex};
+      --_in_flight;
+    }
+    _cv.notify_all();
+  }
+}
+
+#ifdef __linux__
+
+/**
+ * @brief One io_uring instance. Callers fill submission entries under a
+ * mutex; a reaper thread blocks in io_uring_enter for completions, resubmits
+ * the rest of short transfers and completes the handles.
+ */
+class UringIoEngine final : public IoEngine {
+ public:
+  // throws std::runtime_error where io_uring is missing or disabled
+  explicit UringIoEngine(SizeType queue_depth);
+
+  ~UringIoEngine() override;
+
+  auto submit(IoRequest request) -> void override;
+
+  auto drain() -> void override {
+    std::unique_lock lock{_mutex};
+    _cv.wait(lock, [&] { return _in_flight == 0; });
+  }
+
+ private:
+  static auto enter(int fd, unsigned submit, unsigned wait, unsigned flags)
+      -> int {
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+  }
+
+  // queue one entry; the caller holds _mutex and owns a slot
+  auto push(std::uint8_t opcode, IoRequest* request) -> void;
+
+  auto reap() -> void;
+
+  // unmap the rings and close the instance
+  auto release() -> void;
+
+  int _fd = -1;
+  void* _sq_ring = MAP_FAILED;
+  void* _cq_ring = MAP_FAILED;
+  void* _sqes = MAP_FAILED;
+  SizeType _sq_ring_size = 0;
+  SizeType _cq_ring_size = 0;
+  SizeType _sqes_size = 0;
+
+  unsigned* _sq_tail = nullptr;
+  unsigned* _sq_mask = nullptr;
+  unsigned* _sq_array = nullptr;
+  unsigned* _cq_head = nullptr;
+  unsigned* _cq_tail = nullptr;
+  unsigned* _cq_mask = nullptr;
+  io_uring_cqe* _cqes = nullptr;
+  SizeType _entries = 0;
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  SizeType _in_flight = 0;
+  std::thread _reaper;
+};
+
+inline UringIoEngine::UringIoEngine(SizeType queue_depth) {
+  io_uring_params params{};
+  _fd = static_cast<int>(::syscall(
+      __NR_io_uring_setup, static_cast<unsigned>(queue_depth), &params));
+  if (_fd < 0) {
+    throwIoError("io_uring_setup", "io_uring");
+  }
+  // IORING_OP_READ/WRITE and the probe came with Linux 5.6
+  alignas(io_uring_probe) char probe_buffer[sizeof(io_uring_probe) +
+                                            256 * sizeof(io_uring_probe_op)]{};
+  auto* probe = reinterpret_cast<io_uring_probe*>(probe_buffer);
+  if (::syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PROBE, probe,
+                256) < 0 ||
+      probe->last_op < IORING_OP_WRITE ||
+      (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) == 0 ||
+      (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) == 0) {
+    ::close(_fd);
+    errno = ENOSYS;
+    throwIoError("io_uring lacks read/write", "io_uring");
+  }
+
+  _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single) {
+    _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+  }
+  _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  constexpr int prot = PROT_READ | PROT_WRITE;
+  constexpr int flags = MAP_SHARED | MAP_POPULATE;
+  _sq_ring = ::mmap(nullptr, _sq_ring_size, prot, flags, _fd,
+                    IORING_OFF_SQ_RING);
+  _cq_ring = single ? _sq_ring
+                    : ::mmap(nullptr, _cq_ring_size, prot, flags, _fd,
+                             IORING_OFF_CQ_RING);
+  _sqes = ::mmap(nullptr, _sqes_size, prot, flags, _fd, IORING_OFF_SQES);
+  if (_sq_ring == MAP_FAILED || _cq_ring == MAP_FAILED ||
+      _sqes == MAP_FAILED) {
+    const auto err = errno;
+    release();
+    errno = err;
+    throwIoError("cannot map", "io_uring");
+  }
+
+  auto* sq = static_cast<char*>(_sq_ring);
+  auto* cq = static_cast<char*>(_cq_ring);
+  _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  _sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  _cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  // never more in flight than the submission queue holds, so it cannot
+  // overflow and the completion queue (twice as large) cannot either
+  _entries = params.sq_entries;
+
+  _reaper = std::thread{[this] { reap(); }};
+}
+
+inline UringIoEngine::~UringIoEngine() {
+  if (_reaper.joinable()) {
+    drain();
+    {
+      // a no-op without a request wakes the reaper to exit
+      std::unique_lock lock{_mutex};
+      ++_in_flight;
+      push(IORING_OP_NOP, nullptr);
+    }
+    _reaper.join();
+  }
+  release();
+}
+
+inline auto UringIoEngine::release() -> void {
+  if (_sqes != MAP_FAILED) {
+    ::munmap(_sqes, _sqes_size);
+  }
+  if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring) {
+    ::munmap(_cq_ring, _cq_ring_size);
+  }
+  if (_sq_ring != MAP_FAILED) {
+    ::munmap(_sq_ring, _sq_ring_size);
+  }
+  if (0 <= _fd) {
+    ::close(_fd);
+  }
+}
+
+inline auto UringIoEngine::push(std::uint8_t opcode, IoRequest* request)
+    -> void {
+  const auto tail = std::atomic_ref{*_sq_tail}.load(std::memory_order_relaxed);
+  const auto index = tail & *_sq_mask;
+  auto& sqe = static_cast<io_uring_sqe*>(_sqes)[index];
+  std::memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = opcode;
+  sqe.fd = -1;
+  if (request != nullptr) {
+    sqe.fd = request->fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(request->data);
+    sqe.len =
+        static_cast<std::uint32_t>(std::min(request->size, IO_CHUNK_SIZE));
+    sqe.off = request->offset;
+  }
+  sqe.user_data = reinterpret_cast<std::uint64_t>(request);
+  _sq_array[index] = index;
+  std::atomic_ref{*_sq_tail}.store(tail + 1, std::memory_order_release);
+  while (enter(_fd, 1, 0, 0) < 0 && (errno == EINTR || errno == EAGAIN)) {
+  }
+}
+
+inline auto UringIoEngine::submit(IoRequest request) -> void {
+  auto* owned = new IoRequest(std::move(request));
+  std::unique_lock lock{_mutex};
+  _cv.wait(lock, [&] { return _in_flight < _entries; });
+  ++_in_flight;
+  push(owned->write ? IORING_OP_WRITE : IORING_OP_READ, owned);
+}
+
+inline auto UringIoEngine::reap() -> void {
+  while (true) {
+    enter(_fd, 0, 1, IORING_ENTER_GETEVENTS);
+    auto head = *_cq_head;
+    const auto tail =
+        std::atomic_ref{*_cq_tail}.load(std::memory_order_acquire);
+    {
+      // the requests were queued under the lock: taking it orders their
+      // construction before our reads in terms the language (and tsan)
+      // can see, not only through the kernel
+      std::lock_guard lock{_mutex};
+    }
+    for (; head != tail; ++head) {
+      const auto& cqe = _cqes[head & *_cq_mask];
+      auto* request = reinterpret_cast<IoRequest*>(cqe.user_data);
+      const auto res = cqe.res;
+      std::atomic_ref{*_cq_head}.store(head + 1, std::memory_order_release);
+      if (request == nullptr) {
+        return;
+      }
+
+      std::exception_ptr error;
+      if (res == -EINTR || res == -EAGAIN) {
+        std::lock_guard lock{_mutex};
+        push(request->write ? IORING_OP_WRITE : IORING_OP_READ, request);
+        continue;
+      }
+      if (res < 0) {
+        error = ioError(*request, -res);
+      } else if (res == 0) {
+        // nothing moved and nothing failed: resubmitting would spin forever
+        error = std::make_exception_ptr(std::runtime_error(
+            (request->write ? "write made no progress on '"
+                            : "unexpected end of file '") +
+            *request->path + "'"));
+      } else if (static_cast<SizeType>(res) < request->size) {
+        // short transfer or a piece of a long one: queue the rest in the
+        // slot this one held
+        request->data += res;
+        request->size -= static_cast<SizeType>(res);
+        request->offset += static_cast<SizeType>(res);
+        std::lock_guard lock{_mutex};
+        push(request->write ? IORING_OP_WRITE : IORING_OP_READ, request);
+        continue;
+      }
+      request->state->complete(std::move(error));
+      delete request;
+      {
+        std::lock_guard lock{_mutex};
+        --_in_flight;
+      }
+      _cv.notify_all();
+    }
+  }
+}
+
+#endif
+
+}  // namespace detail
+
+/**
+ * @brief Completion of one asynchronous operation. Default-constructed
+ * handles are complete.
+ */
+class IoHandle {
+ public:
+  IoHandle() = default;
+
+  /**
+   * @brief Block until the operation finished; rethrows its error.
+   */
+  auto wait() const -> void {
+    if (_state) {
+      _state->wait();
+    }
+  }
+
+  [[nodiscard]] auto ready() const -> bool {
+    return !_state || _state->ready();
+  }
+
+ private:
+  explicit IoHandle(std::shared_ptr<detail::IoState> state)
+      : _state{std::move(state)} {}
+
+  std::shared_ptr<detail::IoState> _state;
+
+  friend class AsyncIo;
+};
+
+class AsyncIo {
+ public:
+  explicit AsyncIo(AsyncIoOptions options = {});
+
+  // waits for everything in flight
+  ~AsyncIo() = default;
+
+  AsyncIo(const AsyncIo&) = delete;
+  auto operator=(const AsyncIo&) -> AsyncIo& = delete;
+
+  // the backend actually in use, never kAuto
+  [[nodiscard]] auto backend() const -> IoBackend { return _backend; }
+
+  /**
+   * @brief Write the pieces to file, then call on_complete(error) with error
+   * null on success; its own exception becomes the handle's. on_complete
+   * runs on a thread of this AsyncIo that does nothing else, never where
+   * completions are reaped, so it may block. file, the buffers and anything
+   * on_complete uses must outlive the handle's completion.
+   */
+  auto write(const File& file, const std::vector<IoWrite>& writes,
+             std::function<void(std::exception_ptr)> on_complete = {})
+      -> IoHandle;
+
+  auto write(const File& file, const void* data, SizeType size,
+             SizeType offset) -> IoHandle {
+    return write(file, {{data, size, offset}});
+  }
+
+  auto read(const File& file, void* data, SizeType size, SizeType offset)
+      -> IoHandle;
+
+  // block until nothing is in flight and every continuation has run
+  auto drain() -> void {
+    _engine->drain();
+    _continuations.drain();
+  }
+
+ private:
+  auto submit(const File& file, bool write, const void* data, SizeType size,
+              SizeType offset, const std::shared_ptr<detail::IoState>& state)
+      -> void;
+
+  IoBackend _backend = IoBackend::kThreads;
+  // outlives the engine, which may still post to it while draining
+  detail::Continuations _continuations;
+  std::unique_ptr<detail::IoEngine> _engine;
+};
+
+inline AsyncIo::AsyncIo(AsyncIoOptions options) {
+#ifdef __linux__
+  if (options.backend != IoBackend::kThreads) {
+    try {
+      _engine = std::make_unique<detail::UringIoEngine>(options.queue_depth);
+      _backend = IoBackend::kUring;
+    } catch (const std::runtime_error&) {
+      if (options.backend == IoBackend::kUring) {
+        throw;
+      }
+    }
+  }
+#else
+  if (options.backend == IoBackend::kUring) {
+    throw std::runtime_error("io_uring needs Linux");
+  }
+#endif
+  if (!_engine) {
+    _engine = std::make_unique<detail::ThreadIoEngine>(options.threads,
+                                                       options.queue_depth);
+  }
+}
+
+inline auto AsyncIo::submit(const File& file, bool write, const void* data,
+                            SizeType size, SizeType offset,
+                            const std::shared_ptr<detail::IoState>& state)
+    -> void {
+  if (file.direct()) {
+    const auto address = reinterpret_cast<std::uintptr_t>(data);
+    if (address % DIRECT_IO_ALIGNMENT != 0 || size % DIRECT_IO_ALIGNMENT != 0 ||
+        offset % DIRECT_IO_ALIGNMENT != 0) {
+      throw std::invalid_argument("unaligned O_DIRECT transfer to '" +
+                                  file.path() + "'");
+    }
+  }
+  if (size == 0) {
+    return;
+  }
+  state->add();
+  _engine->submit({file.fd(), write,
+                   const_cast<char*>(static_cast<const char*>(data)), size,
+                   offset, &file.path(), state});
+}
+
+inline auto AsyncIo::write(const File& file, const std::vector<IoWrite>& writes,
+                           std::function<void(std::exception_ptr)> on_complete)
+    -> IoHandle {
+  auto state = std::make_shared<detail::IoState>(std::move(on_complete),
+                                                 &_continuations);
+  std::exception_ptr error;
+  try {
+    for (const auto& w : writes) {
+      submit(file, true, w.data, w.size, w.offset, state);
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+  // drop the submission reference; completes now if nothing went out
+  state->complete(error);
+  if (error) {
+    state->wait();
+  }
+  return IoHandle{std::move(state)};
+}
+
+inline auto AsyncIo::read(const File& file, void* data, SizeType size,
+                          SizeType offset) -> IoHandle {
+  auto state = std::make_shared<detail::IoState>(nullptr);
+  std::exception_ptr error;
+  try {
+    submit(file, false, data, size, offset, state);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  state->complete(error);
+  if (error) {
+    state->wait();
+  }
+  return IoHandle{std::move(state)};
+}
+
+namespace detail {
+
+// text is the formatted header; owner keeps the elements alive until the
+// writes are done
+inline auto saveNpyAsync(AsyncIo& io, const std::string& path,
+                         const std::string& text, const char* data,
+                         SizeType bytes, NpySaveOptions options,
+                         std::shared_ptr<const void> owner) -> IoHandle {
+  using Block = std::vector<char, AlignedAllocator<char, DIRECT_IO_ALIGNMENT>>;
+  auto header = std::make_shared<Block>(text.begin(), text.end());
+
+  const bool direct =
+      options.direct &&
+      reinterpret_cast<std::uintptr_t>(data) % DIRECT_IO_ALIGNMENT == 0;
+  const auto tmp = path + ".tmp";
+  auto file = std::make_shared<File>(tmp, File::Mode::kCreate, direct);
+  file->reserve(header->size() + bytes);
+
+  std::vector<IoWrite> writes{{header->data(), header->size(), 0}};
+  auto body = bytes;
+  auto tail = std::make_shared<Block>();
+  if (direct) {
+    // O_DIRECT moves whole blocks: the last partial one goes through a
+    // zero-padded copy and the file is trimmed to size afterwards
+    body = bytes / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+    if (body < bytes) {
+      tail->assign(DIRECT_IO_ALIGNMENT, '\0');
+      std::memcpy(tail->data(), data + body, bytes - body);
+      writes.push_back({tail->data(), tail->size(), header->size() + body});
+    }
+  }
+  writes.push_back({data, body, header->size()});
+
+  return io.write(
+      *file, writes,
+      [file, header, tail, owner = std::move(owner), tmp, path,
+       size = header->size() + bytes,
+       sync = options.sync](std::exception_ptr error) {
+        if (error) {
+          ::unlink(tmp.c_str());
+          return;
+        }
+        file->truncate(size);
+        if (sync) {
+          file->sync();
+        }
+        file->close();
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+          throwIoError("cannot replace", path);
+        }
+      });
+}
+
+}  // namespace detail
+
+/**
+ * @brief saveNpy() that returns once the writes are queued; the file
+ * replaces path when the handle completes. arr must stay alive and
+ * unchanged until then. Row-major arrays are written in C order;
+ * non-contiguous views are gathered into a copy the handle owns.
+ *
+ * With options.direct the payload bypasses the page cache if arr's buffer
+ * is DIRECT_IO_ALIGNMENT aligned, e.g. from AlignedAllocator<T, 4096> or
+ * HugePageAllocator; other buffers are written through the cache.
+ */
+template <typename C>
+inline auto saveNpyAsync(AsyncIo& io, const std::string& path, const C& arr,
+                         NpySaveOptions options = {}) -> IoHandle {
+  using T = std::remove_cv_t<typename C::value_type>;
+  const std::vector<SizeType> shape(arr.shape().begin(), arr.shape().end());
+  const auto header = detail::formatNpyHeader(
+      npyDescr<T>(), shape, detail::layoutOf(arr) == Layout::kColumnMajor);
+  if constexpr (requires { arr.offset(); }) {
+    if (!arr.isContiguous()) {
+      auto copy = std::make_shared<const Array<T>>(
+          toLayout(arr, Layout::kColumnMajor));
+      return detail::saveNpyAsync(
+          io, path, header, reinterpret_cast<const char*>(copy->data()),
+          copy->size() * sizeof(T), options, copy);
+    }
+  }
+  return detail::saveNpyAsync(io, path, header,
+                              reinterpret_cast<const char*>(arr.data()),
+                              arr.size() * sizeof(T), options, nullptr);
+}
+
+}  // namespace fz
+
+#endif  // __FZ_IO_ASYNC_H__
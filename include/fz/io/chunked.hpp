@@ -0,0 +1,689 @@
+/**
+ * @file chunked.hpp
+ * @brief Out-of-core arrays stored on disk as a grid of chunks, streamed
+ * through memory one chunk at a time.
+ *
+ * The file is a header block followed by one slot per chunk, in chunk-grid
+ * order with the first grid index fastest. A chunk holds its elements dense,
+ * first index fastest; chunks on the upper edges are clipped to the array
+ * and leave the end of their slot unused. Slots are CHUNK_ALIGNMENT aligned
+ * so every chunk is one aligned request.
+ *
+ * ChunkReader streams the chunks in file order: a background thread reads
+ * ahead into a ring of two (double buffering) or more buffers while the
+ * caller works on the current chunk, so compute and disk overlap and the
+ * disk sees one sequential pass. ChunkWriter does the same in reverse.
+ * Choose the chunk shape to follow the access pattern: an algorithm that
+ * sweeps along dimension d wants chunks spanning all of d.
+ */
+
+#ifndef __FZ_IO_CHUNKED_H__
+#define __FZ_IO_CHUNKED_H__
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/array_view.hpp"
+#include "fz/io/file.hpp"
+#include "fz/io/npy.hpp"
+#include "fz/layout.hpp"
+
+namespace fz {
+
+inline constexpr SizeType CHUNK_ALIGNMENT = 4096;
+
+namespace detail {
+
+inline constexpr std::string_view CHUNKED_MAGIC = "FZCHUNK1";
+
+inline auto alignUp(SizeType n, SizeType alignment) -> SizeType {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+// first index fastest
+inline auto denseStrides(const std::vector<SizeType>& shape)
+    -> std::vector<SizeType> {
+  std::vector<SizeType> strides(shape.size());
+  SizeType stride = 1;
+  for (SizeType d = 0; d < shape.size(); ++d) {
+    strides[d] = stride;
+    stride *= shape[d];
+  }
+  return strides;
+}
+
+inline auto formatExtents(const std::vector<SizeType>& extents)
+    -> std::string {
+  std::string out;
+  for (SizeType d = 0; d < extents.size(); ++d) {
+    out += (d == 0 ? "" : ",") + std::to_string(extents[d]);
+  }
+  return out;
+}
+
+inline auto parseExtents(const std::string& text) -> std::vector<SizeType> {
+  std::vector<SizeType> extents;
+  std::istringstream in{text};
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    extents.push_back(std::stoull(item));
+  }
+  return extents;
+}
+
+// chunks along each dimension
+inline auto chunkGrid(const std::vector<SizeType>& shape,
+                      const std::vector<SizeType>& chunk_shape)
+    -> std::vector<SizeType> {
+  if (shape.size() != chunk_shape.size()) {
+    throw std::invalid_argument("chunk rank differs from the array rank");
+  }
+  std::vector<SizeType> grid(shape.size());
+  for (SizeType d = 0; d < shape.size(); ++d) {
+    if (chunk_shape[d] == 0) {
+      throw std::invalid_argument("empty chunk extent");
+    }
+    grid[d] = (shape[d] + chunk_shape[d] - 1) / chunk_shape[d];
+  }
+  return grid;
+}
+
+}  // namespace detail
+
+/**
+ * @brief One chunk in memory: where it sits in the array and its elements.
+ */
+template <typename T>
+struct Chunk {
+  SizeType index = 0;
+  std::vector<SizeType> origin;
+  // dense, first index fastest, extents clipped to the array
+  ArrayView<T> view;
+};
+
+/**
+ * @brief An open chunked array file. Chunks are read and written whole by
+ * their index in the chunk grid; any number of threads may transfer
+ * distinct chunks concurrently.
+ */
+template <typename T>
+class ChunkedArray {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  using value_type = T;
+
+ public:
+  static auto create(const std::string& path, std::vector<SizeType> shape,
+                     std::vector<SizeType> chunk_shape) -> ChunkedArray;
+
+  static auto open(const std::string& path, bool writable = false)
+      -> ChunkedArray;
+
+ public:
+  [[nodiscard]] auto shape() const -> const std::vector<SizeType>& {
+    return _shape;
+  }
+
+  [[nodiscard]] auto chunkShape() const -> const std::vector<SizeType>& {
+    return _chunk_shape;
+  }
+
+  // chunks along each dimension
+  [[nodiscard]] auto grid() const -> const std::vector<SizeType>& {
+    return _grid;
+  }
+
+  [[nodiscard]] auto chunkCount() const -> SizeType;
+
+  // elements of a full chunk, the most any chunk holds
+  [[nodiscard]] auto chunkCapacity() const -> SizeType;
+
+  [[nodiscard]] auto chunkOrigin(SizeType k) const -> std::vector<SizeType>;
+
+  [[nodiscard]] auto chunkExtent(SizeType k) const -> std::vector<SizeType>;
+
+  // read chunk k into dst, which holds at least chunkCapacity() elements
+  auto readChunk(SizeType k, T* dst) const -> void;
+
+  auto readChunk(SizeType k) const -> Array<T>;
+
+  auto writeChunk(SizeType k, const T* src) -> void;
+
+  /**
+   * @brief Write an Array or view with the extents of chunk k.
+   */
+  template <typename C>
+  auto writeChunk(SizeType k, const C& chunk) -> void;
+
+  [[nodiscard]] auto file() const -> const File& { return _file; }
+
+ private:
+  ChunkedArray(File file, std::vector<SizeType> shape,
+               std::vector<SizeType> chunk_shape);
+
+  [[nodiscard]] auto slotOffset(SizeType k) const -> SizeType {
+    return CHUNK_ALIGNMENT + k * _slot_bytes;
+  }
+
+  [[nodiscard]] auto chunkSize(SizeType k) const -> SizeType;
+
+  File _file;
+  std::vector<SizeType> _shape;
+  std::vector<SizeType> _chunk_shape;
+  std::vector<SizeType> _grid;
+  SizeType _slot_bytes = 0;
+};
+
+template <typename T>
+ChunkedArray<T>::ChunkedArray(File file, std::vector<SizeType> shape,
+                              std::vector<SizeType> chunk_shape)
+    : _file{std::move(file)},
+      _shape{std::move(shape)},
+      _chunk_shape{std::move(chunk_shape)},
+      _grid{detail::chunkGrid(_shape, _chunk_shape)} {
+  _slot_bytes = detail::alignUp(chunkCapacity() * sizeof(T), CHUNK_ALIGNMENT);
+}
+
+template <typename T>
+auto ChunkedArray<T>::create(const std::string& path,
+                             std::vector<SizeType> shape,
+                             std::vector<SizeType> chunk_shape)
+    -> ChunkedArray {
+  // before the file is created
+  detail::chunkGrid(shape, chunk_shape);
+  File file{path, File::Mode::kCreate};
+  ChunkedArray arr{std::move(file), std::move(shape), std::move(chunk_shape)};
+
+  std::string header{detail::CHUNKED_MAGIC};
+  header += "\ndescr=" + std::string{npyDescr<T>()} +
+            "\nshape=" + detail::formatExtents(arr._shape) +
+            "\nchunk=" + detail::formatExtents(arr._chunk_shape) + "\n";
+  if (CHUNK_ALIGNMENT < header.size()) {
+    throw std::invalid_argument("rank too large for a chunked array");
+  }
+  header.resize(CHUNK_ALIGNMENT, '\0');
+  const auto bytes = arr.slotOffset(arr.chunkCount());
+  arr._file.reserve(bytes);
+  arr._file.truncate(bytes);
+  arr._file.writeAt(header.data(), header.size(), 0);
+  return arr;
+}
+
+template <typename T>
+auto ChunkedArray<T>::open(const std::string& path, bool writable)
+    -> ChunkedArray {
+  File file{path, writable ? File::Mode::kReadWrite : File::Mode::kRead};
+  std::string header(CHUNK_ALIGNMENT, '\0');
+  file.readAt(header.data(), header.size(), 0);
+  if (header.compare(0, detail::CHUNKED_MAGIC.size(),
+                     detail::CHUNKED_MAGIC) != 0) {
+    throw std::runtime_error("'" + path + "' is not a chunked array");
+  }
+  // the header text ends at a NUL inside its block
+  const auto end = header.find('\0');
+  if (end == std::string::npos) {
+    throw std::runtime_error("'" + path + "' is not a chunked array");
+  }
+  header.resize(end);
+
+  std::string descr;
+  std::vector<SizeType> shape;
+  std::vector<SizeType> chunk_shape;
+  std::istringstream in{header};
+  std::string line;
+  while (std::getline(in, line)) {
+    const auto eq = line.find('=');
+    const auto key = line.substr(0, eq);
+    const auto value = eq == std::string::npos ? "" : line.substr(eq + 1);
+    if (key == "descr") {
+      descr = value;
+    } else if (key == "shape") {
+      shape = detail::parseExtents(value);
+    } else if (key == "chunk") {
+      chunk_shape = detail::parseExtents(value);
+    }
+  }
+  if (descr != npyDescr<T>()) {
+    throw std::runtime_error("dtype " + descr + " in '" + path +
+                             "' does not match " + std::string{npyDescr<T>()});
+  }
+  ChunkedArray arr{std::move(file), std::move(shape), std::move(chunk_shape)};
+  if (arr._file.size() < arr.slotOffset(arr.chunkCount())) {
+    throw std::runtime_error("'" + path + "' is truncated");
+  }
+  return arr;
+}
+
+template <typename T>
+auto ChunkedArray<T>::chunkCount() const -> SizeType {
+  SizeType n = 1;
+  for (auto g : _grid) {
+    n *= g;
+  }
+  return n;
+}
+
+template <typename T>
+auto ChunkedArray<T>::chunkCapacity() const -> SizeType {
+  SizeType n = 1;
+  for (auto c : _chunk_shape) {
+    n *= c;
+  }
+  return n;
+}
+
+template <typename T>
+auto ChunkedArray<T>::chunkOrigin(SizeType k) const -> std::vector<SizeType> {
+  std::vector<SizeType> origin(_grid.size());
+  for (SizeType d = 0; d < _grid.size(); ++d) {
+    origin[d] = (k % _grid[d]) * _chunk_shape[d];
+    k /= _grid[d];
+  }
+  return origin;
+}
+
+template <typename T>
+auto ChunkedArray<T>::chunkExtent(SizeType k) const -> std::vector<SizeType> {
+  auto extent = chunkOrigin(k);
+  for (SizeType d = 0; d < extent.size(); ++d) {
+    extent[d] = std::min(_chunk_shape[d], _shape[d] - extent[d]);
+  }
+  return extent;
+}
+
+template <typename T>
+auto ChunkedArray<T>::chunkSize(SizeType k) const -> SizeType {
+  SizeType n = 1;
+  for (auto e : chunkExtent(k)) {
+    n *= e;
+  }
+  return n;
+}
+
+template <typename T>
+auto ChunkedArray<T>::readChunk(SizeType k, T* dst) const -> void {
+  _file.readAt(dst, chunkSize(k) * sizeof(T), slotOffset(k));
+}
+
+template <typename T>
+auto ChunkedArray<T>::readChunk(SizeType k) const -> Array<T> {
+  auto chunk = Array<T>::empty(chunkExtent(k));
+  readChunk(k, chunk.data());
+  return chunk;
+}
+
+template <typename T>
+auto ChunkedArray<T>::writeChunk(SizeType k, const T* src) -> void {
+  _file.writeAt(src, chunkSize(k) * sizeof(T), slotOffset(k));
+}
+
+template <typename T>
+template <typename C>
+auto ChunkedArray<T>::writeChunk(SizeType k, const C& chunk) -> void {
+  if (!std::ranges::equal(chunk.shape(), chunkExtent(k))) {
+    throw std::invalid_argument("chunk shape does not match the chunk grid");
+  }
+  if constexpr (requires { chunk.isContiguous(); }) {
+    if (!chunk.isContiguous()) {
+      const auto dense = toLayout(chunk, Layout::kColumnMajor);
+      writeChunk(k, dense.data());
+      return;
+    }
+  }
+  writeChunk(k, chunk.data());
+}
+
+namespace detail {
+
+/**
+ * @brief Ring of chunk buffers between a producer and a consumer, one of
+ * them the caller and the other an I/O thread. Chunk k lives in buffer
+ * k % depth, so the producer may run up to depth - 1 chunks ahead of the
+ * chunk the consumer holds. An error on the I/O side is rethrown on the
+ * caller's side at its next wait.
+ */
+template <typename T>
+class ChunkRing {
+ public:
+  ChunkRing(SizeType count, SizeType depth, SizeType capacity)
+      : _count{count}, _depth{std::max<SizeType>(depth, 2)} {
+    for (SizeType i = 0; i < _depth; ++i) {
+      _buffers.push_back(Array<T>::empty({capacity}));
+    }
+  }
+
+  [[nodiscard]] auto count() const -> SizeType { return _count; }
+
+  [[nodiscard]] auto buffer(SizeType k) -> T* {
+    return _buffers[k % _depth].data();
+  }
+
+  // producer: wait until the buffer of chunk k is free; false once stopped
+  auto awaitSlot(SizeType k) -> bool {
+    return wait([&] { return k < _consumed + _depth; });
+  }
+
+  // producer: chunk k is filled
+  auto publish(SizeType k) -> void {
+    update([&] { _produced = std::max(_produced, k + 1); });
+  }
+
+  // consumer: wait until chunk k is filled; false once stopped without it
+  auto awaitChunk(SizeType k) -> bool {
+    wait([&] { return k < _produced; });
+    std::lock_guard lock{_mutex};
+    return k < _produced;
+  }
+
+  // consumer: done with chunk k and everything before it
+  auto consume(SizeType k) -> void {
+    update([&] { _consumed = std::max(_consumed, k + 1); });
+  }
+
+  // wait until the first n chunks are consumed
+  auto drain(SizeType n) -> void {
+    wait([&] { return n <= _consumed; });
+  }
+
+  auto fail(std::exception_ptr error) -> void {
+    update([&] { _error = std::move(error); });
+  }
+
+  auto stop() -> void {
+    update([&] { _stop = true; });
+  }
+
+ private:
+  template <typename Predicate>
+  auto wait(Predicate ready) -> bool {
+    std::unique_lock lock{_mutex};
+    _cv.wait(lock, [&] { return _stop || _error || ready(); });
+    if (_error) {
+      std::rethrow_exception(_error);
+    }
+    return !_stop;
+  }
+
+  template <typename F>
+  auto update(F f) -> void {
+    {
+      std::lock_guard lock{_mutex};
+      f();
+    }
+    _cv.notify_all();
+  }
+
+  SizeType _count;
+  SizeType _depth;
+  std::vector<Array<T>> _buffers;
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  SizeType _produced = 0;
+  SizeType _consumed = 0;
+  bool _stop = false;
+  std::exception_ptr _error;
+};
+
+template <typename T>
+inline auto makeChunk(const ChunkedArray<std::remove_const_t<T>>& array,
+                      SizeType k, T* buffer, Chunk<T>& chunk) -> void {
+  auto extent = array.chunkExtent(k);
+  auto strides = denseStrides(extent);
+  chunk.index = k;
+  chunk.origin = array.chunkOrigin(k);
+  chunk.view = ArrayView<T>{buffer, std::move(extent), std::move(strides)};
+}
+
+}  // namespace detail
+
+/**
+ * @brief Streams the chunks of a ChunkedArray in file order while a
+ * background thread prefetches the next depth - 1 of them. The array must
+ * outlive the reader.
+ */
+template <typename T>
+class ChunkReader {
+ public:
+  explicit ChunkReader(const ChunkedArray<T>& array, SizeType depth = 2);
+
+  ~ChunkReader();
+
+  ChunkReader(const ChunkReader&) = delete;
+  auto operator=(const ChunkReader&) -> ChunkReader& = delete;
+
+  /**
+   * @brief The next chunk, or nullptr after the last one. The chunk and its
+   * buffer stay valid until the following call; rethrows read errors.
+   */
+  auto next() -> Chunk<T>*;
+
+ private:
+  auto run() -> void;
+
+  const ChunkedArray<T>& _array;
+  detail::ChunkRing<T> _ring;
+  Chunk<T> _chunk;
+  SizeType _next = 0;
+  std::thread _thread;
+};
+
+template <typename T>
+ChunkReader<T>::ChunkReader(const ChunkedArray<T>& array, SizeType depth)
+    : _array{array}, _ring{array.chunkCount(), depth, array.chunkCapacity()} {
+#ifdef __linux__
+  ::posix_fadvise(_array.file().fd(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  _thread = std::thread{[this] { run(); }};
+}
+
+template <typename T>
+ChunkReader<T>::~ChunkReader() {
+  _ring.stop();
+  _thread.join();
+}
+
+template <typename T>
+auto ChunkReader<T>::run() -> void {
+  try {
+    for (SizeType k = 0; k < _ring.count() && _ring.awaitSlot(k); ++k) {
+      _array.readChunk(k, _ring.buffer(k));
+      _ring.publish(k);
+    }
+  } catch (...) {
+    _ring.fail(std::current_exception());
+  }
+}
+
+template <typename T>
+auto ChunkReader<T>::next() -> Chunk<T>* {
+  if (0 < _next) {
+    // the buffer of the previous chunk is free for the prefetch
+    _ring.consume(_next - 1);
+  }
+  if (_next == _ring.count()) {
+    return nullptr;
+  }
+  _ring.awaitChunk(_next);
+  detail::makeChunk(_array, _next, _ring.buffer(_next), _chunk);
+  ++_next;
+  return &_chunk;
+}
+
+/**
+ * @brief Fills the chunks of a ChunkedArray in file order: the caller
+ * writes into the buffer next() hands out while a background thread writes
+ * the previous ones to disk. The array must outlive the writer.
+ */
+template <typename T>
+class ChunkWriter {
+ public:
+  explicit ChunkWriter(ChunkedArray<T>& array, SizeType depth = 2);
+
+  /**
+   * @brief Completes the writes already queued, dropping their errors, but
+   * not the chunk in hand: a writer left by an exception does not store a
+   * half-filled chunk. Call finish() on the normal path.
+   */
+  ~ChunkWriter();
+
+  ChunkWriter(const ChunkWriter&) = delete;
+  auto operator=(const ChunkWriter&) -> ChunkWriter& = delete;
+
+  /**
+   * @brief Buffer for the next chunk, or nullptr once every chunk was
+   * handed out. Queues the previous chunk for writing; rethrows write
+   * errors.
+   */
+  auto next() -> Chunk<T>*;
+
+  // queue the last chunk and wait until every chunk handed out is written
+  auto finish() -> void;
+
+ private:
+  auto run() -> void;
+
+  ChunkedArray<T>& _array;
+  detail::ChunkRing<T> _ring;
+  Chunk<T> _chunk;
+  SizeType _next = 0;
+  std::thread _thread;
+};
+
+template <typename T>
+ChunkWriter<T>::ChunkWriter(ChunkedArray<T>& array, SizeType depth)
+    : _array{array}, _ring{array.chunkCount(), depth, array.chunkCapacity()} {
+  _thread = std::thread{[this] { run(); }};
+}
+
+template <typename T>
+ChunkWriter<T>::~ChunkWriter() {
+  _ring.stop();
+  _thread.join();
+}
+
+template <typename T>
+auto ChunkWriter<T>::run() -> void {
+  try {
+    for (SizeType k = 0; k < _ring.count() && _ring.awaitChunk(k); ++k) {
+      _array.writeChunk(k, static_cast<const T*>(_ring.buffer(k)));
+      _ring.consume(k);
+    }
+  } catch (...) {
+    _ring.fail(std::current_exception());
+  }
+}
+
+template <typename T>
+auto ChunkWriter<T>::next() -> Chunk<T>* {
+  if (0 < _next) {
+    _ring.publish(_next - 1);
+  }
+  if (_next == _ring.count()) {
+    return nullptr;
+  }
+  _ring.awaitSlot(_next);
+  detail::makeChunk(_array, _next, _ring.buffer(_next), _chunk);
+  ++_next;
+  return &_chunk;
+}
+
+template <typename T>
+auto ChunkWriter<T>::finish() -> void {
+  if (0 < _next) {
+    _ring.publish(_next - 1);
+  }
+  _ring.drain(_next);
+  // chunks never handed out are not waited for
+  _ring.stop();
+}
+
+/**
+ * @brief Call f(chunk) for every chunk of array, prefetching ahead of it.
+ */
+template <typename T, typename F>
+inline auto forEachChunk(const ChunkedArray<T>& array, F&& f,
+                         SizeType depth = 2) -> void {
+  ChunkReader<T> reader{array, depth};
+  while (auto* chunk = reader.next()) {
+    f(*chunk);
+  }
+}
+
+/**
+ * @brief Out-of-core elementwise pass: f(in_chunk, out_chunk) for matching
+ * chunks of two arrays of the same shape and chunk shape, reading ahead of
+ * and writing behind the chunk being computed.
+ */
+template <typename T, typename U, typename F>
+inline auto transformChunks(const ChunkedArray<T>& in, ChunkedArray<U>& out,
+                            F&& f, SizeType depth = 2) -> void {
+  if (in.shape() != out.shape() || in.chunkShape() != out.chunkShape()) {
+    throw std::invalid_argument("chunk grids differ");
+  }
+  ChunkReader<T> reader{in, depth};
+  ChunkWriter<U> writer{out, depth};
+  while (auto* source = reader.next()) {
+    f(static_cast<const Chunk<T>&>(*source), *writer.next());
+  }
+  writer.finish();
+}
+
+/**
+ * @brief Write an in-memory array as a chunked file.
+ */
+template <typename C>
+inline auto saveChunked(const std::string& path, const C& arr,
+                        std::vector<SizeType> chunk_shape) -> void {
+  using T = std::remove_cv_t<typename C::value_type>;
+  auto out = ChunkedArray<T>::create(
+      path, std::vector<SizeType>(arr.shape().begin(), arr.shape().end()),
+      std::move(chunk_shape));
+  const auto view = ArrayView<const T>{arr.data(), out.shape(),
+                                       std::vector<SizeType>(
+                                           arr.strides().begin(),
+                                           arr.strides().end())};
+  ChunkWriter<T> writer{out};
+  while (auto* chunk = writer.next()) {
+    auto stops = chunk->origin;
+    for (SizeType d = 0; d < stops.size(); ++d) {
+      stops[d] += chunk->view.shape()[d];
+    }
+    chunk->view.assign(view.block(chunk->origin, stops));
+  }
+  writer.finish();
+}
+
+/**
+ * @brief Assemble a whole chunked file in memory.
+ */
+template <typename T>
+inline auto loadChunked(const std::string& path) -> Array<T> {
+  const auto in = ChunkedArray<T>::open(path);
+  auto arr = Array<T>::empty(in.shape());
+  forEachChunk(in, [&](const Chunk<T>& chunk) {
+    auto stops = chunk.origin;
+    for (SizeType d = 0; d < stops.size(); ++d) {
+      stops[d] += chunk.view.shape()[d];
+    }
+    arr.view().block(chunk.origin, stops).assign(chunk.view);
+  });
+  return arr;
+}
+
+}  // namespace fz
+
+#endif  // __FZ_IO_CHUNKED_H__
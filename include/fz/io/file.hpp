@@ -0,0 +1,246 @@
+/**
+ * @file file.hpp
+ * @brief Thin RAII wrapper over a POSIX file descriptor for bulk array I/O.
+ *
+ * Reads and writes are positional (pread/pwrite), retried on EINTR and on
+ * short transfers, and issued in IO_CHUNK_SIZE pieces so a multi-GB array
+ * goes to the kernel in a handful of large requests. Failures throw
+ * std::runtime_error naming the file and the errno text.
+ */
+
+#ifndef __FZ_IO_FILE_H__
+#define __FZ_IO_FILE_H__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fz/array_base.hpp"
+
+namespace fz {
+
+// bytes per read or write call; a multiple of every page size in use
+inline constexpr SizeType IO_CHUNK_SIZE = SizeType{64} << 20;
+
+// buffer, size and offset alignment of O_DIRECT transfers
+inline constexpr SizeType DIRECT_IO_ALIGNMENT = 4096;
+
+namespace detail {
+
+[[noreturn]] inline auto throwIoError(const std::string& what,
+                                      const std::string& path) -> void {
+  throw std::runtime_error(what + " '" + path + "': " + std::strerror(errno));
+}
+
+// pread until n bytes are in; running into the end of the file is an error
+inline auto readAll(int fd, void* buffer, SizeType n, SizeType offset,
+                    const std::string& path) -> void {
+  auto* p = static_cast<char*>(buffer);
+  while (0 < n) {
+    const auto r =
+        ::pread(fd, p, std::min(n, IO_CHUNK_SIZE), static_cast<off_t>(offset));
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throwIoError("cannot read", path);
+    }
+    if (r == 0) {
+      throw std::runtime_error("unexpected end of file '" + path + "'");
+    }
+    p += r;
+    n -= static_cast<SizeType>(r);
+    offset += static_cast<SizeType>(r);
+  }
+}
+
+inline auto writeAll(int fd, const void* buffer, SizeType n, SizeType offset,
+                     const std::string& path) -> void {
+  const auto* p = static_cast<const char*>(buffer);
+  while (0 < n) {
+    const auto w =
+        ::pwrite(fd, p, std::min(n, IO_CHUNK_SIZE), static_cast<off_t>(offset));
+    if (w < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throwIoError("cannot write", path);
+    }
+    p += w;
+    n -= static_cast<SizeType>(w);
+    offset += static_cast<SizeType>(w);
+  }
+}
+
+}  // namespace detail
+
+class File {
+ public:
+  enum class Mode : std::uint8_t {
+    kRead,
+    kReadWrite,
+    // create or truncate
+    kCreate,
+  };
+
+ public:
+  File() = default;
+
+  /**
+   * @brief direct opens with O_DIRECT where the platform has it: transfers
+   * bypass the page cache, and their buffers, sizes and offsets must be
+   * DIRECT_IO_ALIGNMENT aligned.
+   */
+  File(std::string path, Mode mode, bool direct = false);
+
+  ~File() { close(); }
+
+  File(const File&) = delete;
+  auto operator=(const File&) -> File& = delete;
+
+  File(File&& other) noexcept
+      : _fd{std::exchange(other._fd, -1)},
+        _direct{other._direct},
+        _path{std::move(other._path)} {}
+
+  auto operator=(File&& other) noexcept -> File& {
+    if (this != &other) {
+      close();
+      _fd = std::exchange(other._fd, -1);
+      _direct = other._direct;
+      _path = std::move(other._path);
+    }
+    return *this;
+  }
+
+ public:
+  [[nodiscard]] auto isOpen() const -> bool { return 0 <= _fd; }
+
+  [[nodiscard]] auto fd() const -> int { return _fd; }
+
+  [[nodiscard]] auto path() const -> const std::string& { return _path; }
+
+  [[nodiscard]] auto direct() const -> bool { return _direct; }
+
+  [[nodiscard]] auto size() const -> SizeType;
+
+  /**
+   * @brief Read exactly n bytes at offset; running into the end of the file
+   * is an error.
+   */
+  auto readAt(void* buffer, SizeType n, SizeType offset) const -> void;
+
+  auto writeAt(const void* buffer, SizeType n, SizeType offset) -> void;
+
+  /**
+   * @brief Allocate the blocks of [0, n) up front, so a large write is laid
+   * out contiguously and a full disk fails before any data is written.
+   */
+  auto reserve(SizeType n) -> void;
+
+  auto truncate(SizeType n) -> void;
+
+  // flush the data (not necessarily the metadata) to the device
+  auto sync() -> void;
+
+  auto close() -> void {
+    if (0 <= _fd) {
+      ::close(_fd);
+      _fd = -1;
+    }
+  }
+
+ private:
+  int _fd = -1;
+  bool _direct = false;
+  std::string _path;
+};
+
+inline File::File(std::string path, Mode mode, bool direct)
+    : _path{std::move(path)} {
+  int flags = O_CLOEXEC;
+  switch (mode) {
+    case Mode::kRead:
+      flags |= O_RDONLY;
+      break;
+    case Mode::kReadWrite:
+      flags |= O_RDWR;
+      break;
+    case Mode::kCreate:
+      flags |= O_RDWR | O_CREAT | O_TRUNC;
+      break;
+  }
+#ifdef O_DIRECT
+  if (direct) {
+    flags |= O_DIRECT;
+    _direct = true;
+  }
+#else
+  static_cast<void>(direct);
+#endif
+  _fd = ::open(_path.c_str(), flags, 0644);
+  if (_fd < 0) {
+    detail::throwIoError("cannot open", _path);
+  }
+}
+
+inline auto File::size() const -> SizeType {
+  struct stat st {};
+  if (::fstat(_fd, &st) != 0) {
+    detail::throwIoError("cannot stat", _path);
+  }
+  return static_cast<SizeType>(st.st_size);
+}
+
+inline auto File::readAt(void* buffer, SizeType n, SizeType offset) const
+    -> void {
+  detail::readAll(_fd, buffer, n, offset, _path);
+}
+
+inline auto File::writeAt(const void* buffer, SizeType n, SizeType offset)
+    -> void {
+  detail::writeAll(_fd, buffer, n, offset, _path);
+}
+
+inline auto File::reserve(SizeType n) -> void {
+#ifdef __linux__
+  const auto err = ::posix_fallocate(_fd, 0, static_cast<off_t>(n));
+  // filesystems without fallocate just allocate as the data arrives
+  if (err != 0 && err != EOPNOTSUPP && err != EINVAL) {
+    errno = err;
+    detail::throwIoError("cannot allocate", _path);
+  }
+#else
+  static_cast<void>(n);
+#endif
+}
+
+inline auto File::truncate(SizeType n) -> void {
+  if (::ftruncate(_fd, static_cast<off_t>(n)) != 0) {
+    detail::throwIoError("cannot resize", _path);
+  }
+}
+
+inline auto File::sync() -> void {
+#ifdef __linux__
+  const auto r = ::fdatasync(_fd);
+#else
+  const auto r = ::fsync(_fd);
+#endif
+  if (r != 0) {
+    detail::throwIoError("cannot sync", _path);
+  }
+}
+
+}  // namespace fz
+
+#endif  // __FZ_IO_FILE_H__
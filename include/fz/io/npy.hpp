@@ -0,0 +1,452 @@
+/**
+ * @file npy.hpp
+ * @brief Array checkpoints in the NumPy .npy format.
+ *
+ * Files are written in Fortran order, which is Array's own first-index-
+ * fastest layout, so saving is a header plus one bulk write of the element
+ * buffer and numpy.load() reads them back with the same shape and indices.
+ * The header is padded so the data starts at NPY_DATA_ALIGNMENT: the payload
+ * is page aligned in the file, which keeps the writes aligned and lets
+ * mapNpy() hand out the file pages themselves as array storage.
+ *
+ * C-order files (numpy's default) load too; mapped ones come back as views
+ * with reversed strides. Byte swapping is not supported.
+ */
+
+#ifndef __FZ_IO_NPY_H__
+#define __FZ_IO_NPY_H__
+
+#include <algorithm>
+#include <bit>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include "fz/array.hpp"
+#include "fz/array_view.hpp"
+#include "fz/io/file.hpp"
+#include "fz/layout.hpp"
+
+namespace fz {
+
+// offset of the element data in files written by saveNpy()
+inline constexpr SizeType NPY_DATA_ALIGNMENT = 4096;
+
+/**
+ * @brief dtype string of T in the native byte order, e.g. "<f8".
+ */
+template <typename T>
+constexpr auto npyDescr() -> std::string_view {
+  constexpr bool little = std::endian::native == std::endian::little;
+  if constexpr (std::is_same_v<T, bool>) {
+    return "|b1";
+  } else if constexpr (std::is_same_v<T, float>) {
+    return little ? "<f4" : ">f4";
+  } else if constexpr (std::is_same_v<T, double>) {
+    return little ? "<f8" : ">f8";
+  } else if constexpr (std::is_same_v<T, std::complex<float>>) {
+    return little ? "<c8" : ">c8";
+  } else if constexpr (std::is_same_v<T, std::complex<double>>) {
+    return little ? "<c16" : ">c16";
+  } else if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+    return std::is_signed_v<T> ? "|i1" : "|u1";
+  } else if constexpr (std::is_integral_v<T> && sizeof(T) == 2) {
+    return std::is_signed_v<T> ? (little ? "<i2" : ">i2")
+                               : (little ? "<u2" : ">u2");
+  } else if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+    return std::is_signed_v<T> ? (little ? "<i4" : ">i4")
+                               : (little ? "<u4" : ">u4");
+  } else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+    return std::is_signed_v<T> ? (little ? "<i8" : ">i8")
+                               : (little ? "<u8" : ">u8");
+  } else {
+    static_assert(sizeof(T) == 0, "no .npy dtype for this element type");
+  }
+}
+
+struct NpyHeader {
+  std::string descr;
+  bool fortran_order = true;
+  std::vector<SizeType> shape;
+  // file offset of the first element
+  SizeType data_offset = 0;
+};
+
+struct NpySaveOptions {
+  // fdatasync before the file replaces the old one
+  bool sync = false;
+  // O_DIRECT where the buffers allow it, see saveNpyAsync()
+  bool direct = false;
+};
+
+enum class MapMode : std::uint8_t {
+  // writes go to the file
+  kShared,
+  // writes stay in private copies of the touched pages
+  kPrivate,
+};
+
+namespace detail {
+
+inline constexpr std::string_view NPY_MAGIC = "\x93NUMPY";
+
+// value of 'key': in a header dict, up to the next ',' or '}' outside '()'
+inline auto npyField(const std::string& dict, std::string_view key,
+                     const std::string& path) -> std::string {
+  auto pos = dict.find("'" + std::string{key} + "'");
+  if (pos == std::string::npos) {
+    pos = dict.find("\"" + std::string{key} + "\"");
+  }
+  if (pos == std::string::npos) {
+    throw std::runtime_error("no '" + std::string{key} +
+                             "' in .npy header of '" + path + "'");
+  }
+  pos = dict.find(':', pos);
+  auto end = pos;
+  int depth = 0;
+  while (++end < dict.size()) {
+    const auto c = dict[end];
+    depth += c == '(' ? 1 : (c == ')' ? -1 : 0);
+    if (depth == 0 && (c == ',' || c == '}')) {
+      break;
+    }
+  }
+  const auto value = dict.substr(pos + 1, end - pos - 1);
+  const auto first = value.find_first_not_of(" '\"");
+  const auto last = value.find_last_not_of(" '\"");
+  return first == std::string::npos ? ""
+                                    : value.substr(first, last - first + 1);
+}
+
+inline auto parseNpyHeader(const std::string& dict, SizeType data_offset,
+                           const std::string& path) -> NpyHeader {
+  NpyHeader header;
+  header.descr = npyField(dict, "descr", path);
+  header.fortran_order = npyField(dict, "fortran_order", path) == "True";
+  header.data_offset = data_offset;
+  const auto shape = npyField(dict, "shape", path);
+  SizeType i = 0;
+  while (i < shape.size()) {
+    i = shape.find_first_of("0123456789", i);
+    if (i == std::string::npos) {
+      break;
+    }
+    SizeType extent = 0;
+    for (; i < shape.size() && '0' <= shape[i] && shape[i] <= '9'; ++i) {
+      extent = 10 * extent + static_cast<SizeType>(shape[i] - '0');
+    }
+    header.shape.push_back(extent);
+  }
+  return header;
+}
+
+inline auto formatNpyHeader(std::string_view descr,
+                            const std::vector<SizeType>& shape,
+                            bool fortran_order = true) -> std::string {
+  std::string dict = "{'descr': '" + std::string{descr} +
+                     "', 'fortran_order': " +
+                     (fortran_order ? "True" : "False") + ", 'shape': (";
+  for (SizeType d = 0; d < shape.size(); ++d) {
+    dict += std::to_string(shape[d]);
+    dict += shape.size() == 1 ? "," : (d + 1 < shape.size() ? ", " : "");
+  }
+  dict += "), }";
+
+  // version 1.0 stores the header length in 2 bytes, 2.0 in 4
+  const bool v1 = dict.size() + 1 + 10 <= 65535;
+  const SizeType preamble = v1 ? 10 : 12;
+  const auto total = (preamble + dict.size() + 1 + NPY_DATA_ALIGNMENT - 1) /
+                     NPY_DATA_ALIGNMENT * NPY_DATA_ALIGNMENT;
+  const auto length = total - preamble;
+
+  std::string out{NPY_MAGIC};
+  out += static_cast<char>(v1 ? 1 : 2);
+  out += '\0';
+  for (SizeType b = 0; b < (v1 ? 2U : 4U); ++b) {
+    out += static_cast<char>((length >> (8 * b)) & 0xff);
+  }
+  out += dict;
+  out.resize(total - 1, ' ');
+  out += '\n';
+  return out;
+}
+
+template <typename Shape>
+inline auto npyShape(const std::vector<SizeType>& extents,
+                     const std::string& path) -> Shape {
+  if constexpr (FixedSizeRange<Shape>) {
+    Shape shape{};
+    if (extents.size() != shape.size()) {
+      throw std::runtime_error("rank mismatch loading '" + path + "'");
+    }
+    std::copy(extents.begin(), extents.end(), shape.begin());
+    return shape;
+  } else {
+    return Shape(extents.begin(), extents.end());
+  }
+}
+
+template <typename T>
+inline auto checkNpyDescr(const NpyHeader& header, const std::string& path)
+    -> void {
+  if (header.descr != npyDescr<T>()) {
+    throw std::runtime_error("dtype " + header.descr + " in '" + path +
+                             "' does not match " +
+                             std::string{npyDescr<T>()});
+  }
+}
+
+inline auto npySize(const std::vector<SizeType>& shape) -> SizeType {
+  SizeType n = 1;
+  for (auto extent : shape) {
+    n *= extent;
+  }
+  return n;
+}
+
+}  // namespace detail
+
+inline auto readNpyHeader(const File& file) -> NpyHeader {
+  char preamble[12];
+  file.readAt(preamble, 10, 0);
+  if (std::string_view{preamble, 6} != detail::NPY_MAGIC) {
+    throw std::runtime_error("'" + file.path() + "' is not a .npy file");
+  }
+  const auto major = static_cast<unsigned char>(preamble[6]);
+  SizeType length = 0;
+  SizeType offset = 10;
+  if (major == 1) {
+    length = static_cast<unsigned char>(preamble[8]) |
+             static_cast<SizeType>(static_cast<unsigned char>(preamble[9]))
+                 << 8;
+  } else if (major == 2 || major == 3) {
+    file.readAt(preamble + 10, 2, 10);
+    for (SizeType b = 0; b < 4; ++b) {
+      length |= static_cast<SizeType>(
+                    static_cast<unsigned char>(preamble[8 + b]))
+                << (8 * b);
+    }
+    offset = 12;
+  } else {
+    throw std::runtime_error("unsupported .npy version in '" + file.path() +
+                             "'");
+  }
+  std::string dict(length, '\0');
+  file.readAt(dict.data(), length, offset);
+  return detail::parseNpyHeader(dict, offset + length, file.path());
+}
+
+inline auto readNpyHeader(const std::string& path) -> NpyHeader {
+  return readNpyHeader(File{path, File::Mode::kRead});
+}
+
+/**
+ * @brief Write an Array or view to path. The data goes to a temporary file
+ * next to it that is renamed over path once complete, so a crash mid-save
+ * leaves the previous checkpoint intact. Row-major arrays are written in C
+ * order as they are; non-contiguous views are gathered first.
+ */
+template <typename C>
+inline auto saveNpy(const std::string& path, const C& arr,
+                    NpySaveOptions options = {}) -> void {
+  using T = std::remove_cv_t<typename C::value_type>;
+  const bool fortran_order = detail::layoutOf(arr) == Layout::kColumnMajor;
+  if constexpr (requires { arr.offset(); }) {
+    if (!arr.isContiguous()) {
+      saveNpy(path, toLayout(arr, Layout::kColumnMajor), options);
+      return;
+    }
+  }
+  const std::vector<SizeType> shape(arr.shape().begin(), arr.shape().end());
+  const auto header =
+      detail::formatNpyHeader(npyDescr<T>(), shape, fortran_order);
+  const auto bytes = arr.size() * sizeof(T);
+
+  const auto tmp = path + ".tmp";
+  try {
+    File file{tmp, File::Mode::kCreate};
+    file.reserve(header.size() + bytes);
+    file.writeAt(header.data(), header.size(), 0);
+    file.writeAt(arr.data(), bytes, header.size());
+    if (options.sync) {
+      file.sync();
+    }
+  } catch (...) {
+    ::unlink(tmp.c_str());
+    throw;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+    detail::throwIoError("cannot replace", path);
+  }
+}
+
+/**
+ * @brief Read a .npy file into a new Array in the given layout. The elements
+ * are read straight into the array's buffer; files stored in the other order
+ * take one extra, cache-blocked pass to reorder.
+ */
+template <typename T, Range Shape = ShapeVector>
+inline auto loadNpy(const std::string& path,
+                    Layout layout = Layout::kColumnMajor)
+    -> Array<T, Shape, Shape> {
+  const File file{path, File::Mode::kRead};
+  const auto header = readNpyHeader(file);
+  detail::checkNpyDescr<T>(header, path);
+
+  // the two orders coincide for rank <= 1
+  const auto stored =
+      header.fortran_order ? Layout::kColumnMajor : Layout::kRowMajor;
+  auto arr = Array<T, Shape, Shape>::empty(
+      detail::npyShape<Shape>(header.shape, path),
+      header.shape.size() <= 1 ? layout : stored);
+  file.readAt(arr.data(), arr.size() * sizeof(T), header.data_offset);
+  if (arr.layout() != layout) {
+    return toLayout(arr, layout);
+  }
+  return arr;
+}
+
+/**
+ * @brief A .npy file mapped into memory; its view() is backed directly by
+ * the file pages, which are read on first touch. ArrayView<const T> maps
+ * read-only. Owns the mapping: views die with it.
+ */
+template <typename T>
+class MappedArray {
+ public:
+  using value_type = std::remove_cv_t<T>;
+  using View = ArrayView<T>;
+
+ public:
+  MappedArray() = default;
+
+  explicit MappedArray(const std::string& path,
+                       MapMode mode = MapMode::kShared);
+
+  ~MappedArray() { unmap(); }
+
+  MappedArray(const MappedArray&) = delete;
+  auto operator=(const MappedArray&) -> MappedArray& = delete;
+
+  MappedArray(MappedArray&& other) noexcept
+      : _base{std::exchange(other._base, nullptr)},
+        _length{std::exchange(other._length, 0)},
+        _view{std::exchange(other._view, View{})},
+        _fortran_order{other._fortran_order} {}
+
+  auto operator=(MappedArray&& other) noexcept -> MappedArray& {
+    if (this != &other) {
+      unmap();
+      _base = std::exchange(other._base, nullptr);
+      _length = std::exchange(other._length, 0);
+      _view = std::exchange(other._view, View{});
+      _fortran_order = other._fortran_order;
+    }
+    return *this;
+  }
+
+ public:
+  [[nodiscard]] auto view() const -> const View& { return _view; }
+
+  [[nodiscard]] auto shape() const -> const ShapeVector& {
+    return _view.shape();
+  }
+
+  [[nodiscard]] auto size() const -> SizeType { return _view.size(); }
+
+  [[nodiscard]] auto data() const -> T* { return _view.data(); }
+
+  // false: the view has C-order (last index fastest) strides
+  [[nodiscard]] auto fortranOrder() const -> bool { return _fortran_order; }
+
+  /**
+   * @brief Write dirty pages of a kShared mapping back to the file and wait
+   * for them.
+   */
+  auto sync() -> void;
+
+ private:
+  auto unmap() -> void {
+    if (_base != nullptr) {
+      ::munmap(_base, _length);
+      _base = nullptr;
+    }
+  }
+
+  void* _base = nullptr;
+  SizeType _length = 0;
+  View _view;
+  bool _fortran_order = true;
+};
+
+template <typename T>
+MappedArray<T>::MappedArray(const std::string& path, MapMode mode) {
+  constexpr bool writable = !std::is_const_v<T>;
+  const bool shared = !writable || mode == MapMode::kShared;
+  const File file{path, writable && shared ? File::Mode::kReadWrite
+                                           : File::Mode::kRead};
+  const auto header = readNpyHeader(file);
+  detail::checkNpyDescr<value_type>(header, path);
+  if (header.data_offset % alignof(value_type) != 0) {
+    throw std::runtime_error("misaligned data in '" + path + "'");
+  }
+  const auto n = detail::npySize(header.shape);
+  _length = header.data_offset + n * sizeof(value_type);
+  if (file.size() < _length) {
+    throw std::runtime_error("'" + path + "' is truncated");
+  }
+
+  const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  _base = ::mmap(nullptr, _length, prot, shared ? MAP_SHARED : MAP_PRIVATE,
+                 file.fd(), 0);
+  if (_base == MAP_FAILED) {
+    _base = nullptr;
+    detail::throwIoError("cannot map", path);
+  }
+
+  _fortran_order = header.fortran_order;
+  const auto rank = header.shape.size();
+  std::vector<SizeType> strides(rank);
+  SizeType stride = 1;
+  for (SizeType k = 0; k < rank; ++k) {
+    const auto d = _fortran_order ? k : rank - 1 - k;
+    strides[d] = stride;
+    stride *= header.shape[d];
+  }
+  _view = View{reinterpret_cast<T*>(static_cast<char*>(_base) +
+                                    header.data_offset),
+               header.shape, std::move(strides)};
+}
+
+template <typename T>
+auto MappedArray<T>::sync() -> void {
+  if (_base != nullptr && ::msync(_base, _length, MS_SYNC) != 0) {
+    throw std::runtime_error(std::string{"msync: "} + std::strerror(errno));
+  }
+}
+
+/**
+ * @brief Map a .npy file without reading it: mapNpy<const T> for read-only
+ * access, mapNpy<T> to modify the file (kShared) or a private copy of it
+ * (kPrivate).
+ */
+template <typename T>
+inline auto mapNpy(const std::string& path, MapMode mode = MapMode::kShared)
+    -> MappedArray<T> {
+  return MappedArray<T>{path, mode};
+}
+
+}  // namespace fz
+
+#endif  // __FZ_IO_NPY_H__
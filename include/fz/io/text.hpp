@@ -0,0 +1,512 @@
+/**
+ * @file text.hpp
+ * @brief Arrays as text: CSV dumps and loads, and NumPy-style printing.
+ *
+ * Numbers go through std::to_chars and std::from_chars, straight into and
+ * out of large buffers that are reused across rows; no stream or locale is
+ * involved per element. Large CSV dumps are formatted in parallel, a batch
+ * of rows at a time, and written out in order.
+ *
+ * A CSV row is one value of the first index: rank-1 arrays are one column,
+ * and for rank > 2 the trailing dimensions are flattened into the columns,
+ * first index fastest.
+ */
+
+#ifndef __FZ_IO_TEXT_H__
+#define __FZ_IO_TEXT_H__
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/array_view.hpp"
+#include "fz/io/file.hpp"
+#include "fz/parallel/parallel_for.hpp"
+
+namespace fz {
+
+struct TextFormat {
+  // significant digits (general) or digits after the point (fixed,
+  // scientific) of floating point values; 0 is the shortest text that reads
+  // back to the same value
+  int precision = 0;
+  std::chars_format notation = std::chars_format::general;
+  // between the values of a CSV row
+  std::string delimiter = ",";
+  // toString() elides the middle of every dimension of arrays larger than
+  // this, keeping edge_items at either end
+  SizeType threshold = 1000;
+  SizeType edge_items = 3;
+};
+
+namespace detail {
+
+template <typename T>
+inline constexpr bool IS_COMPLEX = false;
+
+template <typename T>
+inline constexpr bool IS_COMPLEX<std::complex<T>> = true;
+
+/**
+ * @brief Room to_chars needs for any T in format: fixed notation spells out
+ * every integer digit of the largest value and, at the shortest round trip,
+ * every fraction digit of the smallest denormal.
+ */
+template <typename T>
+inline auto maxScalarChars(const TextFormat& format) -> SizeType {
+  if constexpr (std::is_floating_point_v<T>) {
+    using Limits = std::numeric_limits<T>;
+    const auto precision = static_cast<SizeType>(std::max(format.precision, 0));
+    if (format.notation == std::chars_format::fixed) {
+      const auto fraction =
+          0 < precision ? precision
+                        : static_cast<SizeType>(-Limits::min_exponent10 +
+                                                2 * Limits::max_digits10);
+      // sign, integer digits, point, fraction
+      return 3 + static_cast<SizeType>(Limits::max_exponent10) + fraction;
+    }
+    // sign, digits, point, exponent; general switches to fixed only for
+    // exponents below the precision
+    return std::max(precision, static_cast<SizeType>(Limits::max_digits10)) +
+           16;
+  } else {
+    return std::numeric_limits<T>::digits10 + 3;
+  }
+}
+
+/**
+ * @brief Growable character buffer; clear() keeps the capacity so one
+ * buffer serves a whole dump.
+ */
+class TextBuffer {
+ public:
+  // room for n more characters at the end
+  auto tail(SizeType n) -> char* {
+    if (_data.size() < _size + n) {
+      _data.resize(std::max(2 * _data.size(), _size + n));
+    }
+    return _data.data() + _size;
+  }
+
+  auto commit(const char* end) -> void {
+    _size = static_cast<SizeType>(end - _data.data());
+  }
+
+  auto append(std::string_view text) -> void {
+    std::memcpy(tail(text.size()), text.data(), text.size());
+    _size += text.size();
+  }
+
+  auto clear() -> void { _size = 0; }
+
+  [[nodiscard]] auto view() const -> std::string_view {
+    return {_data.data(), _size};
+  }
+
+  [[nodiscard]] auto size() const -> SizeType { return _size; }
+
+ private:
+  std::string _data;
+  SizeType _size = 0;
+};
+
+template <typename T>
+inline auto formatScalar(char* first, char* last, T value,
+                         const TextFormat& format) -> char* {
+  if constexpr (std::is_same_v<T, bool>) {
+    *first = value ? '1' : '0';
+    return first + 1;
+  } else {
+    std::to_chars_result result{};
+    if constexpr (std::is_floating_point_v<T>) {
+      result = format.precision == 0
+                   ? std::to_chars(first, last, value, format.notation)
+                   : std::to_chars(first, last, value, format.notation,
+                                   format.precision);
+    } else {
+      result = std::to_chars(first, last, value);
+    }
+    if (result.ec != std::errc{}) {
+      throw std::length_error("Value does not fit its text buffer");
+    }
+    return result.ptr;
+  }
+}
+
+// complex values read like NumPy's, e.g. 1.5-2j
+template <typename T>
+inline auto formatValue(TextBuffer& out, const T& value,
+                        const TextFormat& format) -> void {
+  if constexpr (IS_COMPLEX<T>) {
+    // both parts, the imaginary sign and the j
+    const auto size =
+        2 * maxScalarChars<typename T::value_type>(format) + 2;
+    auto* first = out.tail(size);
+    auto* last = first + size;
+    auto* p = formatScalar(first, last, value.real(), format);
+    if (!std::signbit(value.imag())) {
+      *p++ = '+';
+    }
+    p = formatScalar(p, last, value.imag(), format);
+    *p++ = 'j';
+    out.commit(p);
+  } else {
+    const auto size = maxScalarChars<T>(format);
+    auto* first = out.tail(size);
+    out.commit(formatScalar(first, first + size, value, format));
+  }
+}
+
+template <typename T>
+inline auto parseScalar(const char* first, const char* last, T& value)
+    -> std::from_chars_result {
+  if constexpr (std::is_same_v<T, bool>) {
+    int v = 0;
+    auto result = std::from_chars(first, last, v);
+    value = v != 0;
+    return result;
+  } else {
+    // from_chars rejects the leading '+' that other writers emit
+    if (first != last && *first == '+') {
+      ++first;
+    }
+    return std::from_chars(first, last, value);
+  }
+}
+
+template <typename T>
+inline auto parseValue(const char* first, const char* last, T& value)
+    -> std::from_chars_result {
+  if constexpr (IS_COMPLEX<T>) {
+    typename T::value_type re{};
+    typename T::value_type im{};
+    auto result = parseScalar(first, last, re);
+    if (result.ec == std::errc{} && result.ptr != last &&
+        (*result.ptr == '+' || *result.ptr == '-')) {
+      const bool negative = *result.ptr == '-';
+      result = parseScalar(result.ptr + 1, last, im);
+      im = negative ? -im : im;
+      if (result.ec == std::errc{} && result.ptr != last &&
+          *result.ptr == 'j') {
+        ++result.ptr;
+      }
+    }
+    value = T{re, im};
+    return result;
+  } else {
+    return parseScalar(first, last, value);
+  }
+}
+
+// flat offsets of the CSV columns: the trailing dimensions, first fastest
+template <typename C>
+inline auto columnOffsets(const C& arr) -> std::vector<SizeType> {
+  const auto& shape = arr.shape();
+  const auto& strides = arr.strides();
+  const auto rank = static_cast<SizeType>(std::size(shape));
+  SizeType cols = 1;
+  for (SizeType d = 1; d < rank; ++d) {
+    cols *= shape[d];
+  }
+  std::vector<SizeType> offsets(cols);
+  std::vector<SizeType> index(rank, 0);
+  for (SizeType c = 0; c < cols; ++c) {
+    SizeType offset = 0;
+    for (SizeType d = 1; d < rank; ++d) {
+      offset += index[d] * strides[d];
+    }
+    offsets[c] = offset;
+    for (SizeType d = 1; d < rank && ++index[d] == shape[d]; ++d) {
+      index[d] = 0;
+    }
+  }
+  return offsets;
+}
+
+template <typename C, typename Sink>
+inline auto writeCsv(const C& arr, const TextFormat& format,
+                     const ParallelOptions& parallel, Sink&& sink) -> void {
+  if (arr.shape().size() == 0) {
+    throw std::invalid_argument("CSV needs an array of rank 1 or more");
+  }
+  if (arr.size() == 0) {
+    return;
+  }
+  const auto* data = arr.data();
+  const SizeType rows = arr.shape()[0];
+  const SizeType row_stride = arr.strides()[0];
+  const auto columns = columnOffsets(arr);
+
+  auto formatRows = [&](TextBuffer& out, SizeType lo, SizeType hi) {
+    for (auto i = lo; i < hi; ++i) {
+      const auto* row = data + i * row_stride;
+      for (SizeType c = 0; c < columns.size(); ++c) {
+        if (c != 0) {
+          out.append(format.delimiter);
+        }
+        formatValue(out, row[columns[c]], format);
+      }
+      out.append("\n");
+    }
+  };
+
+  // batches of about 4 MiB of text, one block of rows per task
+  constexpr SizeType BATCH_BYTES = SizeType{4} << 20;
+  constexpr SizeType BLOCKS = 64;
+  const auto row_bytes = columns.size() * 24;
+  const auto batch = std::max<SizeType>(BATCH_BYTES / row_bytes, BLOCKS);
+  if (rows <= batch) {
+    TextBuffer out;
+    formatRows(out, 0, rows);
+    sink(out.view());
+    return;
+  }
+  std::vector<TextBuffer> blocks(BLOCKS);
+  const auto block_rows = (batch + BLOCKS - 1) / BLOCKS;
+  auto options = parallel;
+  options.grain = 1;
+  for (SizeType lo = 0; lo < rows; lo += batch) {
+    const auto hi = std::min(rows, lo + batch);
+    parallelFor(
+        0, BLOCKS,
+        [&](SizeType b) {
+          blocks[b].clear();
+          const auto first = std::min(hi, lo + b * block_rows);
+          formatRows(blocks[b], first, std::min(hi, first + block_rows));
+        },
+        options);
+    for (const auto& block : blocks) {
+      sink(block.view());
+    }
+  }
+}
+
+template <typename C>
+inline auto summarise(TextBuffer& out, const C& arr, const TextFormat& format)
+    -> void {
+  const auto& shape = arr.shape();
+  const auto& strides = arr.strides();
+  const auto rank = static_cast<SizeType>(std::size(shape));
+  const bool elide = format.threshold < arr.size();
+  auto shown = [&](SizeType d, SizeType k) {
+    return !elide || shape[d] <= 2 * format.edge_items ||
+           k < format.edge_items || shape[d] - format.edge_items <= k;
+  };
+
+  // format every shown element once to find the column width
+  TextBuffer values;
+  std::vector<SizeType> ends;
+  auto collect = [&](auto&& self, SizeType d, SizeType offset) -> void {
+    for (SizeType k = 0; k < shape[d]; ++k) {
+      if (!shown(d, k)) {
+        continue;
+      }
+      if (d + 1 == rank) {
+        formatValue(values, arr.data()[offset + k * strides[d]], format);
+        ends.push_back(values.size());
+      } else {
+        self(self, d + 1, offset + k * strides[d]);
+      }
+    }
+  };
+  collect(collect, 0, 0);
+  SizeType width = 0;
+  for (SizeType e = 0, begin = 0; e < ends.size(); begin = ends[e++]) {
+    width = std::max(width, ends[e] - begin);
+  }
+
+  // rows of a matrix one per line, blocks of higher ranks with blank lines
+  // between them, like NumPy
+  auto separate = [&](SizeType d) {
+    if (d + 1 == rank) {
+      out.append(", ");
+    } else {
+      out.append(",");
+      out.append(std::string(rank - 1 - d, '\n'));
+      out.append(std::string(d + 1, ' '));
+    }
+  };
+  SizeType next = 0;
+  auto emit = [&](auto&& self, SizeType d) -> void {
+    out.append("[");
+    for (SizeType k = 0; k < shape[d]; ++k) {
+      if (k != 0) {
+        separate(d);
+      }
+      if (!shown(d, k)) {
+        out.append("...");
+        k = shape[d] - format.edge_items - 1;
+      } else if (d + 1 == rank) {
+        const auto begin = next == 0 ? 0 : ends[next - 1];
+        const auto text = values.view().substr(begin, ends[next] - begin);
+        out.append(std::string(width - text.size(), ' '));
+        out.append(text);
+        ++next;
+      } else {
+        self(self, d + 1);
+      }
+    }
+    out.append("]");
+  };
+  emit(emit, 0);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Write arr as CSV, one line per value of the first index. Throws
+ * std::invalid_argument for a rank-0 array, which has no first index.
+ */
+template <typename C>
+inline auto writeCsv(std::ostream& os, const C& arr,
+                     const TextFormat& format = {},
+                     const ParallelOptions& parallel = {}) -> void {
+  detail::writeCsv(arr, format, parallel, [&](std::string_view text) {
+    os.write(text.data(), static_cast<std::streamsize>(text.size()));
+  });
+}
+
+template <typename C>
+inline auto saveCsv(const std::string& path, const C& arr,
+                    const TextFormat& format = {},
+                    const ParallelOptions& parallel = {}) -> void {
+  File file{path, File::Mode::kCreate};
+  SizeType offset = 0;
+  detail::writeCsv(arr, format, parallel, [&](std::string_view text) {
+    file.writeAt(text.data(), text.size(), offset);
+    offset += text.size();
+  });
+}
+
+/**
+ * @brief Parse CSV text into a rows x columns array. Values may be padded
+ * with blanks; blank lines are skipped. Throws std::runtime_error on
+ * malformed values and on rows of differing length.
+ */
+template <typename T>
+inline auto parseCsv(std::string_view text, char delimiter = ',')
+    -> Array<T> {
+  auto skipBlanks = [&](const char* p) {
+    while (p != text.end() && (*p == ' ' || *p == '\t' || *p == '\r')) {
+      ++p;
+    }
+    return p;
+  };
+  auto blank = [&](std::string_view line) {
+    return line.find_first_not_of(" \t\r") == std::string_view::npos;
+  };
+
+  // one pass for the shape, so the values land in place
+  SizeType rows = 0;
+  SizeType cols = 0;
+  for (SizeType pos = 0; pos < text.size();) {
+    const auto end = std::min(text.find('\n', pos), text.size());
+    const auto line = text.substr(pos, end - pos);
+    if (!blank(line)) {
+      if (rows++ == 0) {
+        cols = static_cast<SizeType>(
+                   std::count(line.begin(), line.end(), delimiter)) +
+               1;
+      }
+    }
+    pos = end + 1;
+  }
+
+  auto arr = Array<T>::empty({rows, cols});
+  SizeType i = 0;
+  for (SizeType pos = 0; pos < text.size();) {
+    const auto end = std::min(text.find('\n', pos), text.size());
+    const auto line = text.substr(pos, end - pos);
+    pos = end + 1;
+    if (blank(line)) {
+      continue;
+    }
+    const char* p = line.data();
+    const char* last = line.data() + line.size();
+    SizeType c = 0;
+    while (true) {
+      p = skipBlanks(p);
+      if (cols <= c) {
+        throw std::runtime_error("row " + std::to_string(i + 1) +
+                                 " has more than " + std::to_string(cols) +
+                                 " values");
+      }
+      const auto [ptr, ec] = detail::parseValue(p, last, arr(i, c));
+      if (ec != std::errc{}) {
+        throw std::runtime_error("bad value in row " + std::to_string(i + 1) +
+                                 ": '" +
+                                 std::string{p, std::min(last, p + 32)} + "'");
+      }
+      p = skipBlanks(ptr);
+      ++c;
+      if (p == last) {
+        break;
+      }
+      if (*p != delimiter) {
+        throw std::runtime_error("expected '" + std::string(1, delimiter) +
+                                 "' in row " + std::to_string(i + 1));
+      }
+      ++p;
+    }
+    if (c != cols) {
+      throw std::runtime_error("row " + std::to_string(i + 1) + " has " +
+                               std::to_string(c) + " values, expected " +
+                               std::to_string(cols));
+    }
+    ++i;
+  }
+  return arr;
+}
+
+template <typename T>
+inline auto loadCsv(const std::string& path, char delimiter = ',')
+    -> Array<T> {
+  const File file{path, File::Mode::kRead};
+  std::string text(file.size(), '\0');
+  file.readAt(text.data(), text.size(), 0);
+  return parseCsv<T>(text, delimiter);
+}
+
+/**
+ * @brief NumPy-style text, e.g. "[[1, 2],\n [3, 4]]", with the middle of
+ * large arrays elided.
+ */
+template <typename C>
+inline auto toString(const C& arr, const TextFormat& format = {})
+    -> std::string {
+  if (std::size(arr.shape()) == 0) {
+    return "[]";
+  }
+  detail::TextBuffer out;
+  detail::summarise(out, arr, format);
+  return std::string{out.view()};
+}
+
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto operator<<(std::ostream& os,
+                       const Array<T, Shape, Stride, Alloc>& arr)
+    -> std::ostream& {
+  return os << toString(arr);
+}
+
+template <typename T, Range Shape, Range Stride>
+inline auto operator<<(std::ostream& os,
+                       const ArrayView<T, Shape, Stride>& view)
+    -> std::ostream& {
+  return os << toString(view);
+}
+
+}  // namespace fz
+
+#endif  // __FZ_IO_TEXT_H__
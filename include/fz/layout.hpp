@@ -0,0 +1,170 @@
+/**
+ * @file layout.hpp
+ * @brief Moving array elements between memory layouts: cache-blocked
+ * transposes and row-major <-> column-major conversion, out of place or in
+ * place.
+ */
+
+#ifndef __FZ_LAYOUT_H__
+#define __FZ_LAYOUT_H__
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/array_view.hpp"
+
+namespace fz {
+
+namespace detail {
+
+// swap the two triangles of an n x n matrix, a pair of tiles at a time
+template <typename T>
+inline auto transposeSquare(T *data, SizeType n) -> void {
+  using std::swap;
+  for (SizeType ib = 0; ib < n; ib += COPY_TILE) {
+    const auto ie = std::min(n, ib + COPY_TILE);
+    for (SizeType jb = ib; jb < n; jb += COPY_TILE) {
+      const auto je = std::min(n, jb + COPY_TILE);
+      for (auto i = ib; i < ie; ++i) {
+        for (auto j = std::max(jb, i + 1); j < je; ++j) {
+          swap(data[i + j * n], data[j + i * n]);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Rearrange dense storage in place so that element i of shape, found
+ * at i . from, ends up at i . to. Square 2-D transposes swap tiles; anything
+ * else follows the permutation's cycles, with one bit of bookkeeping per
+ * element.
+ */
+template <typename T, Range Shape, Range ToStride, Range FromStride>
+inline auto permuteInPlace(T *data, const Shape &shape, const ToStride &to,
+                           const FromStride &from) -> void {
+  const auto rank = static_cast<SizeType>(shape.size());
+  if (std::ranges::equal(to, from)) {
+    return;
+  }
+  if (rank == 2 && shape[0] == shape[1] && to[0] == from[1] &&
+      to[1] == from[0]) {
+    transposeSquare(data, shape[0]);
+    return;
+  }
+
+  SizeType size = 1;
+  for (SizeType d = 0; d < rank; ++d) {
+    size *= shape[d];
+  }
+  // where the element that belongs at position p is now
+  auto source = [&](SizeType p) {
+    SizeType offset = 0;
+    for (SizeType d = 0; d < rank; ++d) {
+      offset += p / to[d] % shape[d] * from[d];
+    }
+    return offset;
+  };
+  std::vector<bool> done(size, false);
+  for (SizeType start = 0; start < size; ++start) {
+    if (done[start]) {
+      continue;
+    }
+    auto held = std::move(data[start]);
+    auto p = start;
+    while (true) {
+      done[p] = true;
+      const auto s = source(p);
+      if (s == start) {
+        data[p] = std::move(held);
+        break;
+      }
+      data[p] = std::move(data[s]);
+      p = s;
+    }
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief A copy of arr with its dimensions reversed and the elements moved
+ * to match, in arr's layout.
+ */
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto transpose(const Array<T, Shape, Stride, Alloc> &arr)
+    -> Array<T, Shape, Stride, Alloc> {
+  auto shape = arr.shape();
+  std::reverse(shape.begin(), shape.end());
+  auto strides = arr.strides();
+  std::reverse(strides.begin(), strides.end());
+  auto out = Array<T, Shape, Stride, Alloc>::empty(shape, arr.layout(),
+                                                   arr.getAllocator());
+  detail::blockedCopy(out.data(), out.strides(), arr.data(), strides, shape);
+  return out;
+}
+
+/**
+ * @brief transpose() without a second buffer.
+ */
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto transposeInPlace(Array<T, Shape, Stride, Alloc> &arr) -> void {
+  auto shape = arr.shape();
+  std::reverse(shape.begin(), shape.end());
+  auto from = arr.strides();
+  std::reverse(from.begin(), from.end());
+  detail::permuteInPlace(arr.data(), shape,
+                         detail::layoutStrides<Stride>(shape, arr.layout()),
+                         from);
+  arr.reshape(std::move(shape));
+}
+
+/**
+ * @brief A copy of arr stored in the given layout.
+ */
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto toLayout(const Array<T, Shape, Stride, Alloc> &arr, Layout layout)
+    -> Array<T, Shape, Stride, Alloc> {
+  auto out = Array<T, Shape, Stride, Alloc>::empty(arr.shape(), layout,
+                                                   arr.getAllocator());
+  detail::blockedCopy(out.data(), out.strides(), arr.data(), arr.strides(),
+                      arr.shape());
+  return out;
+}
+
+/**
+ * @brief The elements of a view gathered into a new array in the given
+ * layout.
+ */
+template <typename T, Range Shape, Range Stride>
+inline auto toLayout(const ArrayView<T, Shape, Stride> &view, Layout layout)
+    -> Array<std::remove_cv_t<T>, Shape, Stride> {
+  auto out =
+      Array<std::remove_cv_t<T>, Shape, Stride>::empty(view.shape(), layout);
+  detail::blockedCopy(out.data(), out.strides(), view.data(), view.strides(),
+                      view.shape());
+  return out;
+}
+
+/**
+ * @brief Reorder the elements of arr in place into the given layout. The
+ * values at every index stay the same.
+ */
+template <typename T, Range Shape, Range Stride, typename Alloc>
+inline auto relayout(Array<T, Shape, Stride, Alloc> &arr, Layout layout)
+    -> void {
+  if (arr.layout() == layout) {
+    return;
+  }
+  detail::permuteInPlace(arr.data(), arr.shape(),
+                         detail::layoutStrides<Stride>(arr.shape(), layout),
+                         arr.strides());
+  arr.reshape(arr.shape(), layout);
+}
+
+}  // namespace fz
+
+#endif  // __FZ_LAYOUT_H__
@@ -1,161 +1,742 @@
-// #ifndef __FZ_MEMORY_H__
-// #define __FZ_MEMORY_H__
-
-// #include <exception>
-// #include <new>
-// #include <utility>
-
-// namespace fz {
-
-// // construct
-
-// template <typename T>
-// concept FzConstructible =
-//     requires(T x) { new (x) typename std::remove_reference_t<decltype(*x)>(); };
-
-// template <typename T>
-// concept FzConstructForwardIterator =
-//     requires(T x) { requires std::forward_iterator<T>; };
-
-// template <typename T>
-// concept FzConstructInputIterator =
-//     requires(T x) { requires std::input_iterator<T>; };
-
-// template <FzConstructible T, typename... Args>
-// inline auto construct(T* p, Args&&... args) -> void {
-//   // placement new
-//   new (p) T(std::forward<Args>(args)...);
-// }
-
-// template <typename T>
-// inline auto destroy(T* p) -> void {
-//   p->~T();
-// }
-
-// template <typename ForwardIterator>
-// inline auto destroy(ForwardIterator first, ForwardIterator last) -> void {
-//   constexpr auto has_trivial_destructor = std::is_trivially_destructible_v<
-//       typename std::iterator_traits<ForwardIterator>::value_type>;
-//   if constexpr (has_trivial_destructor) {
-//     return;
-//   } else {
-//     for (; first != last; ++first) {
-//       destroy(&*first);
-//     }
-//   }
-// }
-
-// template <FzConstructInputIterator InputIterator,
-//           FzConstructForwardIterator ForwardIterator>
-// inline auto uninitializedCopy(InputIterator first, InputIterator last,
-//                               ForwardIterator result) -> ForwardIterator {
-//   ForwardIterator cur = result;
-//   constexpr auto has_trivial_copy = std::is_trivially_copy_constructible_v<
-//       typename std::iterator_traits<InputIterator>::value_type>;
-//   if constexpr (has_trivial_copy) {
-//     for (; first != last; ++first, ++cur) {
-//       // is satisfied with commit or rollback?
-//       *cur = *first;
-//     }
-//     return result;
-//   } else {
-//     try {
-//       for (; first != last; ++first, ++cur) {
-//         construct(&*cur, *first);
-//       }
-//     } catch (const std::exception& e) {
-//       destroy(result, cur);
-//       throw e;
-//     }
-//     return cur;
-//   }
-// }
-
-// template <FzConstructForwardIterator ForwardIterator, FzConstructible T>
-// inline auto uninitializedFill(ForwardIterator first, ForwardIterator last,
-//                               const T& x) -> ForwardIterator {
-//   auto cur = first;
-//   constexpr auto has_trivial_copy = std::is_trivially_copy_constructible_v<T>;
-//   if constexpr (has_trivial_copy) {
-//     for (; cur != last; ++cur) {
-//       *cur = x;
-//     }
-//   } else {
-//     try {
-//       for (; cur != last; ++cur) {
-//         construct(&*cur, x);
-//       }
-//     } catch (const std::exception& e) {
-//       destroy(first, cur);
-//       throw e;
-//     }
-//   }
-// }
-
-// template <FzConstructForwardIterator ForwardIterator, typename Size,
-//           FzConstructForwardIterator T>
-//   requires std::is_integral_v<Size> &&
-//            std::is_same_v<
-//                T, typename std::iterator_traits<ForwardIterator>::value_type>
-// inline auto uninitializedFillN(ForwardIterator first, Size n, const T& x)
-//     -> ForwardIterator {
-//   auto cur = first;
-//   constexpr auto has_trivial_copy = std::is_trivially_copy_constructible_v<T>;
-//   if constexpr (has_trivial_copy) {
-//     for (; n > 0; --n, ++cur) {
-//       *cur = x;
-//     }
-//   } else {
-//     try {
-//       for (; n > 0; --n, ++cur) {
-//         construct(&*cur, x);
-//       }
-//     } catch (const std::exception& e) {
-//       destroy(first, cur);
-//       throw e;
-//     }
-//   }
-// }
-
-// // alloc
-
-// class MallocAlloc {
-//  public:
-//   using size_type = std::size_t;
-
-//  public:
-//   static auto allocate(size_type n) -> void*;
-
-//   static auto deallocate(void* p) -> void;
-
-//   static auto reallocate(void* p, size_type n) -> void*;
-
-//  private:
-// };
-
-// auto MallocAlloc::allocate(size_type n) -> void* {
-//   std::set_new_handler(nullptr);
-//   auto p = ::operator new(n);
-//   if (p == nullptr) {
-//     throw std::bad_alloc();
-//   }
-//   return p;
-// }
-
-// auto MallocAlloc::deallocate(void* p) -> void { ::operator delete(p); }
-
-// auto MallocAlloc::reallocate(void* p, size_type n) -> void* {
-//   if (p == nullptr) {
-//     return allocate(n);
-//   }
-
-//   auto new_p = std::realloc(p, n);
-//   if (new_p == nullptr) {
-//     throw std::bad_alloc();
-//   }
-//   return new_p;
-// }
-
-// }  // namespace fz
-
-// #endif  // __FZ_MEMORY_H__
+#ifndef __FZ_MEMORY_H__
+#define __FZ_MEMORY_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace fz {
+
+// construct
+
+template <typename T>
+concept FzConstructible =
+    requires(T x) { new (x) typename std::remove_reference_t<decltype(*x)>(); };
+
+template <typename T>
+concept FzConstructForwardIterator =
+    requires(T x) { requires std::forward_iterator<T>; };
+
+template <typename T>
+concept FzConstructInputIterator =
+    requires(T x) { requires std::input_iterator<T>; };
+
+template <typename T, typename... Args>
+inline auto construct(T* p, Args&&... args) -> void {
+  // placement new
+  new (p) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+inline auto destroy(T* p) -> void {
+  p->~T();
+}
+
+template <typename ForwardIterator>
+inline auto destroy(ForwardIterator first, ForwardIterator last) -> void {
+  constexpr auto has_trivial_destructor = std::is_trivially_destructible_v<
+      typename std::iterator_traits<ForwardIterator>::value_type>;
+  if constexpr (has_trivial_destructor) {
+    return;
+  } else {
+    for (; first != last; ++first) {
+      destroy(&*first);
+    }
+  }
+}
+
+// uninitialized storage
+
+/**
+ * @brief Whether a value-initialised T is all zero bytes, so calloc'd or
+ * freshly mapped memory already holds T{}.
+ */
+template <typename T>
+struct IsZeroBytesValue
+    : std::bool_constant<std::is_arithmetic_v<T> || std::is_enum_v<T> ||
+                         std::is_pointer_v<T>> {};
+
+template <typename T>
+struct IsZeroBytesValue<std::complex<T>> : IsZeroBytesValue<T> {};
+
+template <typename T>
+concept ZeroBytesValue = IsZeroBytesValue<std::remove_cv_t<T>>::value;
+
+/**
+ * @brief Copy-construct [first, last) into the raw storage at result. Between
+ * pointers to a trivially copyable type this is one memcpy; otherwise the
+ * elements built so far are destroyed if a copy throws.
+ */
+template <FzConstructInputIterator InputIterator,
+          FzConstructForwardIterator ForwardIterator>
+inline auto uninitializedCopy(InputIterator first, InputIterator last,
+                              ForwardIterator result) -> ForwardIterator {
+  using T = typename std::iterator_traits<ForwardIterator>::value_type;
+  if constexpr (std::is_pointer_v<InputIterator> &&
+                std::is_pointer_v<ForwardIterator> &&
+                std::is_same_v<std::iter_value_t<InputIterator>, T> &&
+                std::is_trivially_copyable_v<T>) {
+    const auto n = static_cast<std::size_t>(last - first);
+    if (n != 0) {
+      std::memcpy(result, first, n * sizeof(T));
+    }
+    return result + n;
+  } else {
+    auto cur = result;
+    try {
+      for (; first != last; ++first, ++cur) {
+        fz::construct(&*cur, *first);
+      }
+    } catch (...) {
+      fz::destroy(result, cur);
+      throw;
+    }
+    return cur;
+  }
+}
+
+/**
+ * @brief Copy-construct x into n elements of raw storage starting at first.
+ * A trivially copyable x whose bytes are all alike, such as 0 or -1, is
+ * written with memset.
+ */
+template <FzConstructForwardIterator ForwardIterator, typename Size,
+          typename T>
+  requires std::is_integral_v<Size>
+inline auto uninitializedFillN(ForwardIterator first, Size n, const T& x)
+    -> ForwardIterator {
+  using Value = typename std::iterator_traits<ForwardIterator>::value_type;
+  if constexpr (std::is_pointer_v<ForwardIterator> &&
+                std::is_same_v<Value, T> && std::is_trivially_copyable_v<T>) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &x, sizeof(T));
+    const auto uniform =
+        std::all_of(bytes, bytes + sizeof(T),
+                    [&](unsigned char b) { return b == bytes[0]; });
+    if (uniform && 0 < n) {
+      std::memset(static_cast<void*>(first), bytes[0],
+                  static_cast<std::size_t>(n) * sizeof(T));
+      return first + n;
+    }
+  }
+  auto cur = first;
+  try {
+    for (; 0 < n; --n, ++cur) {
+      fz::construct(&*cur, x);
+    }
+  } catch (...) {
+    fz::destroy(first, cur);
+    throw;
+  }
+  return cur;
+}
+
+template <FzConstructForwardIterator ForwardIterator, typename T>
+inline auto uninitializedFill(ForwardIterator first, ForwardIterator last,
+                              const T& x) -> void {
+  uninitializedFillN(first, std::distance(first, last), x);
+}
+
+// alloc
+
+class MallocAlloc {
+ public:
+  using size_type = std::size_t;
+
+ public:
+  static auto allocate(size_type n) -> void*;
+
+  // n zero bytes; large blocks come straight from fresh pages, which the
+  // kernel zeroes lazily on first touch
+  static auto allocateZeroed(size_type n) -> void*;
+
+  static auto deallocate(void* p) -> void;
+
+  static auto reallocate(void* p, size_type n) -> void*;
+
+ private:
+};
+
+inline auto MallocAlloc::allocate(size_type n) -> void* {
+  auto p = std::malloc(n == 0 ? 1 : n);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+inline auto MallocAlloc::allocateZeroed(size_type n) -> void* {
+  auto p = std::calloc(n == 0 ? 1 : n, 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+inline auto MallocAlloc::deallocate(void* p) -> void { std::free(p); }
+
+inline auto MallocAlloc::reallocate(void* p, size_type n) -> void* {
+  if (p == nullptr) {
+    return allocate(n);
+  }
+
+  auto new_p = std::realloc(p, n);
+  if (new_p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return new_p;
+}
+
+/**
+ * @brief Raw memory with a fixed power-of-two alignment.
+ */
+class AlignedAlloc {
+ public:
+  using size_type = std::size_t;
+
+ public:
+  static auto allocate(size_type n, size_type alignment) -> void*;
+
+  static auto deallocate(void* p, size_type alignment) -> void;
+};
+
+inline auto AlignedAlloc::allocate(size_type n, size_type alignment) -> void* {
+  return ::operator new(n == 0 ? 1 : n, std::align_val_t{alignment});
+}
+
+inline auto AlignedAlloc::deallocate(void* p, size_type alignment) -> void {
+  ::operator delete(p, std::align_val_t{alignment});
+}
+
+/**
+ * @brief Page-granular memory for multi-GB buffers, backed by huge pages to
+ * cut TLB misses. Explicit MAP_HUGETLB pages are used when the system has
+ * reserved some; otherwise the mapping is 2 MiB aligned and marked for
+ * transparent huge pages. Off Linux this degrades to aligned allocation.
+ */
+class HugePageAlloc {
+ public:
+  using size_type = std::size_t;
+
+  static constexpr size_type HUGE_PAGE_SIZE = size_type{2} << 20;
+
+ public:
+  /**
+   * @brief The size of the mapping serving an n-byte request.
+   */
+  static auto mappingSize(size_type n) -> size_type;
+
+  // on Linux a fresh mapping, which reads as zero until written
+  static auto allocate(size_type n) -> void*;
+
+  // n must be the size passed to allocate
+  static auto deallocate(void* p, size_type n) -> void;
+};
+
+inline auto HugePageAlloc::mappingSize(size_type n) -> size_type {
+  return (n + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+inline auto HugePageAlloc::allocate(size_type n) -> void* {
+#ifdef __linux__
+  const auto length = mappingSize(n == 0 ? 1 : n);
+  void* p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    return p;
+  }
+
+  // no reserved huge pages: over-map, trim to a 2 MiB boundary, ask for THP
+  p = ::mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  auto addr = reinterpret_cast<std::uintptr_t>(p);
+  auto aligned = (addr + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  if (aligned != addr) {
+    ::munmap(p, aligned - addr);
+  }
+  if (auto tail = addr + HUGE_PAGE_SIZE - aligned; tail != 0) {
+    ::munmap(reinterpret_cast<void*>(aligned + length), tail);
+  }
+  p = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+  ::madvise(p, length, MADV_HUGEPAGE);
+#endif
+  return p;
+#else
+  return AlignedAlloc::allocate(n, HUGE_PAGE_SIZE);
+#endif
+}
+
+inline auto HugePageAlloc::deallocate(void* p, size_type n) -> void {
+#ifdef __linux__
+  ::munmap(p, mappingSize(n == 0 ? 1 : n));
+#else
+  AlignedAlloc::deallocate(p, HUGE_PAGE_SIZE);
+#endif
+}
+
+/**
+ * @brief Monotonic buffer for short-lived temporaries. Allocation bumps a
+ * pointer inside the current chunk and deallocation is a no-op; memory comes
+ * back all at once through rewind() (usually via ArenaScope) or release().
+ * Chunks are kept across rewinds, so a loop that allocates the same scratch
+ * every step stops touching the system allocator after the first one. Not
+ * thread-safe: use one arena per thread.
+ */
+class MonotonicArena {
+ public:
+  using size_type = std::size_t;
+
+  static constexpr size_type DEFAULT_CHUNK_SIZE = size_type{1} << 20;
+  static constexpr size_type CHUNK_ALIGNMENT = 64;
+
+  struct Mark {
+    void* chunk;
+    size_type used;
+  };
+
+ public:
+  explicit MonotonicArena(size_type chunk_size = DEFAULT_CHUNK_SIZE);
+
+  MonotonicArena(const MonotonicArena&) = delete;
+
+  auto operator=(const MonotonicArena&) -> MonotonicArena& = delete;
+
+  ~MonotonicArena();
+
+  /**
+   * @brief n bytes aligned to alignment, which must be a power of two no
+   * larger than CHUNK_ALIGNMENT.
+   */
+  auto allocate(size_type n, size_type alignment = alignof(std::max_align_t))
+      -> void*;
+
+  [[nodiscard]] auto mark() const -> Mark;
+
+  /**
+   * @brief Drop everything allocated since m was taken. O(1); chunks are kept
+   * for reuse.
+   */
+  auto rewind(Mark m) -> void;
+
+  // return every chunk to the system
+  auto release() -> void;
+
+  // bytes handed out since the last rewind to the start
+  [[nodiscard]] auto used() const -> size_type;
+
+  // bytes held in chunks
+  [[nodiscard]] auto capacity() const -> size_type;
+
+ private:
+  struct Chunk {
+    Chunk* next;
+    size_type capacity;
+    // bytes used in earlier chunks, so used() needs no walk
+    size_type before;
+  };
+
+  // chunk payload starts one alignment unit after the header
+  static constexpr size_type HEADER_SIZE =
+      (sizeof(Chunk) + CHUNK_ALIGNMENT - 1) / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT;
+
+  size_type _chunk_size;
+  Chunk* _head{};
+  Chunk* _current{};
+  size_type _used{};
+
+  static auto payload(Chunk* chunk) -> char*;
+
+  auto nextChunk(size_type n) -> Chunk*;
+};
+
+inline MonotonicArena::MonotonicArena(size_type chunk_size)
+    : _chunk_size{chunk_size} {}
+
+inline MonotonicArena::~MonotonicArena() { release(); }
+
+inline auto MonotonicArena::payload(Chunk* chunk) -> char* {
+  return reinterpret_cast<char*>(chunk) + HEADER_SIZE;
+}
+
+inline auto MonotonicArena::allocate(size_type n, size_type alignment)
+    -> void* {
+  if (_current != nullptr) {
+    auto offset = (_used + alignment - 1) & ~(alignment - 1);
+    if (offset + n <= _current->capacity) {
+      _used = offset + n;
+      return payload(_current) + offset;
+    }
+  }
+  _current = nextChunk(n);
+  _used = n;
+  return payload(_current);
+}
+
+// the chunk after _current if it is large enough, otherwise a fresh one
+// linked in right after _current
+inline auto MonotonicArena::nextChunk(size_type n) -> Chunk* {
+  const auto before =
+      _current == nullptr ? size_type{0} : _current->before + _used;
+  auto* next = _current == nullptr ? _head : _current->next;
+  if (next != nullptr && n <= next->capacity) {
+    next->before = before;
+    return next;
+  }
+
+  const auto capacity = std::max(_chunk_size, n);
+  auto* chunk = static_cast<Chunk*>(
+      AlignedAlloc::allocate(HEADER_SIZE + capacity, CHUNK_ALIGNMENT));
+  *chunk = Chunk{next, capacity, before};
+  if (_current == nullptr) {
+    _head = chunk;
+  } else {
+    _current->next = chunk;
+  }
+  return chunk;
+}
+
+inline auto MonotonicArena::mark() const -> Mark { return {_current, _used}; }
+
+inline auto MonotonicArena::rewind(Mark m) -> void {
+  _current = static_cast<Chunk*>(m.chunk);
+  _used = m.used;
+}
+
+inline auto MonotonicArena::release() -> void {
+  while (_head != nullptr) {
+    auto* next = _head->next;
+    AlignedAlloc::deallocate(_head, CHUNK_ALIGNMENT);
+    _head = next;
+  }
+  _current = nullptr;
+  _used = 0;
+}
+
+inline auto MonotonicArena::used() const -> size_type {
+  return _current == nullptr ? 0 : _current->before + _used;
+}
+
+inline auto MonotonicArena::capacity() const -> size_type {
+  size_type total = 0;
+  for (auto* chunk = _head; chunk != nullptr; chunk = chunk->next) {
+    total += chunk->capacity;
+  }
+  return total;
+}
+
+/**
+ * @brief Makes an arena the active one for the calling thread until the
+ * scope ends, then rewinds it to where it was. Scopes nest; ArenaAllocator
+ * binds to whichever scope is active when it is constructed. Everything
+ * allocated inside the scope must be dead by the time it closes.
+ */
+class ArenaScope {
+ public:
+  // scope over the calling thread's own arena
+  ArenaScope();
+
+  explicit ArenaScope(MonotonicArena& arena);
+
+  ArenaScope(const ArenaScope&) = delete;
+
+  auto operator=(const ArenaScope&) -> ArenaScope& = delete;
+
+  ~ArenaScope();
+
+  // the innermost active arena of the calling thread, or nullptr
+  static auto active() -> MonotonicArena*;
+
+  static auto threadArena() -> MonotonicArena&;
+
+ private:
+  MonotonicArena& _arena;
+  MonotonicArena::Mark _mark;
+  MonotonicArena* _previous;
+
+  static auto activeStorage() -> MonotonicArena*&;
+};
+
+inline ArenaScope::ArenaScope() : ArenaScope(threadArena()) {}
+
+inline ArenaScope::ArenaScope(MonotonicArena& arena)
+    : _arena{arena}, _mark{arena.mark()}, _previous{activeStorage()} {
+  activeStorage() = &arena;
+}
+
+inline ArenaScope::~ArenaScope() {
+  _arena.rewind(_mark);
+  activeStorage() = _previous;
+}
+
+inline auto ArenaScope::active() -> MonotonicArena* { return activeStorage(); }
+
+inline auto ArenaScope::threadArena() -> MonotonicArena& {
+  thread_local MonotonicArena arena;
+  return arena;
+}
+
+inline auto ArenaScope::activeStorage() -> MonotonicArena*& {
+  thread_local MonotonicArena* active = nullptr;
+  return active;
+}
+
+/**
+ * @brief Process-wide cache of freed buffers, after the SGI second-level
+ * allocator: buffers are binned by size class and handed back out instead of
+ * going to the system, so a loop cycling the same few Array sizes stops
+ * hitting mmap/munmap. Each thread keeps a few buffers per class without
+ * locking; the rest sit in a shared, locked depot. The bytes held across
+ * both never exceed capacity(); past it, freed buffers go straight back to
+ * the system.
+ */
+class BufferCache {
+ public:
+  using size_type = std::size_t;
+
+  static constexpr size_type ALIGNMENT = 64;
+  static constexpr size_type DEFAULT_CAPACITY = size_type{1} << 30;
+  // four classes per power of two: at most 25% rounding waste
+  static constexpr size_type MIN_CLASS_SIZE = 64;
+  static constexpr size_type NUM_CLASSES = 4 * (48 - 6) + 1;
+  static constexpr size_type THREAD_CACHE_DEPTH = 4;
+
+  struct Stats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    size_type cached_bytes;
+    size_type capacity;
+  };
+
+ public:
+  static auto instance() -> BufferCache&;
+
+  BufferCache(const BufferCache&) = delete;
+
+  auto operator=(const BufferCache&) -> BufferCache& = delete;
+
+  ~BufferCache();
+
+  // ALIGNMENT-aligned buffer of at least n bytes
+  auto allocate(size_type n) -> void*;
+
+  // n must be the size passed to allocate
+  auto deallocate(void* p, size_type n) -> void;
+
+  /**
+   * @brief Return the depot and the calling thread's cache to the system.
+   * Other threads' caches are flushed to the depot when those threads exit.
+   */
+  auto trim() -> void;
+
+  // a lower cap trims immediately
+  auto setCapacity(size_type bytes) -> void;
+
+  [[nodiscard]] auto capacity() const -> size_type;
+
+  [[nodiscard]] auto stats() const -> Stats;
+
+  auto resetStats() -> void;
+
+  // size class of an n-byte request, NUM_CLASSES when it is too large to bin
+  static auto sizeClass(size_type n) -> size_type;
+
+  static auto classSize(size_type c) -> size_type;
+
+ private:
+  struct ThreadCache {
+    std::array<std::array<void*, THREAD_CACHE_DEPTH>, NUM_CLASSES> slots{};
+    std::array<std::uint8_t, NUM_CLASSES> count{};
+
+    ThreadCache();
+
+    ~ThreadCache();
+  };
+
+  std::mutex _mutex;
+  std::vector<std::vector<void*>> _depot;
+  std::atomic<size_type> _capacity{DEFAULT_CAPACITY};
+  std::atomic<size_type> _cached_bytes{};
+  std::atomic<std::uint64_t> _hits{};
+  std::atomic<std::uint64_t> _misses{};
+
+  BufferCache();
+
+  static auto threadCache() -> ThreadCache&;
+
+  // moves a thread's buffers into the depot
+  auto flush(ThreadCache& cache) -> void;
+
+  auto releaseDepot() -> void;
+};
+
+inline BufferCache::BufferCache() : _depot(NUM_CLASSES) {}
+
+inline BufferCache::~BufferCache() { releaseDepot(); }
+
+inline auto BufferCache::instance() -> BufferCache& {
+  static BufferCache cache;
+  return cache;
+}
+
+inline BufferCache::ThreadCache::ThreadCache() {
+  // the depot has to outlive every thread cache, main thread's included
+  instance();
+}
+
+inline BufferCache::ThreadCache::~ThreadCache() { instance().flush(*this); }
+
+inline auto BufferCache::threadCache() -> ThreadCache& {
+  thread_local ThreadCache cache;
+  return cache;
+}
+
+inline auto BufferCache::sizeClass(size_type n) -> size_type {
+  if (n <= MIN_CLASS_SIZE) {
+    return 0;
+  }
+  const auto width = static_cast<size_type>(std::bit_width(n - 1));
+  const auto base = size_type{1} << (width - 1);
+  const auto step = base / 4;
+  const auto k = (n - base + step - 1) / step;
+  return std::min((width - 7) * 4 + k, NUM_CLASSES);
+}
+
+inline auto BufferCache::classSize(size_type c) -> size_type {
+  if (c == 0) {
+    return MIN_CLASS_SIZE;
+  }
+  const auto base = MIN_CLASS_SIZE << ((c - 1) / 4);
+  return base + ((c - 1) % 4 + 1) * (base / 4);
+}
+
+inline auto BufferCache::allocate(size_type n) -> void* {
+  const auto c = sizeClass(n);
+  if (c == NUM_CLASSES) {
+    _misses.fetch_add(1, std::memory_order_relaxed);
+    return AlignedAlloc::allocate(n, ALIGNMENT);
+  }
+
+  auto& cache = threadCache();
+  void* p = nullptr;
+  if (cache.count[c] != 0) {
+    p = cache.slots[c][--cache.count[c]];
+  } else {
+    std::lock_guard lock{_mutex};
+    if (!_depot[c].empty()) {
+      p = _depot[c].back();
+      _depot[c].pop_back();
+    }
+  }
+
+  if (p == nullptr) {
+    _misses.fetch_add(1, std::memory_order_relaxed);
+    return AlignedAlloc::allocate(classSize(c), ALIGNMENT);
+  }
+  _hits.fetch_add(1, std::memory_order_relaxed);
+  _cached_bytes.fetch_sub(classSize(c), std::memory_order_relaxed);
+  return p;
+}
+
+inline auto BufferCache::deallocate(void* p, size_type n) -> void {
+  if (p == nullptr) {
+    return;
+  }
+  const auto c = sizeClass(n);
+  if (c == NUM_CLASSES) {
+    AlignedAlloc::deallocate(p, ALIGNMENT);
+    return;
+  }
+
+  const auto bytes = classSize(c);
+  auto cached = _cached_bytes.load(std::memory_order_relaxed);
+  do {
+    if (_capacity.load(std::memory_order_relaxed) < cached + bytes) {
+      AlignedAlloc::deallocate(p, ALIGNMENT);
+      return;
+    }
+  } while (!_cached_bytes.compare_exchange_weak(cached, cached + bytes,
+                                                std::memory_order_relaxed));
+
+  auto& cache = threadCache();
+  if (cache.count[c] < THREAD_CACHE_DEPTH) {
+    cache.slots[c][cache.count[c]++] = p;
+    return;
+  }
+  std::lock_guard lock{_mutex};
+  _depot[c].push_back(p);
+}
+
+inline auto BufferCache::flush(ThreadCache& cache) -> void {
+  std::lock_guard lock{_mutex};
+  for (size_type c = 0; c < NUM_CLASSES; ++c) {
+    for (size_type i = 0; i < cache.count[c]; ++i) {
+      _depot[c].push_back(cache.slots[c][i]);
+    }
+    cache.count[c] = 0;
+  }
+}
+
+inline auto BufferCache::releaseDepot() -> void {
+  std::lock_guard lock{_mutex};
+  for (size_type c = 0; c < NUM_CLASSES; ++c) {
+    for (auto* p : _depot[c]) {
+      AlignedAlloc::deallocate(p, ALIGNMENT);
+    }
+    _cached_bytes.fetch_sub(_depot[c].size() * classSize(c),
+                            std::memory_order_relaxed);
+    _depot[c].clear();
+    _depot[c].shrink_to_fit();
+  }
+}
+
+inline auto BufferCache::trim() -> void {
+  flush(threadCache());
+  releaseDepot();
+}
+
+inline auto BufferCache::setCapacity(size_type bytes) -> void {
+  _capacity.store(bytes, std::memory_order_relaxed);
+  if (bytes < _cached_bytes.load(std::memory_order_relaxed)) {
+    trim();
+  }
+}
+
+inline auto BufferCache::capacity() const -> size_type {
+  return _capacity.load(std::memory_order_relaxed);
+}
+
+inline auto BufferCache::stats() const -> Stats {
+  return {_hits.load(std::memory_order_relaxed),
+          _misses.load(std::memory_order_relaxed),
+          _cached_bytes.load(std::memory_order_relaxed), capacity()};
+}
+
+inline auto BufferCache::resetStats() -> void {
+  _hits.store(0, std::memory_order_relaxed);
+  _misses.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace fz
+
+#endif  // __FZ_MEMORY_H__
@@ -0,0 +1,419 @@
+/**
+ * @file numa.hpp
+ * @brief NUMA page placement for Array storage.
+ *
+ * Linux puts a page on the node of the thread that first writes it, so an
+ * Array allocated and filled by one thread lives on one socket and every
+ * other socket reads it over the interconnect. NumaAllocator places the
+ * pages when the buffer is allocated instead:
+ *
+ * - kFirstTouch writes them from the pool under the static schedule, so part
+ *   r of the buffer lands on the node of rank r. A later parallelFor or
+ *   reduce with Schedule::kStatic on the same pool hands part r to the same
+ *   thread and finds its memory local.
+ * - kInterleave spreads the pages round-robin over all nodes, for data every
+ *   thread reads all of.
+ * - kBind keeps every page on one node.
+ *
+ * pinThreads() stops the OS from moving ranks between sockets afterwards,
+ * and pagePlacement() reports where the pages of an Array actually are.
+ * This uses the mbind and move_pages system calls directly, not libnuma. Off
+ * Linux, or on a single node, everything works and placement does nothing.
+ */
+
+#ifndef __FZ_PARALLEL_NUMA_H__
+#define __FZ_PARALLEL_NUMA_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/array_base.hpp"
+#include "fz/memory.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/parallel/thread_pool.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fz {
+
+enum class NumaPolicy {
+  // each rank writes the part of the buffer staticPartition() gives it
+  kFirstTouch,
+  // pages round-robin over every node
+  kInterleave,
+  // every page on NumaOptions::node
+  kBind,
+};
+
+struct NumaOptions {
+  NumaPolicy policy = NumaPolicy::kFirstTouch;
+  // the node for kBind
+  SizeType node = 0;
+  // the pool whose ranks first-touch; nullptr means ThreadPool::global()
+  ThreadPool* pool = nullptr;
+};
+
+/**
+ * @brief Where the pages of a buffer are.
+ */
+struct PagePlacement {
+  // pages on each node, indexed by node
+  std::vector<SizeType> pages;
+  // pages not backed by memory yet, or whose node could not be queried
+  SizeType unplaced = 0;
+
+  [[nodiscard]] auto total() const -> SizeType {
+    auto sum = unplaced;
+    for (auto n : pages) {
+      sum += n;
+    }
+    return sum;
+  }
+};
+
+// "node 0: 512, node 1: 512, unplaced: 0" (pages)
+inline auto operator<<(std::ostream& os, const PagePlacement& placement)
+    -> std::ostream& {
+  for (SizeType node = 0; node < placement.pages.size(); ++node) {
+    os << "node " << node << ": " << placement.pages[node] << ", ";
+  }
+  return os << "unplaced: " << placement.unplaced;
+}
+
+namespace numa {
+
+inline auto pageSize() -> SizeType;
+
+// number of nodes, 1 when the system does not say
+inline auto nodeCount() -> SizeType;
+
+// the CPUs of node this process may run on
+inline auto cpusOfNode(SizeType node) -> std::vector<int>;
+
+/**
+ * @brief Pin every rank of pool to one CPU, filling node 0's CPUs first, so
+ * consecutive static parts stay on the same node. This pins the calling
+ * thread too, as rank 0. Failures are ignored: pinning is a hint.
+ */
+inline auto pinThreads(ThreadPool& pool = ThreadPool::global()) -> void;
+
+/**
+ * @brief The node of every page overlapping [p, p + bytes), via move_pages.
+ * Nothing is touched: pages never written count as unplaced.
+ */
+inline auto pagePlacement(const void* p, SizeType bytes) -> PagePlacement;
+
+template <typename A>
+  requires requires(const A& a) {
+    a.data();
+    a.size();
+  }
+auto pagePlacement(const A& arr) -> PagePlacement {
+  return pagePlacement(static_cast<const void*>(arr.data()),
+                       arr.size() * sizeof(*arr.data()));
+}
+
+}  // namespace numa
+
+namespace detail {
+
+// "0-3,8,10-11" as in sysfs cpulist and node lists
+inline auto parseCpuList(const std::string& text) -> std::vector<int> {
+  std::vector<int> ids;
+  SizeType pos = 0;
+  while (pos < text.size()) {
+    auto end = text.find(',', pos);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const auto item = text.substr(pos, end - pos);
+    pos = end + 1;
+    if (item.empty() || item.find_first_of("0123456789") != 0) {
+      continue;
+    }
+    const auto dash = item.find('-');
+    const auto lo = std::stoi(item.substr(0, dash));
+    const auto hi = dash == std::string::npos
+                        ? lo
+                        : std::stoi(item.substr(dash + 1));
+    for (auto id = lo; id <= hi; ++id) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+inline auto readLine(const std::string& path) -> std::string {
+  std::ifstream in{path};
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+#ifdef __linux__
+// MPOL_* from <linux/mempolicy.h>
+inline constexpr int MPOL_BIND_MODE = 2;
+inline constexpr int MPOL_INTERLEAVE_MODE = 3;
+
+inline auto bindPages(void* p, SizeType bytes, int mode,
+                      const std::vector<SizeType>& nodes) -> void {
+  constexpr SizeType BITS = std::numeric_limits<unsigned long>::digits;
+  const auto max_node = numa::nodeCount();
+  // the kernel reads one bit less than maxnode says
+  std::vector<unsigned long> mask((max_node + 1 + BITS - 1) / BITS);
+  for (auto node : nodes) {
+    mask[node / BITS] |= 1UL << (node % BITS);
+  }
+  ::syscall(SYS_mbind, p, bytes, mode, mask.data(), max_node + 1, 0);
+}
+#endif
+
+/**
+ * @brief Apply options to the fresh pages holding n elements of size bytes
+ * at p, which must be page aligned.
+ */
+inline auto placePages(void* p, SizeType n, SizeType size,
+                       const NumaOptions& options) -> void {
+#ifdef __linux__
+  const auto bytes = n * size;
+  switch (options.policy) {
+    case NumaPolicy::kInterleave: {
+      std::vector<SizeType> nodes(numa::nodeCount());
+      for (SizeType node = 0; node < nodes.size(); ++node) {
+        nodes[node] = node;
+      }
+      bindPages(p, bytes, MPOL_INTERLEAVE_MODE, nodes);
+      return;
+    }
+    case NumaPolicy::kBind:
+      bindPages(p, bytes, MPOL_BIND_MODE, {options.node});
+      return;
+    case NumaPolicy::kFirstTouch:
+      break;
+  }
+
+  // each rank writes the pages that start inside its part of the elements
+  auto& pool = resolvePool({.pool = options.pool});
+  const auto page = numa::pageSize();
+  auto* base = static_cast<volatile unsigned char*>(p);
+  pool.broadcast([&](SizeType rank) {
+    const auto [lo, hi] = staticPartition(0, n, rank, pool.concurrency());
+    const auto first = (lo * size + page - 1) / page * page;
+    const auto last = std::min(hi * size, bytes);
+    for (auto offset = first; offset < last; offset += page) {
+      base[offset] = 0;
+    }
+  });
+#else
+  static_cast<void>(p);
+  static_cast<void>(n);
+  static_cast<void>(size);
+  static_cast<void>(options);
+#endif
+}
+
+}  // namespace detail
+
+/**
+ * @brief Page-granular allocator that places its pages by NumaOptions. Meant
+ * for large buffers: every allocation is a fresh mapping and, for
+ * kFirstTouch, a broadcast on the pool. Memory comes back zeroed.
+ */
+template <typename T>
+class NumaAllocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using size_type = std::size_t;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using is_always_equal = std::false_type;
+
+ public:
+  NumaAllocator() = default;
+
+  explicit NumaAllocator(const NumaOptions& options) : _options{options} {
+    if (options.policy == NumaPolicy::kBind &&
+        numa::nodeCount() <= options.node) {
+      throw std::invalid_argument("No such NUMA node");
+    }
+  }
+
+  template <typename U>
+  NumaAllocator(const NumaAllocator<U>& other) noexcept  // NOLINT
+      : _options{other.options()} {}
+
+  [[nodiscard]] auto options() const -> const NumaOptions& { return _options; }
+
+  auto allocate(size_type n) -> pointer {
+    if (std::numeric_limits<size_type>::max() / sizeof(T) < n) {
+      throw std::bad_array_new_length();
+    }
+    const auto bytes = std::max<size_type>(n * sizeof(T), 1);
+#ifdef __linux__
+    void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+#else
+    void* p = AlignedAlloc::allocate(bytes, FZ_DEFAULT_ALIGNMENT);
+    std::memset(p, 0, bytes);
+#endif
+    detail::placePages(p, n, sizeof(T), _options);
+    return static_cast<pointer>(p);
+  }
+
+  // the pages are fresh or were placed by writing zeros
+  auto allocateZeroed(size_type n) -> pointer { return allocate(n); }
+
+  auto deallocate(pointer p, size_type n) -> void {
+#ifdef __linux__
+    ::munmap(p, std::max<size_type>(n * sizeof(T), 1));
+#else
+    static_cast<void>(n);
+    AlignedAlloc::deallocate(p, FZ_DEFAULT_ALIGNMENT);
+#endif
+  }
+
+  template <typename U>
+  friend auto operator==(const NumaAllocator& lhs, const NumaAllocator<U>& rhs)
+      -> bool {
+    return lhs.options().policy == rhs.options().policy &&
+           lhs.options().node == rhs.options().node &&
+           lhs.options().pool == rhs.options().pool;
+  }
+
+ private:
+  NumaOptions _options{};
+};
+
+/**
+ * @brief An Array whose storage NumaAllocator places, e.g.
+ * NumaArray<double>::zeros(shape, NumaAllocator<double>{{.pool = &pool}}).
+ */
+template <typename T>
+using NumaArray = Array<T, ShapeVector, ShapeVector, NumaAllocator<T>>;
+
+namespace numa {
+
+inline auto pageSize() -> SizeType {
+#ifdef __linux__
+  static const auto size = static_cast<SizeType>(::sysconf(_SC_PAGESIZE));
+  return size;
+#else
+  return 4096;
+#endif
+}
+
+inline auto nodeCount() -> SizeType {
+  static const auto count = []() -> SizeType {
+    const auto nodes = detail::parseCpuList(
+        detail::readLine("/sys/devices/system/node/online"));
+    if (nodes.empty()) {
+      return 1;
+    }
+    return static_cast<SizeType>(*std::ranges::max_element(nodes)) + 1;
+  }();
+  return count;
+}
+
+inline auto cpusOfNode(SizeType node) -> std::vector<int> {
+  auto cpus = detail::parseCpuList(detail::readLine(
+      "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+    if (cpus.empty() && node == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+    std::erase_if(cpus, [&](int cpu) {
+      return CPU_SETSIZE <= cpu || !CPU_ISSET(cpu, &allowed);
+    });
+  }
+#endif
+  return cpus;
+}
+
+inline auto pinThreads(ThreadPool& pool) -> void {
+#ifdef __linux__
+  std::vector<int> order;
+  for (SizeType node = 0; node < nodeCount(); ++node) {
+    const auto cpus = cpusOfNode(node);
+    order.insert(order.end(), cpus.begin(), cpus.end());
+  }
+  if (order.empty()) {
+    return;
+  }
+  pool.broadcast([&](SizeType rank) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(order[rank % order.size()], &set);
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+  });
+#else
+  static_cast<void>(pool);
+#endif
+}
+
+inline auto pagePlacement(const void* p, SizeType bytes) -> PagePlacement {
+  PagePlacement placement;
+  placement.pages.assign(nodeCount(), 0);
+  if (bytes == 0) {
+    return placement;
+  }
+  const auto page = pageSize();
+  const auto begin = reinterpret_cast<std::uintptr_t>(p) / page * page;
+  const auto end = reinterpret_cast<std::uintptr_t>(p) + bytes;
+  const auto count = (end - begin + page - 1) / page;
+#ifdef __linux__
+  std::vector<void*> pages(count);
+  for (SizeType i = 0; i < count; ++i) {
+    pages[i] = reinterpret_cast<void*>(begin + i * page);
+  }
+  std::vector<int> status(count, -1);
+  // no target nodes: move_pages only reports where each page is
+  if (::syscall(SYS_move_pages, 0, count, pages.data(), nullptr,
+                status.data(), 0) == 0) {
+    for (auto node : status) {
+      if (node < 0) {
+        ++placement.unplaced;
+        continue;
+      }
+      if (placement.pages.size() <= static_cast<SizeType>(node)) {
+        placement.pages.resize(node + 1);
+      }
+      ++placement.pages[node];
+    }
+    return placement;
+  }
+#endif
+  placement.unplaced = count;
+  return placement;
+}
+
+}  // namespace numa
+
+}  // namespace fz
+
+#endif  // __FZ_PARALLEL_NUMA_H__
@@ -0,0 +1,434 @@
+/**
+ * @file numeric.hpp
+ * @brief Parallel reduce, transformReduce and scans over Arrays and views.
+ *
+ * Elements are taken in memory order, by increasing stride: first index
+ * fastest for a column-major Array, last index fastest for a row-major one,
+ * so a dense operand of either layout is a flat span. Work is cut into
+ * chunks of consecutive elements in that order. Every chunk is folded on one
+ * thread, through the SIMD kernels where the operation allows it, and the
+ * per-chunk partials are then combined pairwise in chunk order. Only
+ * associativity is assumed, never commutativity.
+ *
+ * With ParallelOptions::deterministic the chunk size no longer depends on the
+ * pool (it is the grain, or DETERMINISTIC_CHUNK) and the SIMD kernels run in
+ * their reproducible mode, so floating-point results are bit-identical for
+ * any thread count and instruction set.
+ *
+ * Otherwise Schedule::kStatic folds one staticPartition() chunk per thread,
+ * each on the thread that owns it, so a reduction reads the same pages a
+ * static sweep wrote.
+ */
+
+#ifndef __FZ_PARALLEL_NUMERIC_H__
+#define __FZ_PARALLEL_NUMERIC_H__
+
+#include <algorithm>
+#include <functional>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/array_base.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/simd/simd.hpp"
+
+namespace fz {
+
+// elements per chunk in deterministic mode unless a grain is given
+inline constexpr SizeType DETERMINISTIC_CHUNK = SizeType{1} << 14;
+
+namespace detail {
+
+// smallest chunk worth a task of its own in fast mode
+inline constexpr SizeType MIN_REDUCE_CHUNK = SizeType{1} << 11;
+
+template <typename C>
+concept StridedStorage = requires(const C& c) {
+  c.data();
+  c.shape();
+  c.strides();
+  c.size();
+};
+
+// the elements fill data()[0, size()), in whichever order
+template <StridedStorage C>
+inline auto isDense(const C& c) -> bool {
+  if constexpr (requires { c.isDense(); }) {
+    return c.isDense();
+  } else {
+    return true;
+  }
+}
+
+// element i of x and of y at offset i: both dense and stored the same way
+template <StridedStorage C, StridedStorage D>
+inline auto isSameDense(const C& x, const D& y) -> bool {
+  if (!isDense(x) || !isDense(y)) {
+    return false;
+  }
+  for (SizeType d = 0; d < x.shape().size(); ++d) {
+    if (x.shape()[d] != 1 &&
+        static_cast<SizeType>(x.strides()[d]) !=
+            static_cast<SizeType>(y.strides()[d])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// r[order[0]], r[order[1]], ...: a shape or strides in the memory order of
+// some operand
+template <Range R>
+auto permuted(const R& r, const std::vector<SizeType>& order)
+    -> std::vector<SizeType> {
+  std::vector<SizeType> out(order.size());
+  for (SizeType k = 0; k < order.size(); ++k) {
+    out[k] = static_cast<SizeType>(r[order[k]]);
+  }
+  return out;
+}
+
+/**
+ * @brief Call f(offset) for the elements at logical positions [lo, hi) of a
+ * strided layout, first index fastest. Permute shape and strides with
+ * memoryOrder() first to walk memory forwards.
+ */
+template <Range Shape, Range Stride, typename F>
+auto forEachOffset(const Shape& shape, const Stride& strides, SizeType lo,
+                   SizeType hi, F&& f) -> void {
+  if (hi <= lo) {
+    return;
+  }
+  const auto rank = shape.size();
+  std::vector<SizeType> index(rank);
+  SizeType offset = 0;
+  auto rest = lo;
+  for (SizeType d = 0; d < rank; ++d) {
+    index[d] = rest % shape[d];
+    rest /= shape[d];
+    offset += index[d] * strides[d];
+  }
+
+  for (auto i = lo; i < hi; ++i) {
+    f(offset);
+    for (SizeType d = 0; d < rank; ++d) {
+      offset += strides[d];
+      if (++index[d] < shape[d]) {
+        break;
+      }
+      offset -= index[d] * strides[d];
+      index[d] = 0;
+    }
+  }
+}
+
+// f(element) for positions [lo, hi) of c in memory order
+template <StridedStorage C, typename F>
+auto forEachElement(const C& c, SizeType lo, SizeType hi, F&& f) -> void {
+  const auto* data = c.data();
+  if (isDense(c)) {
+    for (auto i = lo; i < hi; ++i) {
+      f(data[i]);
+    }
+  } else {
+    const auto order = memoryOrder<std::vector<SizeType>>(c.strides());
+    forEachOffset(permuted(c.shape(), order), permuted(c.strides(), order),
+                  lo, hi, [&](SizeType offset) { f(data[offset]); });
+  }
+}
+
+template <typename Op, typename T>
+inline constexpr bool IS_PLUS =
+    std::is_same_v<Op, std::plus<>> || std::is_same_v<Op, std::plus<T>>;
+
+template <typename Op, typename T>
+inline constexpr bool IS_MULTIPLIES = std::is_same_v<Op, std::multiplies<>> ||
+                                      std::is_same_v<Op, std::multiplies<T>>;
+
+inline auto chunkSize(SizeType n, const ParallelOptions& options,
+                      const ThreadPool& pool) -> SizeType {
+  if (options.deterministic) {
+    return options.grain != 0 ? options.grain : DETERMINISTIC_CHUNK;
+  }
+  if (options.grain != 0) {
+    return options.grain;
+  }
+  return std::max(resolveGrain(options, n, pool), MIN_REDUCE_CHUNK);
+}
+
+// adjacent pairs first, then pairs of pairs: a fixed association for a given
+// number of partials
+template <typename T, typename Op>
+auto combineTree(std::vector<T>& partials, Op& op) -> T {
+  for (SizeType width = 1; width < partials.size(); width *= 2) {
+    for (SizeType i = 0; i + width < partials.size(); i += 2 * width) {
+      partials[i] = op(std::move(partials[i]), std::move(partials[i + width]));
+    }
+  }
+  return std::move(partials[0]);
+}
+
+/**
+ * @brief fold(lo, hi) -> T for every chunk on the pool, then combine the
+ * partials in order and fold in init.
+ */
+template <typename T, typename Op, typename Fold>
+auto chunkedReduce(SizeType n, T init, Op& op, Fold&& fold,
+                   const ParallelOptions& options) -> T {
+  if (n == 0) {
+    return init;
+  }
+  auto& pool = resolvePool(options);
+  const auto parts = pool.concurrency();
+  if (options.schedule == Schedule::kStatic && !options.deterministic &&
+      parts <= n) {
+    std::vector<T> partials(parts, init);
+    pool.broadcast([&](SizeType rank) {
+      const auto [lo, hi] = staticPartition(0, n, rank, parts);
+      partials[rank] = fold(lo, hi);
+    });
+    return op(std::move(init), combineTree(partials, op));
+  }
+
+  const auto chunk = chunkSize(n, options, pool);
+  const auto chunks = (n + chunk - 1) / chunk;
+
+  std::vector<T> partials(chunks, init);
+  parallelFor(
+      0, chunks,
+      [&](SizeType c) {
+        partials[c] = fold(c * chunk, std::min(n, (c + 1) * chunk));
+      },
+      {.grain = 1, .pool = &pool});
+  return op(std::move(init), combineTree(partials, op));
+}
+
+template <typename D>
+auto checkSameShape(const auto& in, const D& out) -> void {
+  if (!std::ranges::equal(in.shape(), out.shape())) {
+    throw std::invalid_argument("Shape mismatch");
+  }
+}
+
+/**
+ * @brief Two-pass scan: chunk totals, a serial scan over them, then every
+ * chunk rescanned from its carry. in and out may alias. An inclusive scan
+ * has no init: it starts from the first element.
+ */
+template <bool INCLUSIVE, StridedStorage C, StridedStorage D, typename T,
+          typename Op>
+auto chunkedScan(const C& in, D& out, T init, Op op,
+                 const ParallelOptions& options) -> void {
+  checkSameShape(in, out);
+  const auto n = in.size();
+  if (n == 0) {
+    return;
+  }
+  auto& pool = resolvePool(options);
+  const auto chunk = chunkSize(n, options, pool);
+  const auto chunks = (n + chunk - 1) / chunk;
+
+  // carries[c]: everything before chunk c folded together (and into init)
+  std::vector<T> carries(chunks, init);
+  parallelFor(
+      0, chunks - 1,
+      [&](SizeType c) {
+        bool first = true;
+        T acc = init;
+        forEachElement(in, c * chunk, (c + 1) * chunk, [&](const auto& v) {
+          acc = first ? static_cast<T>(v) : op(std::move(acc), v);
+          first = false;
+        });
+        carries[c + 1] = std::move(acc);
+      },
+      {.grain = 1, .pool = &pool});
+  for (SizeType c = 1; c < chunks; ++c) {
+    if (INCLUSIVE && c == 1) {
+      continue;
+    }
+    carries[c] = op(carries[c - 1], carries[c]);
+  }
+
+  // chunk c reads and writes only its own positions, so in and out may alias;
+  // out is written at the positions in visits, in its memory order or not
+  auto* dst = out.data();
+  const bool dense = isSameDense(in, out);
+  const auto order = memoryOrder<std::vector<SizeType>>(in.strides());
+  const auto shape = permuted(in.shape(), order);
+  const auto out_strides = permuted(out.strides(), order);
+  parallelFor(
+      0, chunks,
+      [&](SizeType c) {
+        const auto lo = c * chunk;
+        const auto hi = std::min(n, lo + chunk);
+        bool fresh = INCLUSIVE && c == 0;
+        T acc = carries[c];
+        auto scanInto = [&](auto&& store) {
+          forEachElement(in, lo, hi, [&](const auto& v) {
+            if constexpr (INCLUSIVE) {
+              acc = fresh ? static_cast<T>(v) : op(std::move(acc), v);
+              fresh = false;
+              store(acc);
+            } else {
+              auto next = op(acc, v);
+              store(std::move(acc));
+              acc = std::move(next);
+            }
+          });
+        };
+        if (dense) {
+          auto* p = dst + lo;
+          scanInto([&](const auto& value) { *p++ = value; });
+        } else {
+          std::vector<SizeType> offsets;
+          offsets.reserve(hi - lo);
+          forEachOffset(shape, out_strides, lo, hi,
+                        [&](SizeType offset) { offsets.push_back(offset); });
+          auto it = offsets.begin();
+          scanInto([&](const auto& value) { dst[*it++] = value; });
+        }
+      },
+      {.grain = 1, .pool = &pool});
+}
+
+}  // namespace detail
+
+/**
+ * @brief op-fold of init and every element of x in memory order. op must be
+ * associative.
+ */
+template <detail::StridedStorage C, typename T, typename Op = std::plus<>>
+auto reduce(const C& x, T init, Op op = {}, const ParallelOptions& options = {})
+    -> T {
+  using Value = std::remove_cvref_t<decltype(*x.data())>;
+  const auto* data = x.data();
+  const bool dense = detail::isDense(x);
+  return detail::chunkedReduce(
+      x.size(), init, op,
+      [&](SizeType lo, SizeType hi) -> T {
+        if constexpr (simd::Vectorizable<Value> && std::is_same_v<T, Value> &&
+                      detail::IS_PLUS<Op, T>) {
+          if (dense) {
+            return simd::sum(data + lo, hi - lo,
+                             options.deterministic
+                                 ? simd::Reduction::kReproducible
+                                 : simd::Reduction::kFast);
+          }
+        }
+        bool first = true;
+        T acc = init;
+        detail::forEachElement(x, lo, hi, [&](const auto& v) {
+          acc = first ? static_cast<T>(v) : op(std::move(acc), v);
+          first = false;
+        });
+        return acc;
+      },
+      options);
+}
+
+/**
+ * @brief reduce of transform(x[i]) over every element.
+ */
+template <detail::StridedStorage C, typename T, typename ReduceOp,
+          typename TransformOp>
+auto transformReduce(const C& x, T init, ReduceOp reduce_op,
+                     TransformOp transform, const ParallelOptions& options = {})
+    -> T {
+  return detail::chunkedReduce(
+      x.size(), init, reduce_op,
+      [&](SizeType lo, SizeType hi) -> T {
+        bool first = true;
+        T acc = init;
+        detail::forEachElement(x, lo, hi, [&](const auto& v) {
+          acc = first ? static_cast<T>(transform(v))
+                      : reduce_op(std::move(acc), transform(v));
+          first = false;
+        });
+        return acc;
+      },
+      options);
+}
+
+/**
+ * @brief reduce of transform(x[i], y[i]) over every element, in the memory
+ * order of x; with plus and multiplies on operands stored alike this is a
+ * dot product on the SIMD kernels.
+ */
+template <detail::StridedStorage C, detail::StridedStorage D, typename T,
+          typename ReduceOp = std::plus<>,
+          typename TransformOp = std::multiplies<>>
+auto transformReduce(const C& x, const D& y, T init, ReduceOp reduce_op = {},
+                     TransformOp transform = {},
+                     const ParallelOptions& options = {}) -> T {
+  detail::checkSameShape(x, y);
+  using Value = std::remove_cvref_t<decltype(*x.data())>;
+  using Other = std::remove_cvref_t<decltype(*y.data())>;
+  const auto* x_data = x.data();
+  const auto* y_data = y.data();
+  const bool dense = detail::isSameDense(x, y);
+  const auto order = detail::memoryOrder<std::vector<SizeType>>(x.strides());
+  const auto shape = detail::permuted(x.shape(), order);
+  const auto y_strides = detail::permuted(y.strides(), order);
+  return detail::chunkedReduce(
+      x.size(), init, reduce_op,
+      [&](SizeType lo, SizeType hi) -> T {
+        if constexpr (simd::Vectorizable<Value> &&
+                      std::is_same_v<Value, Other> &&
+                      std::is_same_v<T, Value> &&
+                      detail::IS_PLUS<ReduceOp, T> &&
+                      detail::IS_MULTIPLIES<TransformOp, T>) {
+          if (dense) {
+            return simd::dot(x_data + lo, y_data + lo, hi - lo,
+                             options.deterministic
+                                 ? simd::Reduction::kReproducible
+                                 : simd::Reduction::kFast);
+          }
+        }
+        // gather y at the positions x visits, in x's memory order
+        std::vector<SizeType> y_offsets;
+        y_offsets.reserve(hi - lo);
+        detail::forEachOffset(shape, y_strides, lo, hi,
+                              [&](SizeType o) { y_offsets.push_back(o); });
+        bool first = true;
+        T acc = init;
+        SizeType k = 0;
+        detail::forEachElement(x, lo, hi, [&](const auto& v) {
+          auto t = transform(v, y_data[y_offsets[k++]]);
+          acc = first ? static_cast<T>(t) : reduce_op(std::move(acc), t);
+          first = false;
+        });
+        return acc;
+      },
+      options);
+}
+
+/**
+ * @brief out[i] = x[0] op ... op x[i], i counting the elements of x in memory
+ * order. out must have the shape of x and may be x itself; whatever its
+ * layout, out(index) receives the result for x(index).
+ */
+template <detail::StridedStorage C, detail::StridedStorage D,
+          typename Op = std::plus<>>
+auto inclusiveScan(const C& x, D&& out, Op op = {},
+                   const ParallelOptions& options = {}) -> void {
+  using Value = std::remove_cvref_t<decltype(*x.data())>;
+  detail::chunkedScan<true>(x, out, Value{}, op, options);
+}
+
+/**
+ * @brief out[i] = init op x[0] op ... op x[i - 1], i counting as in
+ * inclusiveScan().
+ */
+template <detail::StridedStorage C, detail::StridedStorage D, typename T,
+          typename Op = std::plus<>>
+auto exclusiveScan(const C& x, D&& out, T init, Op op = {},
+                   const ParallelOptions& options = {}) -> void {
+  detail::chunkedScan<false>(x, out, init, op, options);
+}
+
+}  // namespace fz
+
+#endif  // __FZ_PARALLEL_NUMERIC_H__
@@ -0,0 +1,403 @@
+/**
+ * @file parallel_for.hpp
+ * @brief Data-parallel loops on the work-stealing ThreadPool.
+ *
+ * Ranges are split in halves recursively down to the grain size; each half is
+ * a task that idle workers can steal, so uneven work balances itself. An N-D
+ * BlockedRange splits on its slowest dimension, so blocks stay contiguous in
+ * memory: the last one by default, as for a column-major Array, or the one
+ * of largest stride when built from an Array's strides.
+ *
+ * Schedule::kStatic instead cuts the range into one contiguous part per
+ * thread and always hands part r to the same thread, rank r of the pool.
+ * That is what keeps a loop on the memory its thread first touched on a
+ * NUMA machine (see fz/parallel/numa.hpp).
+ */
+
+#ifndef __FZ_PARALLEL_PARALLEL_FOR_H__
+#define __FZ_PARALLEL_PARALLEL_FOR_H__
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/array_base.hpp"
+#include "fz/parallel/thread_pool.hpp"
+
+namespace fz {
+
+enum class Schedule {
+  // recursive halving down to the grain, balanced by work stealing
+  kDynamic,
+  // staticPartition(): part r of concurrency() always on rank r
+  kStatic,
+};
+
+struct ParallelOptions {
+  // smallest number of elements handed to one task, 0 picks one so that
+  // every thread gets about eight tasks
+  SizeType grain = 0;
+  // nullptr means ThreadPool::global()
+  ThreadPool* pool = nullptr;
+  // reductions and scans: chunk independently of the thread count and
+  // combine in a fixed order, so results are bit-identical on any pool
+  bool deterministic = false;
+  Schedule schedule = Schedule::kDynamic;
+};
+
+/**
+ * @brief Part rank of [begin, end) cut into parts near-equal contiguous
+ * pieces, the earlier parts taking the remainder; Schedule::kStatic and
+ * NumaAllocator's first touch both cut this way.
+ */
+inline auto staticPartition(SizeType begin, SizeType end, SizeType rank,
+                            SizeType parts) -> std::pair<SizeType, SizeType> {
+  const auto n = end - begin;
+  const auto base = n / parts;
+  const auto extra = n % parts;
+  const auto lo = begin + rank * base + std::min(rank, extra);
+  return {lo, lo + base + (rank < extra ? 1 : 0)};
+}
+
+namespace detail {
+
+// Array, ArrayView, CowArray: a shape and the strides it is stored with
+template <typename A>
+concept StridedSpace = requires(const A& a) {
+  { a.shape() } -> Range;
+  { a.strides() } -> Range;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Box [begin, end) of an N-D index space, visited fastest dimension
+ * first: the first index unless the range follows an Array's strides.
+ */
+template <Range Index = std::vector<SizeType>>
+class BlockedRange {
+ public:
+  BlockedRange() = default;
+
+  // the whole of shape, first index fastest
+  explicit BlockedRange(const Index& shape);
+
+  // the whole index space of arr in memory order, e.g. BlockedRange{arr} for
+  // an Array of either layout or a transposed view
+  template <detail::StridedSpace A>
+  explicit BlockedRange(const A& arr);
+
+  BlockedRange(Index begin, Index end);
+
+  // order lists the dimensions from fastest to slowest
+  BlockedRange(Index begin, Index end, Index order);
+
+  [[nodiscard]] auto rank() const -> SizeType;
+
+  [[nodiscard]] auto begin() const -> const Index&;
+
+  [[nodiscard]] auto end() const -> const Index&;
+
+  [[nodiscard]] auto extent(SizeType dim) const -> SizeType;
+
+  [[nodiscard]] auto size() const -> SizeType;
+
+  [[nodiscard]] auto empty() const -> bool;
+
+  // the dimensions from fastest to slowest
+  [[nodiscard]] auto order() const -> const Index&;
+
+  /**
+   * @brief The slowest dimension with more than one index, where split()
+   * cuts; rank() when the range is a single point.
+   */
+  [[nodiscard]] auto splitDimension() const -> SizeType;
+
+  /**
+   * @brief Cut off and return the upper half along splitDimension().
+   */
+  auto split() -> BlockedRange;
+
+  /**
+   * @brief Call f(index) for every index in the box, fastest dimension
+   * first.
+   */
+  template <typename F>
+  auto forEach(F&& f) const -> void;
+
+ private:
+  Index _begin{};
+  Index _end{};
+  Index _order{};
+};
+
+template <Range Index>
+BlockedRange<Index>::BlockedRange(const Index& shape)
+    : _begin{shape}, _end{shape}, _order{shape} {
+  std::fill(_begin.begin(), _begin.end(), SizeType{0});
+  std::iota(_order.begin(), _order.end(), SizeType{0});
+}
+
+template <Range Index>
+template <detail::StridedSpace A>
+BlockedRange<Index>::BlockedRange(const A& arr)
+    : BlockedRange{Index{arr.shape()}} {
+  _order = detail::memoryOrder<Index>(arr.strides());
+}
+
+template <Range Index>
+BlockedRange<Index>::BlockedRange(Index begin, Index end)
+    : BlockedRange{begin, std::move(end), begin} {
+  std::iota(_order.begin(), _order.end(), SizeType{0});
+}
+
+template <Range Index>
+BlockedRange<Index>::BlockedRange(Index begin, Index end, Index order)
+    : _begin{std::move(begin)},
+      _end{std::move(end)},
+      _order{std::move(order)} {
+  if (_begin.size() != _end.size() || _begin.size() != _order.size()) {
+    throw std::invalid_argument("Rank mismatch");
+  }
+  for (SizeType d = 0; d < _begin.size(); ++d) {
+    if (_end[d] < _begin[d]) {
+      throw std::invalid_argument("Invalid range");
+    }
+  }
+}
+
+template <detail::StridedSpace A>
+BlockedRange(const A& arr)
+    -> BlockedRange<std::remove_cvref_t<decltype(arr.shape())>>;
+
+template <Range Index>
+inline auto BlockedRange<Index>::rank() const -> SizeType {
+  return _begin.size();
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::begin() const -> const Index& {
+  return _begin;
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::end() const -> const Index& {
+  return _end;
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::extent(SizeType dim) const -> SizeType {
+  return _end[dim] - _begin[dim];
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::size() const -> SizeType {
+  SizeType size = 1;
+  for (SizeType d = 0; d < rank(); ++d) {
+    size *= extent(d);
+  }
+  return size;
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::empty() const -> bool {
+  return size() == 0;
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::order() const -> const Index& {
+  return _order;
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::splitDimension() const -> SizeType {
+  for (auto k = rank(); 0 < k; --k) {
+    if (1 < extent(_order[k - 1])) {
+      return _order[k - 1];
+    }
+  }
+  return rank();
+}
+
+template <Range Index>
+inline auto BlockedRange<Index>::split() -> BlockedRange {
+  const auto dim = splitDimension();
+  if (dim == rank()) {
+    throw std::logic_error("Range cannot be split");
+  }
+  BlockedRange upper = *this;
+  const auto mid = _begin[dim] + extent(dim) / 2;
+  _end[dim] = mid;
+  upper._begin[dim] = mid;
+  return upper;
+}
+
+template <Range Index>
+template <typename F>
+auto BlockedRange<Index>::forEach(F&& f) const -> void {
+  if (empty()) {
+    return;
+  }
+  auto index = _begin;
+  const auto n = rank();
+  while (true) {
+    f(static_cast<const Index&>(index));
+    SizeType k = 0;
+    for (; k < n; ++k) {
+      const auto d = _order[k];
+      if (++index[d] < _end[d]) {
+        break;
+      }
+      index[d] = _begin[d];
+    }
+    if (k == n) {
+      return;
+    }
+  }
+}
+
+namespace detail {
+
+inline auto resolvePool(const ParallelOptions& options) -> ThreadPool& {
+  return options.pool == nullptr ? ThreadPool::global() : *options.pool;
+}
+
+inline auto resolveGrain(const ParallelOptions& options, SizeType n,
+                         const ThreadPool& pool) -> SizeType {
+  if (options.grain != 0) {
+    return options.grain;
+  }
+  return std::max<SizeType>(n / (8 * pool.concurrency()), 1);
+}
+
+template <typename F>
+auto splitRange(TaskGroup& group, SizeType begin, SizeType end, SizeType grain,
+                const F& f) -> void {
+  while (grain < end - begin) {
+    const auto mid = begin + (end - begin) / 2;
+    group.run([&group, mid, end, grain, &f]() {
+      splitRange(group, mid, end, grain, f);
+    });
+    end = mid;
+  }
+  f(begin, end);
+}
+
+template <Range Index, typename F>
+auto splitBlocked(TaskGroup& group, BlockedRange<Index> range, SizeType grain,
+                  const F& f) -> void {
+  while (grain < range.size() && range.splitDimension() != range.rank()) {
+    group.run([&group, upper = range.split(), grain, &f]() {
+      splitBlocked(group, upper, grain, f);
+    });
+  }
+  f(static_cast<const BlockedRange<Index>&>(range));
+}
+
+}  // namespace detail
+
+/**
+ * @brief Run f over [begin, end) in parallel. f is called either with a
+ * sub-range, f(lo, hi), or once per index, f(i). A static schedule ignores
+ * the grain. Returns when every call has finished and rethrows the first
+ * exception one of them threw. Safe to call from inside another parallel
+ * loop.
+ */
+template <typename F>
+auto parallelFor(SizeType begin, SizeType end, F&& f,
+                 const ParallelOptions& options = {}) -> void {
+  if (end <= begin) {
+    return;
+  }
+  auto& pool = detail::resolvePool(options);
+  const auto grain = detail::resolveGrain(options, end - begin, pool);
+
+  auto body = [&f](SizeType lo, SizeType hi) {
+    if constexpr (std::is_invocable_v<F&, SizeType, SizeType>) {
+      f(lo, hi);
+    } else {
+      for (auto i = lo; i < hi; ++i) {
+        f(i);
+      }
+    }
+  };
+  if (pool.concurrency() == 1 ||
+      (options.schedule == Schedule::kDynamic && end - begin <= grain)) {
+    body(begin, end);
+    return;
+  }
+  if (options.schedule == Schedule::kStatic) {
+    pool.broadcast([&](SizeType rank) {
+      const auto [lo, hi] =
+          staticPartition(begin, end, rank, pool.concurrency());
+      if (lo < hi) {
+        body(lo, hi);
+      }
+    });
+    return;
+  }
+
+  TaskGroup group{pool};
+  detail::splitRange(group, begin, end, grain, body);
+  group.wait();
+}
+
+/**
+ * @brief Run f(block) over disjoint blocks covering range, splitting on the
+ * slowest dimension first. The grain counts elements of the index space; a
+ * static schedule cuts the slowest dimension of extent > 1 only.
+ */
+template <Range Index, typename F>
+auto parallelFor(const BlockedRange<Index>& range, F&& f,
+                 const ParallelOptions& options = {}) -> void {
+  if (range.empty()) {
+    return;
+  }
+  auto& pool = detail::resolvePool(options);
+  const auto grain = detail::resolveGrain(options, range.size(), pool);
+  const auto dim = range.splitDimension();
+  if (pool.concurrency() == 1 || dim == range.rank() ||
+      (options.schedule == Schedule::kDynamic && range.size() <= grain)) {
+    f(range);
+    return;
+  }
+  if (options.schedule == Schedule::kStatic) {
+    pool.broadcast([&](SizeType rank) {
+      const auto [lo, hi] = staticPartition(
+          range.begin()[dim], range.end()[dim], rank, pool.concurrency());
+      if (lo < hi) {
+        auto begin = range.begin();
+        auto end = range.end();
+        begin[dim] = lo;
+        end[dim] = hi;
+        const BlockedRange<Index> part{std::move(begin), std::move(end),
+                                       range.order()};
+        f(part);
+      }
+    });
+    return;
+  }
+
+  TaskGroup group{pool};
+  detail::splitBlocked(group, range, grain, f);
+  group.wait();
+}
+
+/**
+ * @brief parallelFor over BlockedRange{arr}: the index space of arr split on
+ * its slowest dimension in memory, whatever the layout, and walked fastest
+ * dimension first by block.forEach.
+ */
+template <detail::StridedSpace A, typename F>
+auto parallelFor(const A& arr, F&& f, const ParallelOptions& options = {})
+    -> void {
+  parallelFor(BlockedRange{arr}, std::forward<F>(f), options);
+}
+
+}  // namespace fz
+
+#endif  // __FZ_PARALLEL_PARALLEL_FOR_H__
@@ -0,0 +1,328 @@
+/**
+ * @file perf_counters.hpp
+ * @brief Hardware performance counters through Linux perf_event_open.
+ *
+ * The counters are opened as one group led by cycles, so they are scheduled
+ * onto the PMU together and their ratios are consistent. Counters the CPU
+ * or the kernel refuses are left out individually; when not even cycles can
+ * be opened (no PMU in a VM, perf_event_paranoid in a container, another OS)
+ * the group is unavailable and every read is empty.
+ *
+ * Only the calling thread is counted.
+ */
+
+#ifndef __FZ_PARALLEL_PERF_COUNTERS_H__
+#define __FZ_PARALLEL_PERF_COUNTERS_H__
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "fz/array_base.hpp"
+
+namespace fz {
+
+enum class PerfEvent : std::uint8_t {
+  kCycles,
+  kInstructions,
+  kL1dMisses,
+  kLlcMisses,
+  kBranchMisses,
+  kDtlbMisses,
+};
+
+inline constexpr SizeType PERF_EVENT_COUNT = 6;
+
+inline constexpr auto perfEventName(PerfEvent event) -> std::string_view {
+  switch (event) {
+    case PerfEvent::kCycles:
+      return "cycles";
+    case PerfEvent::kInstructions:
+      return "instructions";
+    case PerfEvent::kL1dMisses:
+      return "l1d_misses";
+    case PerfEvent::kLlcMisses:
+      return "llc_misses";
+    case PerfEvent::kBranchMisses:
+      return "branch_misses";
+    case PerfEvent::kDtlbMisses:
+      return "dtlb_misses";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Counts of one measured span, scaled up when the kernel had to
+ * multiplex the group.
+ */
+class CounterSample {
+ public:
+  [[nodiscard]] auto has(PerfEvent event) const -> bool {
+    return _valid[index(event)];
+  }
+
+  // 0 when the event was not counted
+  [[nodiscard]] auto get(PerfEvent event) const -> double {
+    return _values[index(event)];
+  }
+
+  auto set(PerfEvent event, double value) -> void {
+    _values[index(event)] = value;
+    _valid[index(event)] = true;
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return !has(PerfEvent::kCycles); }
+
+  auto operator+=(const CounterSample& other) -> CounterSample& {
+    for (SizeType i = 0; i < PERF_EVENT_COUNT; ++i) {
+      _values[i] += other._values[i];
+      _valid[i] = _valid[i] || other._valid[i];
+    }
+    return *this;
+  }
+
+  // every count times factor, e.g. 1 / iterations
+  [[nodiscard]] auto scaled(double factor) const -> CounterSample {
+    auto result = *this;
+    for (auto& v : result._values) {
+      v *= factor;
+    }
+    return result;
+  }
+
+  // instructions per cycle, 0 when either is missing
+  [[nodiscard]] auto ipc() const -> double {
+    return ratio(get(PerfEvent::kInstructions), get(PerfEvent::kCycles));
+  }
+
+  [[nodiscard]] auto bytesPerCycle(double bytes) const -> double {
+    return ratio(bytes, get(PerfEvent::kCycles));
+  }
+
+  // events of one kind per thousand instructions
+  [[nodiscard]] auto perKiloInstruction(PerfEvent event) const -> double {
+    return ratio(1000.0 * get(event), get(PerfEvent::kInstructions));
+  }
+
+  /**
+   * @brief Coarse guess at what limits the measured code, from the miss
+   * rates and IPC; bytes is the data the code streamed, 0 if unknown.
+   */
+  [[nodiscard]] auto bottleneck(double bytes = 0.0) const -> std::string_view;
+
+ private:
+  static constexpr auto index(PerfEvent event) -> SizeType {
+    return static_cast<SizeType>(event);
+  }
+
+  static auto ratio(double a, double b) -> double {
+    return b <= 0.0 ? 0.0 : a / b;
+  }
+
+  std::array<double, PERF_EVENT_COUNT> _values{};
+  std::array<bool, PERF_EVENT_COUNT> _valid{};
+};
+
+inline auto CounterSample::bottleneck(double bytes) const -> std::string_view {
+  if (empty()) {
+    return "-";
+  }
+  // a cache line from DRAM for most of the data streamed
+  const auto llc_bytes = 64.0 * get(PerfEvent::kLlcMisses);
+  if ((0.0 < bytes && 0.5 * bytes < llc_bytes) ||
+      5.0 < perKiloInstruction(PerfEvent::kLlcMisses)) {
+    return "memory bandwidth";
+  }
+  if (1.0 < perKiloInstruction(PerfEvent::kDtlbMisses)) {
+    return "tlb";
+  }
+  if (5.0 < perKiloInstruction(PerfEvent::kBranchMisses)) {
+    return "branch mispredicts";
+  }
+  if (20.0 < perKiloInstruction(PerfEvent::kL1dMisses)) {
+    return "cache";
+  }
+  if (has(PerfEvent::kInstructions) && ipc() < 1.0) {
+    return "latency";
+  }
+  return "compute";
+}
+
+/**
+ * @brief A group of counters on the calling thread; not copyable, the file
+ * descriptors belong to it.
+ */
+class PerfCounters {
+ public:
+  PerfCounters();
+
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  auto operator=(const PerfCounters&) -> PerfCounters& = delete;
+
+  // false when no counter could be opened; the spans then read empty
+  [[nodiscard]] auto available() const -> bool { return 0 <= _fds[0]; }
+
+  // why the group is unavailable, empty when it is
+  [[nodiscard]] auto error() const -> const std::string& { return _error; }
+
+  [[nodiscard]] auto counting(PerfEvent event) const -> bool {
+    return 0 <= _fds[static_cast<SizeType>(event)];
+  }
+
+  // reset and start the group
+  auto start() -> void;
+
+  // stop the group and read what it counted since start()
+  auto stop() -> CounterSample;
+
+ private:
+  std::array<int, PERF_EVENT_COUNT> _fds;
+  // kernel ids, matching the values of a group read to their event
+  std::array<std::uint64_t, PERF_EVENT_COUNT> _ids{};
+  std::string _error;
+};
+
+#ifdef __linux__
+
+namespace detail {
+
+inline auto perfEventAttr(PerfEvent event) -> perf_event_attr {
+  constexpr auto cache = [](std::uint64_t id, std::uint64_t op) {
+    return id | (op << 8) |
+           (std::uint64_t{PERF_COUNT_HW_CACHE_RESULT_MISS} << 16);
+  };
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  switch (event) {
+    case PerfEvent::kCycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PerfEvent::kInstructions:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PerfEvent::kL1dMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ);
+      break;
+    case PerfEvent::kLlcMisses:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case PerfEvent::kBranchMisses:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    case PerfEvent::kDtlbMisses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config =
+          cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ);
+      break;
+  }
+  attr.disabled = 1;
+  // user space only, which is all perf_event_paranoid=2 allows
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING | PERF_FORMAT_ID;
+  return attr;
+}
+
+}  // namespace detail
+
+inline PerfCounters::PerfCounters() {
+  _fds.fill(-1);
+  for (SizeType i = 0; i < PERF_EVENT_COUNT; ++i) {
+    auto attr = detail::perfEventAttr(static_cast<PerfEvent>(i));
+    const auto fd = syscall(SYS_perf_event_open, &attr, 0, -1,
+                            i == 0 ? -1 : _fds[0], 0);
+    if (fd < 0 && i == 0) {
+      _error = std::string{"perf_event_open: "} + std::strerror(errno);
+      return;
+    }
+    _fds[i] = static_cast<int>(fd);
+    if (0 <= fd) {
+      ioctl(_fds[i], PERF_EVENT_IOC_ID, &_ids[i]);
+    }
+  }
+}
+
+inline PerfCounters::~PerfCounters() {
+  // members first, then the leader
+  for (auto i = PERF_EVENT_COUNT; 0 < i; --i) {
+    if (0 <= _fds[i - 1]) {
+      close(_fds[i - 1]);
+    }
+  }
+}
+
+inline auto PerfCounters::start() -> void {
+  if (!available()) {
+    return;
+  }
+  ioctl(_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+inline auto PerfCounters::stop() -> CounterSample {
+  CounterSample sample;
+  if (!available()) {
+    return sample;
+  }
+  ioctl(_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  // { nr, time_enabled, time_running, { value, id } * nr }
+  std::array<std::uint64_t, 3 + 2 * PERF_EVENT_COUNT> data{};
+  if (read(_fds[0], data.data(), sizeof(data)) < 0) {
+    return sample;
+  }
+  const auto nr = data[0];
+  const auto enabled = static_cast<double>(data[1]);
+  const auto running = static_cast<double>(data[2]);
+  // the group shared the PMU with others for part of the time
+  const auto scale = 0.0 < running ? enabled / running : 0.0;
+
+  for (std::uint64_t k = 0; k < nr && k < PERF_EVENT_COUNT; ++k) {
+    const auto value = data[3 + 2 * k];
+    const auto id = data[4 + 2 * k];
+    for (SizeType i = 0; i < PERF_EVENT_COUNT; ++i) {
+      if (0 <= _fds[i] && _ids[i] == id) {
+        sample.set(static_cast<PerfEvent>(i),
+                   static_cast<double>(value) * scale);
+      }
+    }
+  }
+  return sample;
+}
+
+#else
+
+inline PerfCounters::PerfCounters()
+    : _error{"performance counters need Linux perf_event_open"} {
+  _fds.fill(-1);
+}
+
+inline PerfCounters::~PerfCounters() = default;
+
+inline auto PerfCounters::start() -> void {}
+
+inline auto PerfCounters::stop() -> CounterSample { return {}; }
+
+#endif
+
+}  // namespace fz
+
+#endif  // __FZ_PARALLEL_PERF_COUNTERS_H__
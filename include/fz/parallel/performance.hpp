@@ -2,32 +2,91 @@
 #define __FZ_PARALLEL_PERFORMANCE_H__
 
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
 #include <utility>
 
+#include "fz/parallel/perf_counters.hpp"
 #include "fz/util/time.hpp"
 
 namespace fz {
 
 class Performance {
  public:
-  class ExecutionProfile {
-    using TimeDuration = decltype(std::chrono::high_resolution_clock::now() -
-                                  std::chrono::high_resolution_clock::now());
-
-    TimeDuration _duration{};
+  /**
+   * @brief Duration (and optionally hardware counters) of calls or spans,
+   * read on ClockType: steady_clock by default, TscClock for spans too short
+   * for a vDSO call per read.
+   */
+  template <typename ClockType = std::chrono::steady_clock>
+  class BasicExecutionProfile {
+   public:
+    using Clock = ClockType;
+    using TimeDuration = typename Clock::duration;
 
     [[nodiscard]] auto duration() const { return _duration; }
 
-    template <typename Func, typename... Args>
-    auto execute(Func&& func, Args&&... args) {
-      auto res =
-          measureTime(std::forward<Func>(func), std::forward<Args>(args)...);
-      if constexpr (std::is_same_v<TimeDuration, decltype(res)>) {
-        _duration = res;
-      } else {
-        _duration = std::get<0>(res);
-        return std::get<1>(res);
+    /**
+     * @brief Time a span that is not a single call. Spans accumulate until
+     * reset(), so a stop()/start() pair excludes the code between them.
+     */
+    auto start() -> void {
+      if (_perf) {
+        _perf->start();
       }
+      _start = Clock::now();
+    }
+
+    auto stop() -> void {
+      _duration += Clock::now() - _start;
+      if (_perf) {
+        _counters += _perf->stop();
+      }
+    }
+
+    auto reset() -> void {
+      _duration = TimeDuration{};
+      _counters = CounterSample{};
+    }
+
+    /**
+     * @brief Count hardware events of the calling thread alongside the
+     * duration. Returns false, and keeps timing alone, when the counters
+     * cannot be opened; countersError() tells why.
+     */
+    auto enableCounters() -> bool {
+      auto perf = std::make_shared<PerfCounters>();
+      if (!perf->available()) {
+        _counters_error = perf->error();
+        return false;
+      }
+      _perf = std::move(perf);
+      return true;
+    }
+
+    // empty unless enableCounters() succeeded
+    [[nodiscard]] auto counters() const -> const CounterSample& {
+      return _counters;
+    }
+
+    [[nodiscard]] auto countersError() const -> const std::string& {
+      return _counters_error;
+    }
+
+    /**
+     * @brief Time one call, replacing the previous measurement, and return
+     * what func returns without copying or moving it.
+     */
+    template <typename Func, typename... Args>
+    auto execute(Func&& func, Args&&... args)
+        -> std::invoke_result_t<Func, Args...> {
+      // stops after the return value is constructed in the caller
+      Span span{*this};
+      return std::invoke(std::forward<Func>(func),
+                         std::forward<Args>(args)...);
     }
 
     template <typename StringStream = std::stringstream,
@@ -58,8 +117,29 @@ class Performance {
 
       return ss.str();
     }
+
+   private:
+    struct Span {
+      explicit Span(BasicExecutionProfile& owner) : profile{owner} {
+        profile.reset();
+        profile.start();
+      }
+
+      ~Span() { profile.stop(); }
+
+      BasicExecutionProfile& profile;
+    };
+
+    TimeDuration _duration{};
+    typename Clock::time_point _start{};
+    // shared by copies, which must not count at the same time
+    std::shared_ptr<PerfCounters> _perf;
+    CounterSample _counters;
+    std::string _counters_error;
   };
 
+  using ExecutionProfile = BasicExecutionProfile<>;
+
  public:
  private:
 };
@@ -0,0 +1,471 @@
+/**
+ * @file profiler.hpp
+ * @brief Scoped instrumentation zones for whole-program profiling.
+ *
+ *   auto step() -> void {
+ *     FZ_PROFILE_SCOPE("step");
+ *     {
+ *       FZ_PROFILE_SCOPE("update_e");
+ *       ...
+ *     }
+ *   }
+ *   fz::Profiler::instance().report(std::cout);
+ *
+ * A zone reads TscClock::ticks() on entry and exit and records into a
+ * buffer owned by the calling thread without locking; Profiler::collect()
+ * drains all buffers and ticks are converted to nanoseconds on the way out.
+ * Zones nest per thread and are summarised as a call tree, or exported as
+ * Chrome trace events (chrome://tracing, ui.perfetto.dev).
+ *
+ * FZ_PROFILE_SCOPE expands to nothing unless FZ_PROFILE is defined, e.g.
+ * with the CMake option of the same name.
+ */
+
+#ifndef __FZ_PARALLEL_PROFILER_H__
+#define __FZ_PARALLEL_PROFILER_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fz/array_base.hpp"
+#include "fz/util/time.hpp"
+
+namespace fz {
+
+struct ProfileEvent {
+  // must outlive the profiler, FZ_PROFILE_SCOPE takes string literals
+  const char* name;
+  // since the profiler was created
+  std::int64_t begin_ns;
+  std::int64_t end_ns;
+  // 1 for a zone opened outside any other zone
+  std::uint32_t depth;
+  std::uint32_t thread;
+};
+
+namespace detail {
+
+// a ProfileEvent as recorded, in TscClock ticks
+struct ProfileRecord {
+  const char* name;
+  std::int64_t begin;
+  std::int64_t end;
+  std::uint32_t depth;
+  std::uint32_t thread;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Single-producer single-consumer ring of events. The owning thread
+ * pushes, the collector drains; when the collector falls behind, new events
+ * are dropped and counted.
+ */
+class ProfileBuffer {
+ public:
+  static constexpr SizeType CAPACITY = SizeType{1} << 14;
+
+  explicit ProfileBuffer(std::uint32_t thread);
+
+  [[nodiscard]] auto thread() const -> std::uint32_t { return _thread; }
+
+  // owner only: depth of the zone being opened
+  auto enter() -> std::uint32_t { return ++_depth; }
+
+  // owner only: close the innermost zone
+  auto leave(const char* name, std::int64_t begin, std::int64_t end) -> void;
+
+  // collector only: append the pending records to out
+  auto drain(std::vector<detail::ProfileRecord>& out) -> void;
+
+  [[nodiscard]] auto dropped() const -> SizeType {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+  // the owning thread has exited, the buffer goes once drained
+  auto retire() -> void { _retired.store(true, std::memory_order_release); }
+
+  [[nodiscard]] auto retired() const -> bool {
+    return _retired.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::unique_ptr<detail::ProfileRecord[]> _records;
+  std::uint32_t _thread;
+  // owner-side state, kept off the collector's cache line
+  std::uint32_t _depth{};
+  SizeType _cached_tail{};
+  alignas(64) std::atomic<SizeType> _head{0};
+  alignas(64) std::atomic<SizeType> _tail{0};
+  std::atomic<SizeType> _dropped{0};
+  std::atomic<bool> _retired{false};
+};
+
+inline ProfileBuffer::ProfileBuffer(std::uint32_t thread)
+    : _records{std::make_unique<detail::ProfileRecord[]>(CAPACITY)},
+      _thread{thread} {}
+
+inline auto ProfileBuffer::leave(const char* name, std::int64_t begin,
+                                 std::int64_t end) -> void {
+  const auto depth = _depth--;
+  const auto head = _head.load(std::memory_order_relaxed);
+  if (head - _cached_tail == CAPACITY) {
+    _cached_tail = _tail.load(std::memory_order_acquire);
+    if (head - _cached_tail == CAPACITY) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  _records[head % CAPACITY] = {name, begin, end, depth, _thread};
+  _head.store(head + 1, std::memory_order_release);
+}
+
+inline auto ProfileBuffer::drain(std::vector<detail::ProfileRecord>& out)
+    -> void {
+  const auto tail = _tail.load(std::memory_order_relaxed);
+  const auto head = _head.load(std::memory_order_acquire);
+  for (auto i = tail; i < head; ++i) {
+    out.push_back(_records[i % CAPACITY]);
+  }
+  _tail.store(head, std::memory_order_release);
+}
+
+/**
+ * @brief One node of the call tree: every zone with the same name under the
+ * same chain of parents, merged across threads.
+ */
+struct ProfileNode {
+  std::string name;
+  SizeType count{};
+  std::int64_t total_ns{};
+  // total minus the time spent in child zones
+  std::int64_t self_ns{};
+  std::int64_t p50_ns{};
+  std::int64_t p90_ns{};
+  std::int64_t p99_ns{};
+  std::vector<ProfileNode> children;
+};
+
+class Profiler {
+ public:
+  static auto instance() -> Profiler&;
+
+  // the calling thread's buffer, registered on first use
+  static auto threadBuffer() -> ProfileBuffer&;
+
+  /**
+   * @brief Move the events of every thread into the profiler. Zones still
+   * open are picked up by a later call.
+   */
+  auto collect() -> void;
+
+  // collected events in no particular order
+  [[nodiscard]] auto events() -> std::vector<ProfileEvent>;
+
+  // events lost to full buffers
+  [[nodiscard]] auto dropped() -> SizeType;
+
+  /**
+   * @brief Collect and build the call tree; the root is unnamed and holds
+   * the top-level zones as children.
+   */
+  auto summary() -> ProfileNode;
+
+  // print summary() as an indented table
+  auto report(std::ostream& os) -> void;
+
+  // collect and write Chrome trace_event JSON
+  auto writeChromeTrace(std::ostream& os) -> void;
+
+  // forget collected and pending events
+  auto clear() -> void;
+
+ private:
+  Profiler() : _origin{TscClock::ticks()} {}
+
+  auto registerThread() -> std::shared_ptr<ProfileBuffer>;
+
+  auto collectLocked() -> void;
+
+  std::mutex _mutex;
+  std::vector<std::shared_ptr<ProfileBuffer>> _buffers;
+  std::vector<detail::ProfileRecord> _records;
+  SizeType _retired_dropped{};
+  std::uint32_t _next_thread{};
+  std::int64_t _origin;
+};
+
+/**
+ * @brief RAII zone, prefer FZ_PROFILE_SCOPE which can be compiled out.
+ */
+class ProfileZone {
+ public:
+  explicit ProfileZone(const char* name)
+      : _buffer{&Profiler::threadBuffer()}, _name{name} {
+    _buffer->enter();
+    _begin = TscClock::ticks();
+  }
+
+  ~ProfileZone() { _buffer->leave(_name, _begin, TscClock::ticks()); }
+
+  ProfileZone(const ProfileZone&) = delete;
+  auto operator=(const ProfileZone&) -> ProfileZone& = delete;
+
+ private:
+  ProfileBuffer* _buffer;
+  const char* _name;
+  std::int64_t _begin{};
+};
+
+inline auto Profiler::instance() -> Profiler& {
+  static Profiler profiler;
+  return profiler;
+}
+
+inline auto Profiler::threadBuffer() -> ProfileBuffer& {
+  // the profiler keeps the buffer until its events are collected
+  struct Holder {
+    std::shared_ptr<ProfileBuffer> buffer = instance().registerThread();
+    ~Holder() { buffer->retire(); }
+  };
+  thread_local Holder holder;
+  return *holder.buffer;
+}
+
+inline auto Profiler::registerThread() -> std::shared_ptr<ProfileBuffer> {
+  std::lock_guard lock{_mutex};
+  auto buffer = std::make_shared<ProfileBuffer>(_next_thread++);
+  _buffers.push_back(buffer);
+  return buffer;
+}
+
+inline auto Profiler::collectLocked() -> void {
+  for (auto it = _buffers.begin(); it != _buffers.end();) {
+    const auto retired = (*it)->retired();
+    (*it)->drain(_records);
+    if (retired) {
+      _retired_dropped += (*it)->dropped();
+      it = _buffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+inline auto Profiler::collect() -> void {
+  std::lock_guard lock{_mutex};
+  collectLocked();
+}
+
+inline auto Profiler::events() -> std::vector<ProfileEvent> {
+  std::lock_guard lock{_mutex};
+  collectLocked();
+  auto toNs = [this](std::int64_t t) {
+    return TscClock::toDuration(t - _origin).count();
+  };
+
+  std::vector<ProfileEvent> events;
+  events.reserve(_records.size());
+  for (const auto& r : _records) {
+    events.push_back({r.name, toNs(r.begin), toNs(r.end), r.depth, r.thread});
+  }
+  return events;
+}
+
+inline auto Profiler::dropped() -> SizeType {
+  std::lock_guard lock{_mutex};
+  auto dropped = _retired_dropped;
+  for (const auto& buffer : _buffers) {
+    dropped += buffer->dropped();
+  }
+  return dropped;
+}
+
+inline auto Profiler::clear() -> void {
+  std::lock_guard lock{_mutex};
+  collectLocked();
+  _records.clear();
+  _retired_dropped = 0;
+}
+
+namespace detail {
+
+struct ProfileTreeBuilder {
+  ProfileNode node;
+  std::vector<std::int64_t> durations;
+  std::vector<std::unique_ptr<ProfileTreeBuilder>> children;
+
+  auto child(const char* name) -> ProfileTreeBuilder& {
+    for (auto& c : children) {
+      if (c->node.name == name) {
+        return *c;
+      }
+    }
+    children.push_back(std::make_unique<ProfileTreeBuilder>());
+    children.back()->node.name = name;
+    return *children.back();
+  }
+
+  auto build() -> ProfileNode {
+    std::sort(durations.begin(), durations.end());
+    auto rank = [this](double q) {
+      const auto i = static_cast<SizeType>(
+          std::ceil(q * static_cast<double>(durations.size())));
+      return durations[std::max<SizeType>(i, 1) - 1];
+    };
+    if (!durations.empty()) {
+      node.p50_ns = rank(0.5);
+      node.p90_ns = rank(0.9);
+      node.p99_ns = rank(0.99);
+    }
+    for (auto& c : children) {
+      node.children.push_back(c->build());
+    }
+    // heaviest first
+    std::stable_sort(node.children.begin(), node.children.end(),
+                     [](const auto& a, const auto& b) {
+                       return a.total_ns > b.total_ns;
+                     });
+    return std::move(node);
+  }
+};
+
+// puts back the flags and precision of a caller's stream on scope exit
+class StreamStateGuard {
+ public:
+  explicit StreamStateGuard(std::ostream& os)
+      : _os{os}, _flags{os.flags()}, _precision{os.precision()} {}
+
+  ~StreamStateGuard() {
+    _os.flags(_flags);
+    _os.precision(_precision);
+  }
+
+  StreamStateGuard(const StreamStateGuard&) = delete;
+  auto operator=(const StreamStateGuard&) -> StreamStateGuard& = delete;
+
+ private:
+  std::ostream& _os;
+  std::ios_base::fmtflags _flags;
+  std::streamsize _precision;
+};
+
+inline auto reportNode(std::ostream& os, const ProfileNode& node, int indent)
+    -> void {
+  const auto label = std::string(2 * indent, ' ') + node.name;
+  os << std::left << std::setw(36) << label << std::right << std::setw(10)
+     << node.count << std::fixed << std::setprecision(3) << std::setw(12)
+     << static_cast<double>(node.total_ns) * 1e-6 << std::setw(12)
+     << static_cast<double>(node.self_ns) * 1e-6 << std::setw(11)
+     << static_cast<double>(node.p50_ns) * 1e-3 << std::setw(11)
+     << static_cast<double>(node.p90_ns) * 1e-3 << std::setw(11)
+     << static_cast<double>(node.p99_ns) * 1e-3 << '\n';
+  for (const auto& child : node.children) {
+    reportNode(os, child, indent + 1);
+  }
+}
+
+}  // namespace detail
+
+inline auto Profiler::summary() -> ProfileNode {
+  auto events = this->events();
+  // per thread in begin order, a parent before the children it starts with
+  std::sort(events.begin(), events.end(), [](const auto& a, const auto& b) {
+    if (a.thread != b.thread) {
+      return a.thread < b.thread;
+    }
+    if (a.begin_ns != b.begin_ns) {
+      return a.begin_ns < b.begin_ns;
+    }
+    return a.depth < b.depth;
+  });
+
+  detail::ProfileTreeBuilder root;
+  // open ancestors with their depths; a recorded zone's depth need not be
+  // one more than its parent's, as the zones between may not be recorded
+  std::vector<std::pair<std::uint32_t, detail::ProfileTreeBuilder*>> stack;
+  std::uint32_t thread = 0;
+  for (const auto& event : events) {
+    if (event.thread != thread) {
+      stack.clear();
+      thread = event.thread;
+    }
+    // the parent is the latest zone further up; if it is missing (still
+    // open, or dropped) the zone hangs off the nearest ancestor recorded
+    while (!stack.empty() && event.depth <= stack.back().first) {
+      stack.pop_back();
+    }
+    auto* parent = stack.empty() ? &root : stack.back().second;
+    auto& builder = parent->child(event.name);
+    const auto duration = event.end_ns - event.begin_ns;
+    builder.node.count += 1;
+    builder.node.total_ns += duration;
+    builder.node.self_ns += duration;
+    builder.durations.push_back(duration);
+    if (parent != &root) {
+      parent->node.self_ns -= duration;
+    }
+    stack.emplace_back(event.depth, &builder);
+  }
+  return root.build();
+}
+
+inline auto Profiler::report(std::ostream& os) -> void {
+  const auto root = summary();
+  const detail::StreamStateGuard guard{os};
+  os << std::left << std::setw(36) << "zone" << std::right << std::setw(10)
+     << "count" << std::setw(12) << "total ms" << std::setw(12) << "self ms"
+     << std::setw(11) << "p50 us" << std::setw(11) << "p90 us"
+     << std::setw(11) << "p99 us" << '\n';
+  for (const auto& child : root.children) {
+    detail::reportNode(os, child, 0);
+  }
+  if (const auto lost = dropped(); lost != 0) {
+    os << lost << " zones dropped, collect more often\n";
+  }
+}
+
+inline auto Profiler::writeChromeTrace(std::ostream& os) -> void {
+  const auto events = this->events();
+  const detail::StreamStateGuard guard{os};
+  os << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  const char* separator = "\n";
+  os << std::fixed << std::setprecision(3);
+  for (const auto& event : events) {
+    // complete events, timestamps in microseconds
+    os << separator << "  {\"name\": \"" << event.name
+       << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+       << ", \"ts\": " << static_cast<double>(event.begin_ns) * 1e-3
+       << ", \"dur\": "
+       << static_cast<double>(event.end_ns - event.begin_ns) * 1e-3 << "}";
+    separator = ",\n";
+  }
+  os << "\n]}\n";
+}
+
+}  // namespace fz
+
+#define FZ_PROFILE_CONCAT_IMPL(a, b) a##b
+#define FZ_PROFILE_CONCAT(a, b) FZ_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef FZ_PROFILE
+/**
+ * @brief Time the rest of the enclosing block as a zone named name, a string
+ * literal.
+ */
+#define FZ_PROFILE_SCOPE(name) \
+  ::fz::ProfileZone FZ_PROFILE_CONCAT(fz_profile_zone_, __LINE__) { name }
+#else
+#define FZ_PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
+
+#endif  // __FZ_PARALLEL_PROFILER_H__
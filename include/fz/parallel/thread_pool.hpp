@@ -0,0 +1,589 @@
+/**
+ * @file thread_pool.hpp
+ * @brief Work-stealing thread pool.
+ *
+ * Every worker owns a Chase-Lev deque: it pushes and pops work at the bottom
+ * while idle workers steal from the top. Threads outside the pool submit
+ * through a shared injection queue. A thread waiting on a TaskGroup runs
+ * pending tasks instead of blocking, which keeps nested parallelism from
+ * deadlocking. broadcast() bypasses stealing and runs a call on every
+ * thread, for work that has to stay on a fixed thread such as NUMA first
+ * touch.
+ */
+
+#ifndef __FZ_PARALLEL_THREAD_POOL_H__
+#define __FZ_PARALLEL_THREAD_POOL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fz/array_base.hpp"
+
+namespace fz {
+
+class Task {
+ public:
+  virtual ~Task() = default;
+
+  // runs the task; the task may delete itself
+  virtual auto execute() -> void = 0;
+};
+
+/**
+ * @brief Chase-Lev deque (Le et al., "Correct and efficient work-stealing for
+ * weak memory models", PPoPP 2013). push and pop belong to the owning thread,
+ * steal may be called from any thread. The ring grows on demand; replaced
+ * rings are retired until the deque dies since a thief may still read them.
+ */
+template <typename T>
+class WorkStealingDeque {
+ public:
+  explicit WorkStealingDeque(std::int64_t capacity = 256);
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+
+  auto operator=(const WorkStealingDeque&) -> WorkStealingDeque& = delete;
+
+  ~WorkStealingDeque() = default;
+
+  auto push(T item) -> void;
+
+  // T{} when empty
+  auto pop() -> T;
+
+  // T{} when empty or when another thread won the race
+  auto steal() -> T;
+
+  [[nodiscard]] auto empty() const -> bool;
+
+ private:
+  struct Ring {
+    std::int64_t capacity;
+    std::unique_ptr<std::atomic<T>[]> items;
+
+    explicit Ring(std::int64_t capacity)
+        : capacity{capacity}, items{new std::atomic<T>[capacity]} {}
+
+    auto get(std::int64_t i) const -> T {
+      return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    auto put(std::int64_t i, T item) -> void {
+      items[i & (capacity - 1)].store(item, std::memory_order_relaxed);
+    }
+  };
+
+  alignas(64) std::atomic<std::int64_t> _top{0};
+  alignas(64) std::atomic<std::int64_t> _bottom{0};
+  alignas(64) std::atomic<Ring*> _ring;
+  std::vector<std::unique_ptr<Ring>> _rings;
+};
+
+template <typename T>
+WorkStealingDeque<T>::WorkStealingDeque(std::int64_t capacity) {
+  _rings.emplace_back(std::make_unique<Ring>(std::bit_ceil(
+      static_cast<std::uint64_t>(std::max<std::int64_t>(capacity, 2)))));
+  _ring.store(_rings.back().get(), std::memory_order_relaxed);
+}
+
+template <typename T>
+auto WorkStealingDeque<T>::push(T item) -> void {
+  auto b = _bottom.load(std::memory_order_relaxed);
+  auto t = _top.load(std::memory_order_acquire);
+  auto* ring = _ring.load(std::memory_order_relaxed);
+  if (ring->capacity - 1 < b - t) {
+    auto grown = std::make_unique<Ring>(ring->capacity * 2);
+    for (auto i = t; i < b; ++i) {
+      grown->put(i, ring->get(i));
+    }
+    _rings.emplace_back(std::move(grown));
+    ring = _rings.back().get();
+    _ring.store(ring, std::memory_order_release);
+  }
+  ring->put(b, item);
+  _bottom.store(b + 1, std::memory_order_release);
+}
+
+template <typename T>
+auto WorkStealingDeque<T>::pop() -> T {
+  auto b = _bottom.load(std::memory_order_relaxed) - 1;
+  auto* ring = _ring.load(std::memory_order_relaxed);
+  _bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto t = _top.load(std::memory_order_relaxed);
+  if (b < t) {
+    _bottom.store(b + 1, std::memory_order_relaxed);
+    return T{};
+  }
+
+  auto item = ring->get(b);
+  if (t == b) {
+    // last item: race the thieves for it
+    if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      item = T{};
+    }
+    _bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return item;
+}
+
+template <typename T>
+auto WorkStealingDeque<T>::steal() -> T {
+  auto t = _top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto b = _bottom.load(std::memory_order_acquire);
+  if (b <= t) {
+    return T{};
+  }
+
+  auto* ring = _ring.load(std::memory_order_acquire);
+  auto item = ring->get(t);
+  if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return T{};
+  }
+  return item;
+}
+
+template <typename T>
+auto WorkStealingDeque<T>::empty() const -> bool {
+  return _bottom.load(std::memory_order_relaxed) <=
+         _top.load(std::memory_order_relaxed);
+}
+
+class TaskGroup;
+
+class ThreadPool {
+ public:
+  /**
+   * @brief A pool of concurrency threads counting the caller: concurrency - 1
+   * workers are started and the thread waiting on a TaskGroup makes up the
+   * rest. ThreadPool{1} runs everything on the caller.
+   */
+  explicit ThreadPool(SizeType concurrency = defaultConcurrency());
+
+  ThreadPool(const ThreadPool&) = delete;
+
+  auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+  ~ThreadPool();
+
+  [[nodiscard]] auto concurrency() const -> SizeType;
+
+  /**
+   * @brief Queue a task: on the calling worker's own deque, or on the shared
+   * injection queue from outside the pool.
+   */
+  auto submit(Task* task) -> void;
+
+  /**
+   * @brief Run queued tasks on the calling thread until done() holds.
+   */
+  template <typename Predicate>
+  auto helpUntil(Predicate done) -> void;
+
+  /**
+   * @brief Call f(rank) once on every thread of the pool and wait for all of
+   * them: rank 0 is the caller, rank i + 1 worker i, so a rank always maps
+   * to the same thread. Rethrows the first exception. Called from inside
+   * the pool, the ranks run one after another on the calling thread.
+   */
+  template <typename F>
+  auto broadcast(F&& f) -> void;
+
+  // FZ_NUM_THREADS if set, otherwise the hardware concurrency
+  static auto defaultConcurrency() -> SizeType;
+
+  // the pool parallelFor and friends use when none is given
+  static auto global() -> ThreadPool&;
+
+  /**
+   * @brief Replace the global pool. No parallel work may be running on the
+   * old one.
+   */
+  static auto setGlobalConcurrency(SizeType concurrency) -> void;
+
+  // index of the calling thread among this pool's workers, or -1
+  [[nodiscard]] auto workerIndex() const -> std::int64_t;
+
+ private:
+  struct Worker {
+    WorkStealingDeque<Task*> deque;
+    // a broadcast task only this worker may run
+    std::atomic<Task*> pinned{nullptr};
+    std::thread thread;
+  };
+
+  template <typename F>
+  class BroadcastTask : public Task {
+   public:
+    BroadcastTask(F& f, SizeType rank, std::atomic<SizeType>& pending,
+                  std::exception_ptr& error, std::mutex& error_mutex)
+        : _f{f},
+          _rank{rank},
+          _pending{pending},
+          _error{error},
+          _error_mutex{error_mutex} {}
+
+    auto execute() -> void override {
+      try {
+        _f(_rank);
+      } catch (...) {
+        std::lock_guard lock{_error_mutex};
+        if (!_error) {
+          _error = std::current_exception();
+        }
+      }
+      _pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+   private:
+    F& _f;
+    SizeType _rank;
+    std::atomic<SizeType>& _pending;
+    std::exception_ptr& _error;
+    std::mutex& _error_mutex;
+  };
+
+  struct WorkerContext {
+    const ThreadPool* pool;
+    std::int64_t index;
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::mutex _injection_mutex;
+  std::deque<Task*> _injection;
+  std::atomic<SizeType> _injected{0};
+  // one broadcast at a time owns the pinned slots
+  std::mutex _broadcast_mutex;
+
+  std::mutex _sleep_mutex;
+  std::condition_variable _sleep_cv;
+  std::atomic<std::uint64_t> _epoch{0};
+  std::atomic<SizeType> _sleeping{0};
+  std::atomic<bool> _stop{false};
+
+  static auto context() -> WorkerContext&;
+
+  static auto globalStorage() -> std::unique_ptr<ThreadPool>&;
+
+  auto run(std::int64_t index) -> void;
+
+  // any runnable task for the calling thread, nullptr if none was found
+  auto findTask(std::int64_t index) -> Task*;
+
+  auto wake() -> void;
+};
+
+/**
+ * @brief Fork-join scope: run() spawns tasks onto a pool and wait() blocks,
+ * helping with queued work, until all of them have finished. The first
+ * exception thrown by a task is rethrown from wait().
+ */
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool& pool = ThreadPool::global());
+
+  TaskGroup(const TaskGroup&) = delete;
+
+  auto operator=(const TaskGroup&) -> TaskGroup& = delete;
+
+  ~TaskGroup();
+
+  template <typename F>
+  auto run(F&& f) -> void;
+
+  auto wait() -> void;
+
+  [[nodiscard]] auto pool() const -> ThreadPool&;
+
+ private:
+  template <typename F>
+  class FunctionTask : public Task {
+   public:
+    FunctionTask(TaskGroup& group, F f) : _group{group}, _f{std::move(f)} {}
+
+    auto execute() -> void override {
+      auto& group = _group;
+      try {
+        _f();
+      } catch (...) {
+        group.fail(std::current_exception());
+      }
+      delete this;
+      group._pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+   private:
+    TaskGroup& _group;
+    F _f;
+  };
+
+  ThreadPool& _pool;
+  std::atomic<SizeType> _pending{0};
+  std::atomic<bool> _failed{false};
+  std::exception_ptr _error;
+
+  auto fail(std::exception_ptr error) -> void;
+};
+
+inline ThreadPool::ThreadPool(SizeType concurrency) {
+  const auto workers = std::max<SizeType>(concurrency, 1) - 1;
+  _workers.reserve(workers);
+  for (SizeType i = 0; i < workers; ++i) {
+    _workers.emplace_back(std::make_unique<Worker>());
+  }
+  // start only once every deque exists, thieves index into all of them
+  for (SizeType i = 0; i < workers; ++i) {
+    _workers[i]->thread =
+        std::thread{[this, i]() { run(static_cast<std::int64_t>(i)); }};
+  }
+}
+
+inline ThreadPool::~ThreadPool() {
+  _stop.store(true, std::memory_order_seq_cst);
+  {
+    std::lock_guard lock{_sleep_mutex};
+    _epoch.fetch_add(1, std::memory_order_seq_cst);
+  }
+  _sleep_cv.notify_all();
+  for (auto& worker : _workers) {
+    worker->thread.join();
+  }
+}
+
+inline auto ThreadPool::concurrency() const -> SizeType {
+  return _workers.size() + 1;
+}
+
+inline auto ThreadPool::context() -> WorkerContext& {
+  thread_local WorkerContext ctx{nullptr, -1};
+  return ctx;
+}
+
+inline auto ThreadPool::workerIndex() const -> std::int64_t {
+  const auto& ctx = context();
+  return ctx.pool == this ? ctx.index : -1;
+}
+
+inline auto ThreadPool::defaultConcurrency() -> SizeType {
+  if (const char* env = std::getenv("FZ_NUM_THREADS"); env != nullptr) {
+    if (auto n = std::strtoull(env, nullptr, 10); 0 < n) {
+      return static_cast<SizeType>(n);
+    }
+  }
+  return std::max<SizeType>(std::thread::hardware_concurrency(), 1);
+}
+
+inline auto ThreadPool::globalStorage() -> std::unique_ptr<ThreadPool>& {
+  static std::unique_ptr<ThreadPool> pool = std::make_unique<ThreadPool>();
+  return pool;
+}
+
+inline auto ThreadPool::global() -> ThreadPool& { return *globalStorage(); }
+
+inline auto ThreadPool::setGlobalConcurrency(SizeType concurrency) -> void {
+  auto& pool = globalStorage();
+  if (pool->concurrency() != concurrency) {
+    pool.reset();
+    pool = std::make_unique<ThreadPool>(concurrency);
+  }
+}
+
+inline auto ThreadPool::submit(Task* task) -> void {
+  if (auto index = workerIndex(); 0 <= index) {
+    _workers[index]->deque.push(task);
+  } else {
+    std::lock_guard lock{_injection_mutex};
+    _injection.push_back(task);
+    _injected.fetch_add(1, std::memory_order_release);
+  }
+  wake();
+}
+
+// Dekker-style handshake with the sleeping side in run(): either the worker
+// sees the new epoch before it waits, or we see it sleeping and notify.
+inline auto ThreadPool::wake() -> void {
+  _epoch.fetch_add(1, std::memory_order_seq_cst);
+  if (_sleeping.load(std::memory_order_seq_cst) != 0) {
+    { std::lock_guard lock{_sleep_mutex}; }
+    _sleep_cv.notify_all();
+  }
+}
+
+inline auto ThreadPool::findTask(std::int64_t index) -> Task* {
+  if (0 <= index) {
+    auto& pinned = _workers[index]->pinned;
+    if (pinned.load(std::memory_order_relaxed) != nullptr) {
+      if (auto* task = pinned.exchange(nullptr, std::memory_order_acquire);
+          task != nullptr) {
+        return task;
+      }
+    }
+    if (auto* task = _workers[index]->deque.pop(); task != nullptr) {
+      return task;
+    }
+  }
+
+  if (_injected.load(std::memory_order_acquire) != 0) {
+    std::lock_guard lock{_injection_mutex};
+    if (!_injection.empty()) {
+      auto* task = _injection.front();
+      _injection.pop_front();
+      _injected.fetch_sub(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+
+  // steal, starting from a per-thread pseudo-random victim
+  const auto n = _workers.size();
+  if (n == 0) {
+    return nullptr;
+  }
+  thread_local std::uint64_t seed =
+      std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  const auto start = static_cast<SizeType>(seed % n);
+  for (SizeType k = 0; k < n; ++k) {
+    const auto victim = (start + k) % n;
+    if (static_cast<std::int64_t>(victim) == index) {
+      continue;
+    }
+    if (auto* task = _workers[victim]->deque.steal(); task != nullptr) {
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+inline auto ThreadPool::run(std::int64_t index) -> void {
+  context() = {this, index};
+  constexpr int SPINS = 64;
+  while (!_stop.load(std::memory_order_acquire)) {
+    auto epoch = _epoch.load(std::memory_order_seq_cst);
+    Task* task = nullptr;
+    for (int spin = 0; spin < SPINS && task == nullptr; ++spin) {
+      task = findTask(index);
+      if (task == nullptr) {
+        std::this_thread::yield();
+      }
+    }
+    if (task != nullptr) {
+      task->execute();
+      continue;
+    }
+
+    std::unique_lock lock{_sleep_mutex};
+    _sleeping.fetch_add(1, std::memory_order_seq_cst);
+    _sleep_cv.wait(lock, [&]() {
+      return _stop.load(std::memory_order_acquire) ||
+             _epoch.load(std::memory_order_seq_cst) != epoch;
+    });
+    _sleeping.fetch_sub(1, std::memory_order_seq_cst);
+  }
+}
+
+template <typename Predicate>
+auto ThreadPool::helpUntil(Predicate done) -> void {
+  const auto index = workerIndex();
+  while (!done()) {
+    if (auto* task = findTask(index); task != nullptr) {
+      task->execute();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+template <typename F>
+auto ThreadPool::broadcast(F&& f) -> void {
+  if (_workers.empty() || 0 <= workerIndex()) {
+    for (SizeType rank = 0; rank < concurrency(); ++rank) {
+      f(rank);
+    }
+    return;
+  }
+
+  std::lock_guard lock{_broadcast_mutex};
+  std::atomic<SizeType> pending{concurrency()};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  std::vector<BroadcastTask<std::remove_reference_t<F>>> tasks;
+  tasks.reserve(_workers.size());
+  for (SizeType i = 0; i < _workers.size(); ++i) {
+    tasks.emplace_back(f, i + 1, pending, error, error_mutex);
+    _workers[i]->pinned.store(&tasks.back(), std::memory_order_release);
+  }
+  wake();
+
+  BroadcastTask<std::remove_reference_t<F>>{f, 0, pending, error, error_mutex}
+      .execute();
+  // no helping with other tasks here: one of them may broadcast as well
+  while (pending.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+inline TaskGroup::TaskGroup(ThreadPool& pool) : _pool{pool} {}
+
+inline TaskGroup::~TaskGroup() {
+  // never leave tasks behind that point at this group
+  _pool.helpUntil(
+      [this]() { return _pending.load(std::memory_order_acquire) == 0; });
+}
+
+template <typename F>
+auto TaskGroup::run(F&& f) -> void {
+  if (_pool.concurrency() == 1) {
+    try {
+      f();
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    return;
+  }
+  _pending.fetch_add(1, std::memory_order_relaxed);
+  _pool.submit(new FunctionTask<std::decay_t<F>>{*this, std::forward<F>(f)});
+}
+
+inline auto TaskGroup::wait() -> void {
+  _pool.helpUntil(
+      [this]() { return _pending.load(std::memory_order_acquire) == 0; });
+  if (_failed.load(std::memory_order_acquire)) {
+    _failed.store(false, std::memory_order_relaxed);
+    std::rethrow_exception(std::exchange(_error, nullptr));
+  }
+}
+
+inline auto TaskGroup::pool() const -> ThreadPool& { return _pool; }
+
+inline auto TaskGroup::fail(std::exception_ptr error) -> void {
+  bool expected = false;
+  if (_failed.compare_exchange_strong(expected, true,
+                                      std::memory_order_acq_rel)) {
+    _error = std::move(error);
+  }
+}
+
+}  // namespace fz
+
+#endif  // __FZ_PARALLEL_THREAD_POOL_H__
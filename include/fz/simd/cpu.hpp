@@ -0,0 +1,128 @@
+#ifndef __FZ_SIMD_CPU_H__
+#define __FZ_SIMD_CPU_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FZ_SIMD_X86 1
+#include <cpuid.h>
+#endif
+
+namespace fz::simd {
+
+// ordered: every level implies the ones below it
+enum class Isa { kScalar = 0, kSse2 = 1, kAvx2 = 2, kAvx512 = 3 };
+
+inline auto isaName(Isa isa) -> std::string_view {
+  switch (isa) {
+    case Isa::kSse2:
+      return "sse2";
+    case Isa::kAvx2:
+      return "avx2";
+    case Isa::kAvx512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+namespace detail {
+
+inline auto cpuidIsa() -> Isa {
+#ifdef FZ_SIMD_X86
+  unsigned eax = 0;
+  unsigned ebx = 0;
+  unsigned ecx = 0;
+  unsigned edx = 0;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+    return Isa::kScalar;
+  }
+  const bool sse2 = (edx & (1U << 26)) != 0;
+  const bool osxsave = (ecx & (1U << 27)) != 0;
+  const bool avx = (ecx & (1U << 28)) != 0;
+  const bool fma = (ecx & (1U << 12)) != 0;
+  if (!sse2) {
+    return Isa::kScalar;
+  }
+  if (!osxsave || !avx) {
+    return Isa::kSse2;
+  }
+
+  // the OS must save the wider registers on context switch
+  unsigned xcr0_lo = 0;
+  unsigned xcr0_hi = 0;
+  __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  const bool os_ymm = (xcr0_lo & 0x6U) == 0x6U;
+  const bool os_zmm = (xcr0_lo & 0xE6U) == 0xE6U;
+
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0) {
+    return Isa::kSse2;
+  }
+  const bool avx2 = (ebx & (1U << 5)) != 0;
+  const bool avx512f = (ebx & (1U << 16)) != 0;
+  if (avx512f && os_zmm) {
+    return Isa::kAvx512;
+  }
+  if (avx2 && fma && os_ymm) {
+    return Isa::kAvx2;
+  }
+  return Isa::kSse2;
+#else
+  return Isa::kScalar;
+#endif
+}
+
+inline auto activeIsaStorage() -> std::atomic<Isa> &;
+
+}  // namespace detail
+
+/**
+ * @brief The best instruction set this CPU and OS support, probed once via
+ * CPUID. FZ_SIMD_ISA=scalar|sse2|avx2|avx512 caps it, e.g. to reproduce a
+ * result from an older machine.
+ */
+inline auto detectedIsa() -> Isa {
+  static const Isa isa = [] {
+    auto isa = detail::cpuidIsa();
+    if (const char *env = std::getenv("FZ_SIMD_ISA"); env != nullptr) {
+      for (auto cap : {Isa::kScalar, Isa::kSse2, Isa::kAvx2, Isa::kAvx512}) {
+        if (isaName(cap) == env && cap < isa) {
+          isa = cap;
+        }
+      }
+    }
+    return isa;
+  }();
+  return isa;
+}
+
+/**
+ * @brief The instruction set kernels currently dispatch to.
+ */
+inline auto activeIsa() -> Isa {
+  return detail::activeIsaStorage().load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Switch kernels to another instruction set, clamped to what the CPU
+ * supports. Returns the instruction set actually selected.
+ */
+inline auto setActiveIsa(Isa isa) -> Isa {
+  if (detectedIsa() < isa) {
+    isa = detectedIsa();
+  }
+  detail::activeIsaStorage().store(isa, std::memory_order_relaxed);
+  return isa;
+}
+
+inline auto detail::activeIsaStorage() -> std::atomic<Isa> & {
+  static std::atomic<Isa> isa{detectedIsa()};
+  return isa;
+}
+
+}  // namespace fz::simd
+
+#endif  // __FZ_SIMD_CPU_H__
@@ -0,0 +1,302 @@
+/**
+ * @file kernels.hpp
+ * @brief Per-instruction-set builds of the kernels in kernels.inl.
+ *
+ * Each instruction set gets its own namespace compiled under a target
+ * region, so one binary carries all of them and simd.hpp picks one at run
+ * time. Floating-point contraction is disabled throughout: the fast kernels
+ * ask for FMA explicitly and the reproducible ones must not get it.
+ */
+
+#ifndef __FZ_SIMD_KERNELS_H__
+#define __FZ_SIMD_KERNELS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fz/array_base.hpp"
+#include "fz/simd/cpu.hpp"
+
+#ifdef FZ_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace fz::simd {
+
+// logical lanes of the reproducible reductions: one 64-byte register
+template <typename T>
+inline constexpr SizeType REPRODUCIBLE_LANES = 64 / sizeof(T);
+
+// rows sliceDot works on at once: the C of a SELL-C-sigma sparse matrix
+inline constexpr SizeType SLICE_ROWS = 16;
+
+template <typename T>
+struct KernelTable {
+  void (*fill)(T *, SizeType, T);
+  void (*copy)(const T *, SizeType, T *);
+  void (*axpy)(SizeType, T, const T *, T *);
+  void (*scale)(T *, SizeType, T);
+  T (*sum)(const T *, SizeType);
+  T (*dot)(const T *, const T *, SizeType);
+  T (*min)(const T *, SizeType);
+  T (*max)(const T *, SizeType);
+  void (*sum_lanes)(const T *, SizeType, T *);
+  void (*dot_lanes)(const T *, const T *, SizeType, T *);
+  void (*gather_dot)(const T *, const std::int32_t *, const SizeType *,
+                     SizeType, const T *, T *);
+  void (*slice_dot)(const T *, const std::int32_t *, SizeType, const T *,
+                    T *);
+  void (*gather_axpy)(const T *, const std::int32_t *, SizeType, SizeType,
+                      const T *, SizeType, SizeType, T *);
+};
+
+}  // namespace fz::simd
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace fz::simd::detail {
+
+// pairwise combine of the logical lanes, then the tail in order
+template <typename T>
+inline auto combineLanes(T *lanes, const T *tail, const T *tail_other,
+                         SizeType tail_size) -> T {
+  for (SizeType width = REPRODUCIBLE_LANES<T> / 2; 0 < width; width /= 2) {
+    for (SizeType l = 0; l < width; ++l) {
+      lanes[l] = lanes[l] + lanes[l + width];
+    }
+  }
+
+  T result = lanes[0];
+  for (SizeType i = 0; i < tail_size; ++i) {
+    result = tail_other == nullptr ? result + tail[i]
+                                   : result + tail[i] * tail_other[i];
+  }
+  return result;
+}
+
+}  // namespace fz::simd::detail
+
+namespace fz::simd::detail::scalar {
+
+template <typename T>
+struct Vec {
+  using Reg = T;
+  static constexpr SizeType LANES = 1;
+
+  static auto zero() -> Reg { return T{}; }
+  static auto set1(T v) -> Reg { return v; }
+  static auto loadu(const T *p) -> Reg { return *p; }
+  static auto gather(const T *base, const std::int32_t *index) -> Reg {
+    return base[*index];
+  }
+  static auto storeu(T *p, Reg v) -> void { *p = v; }
+  static auto add(Reg a, Reg b) -> Reg { return a + b; }
+  static auto mul(Reg a, Reg b) -> Reg { return a * b; }
+  static auto fmadd(Reg a, Reg b, Reg c) -> Reg { return a * b + c; }
+  static auto min(Reg a, Reg b) -> Reg { return b < a ? b : a; }
+  static auto max(Reg a, Reg b) -> Reg { return a < b ? b : a; }
+};
+
+#include "fz/simd/kernels.inl"
+
+}  // namespace fz::simd::detail::scalar
+
+#ifdef FZ_SIMD_X86
+
+// SSE2 is part of x86-64, no target switch needed
+namespace fz::simd::detail::sse2 {
+
+template <typename T>
+struct Vec;
+
+template <>
+struct Vec<double> {
+  using Reg = __m128d;
+  static constexpr SizeType LANES = 2;
+
+  static auto zero() -> Reg { return _mm_setzero_pd(); }
+  static auto set1(double v) -> Reg { return _mm_set1_pd(v); }
+  static auto loadu(const double *p) -> Reg { return _mm_loadu_pd(p); }
+  static auto gather(const double *base, const std::int32_t *index) -> Reg {
+    return _mm_set_pd(base[index[1]], base[index[0]]);
+  }
+  static auto storeu(double *p, Reg v) -> void { _mm_storeu_pd(p, v); }
+  static auto add(Reg a, Reg b) -> Reg { return _mm_add_pd(a, b); }
+  static auto mul(Reg a, Reg b) -> Reg { return _mm_mul_pd(a, b); }
+  static auto fmadd(Reg a, Reg b, Reg c) -> Reg {
+    return _mm_add_pd(_mm_mul_pd(a, b), c);
+  }
+  static auto min(Reg a, Reg b) -> Reg { return _mm_min_pd(a, b); }
+  static auto max(Reg a, Reg b) -> Reg { return _mm_max_pd(a, b); }
+};
+
+template <>
+struct Vec<float> {
+  using Reg = __m128;
+  static constexpr SizeType LANES = 4;
+
+  static auto zero() -> Reg { return _mm_setzero_ps(); }
+  static auto set1(float v) -> Reg { return _mm_set1_ps(v); }
+  static auto loadu(const float *p) -> Reg { return _mm_loadu_ps(p); }
+  static auto gather(const float *base, const std::int32_t *index) -> Reg {
+    return _mm_set_ps(base[index[3]], base[index[2]], base[index[1]],
+                      base[index[0]]);
+  }
+  static auto storeu(float *p, Reg v) -> void { _mm_storeu_ps(p, v); }
+  static auto add(Reg a, Reg b) -> Reg { return _mm_add_ps(a, b); }
+  static auto mul(Reg a, Reg b) -> Reg { return _mm_mul_ps(a, b); }
+  static auto fmadd(Reg a, Reg b, Reg c) -> Reg {
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+  }
+  static auto min(Reg a, Reg b) -> Reg { return _mm_min_ps(a, b); }
+  static auto max(Reg a, Reg b) -> Reg { return _mm_max_ps(a, b); }
+};
+
+#include "fz/simd/kernels.inl"
+
+}  // namespace fz::simd::detail::sse2
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+namespace fz::simd::detail::avx2 {
+
+template <typename T>
+struct Vec;
+
+template <>
+struct Vec<double> {
+  using Reg = __m256d;
+  static constexpr SizeType LANES = 4;
+
+  static auto zero() -> Reg { return _mm256_setzero_pd(); }
+  static auto set1(double v) -> Reg { return _mm256_set1_pd(v); }
+  static auto loadu(const double *p) -> Reg { return _mm256_loadu_pd(p); }
+  static auto gather(const double *base, const std::int32_t *index) -> Reg {
+    return _mm256_i32gather_pd(
+        base, _mm_loadu_si128(reinterpret_cast<const __m128i *>(index)), 8);
+  }
+  static auto storeu(double *p, Reg v) -> void { _mm256_storeu_pd(p, v); }
+  static auto add(Reg a, Reg b) -> Reg { return _mm256_add_pd(a, b); }
+  static auto mul(Reg a, Reg b) -> Reg { return _mm256_mul_pd(a, b); }
+  static auto fmadd(Reg a, Reg b, Reg c) -> Reg {
+    return _mm256_fmadd_pd(a, b, c);
+  }
+  static auto min(Reg a, Reg b) -> Reg { return _mm256_min_pd(a, b); }
+  static auto max(Reg a, Reg b) -> Reg { return _mm256_max_pd(a, b); }
+};
+
+template <>
+struct Vec<float> {
+  using Reg = __m256;
+  static constexpr SizeType LANES = 8;
+
+  static auto zero() -> Reg { return _mm256_setzero_ps(); }
+  static auto set1(float v) -> Reg { return _mm256_set1_ps(v); }
+  static auto loadu(const float *p) -> Reg { return _mm256_loadu_ps(p); }
+  static auto gather(const float *base, const std::int32_t *index) -> Reg {
+    return _mm256_i32gather_ps(
+        base, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(index)),
+        4);
+  }
+  static auto storeu(float *p, Reg v) -> void { _mm256_storeu_ps(p, v); }
+  static auto add(Reg a, Reg b) -> Reg { return _mm256_add_ps(a, b); }
+  static auto mul(Reg a, Reg b) -> Reg { return _mm256_mul_ps(a, b); }
+  static auto fmadd(Reg a, Reg b, Reg c) -> Reg {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  static auto min(Reg a, Reg b) -> Reg { return _mm256_min_ps(a, b); }
+  static auto max(Reg a, Reg b) -> Reg { return _mm256_max_ps(a, b); }
+};
+
+#include "fz/simd/kernels.inl"
+
+}  // namespace fz::simd::detail::avx2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push(__attribute__((target("avx512f"))), \
+                             apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+namespace fz::simd::detail::avx512 {
+
+template <typename T>
+struct Vec;
+
+template <>
+struct Vec<double> {
+  using Reg = __m512d;
+  static constexpr SizeType LANES = 8;
+
+  static auto zero() -> Reg { return _mm512_setzero_pd(); }
+  static auto set1(double v) -> Reg { return _mm512_set1_pd(v); }
+  static auto loadu(const double *p) -> Reg { return _mm512_loadu_pd(p); }
+  static auto gather(const double *base, const std::int32_t *index) -> Reg {
+    return _mm512_i32gather_pd(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(index)), base, 8);
+  }
+  static auto storeu(double *p, Reg v) -> void { _mm512_storeu_pd(p, v); }
+  static auto add(Reg a, Reg b) -> Reg { return _mm512_add_pd(a, b); }
+  static auto mul(Reg a, Reg b) -> Reg { return _mm512_mul_pd(a, b); }
+  static auto fmadd(Reg a, Reg b, Reg c) -> Reg {
+    return _mm512_fmadd_pd(a, b, c);
+  }
+  static auto min(Reg a, Reg b) -> Reg { return _mm512_min_pd(a, b); }
+  static auto max(Reg a, Reg b) -> Reg { return _mm512_max_pd(a, b); }
+};
+
+template <>
+struct Vec<float> {
+  using Reg = __m512;
+  static constexpr SizeType LANES = 16;
+
+  static auto zero() -> Reg { return _mm512_setzero_ps(); }
+  static auto set1(float v) -> Reg { return _mm512_set1_ps(v); }
+  static auto loadu(const float *p) -> Reg { return _mm512_loadu_ps(p); }
+  static auto gather(const float *base, const std::int32_t *index) -> Reg {
+    return _mm512_i32gather_ps(_mm512_loadu_si512(index), base, 4);
+  }
+  static auto storeu(float *p, Reg v) -> void { _mm512_storeu_ps(p, v); }
+  static auto add(Reg a, Reg b) -> Reg { return _mm512_add_ps(a, b); }
+  static auto mul(Reg a, Reg b) -> Reg { return _mm512_mul_ps(a, b); }
+  static auto fmadd(Reg a, Reg b, Reg c) -> Reg {
+    return _mm512_fmadd_ps(a, b, c);
+  }
+  static auto min(Reg a, Reg b) -> Reg { return _mm512_min_ps(a, b); }
+  static auto max(Reg a, Reg b) -> Reg { return _mm512_max_ps(a, b); }
+};
+
+#include "fz/simd/kernels.inl"
+
+}  // namespace fz::simd::detail::avx512
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif  // FZ_SIMD_X86
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT ON
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif  // __FZ_SIMD_KERNELS_H__
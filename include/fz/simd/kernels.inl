@@ -0,0 +1,295 @@
+// Instruction-set independent kernel bodies.
+//
+// No include guard: kernels.hpp includes this file once per instruction set,
+// inside that instruction set's namespace and target region, after defining
+// the Vec<T> register wrapper the bodies are written against.
+
+template <typename T>
+inline auto reduceLanes(typename Vec<T>::Reg reg) -> T {
+  T lanes[Vec<T>::LANES];
+  Vec<T>::storeu(lanes, reg);
+  T sum = lanes[0];
+  for (SizeType l = 1; l < Vec<T>::LANES; ++l) {
+    sum += lanes[l];
+  }
+  return sum;
+}
+
+template <typename T>
+inline auto fill(T *x, SizeType n, T value) -> void {
+  using V = Vec<T>;
+  const auto v = V::set1(value);
+  SizeType i = 0;
+  for (; i + V::LANES <= n; i += V::LANES) {
+    V::storeu(x + i, v);
+  }
+  for (; i < n; ++i) {
+    x[i] = value;
+  }
+}
+
+template <typename T>
+inline auto copy(const T *src, SizeType n, T *dst) -> void {
+  using V = Vec<T>;
+  SizeType i = 0;
+  for (; i + 2 * V::LANES <= n; i += 2 * V::LANES) {
+    auto a = V::loadu(src + i);
+    auto b = V::loadu(src + i + V::LANES);
+    V::storeu(dst + i, a);
+    V::storeu(dst + i + V::LANES, b);
+  }
+  for (; i < n; ++i) {
+    dst[i] = src[i];
+  }
+}
+
+template <typename T>
+inline auto axpy(SizeType n, T a, const T *x, T *y) -> void {
+  using V = Vec<T>;
+  const auto va = V::set1(a);
+  SizeType i = 0;
+  for (; i + V::LANES <= n; i += V::LANES) {
+    V::storeu(y + i, V::fmadd(va, V::loadu(x + i), V::loadu(y + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+template <typename T>
+inline auto scale(T *x, SizeType n, T a) -> void {
+  using V = Vec<T>;
+  const auto va = V::set1(a);
+  SizeType i = 0;
+  for (; i + V::LANES <= n; i += V::LANES) {
+    V::storeu(x + i, V::mul(va, V::loadu(x + i)));
+  }
+  for (; i < n; ++i) {
+    x[i] *= a;
+  }
+}
+
+// four independent accumulators hide the add latency
+template <typename T>
+inline auto sum(const T *x, SizeType n) -> T {
+  using V = Vec<T>;
+  auto acc0 = V::zero();
+  auto acc1 = V::zero();
+  auto acc2 = V::zero();
+  auto acc3 = V::zero();
+  SizeType i = 0;
+  for (; i + 4 * V::LANES <= n; i += 4 * V::LANES) {
+    acc0 = V::add(acc0, V::loadu(x + i));
+    acc1 = V::add(acc1, V::loadu(x + i + V::LANES));
+    acc2 = V::add(acc2, V::loadu(x + i + 2 * V::LANES));
+    acc3 = V::add(acc3, V::loadu(x + i + 3 * V::LANES));
+  }
+  for (; i + V::LANES <= n; i += V::LANES) {
+    acc0 = V::add(acc0, V::loadu(x + i));
+  }
+  T result = reduceLanes<T>(V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+  for (; i < n; ++i) {
+    result += x[i];
+  }
+  return result;
+}
+
+template <typename T>
+inline auto dot(const T *x, const T *y, SizeType n) -> T {
+  using V = Vec<T>;
+  auto acc0 = V::zero();
+  auto acc1 = V::zero();
+  auto acc2 = V::zero();
+  auto acc3 = V::zero();
+  SizeType i = 0;
+  for (; i + 4 * V::LANES <= n; i += 4 * V::LANES) {
+    acc0 = V::fmadd(V::loadu(x + i), V::loadu(y + i), acc0);
+    acc1 = V::fmadd(V::loadu(x + i + V::LANES), V::loadu(y + i + V::LANES),
+                    acc1);
+    acc2 = V::fmadd(V::loadu(x + i + 2 * V::LANES),
+                    V::loadu(y + i + 2 * V::LANES), acc2);
+    acc3 = V::fmadd(V::loadu(x + i + 3 * V::LANES),
+                    V::loadu(y + i + 3 * V::LANES), acc3);
+  }
+  for (; i + V::LANES <= n; i += V::LANES) {
+    acc0 = V::fmadd(V::loadu(x + i), V::loadu(y + i), acc0);
+  }
+  T result = reduceLanes<T>(V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+  for (; i < n; ++i) {
+    result += x[i] * y[i];
+  }
+  return result;
+}
+
+// n >= 1
+template <typename T>
+inline auto min(const T *x, SizeType n) -> T {
+  using V = Vec<T>;
+  auto acc = V::set1(x[0]);
+  SizeType i = 0;
+  for (; i + V::LANES <= n; i += V::LANES) {
+    acc = V::min(acc, V::loadu(x + i));
+  }
+  T lanes[V::LANES];
+  V::storeu(lanes, acc);
+  T result = lanes[0];
+  for (SizeType l = 1; l < V::LANES; ++l) {
+    result = lanes[l] < result ? lanes[l] : result;
+  }
+  for (; i < n; ++i) {
+    result = x[i] < result ? x[i] : result;
+  }
+  return result;
+}
+
+// n >= 1
+template <typename T>
+inline auto max(const T *x, SizeType n) -> T {
+  using V = Vec<T>;
+  auto acc = V::set1(x[0]);
+  SizeType i = 0;
+  for (; i + V::LANES <= n; i += V::LANES) {
+    acc = V::max(acc, V::loadu(x + i));
+  }
+  T lanes[V::LANES];
+  V::storeu(lanes, acc);
+  T result = lanes[0];
+  for (SizeType l = 1; l < V::LANES; ++l) {
+    result = result < lanes[l] ? lanes[l] : result;
+  }
+  for (; i < n; ++i) {
+    result = result < x[i] ? x[i] : result;
+  }
+  return result;
+}
+
+// Reproducible reductions: element i always lands in logical lane
+// i % REPRODUCIBLE_LANES<T>, however many lanes the registers hold, and every
+// lane sees the same sequence of roundings. Only the first
+// n - n % REPRODUCIBLE_LANES<T> elements are consumed; the caller combines the
+// lanes and the tail in a fixed order.
+
+template <typename T>
+inline auto sumLanes(const T *x, SizeType n, T *lanes) -> void {
+  using V = Vec<T>;
+  constexpr SizeType K = REPRODUCIBLE_LANES<T>;
+  constexpr SizeType R = K / V::LANES;
+  typename V::Reg acc[R];
+  for (SizeType r = 0; r < R; ++r) {
+    acc[r] = V::loadu(lanes + r * V::LANES);
+  }
+  for (SizeType i = 0; i + K <= n; i += K) {
+    for (SizeType r = 0; r < R; ++r) {
+      acc[r] = V::add(acc[r], V::loadu(x + i + r * V::LANES));
+    }
+  }
+  for (SizeType r = 0; r < R; ++r) {
+    V::storeu(lanes + r * V::LANES, acc[r]);
+  }
+}
+
+template <typename T>
+inline auto dotLanes(const T *x, const T *y, SizeType n, T *lanes) -> void {
+  using V = Vec<T>;
+  constexpr SizeType K = REPRODUCIBLE_LANES<T>;
+  constexpr SizeType R = K / V::LANES;
+  typename V::Reg acc[R];
+  for (SizeType r = 0; r < R; ++r) {
+    acc[r] = V::loadu(lanes + r * V::LANES);
+  }
+  for (SizeType i = 0; i + K <= n; i += K) {
+    for (SizeType r = 0; r < R; ++r) {
+      // separate multiply and add: the scalar path cannot fuse them either
+      acc[r] = V::add(acc[r], V::mul(V::loadu(x + i + r * V::LANES),
+                                     V::loadu(y + i + r * V::LANES)));
+    }
+  }
+  for (SizeType r = 0; r < R; ++r) {
+    V::storeu(lanes + r * V::LANES, acc[r]);
+  }
+}
+
+// Sparse products: x is read through an index array, as a CSR row or a
+// SELL slice stores it.
+
+// y[r] = sum of values[k] * x[cols[k]] over k in [offsets[r], offsets[r + 1])
+template <typename T>
+inline auto gatherDot(const T *values, const std::int32_t *cols,
+                      const SizeType *offsets, SizeType rows, const T *x,
+                      T *y) -> void {
+  using V = Vec<T>;
+  for (SizeType r = 0; r < rows; ++r) {
+    const auto last = offsets[r + 1];
+    auto k = offsets[r];
+    T result{};
+    if (k + V::LANES <= last) {
+      auto acc = V::zero();
+      for (; k + V::LANES <= last; k += V::LANES) {
+        acc = V::fmadd(V::loadu(values + k), V::gather(x, cols + k), acc);
+      }
+      result = reduceLanes<T>(acc);
+    }
+    for (; k < last; ++k) {
+      result += values[k] * x[cols[k]];
+    }
+    y[r] = result;
+  }
+}
+
+// SLICE_ROWS row products at once; entry j of row r sits at
+// j * SLICE_ROWS + r, so every step is one contiguous load per register
+template <typename T>
+inline auto sliceDot(const T *values, const std::int32_t *cols,
+                     SizeType width, const T *x, T *result) -> void {
+  using V = Vec<T>;
+  constexpr SizeType R = SLICE_ROWS / V::LANES;
+  typename V::Reg acc[R];
+  for (SizeType r = 0; r < R; ++r) {
+    acc[r] = V::zero();
+  }
+  for (SizeType j = 0; j < width; ++j) {
+    const auto offset = j * SLICE_ROWS;
+    for (SizeType r = 0; r < R; ++r) {
+      acc[r] = V::fmadd(V::loadu(values + offset + r * V::LANES),
+                        V::gather(x, cols + offset + r * V::LANES), acc[r]);
+    }
+  }
+  for (SizeType r = 0; r < R; ++r) {
+    V::storeu(result + r * V::LANES, acc[r]);
+  }
+}
+
+// y[0, k) = sum over i < n of values[i * stride] times the k contiguous
+// elements at x + cols[i * stride] * ld: one row of a sparse matrix times a
+// row-major dense matrix
+template <typename T>
+inline auto gatherAxpy(const T *values, const std::int32_t *cols,
+                       SizeType stride, SizeType n, const T *x, SizeType ld,
+                       SizeType k, T *y) -> void {
+  using V = Vec<T>;
+  SizeType l = 0;
+  for (; l + V::LANES <= k; l += V::LANES) {
+    auto acc = V::zero();
+    for (SizeType i = 0; i < n; ++i) {
+      const auto *row = x + static_cast<SizeType>(cols[i * stride]) * ld;
+      acc = V::fmadd(V::set1(values[i * stride]), V::loadu(row + l), acc);
+    }
+    V::storeu(y + l, acc);
+  }
+  for (; l < k; ++l) {
+    T result{};
+    for (SizeType i = 0; i < n; ++i) {
+      result += values[i * stride] *
+                x[static_cast<SizeType>(cols[i * stride]) * ld + l];
+    }
+    y[l] = result;
+  }
+}
+
+template <typename T>
+inline constexpr KernelTable<T> TABLE{
+    &fill<T>,     &copy<T>,     &axpy<T>,      &scale<T>,
+    &sum<T>,      &dot<T>,      &min<T>,       &max<T>,
+    &sumLanes<T>, &dotLanes<T>, &gatherDot<T>, &sliceDot<T>,
+    &gatherAxpy<T>,
+};
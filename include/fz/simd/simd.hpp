@@ -0,0 +1,360 @@
+/**
+ * @file simd.hpp
+ * @brief Vectorised kernels over contiguous storage with run-time instruction
+ * set dispatch.
+ *
+ * float and double go through the AVX-512 / AVX2 / SSE2 / scalar build picked
+ * by activeIsa(); every other element type takes a plain loop. Each kernel
+ * takes either a pointer and a length or any contiguous container with data()
+ * and size(), e.g. an Array of either layout or a dense ArrayView. Kernels
+ * over two containers pair elements by offset, so both must be stored in the
+ * same order.
+ */
+
+#ifndef __FZ_SIMD_SIMD_H__
+#define __FZ_SIMD_SIMD_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+
+#include "fz/simd/cpu.hpp"
+#include "fz/simd/kernels.hpp"
+
+namespace fz::simd {
+
+enum class Reduction {
+  // whatever order is fastest on the active instruction set
+  kFast,
+  // fixed lane assignment and combine order: bit-identical results on every
+  // instruction set, at some cost in speed
+  kReproducible,
+};
+
+template <typename T>
+concept Vectorizable = std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+template <typename C>
+concept ContiguousStorage = requires(C &c) {
+  { c.data() } -> std::convertible_to<const typename C::value_type *>;
+  { c.size() } -> std::convertible_to<SizeType>;
+};
+
+template <Vectorizable T>
+inline auto kernels() -> const KernelTable<T> & {
+  switch (activeIsa()) {
+#ifdef FZ_SIMD_X86
+    case Isa::kAvx512:
+      return detail::avx512::TABLE<T>;
+    case Isa::kAvx2:
+      return detail::avx2::TABLE<T>;
+    case Isa::kSse2:
+      return detail::sse2::TABLE<T>;
+#endif
+    default:
+      return detail::scalar::TABLE<T>;
+  }
+}
+
+namespace detail {
+
+// the elements fill data()[0, size()), in any order: enough for the kernels
+// that treat them as a set
+template <typename C>
+inline auto checkDense(const C &c) -> void {
+  if constexpr (requires { c.isDense(); }) {
+    if (!c.isDense()) {
+      throw std::invalid_argument("Storage is not contiguous");
+    }
+  }
+}
+
+template <typename C>
+inline auto isFirstIndexFastest(const C &c) -> bool {
+  if constexpr (requires { c.isContiguous(); }) {
+    return c.isContiguous();
+  } else {
+    return true;
+  }
+}
+
+// kernels pairing x and y by offset need element i of both at offset i:
+// both first index fastest, or the same shape stored the same way
+template <typename C, typename D>
+inline auto checkSameOrder(const C &x, const D &y) -> void {
+  checkDense(x);
+  checkDense(y);
+  if (isFirstIndexFastest(x) && isFirstIndexFastest(y)) {
+    return;
+  }
+  if constexpr (requires {
+                  x.shape();
+                  x.strides();
+                  y.shape();
+                  y.strides();
+                }) {
+    if (std::ranges::equal(x.shape(), y.shape()) &&
+        std::ranges::equal(x.strides(), y.strides())) {
+      return;
+    }
+  }
+  throw std::invalid_argument("Storage orders differ");
+}
+
+}  // namespace detail
+
+template <typename T>
+inline auto fill(T *x, SizeType n, T value) -> void {
+  if constexpr (Vectorizable<T>) {
+    kernels<T>().fill(x, n, value);
+  } else {
+    std::fill(x, x + n, value);
+  }
+}
+
+template <typename T>
+inline auto copy(const T *src, SizeType n, T *dst) -> void {
+  if constexpr (Vectorizable<T>) {
+    kernels<T>().copy(src, n, dst);
+  } else {
+    std::copy(src, src + n, dst);
+  }
+}
+
+/**
+ * @brief y += a * x
+ */
+template <typename T>
+inline auto axpy(SizeType n, T a, const T *x, T *y) -> void {
+  if constexpr (Vectorizable<T>) {
+    kernels<T>().axpy(n, a, x, y);
+  } else {
+    for (SizeType i = 0; i < n; ++i) {
+      y[i] += a * x[i];
+    }
+  }
+}
+
+/**
+ * @brief x *= a
+ */
+template <typename T>
+inline auto scale(T *x, SizeType n, T a) -> void {
+  if constexpr (Vectorizable<T>) {
+    kernels<T>().scale(x, n, a);
+  } else {
+    for (SizeType i = 0; i < n; ++i) {
+      x[i] *= a;
+    }
+  }
+}
+
+template <typename T>
+inline auto sum(const T *x, SizeType n, Reduction mode = Reduction::kFast)
+    -> T {
+  if constexpr (Vectorizable<T>) {
+    if (mode == Reduction::kFast) {
+      return kernels<T>().sum(x, n);
+    }
+
+    T lanes[REPRODUCIBLE_LANES<T>]{};
+    kernels<T>().sum_lanes(x, n, lanes);
+    auto body = n - n % REPRODUCIBLE_LANES<T>;
+    return detail::combineLanes<T>(lanes, x + body, nullptr, n - body);
+  } else {
+    return std::accumulate(x, x + n, T{});
+  }
+}
+
+template <typename T>
+inline auto dot(const T *x, const T *y, SizeType n,
+                Reduction mode = Reduction::kFast) -> T {
+  if constexpr (Vectorizable<T>) {
+    if (mode == Reduction::kFast) {
+      return kernels<T>().dot(x, y, n);
+    }
+
+    T lanes[REPRODUCIBLE_LANES<T>]{};
+    kernels<T>().dot_lanes(x, y, n, lanes);
+    auto body = n - n % REPRODUCIBLE_LANES<T>;
+    return detail::combineLanes<T>(lanes, x + body, y + body, n - body);
+  } else {
+    return std::inner_product(x, x + n, y, T{});
+  }
+}
+
+/**
+ * @brief Euclidean norm, sqrt(dot(x, x)).
+ */
+template <typename T>
+inline auto norm(const T *x, SizeType n, Reduction mode = Reduction::kFast)
+    -> T {
+  using std::sqrt;
+  return sqrt(dot(x, x, n, mode));
+}
+
+/**
+ * @brief Smallest element; n must be positive. NaN handling is unspecified.
+ */
+template <typename T>
+inline auto min(const T *x, SizeType n) -> T {
+  if (n == 0) {
+    throw std::invalid_argument("Empty range");
+  }
+  if constexpr (Vectorizable<T>) {
+    return kernels<T>().min(x, n);
+  } else {
+    return *std::min_element(x, x + n);
+  }
+}
+
+/**
+ * @brief Largest element; n must be positive. NaN handling is unspecified.
+ */
+template <typename T>
+inline auto max(const T *x, SizeType n) -> T {
+  if (n == 0) {
+    throw std::invalid_argument("Empty range");
+  }
+  if constexpr (Vectorizable<T>) {
+    return kernels<T>().max(x, n);
+  } else {
+    return *std::max_element(x, x + n);
+  }
+}
+
+/**
+ * @brief Rows of a CSR matrix times a dense vector: y[r] is the sum of
+ * values[k] * x[cols[k]] over k in [offsets[r], offsets[r + 1]), r < rows.
+ */
+template <typename T>
+inline auto gatherDot(const T *values, const std::int32_t *cols,
+                      const SizeType *offsets, SizeType rows, const T *x,
+                      T *y) -> void {
+  if constexpr (Vectorizable<T>) {
+    kernels<T>().gather_dot(values, cols, offsets, rows, x, y);
+  } else {
+    for (SizeType r = 0; r < rows; ++r) {
+      T result{};
+      for (auto k = offsets[r]; k < offsets[r + 1]; ++k) {
+        result += values[k] * x[cols[k]];
+      }
+      y[r] = result;
+    }
+  }
+}
+
+/**
+ * @brief gatherDot of SLICE_ROWS rows of width entries each, stored
+ * interleaved: entry j of row r is at j * SLICE_ROWS + r. Row r's result
+ * goes to result[r].
+ */
+template <typename T>
+inline auto sliceDot(const T *values, const std::int32_t *cols,
+                     SizeType width, const T *x, T *result) -> void {
+  if constexpr (Vectorizable<T>) {
+    kernels<T>().slice_dot(values, cols, width, x, result);
+  } else {
+    std::fill(result, result + SLICE_ROWS, T{});
+    for (SizeType j = 0; j < width; ++j) {
+      for (SizeType r = 0; r < SLICE_ROWS; ++r) {
+        const auto k = j * SLICE_ROWS + r;
+        result[r] += values[k] * x[cols[k]];
+      }
+    }
+  }
+}
+
+/**
+ * @brief One sparse row times a row-major dense matrix: y[0, k) is the sum
+ * over i < n of values[i * stride] times row cols[i * stride] of x, whose
+ * rows are k contiguous elements ld apart.
+ */
+template <typename T>
+inline auto gatherAxpy(const T *values, const std::int32_t *cols,
+                       SizeType stride, SizeType n, const T *x, SizeType ld,
+                       SizeType k, T *y) -> void {
+  if constexpr (Vectorizable<T>) {
+    kernels<T>().gather_axpy(values, cols, stride, n, x, ld, k, y);
+  } else {
+    std::fill(y, y + k, T{});
+    for (SizeType i = 0; i < n; ++i) {
+      const auto *row = x + static_cast<SizeType>(cols[i * stride]) * ld;
+      for (SizeType l = 0; l < k; ++l) {
+        y[l] += values[i * stride] * row[l];
+      }
+    }
+  }
+}
+
+// container overloads
+
+template <ContiguousStorage C>
+inline auto fill(C &x, typename C::value_type value) -> void {
+  detail::checkDense(x);
+  fill(x.data(), x.size(), value);
+}
+
+template <ContiguousStorage C, ContiguousStorage D>
+inline auto copy(const C &src, D &dst) -> void {
+  if (src.size() != dst.size()) {
+    throw std::invalid_argument("Size mismatch");
+  }
+  detail::checkSameOrder(src, dst);
+  copy(src.data(), src.size(), dst.data());
+}
+
+template <ContiguousStorage C, ContiguousStorage D>
+inline auto axpy(typename D::value_type a, const C &x, D &y) -> void {
+  if (x.size() != y.size()) {
+    throw std::invalid_argument("Size mismatch");
+  }
+  detail::checkSameOrder(x, y);
+  axpy(y.size(), a, x.data(), y.data());
+}
+
+template <ContiguousStorage C>
+inline auto scale(C &x, typename C::value_type a) -> void {
+  detail::checkDense(x);
+  scale(x.data(), x.size(), a);
+}
+
+template <ContiguousStorage C>
+inline auto sum(const C &x, Reduction mode = Reduction::kFast) {
+  detail::checkDense(x);
+  return sum(x.data(), x.size(), mode);
+}
+
+template <ContiguousStorage C, ContiguousStorage D>
+inline auto dot(const C &x, const D &y, Reduction mode = Reduction::kFast) {
+  if (x.size() != y.size()) {
+    throw std::invalid_argument("Size mismatch");
+  }
+  detail::checkSameOrder(x, y);
+  return dot(x.data(), y.data(), x.size(), mode);
+}
+
+template <ContiguousStorage C>
+inline auto norm(const C &x, Reduction mode = Reduction::kFast) {
+  detail::checkDense(x);
+  return norm(x.data(), x.size(), mode);
+}
+
+template <ContiguousStorage C>
+inline auto min(const C &x) {
+  detail::checkDense(x);
+  return min(x.data(), x.size());
+}
+
+template <ContiguousStorage C>
+inline auto max(const C &x) {
+  detail::checkDense(x);
+  return max(x.data(), x.size());
+}
+
+}  // namespace fz::simd
+
+#endif  // __FZ_SIMD_SIMD_H__
@@ -0,0 +1,282 @@
+/**
+ * @file small_vector.hpp
+ * @brief A vector that keeps up to N elements inside the object and only
+ * goes to the heap beyond that; Array's shapes and strides.
+ */
+
+#ifndef __FZ_SMALL_VECTOR_H__
+#define __FZ_SMALL_VECTOR_H__
+
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace fz {
+
+/**
+ * @brief The std::vector interface Array needs, with the first N elements
+ * stored inline, so a shape of rank <= N costs no allocation. Elements must
+ * be trivially copyable. Moving an inline vector copies its elements.
+ */
+template <typename T, std::size_t N>
+class SmallVector {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T &;
+  using const_reference = const T &;
+  using pointer = T *;
+  using const_pointer = const T *;
+  using iterator = T *;
+  using const_iterator = const T *;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  static constexpr size_type INLINE_CAPACITY = N;
+
+ public:
+  SmallVector() = default;
+
+  explicit SmallVector(size_type n, const T &value = T{}) { assign(n, value); }
+
+  SmallVector(std::initializer_list<T> init) {
+    assign(init.begin(), init.end());
+  }
+
+  template <std::input_iterator It>
+  SmallVector(It first, It last) {
+    assign(first, last);
+  }
+
+  // any other range of convertible elements, e.g. a std::vector shape
+  template <std::ranges::input_range R>
+    requires(!std::is_same_v<std::remove_cvref_t<R>, SmallVector> &&
+             std::is_convertible_v<std::ranges::range_value_t<R>, T>)
+  SmallVector(const R &range)  // NOLINT
+  {
+    assign(std::ranges::begin(range), std::ranges::end(range));
+  }
+
+  SmallVector(const SmallVector &other) {
+    assign(other.begin(), other.end());
+  }
+
+  SmallVector(SmallVector &&other) noexcept { steal(other); }
+
+  auto operator=(const SmallVector &other) -> SmallVector & {
+    if (this != &other) {
+      assign(other.begin(), other.end());
+    }
+    return *this;
+  }
+
+  auto operator=(SmallVector &&other) noexcept -> SmallVector & {
+    if (this != &other) {
+      release();
+      steal(other);
+    }
+    return *this;
+  }
+
+  auto operator=(std::initializer_list<T> init) -> SmallVector & {
+    assign(init.begin(), init.end());
+    return *this;
+  }
+
+  ~SmallVector() { release(); }
+
+ public:
+  [[nodiscard]] auto size() const -> size_type { return _size; }
+
+  [[nodiscard]] auto capacity() const -> size_type { return _capacity; }
+
+  [[nodiscard]] auto empty() const -> bool { return _size == 0; }
+
+  // whether the elements live inside the object
+  [[nodiscard]] auto isInline() const -> bool { return _data == _inline; }
+
+  auto data() -> T * { return _data; }
+
+  auto data() const -> const T * { return _data; }
+
+  auto begin() -> iterator { return _data; }
+
+  auto end() -> iterator { return _data + _size; }
+
+  auto begin() const -> const_iterator { return _data; }
+
+  auto end() const -> const_iterator { return _data + _size; }
+
+  auto cbegin() const -> const_iterator { return _data; }
+
+  auto cend() const -> const_iterator { return _data + _size; }
+
+  auto rbegin() -> reverse_iterator { return reverse_iterator{end()}; }
+
+  auto rend() -> reverse_iterator { return reverse_iterator{begin()}; }
+
+  auto rbegin() const -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+
+  auto rend() const -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  auto operator[](size_type i) -> T & { return _data[i]; }
+
+  auto operator[](size_type i) const -> const T & { return _data[i]; }
+
+  auto at(size_type i) -> T & {
+    if (_size <= i) {
+      throw std::out_of_range("Index out of range");
+    }
+    return _data[i];
+  }
+
+  auto at(size_type i) const -> const T & {
+    if (_size <= i) {
+      throw std::out_of_range("Index out of range");
+    }
+    return _data[i];
+  }
+
+  auto front() -> T & { return _data[0]; }
+
+  auto front() const -> const T & { return _data[0]; }
+
+  auto back() -> T & { return _data[_size - 1]; }
+
+  auto back() const -> const T & { return _data[_size - 1]; }
+
+ public:
+  auto reserve(size_type n) -> void {
+    if (n <= _capacity) {
+      return;
+    }
+    auto *p = static_cast<T *>(::operator new(n * sizeof(T)));
+    if (_size != 0) {
+      std::memcpy(p, _data, _size * sizeof(T));
+    }
+    release();
+    _data = p;
+    _capacity = n;
+  }
+
+  auto resize(size_type n, const T &value = T{}) -> void {
+    reserve(n);
+    if (_size < n) {
+      std::fill(_data + _size, _data + n, value);
+    }
+    _size = n;
+  }
+
+  auto clear() -> void { _size = 0; }
+
+  auto assign(size_type n, const T &value) -> void {
+    _size = 0;
+    resize(n, value);
+  }
+
+  template <std::input_iterator It>
+  auto assign(It first, It last) -> void {
+    _size = 0;
+    if constexpr (std::forward_iterator<It>) {
+      const auto n = static_cast<size_type>(std::distance(first, last));
+      reserve(n);
+      std::copy(first, last, _data);
+      _size = n;
+    } else {
+      for (; first != last; ++first) {
+        push_back(static_cast<T>(*first));
+      }
+    }
+  }
+
+  auto push_back(const T &value) -> void {  // NOLINT
+    if (_size == _capacity) {
+      // value may be one of our own elements
+      const auto copy = value;
+      reserve(std::max<size_type>(2 * _capacity, 1));
+      _data[_size++] = copy;
+      return;
+    }
+    _data[_size++] = value;
+  }
+
+  template <typename... Args>
+  auto emplace_back(Args &&...args) -> T & {  // NOLINT
+    push_back(T(std::forward<Args>(args)...));
+    return back();
+  }
+
+  auto pop_back() -> void { --_size; }  // NOLINT
+
+  auto insert(const_iterator pos, const T &value) -> iterator {
+    const auto i = static_cast<size_type>(pos - begin());
+    push_back(value);
+    std::rotate(begin() + i, end() - 1, end());
+    return begin() + i;
+  }
+
+  auto erase(const_iterator pos) -> iterator {
+    const auto i = static_cast<size_type>(pos - begin());
+    std::copy(begin() + i + 1, end(), begin() + i);
+    --_size;
+    return begin() + i;
+  }
+
+ public:
+  template <std::ranges::input_range R>
+  friend auto operator==(const SmallVector &lhs, const R &rhs) -> bool {
+    return std::ranges::equal(lhs, rhs);
+  }
+
+  friend auto operator<=>(const SmallVector &lhs, const SmallVector &rhs) {
+    return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(),
+                                                  rhs.begin(), rhs.end());
+  }
+
+ private:
+  T *_data = _inline;
+  size_type _size = 0;
+  size_type _capacity = N;
+  T _inline[N == 0 ? 1 : N];
+
+  auto release() -> void {
+    if (!isInline()) {
+      ::operator delete(_data);
+      _data = _inline;
+      _capacity = N;
+    }
+  }
+
+  // take other's elements, leaving it empty
+  auto steal(SmallVector &other) -> void {
+    if (other.isInline()) {
+      std::memcpy(_inline, other._inline, other._size * sizeof(T));
+    } else {
+      _data = other._data;
+      _capacity = other._capacity;
+      other._data = other._inline;
+      other._capacity = N;
+    }
+    _size = other._size;
+    other._size = 0;
+  }
+};
+
+}  // namespace fz
+
+#endif  // __FZ_SMALL_VECTOR_H__
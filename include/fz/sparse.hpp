@@ -0,0 +1,561 @@
+/**
+ * @file sparse.hpp
+ * @brief Sparse matrices and their products with dense Arrays.
+ *
+ * A CooMatrix collects (row, column, value) triplets in any order, which is
+ * how operators are assembled; it is then compressed into a format built for
+ * products:
+ *
+ *   fz::CooMatrix<double> coo{n, n};
+ *   for (fz::SizeType i = 0; i < n; ++i) {
+ *     coo.add(i, i, 2.0);
+ *     ...
+ *   }
+ *   const fz::CsrMatrix<double> a{coo};
+ *   fz::spmv(a, x, y);  // y = a * x
+ *
+ * CsrMatrix (compressed sparse row) suits irregular rows. SellMatrix
+ * (SELL-C-sigma) stores SLICE_ROWS rows interleaved, padded to the longest
+ * of them, so one vector register covers several rows at every step; rows
+ * are sorted by length within windows of sigma rows to keep the padding low.
+ * It is the faster of the two when rows are of similar length, as in banded
+ * and stencil operators.
+ *
+ * Products run over rows (CSR) or slices (SELL) on the thread pool and read
+ * x through the gather kernels of fz/simd. Dense operands are contiguous
+ * vectors, or matrices with one right-hand side per column, column-major or
+ * row-major.
+ */
+
+#ifndef __FZ_SPARSE_H__
+#define __FZ_SPARSE_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/array_base.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/simd/simd.hpp"
+
+namespace fz {
+
+// row and column indices are 32 bits, the index width of gather instructions
+using SparseIndex = std::int32_t;
+
+/**
+ * @brief Sparse matrix as unordered (row, column, value) triplets. Repeated
+ * positions are summed when the matrix is compressed, so a finite-element
+ * style assembly can add each contribution as it comes.
+ */
+template <typename T>
+class CooMatrix {
+ public:
+  using value_type = T;
+
+ public:
+  CooMatrix() = default;
+
+  CooMatrix(SizeType rows, SizeType cols);
+
+ public:
+  [[nodiscard]] auto rows() const -> SizeType { return _rows; }
+
+  [[nodiscard]] auto cols() const -> SizeType { return _cols; }
+
+  // stored triplets, counting repeated positions once each
+  [[nodiscard]] auto nnz() const -> SizeType { return _values.size(); }
+
+  auto rowIndices() const -> std::span<const SparseIndex> {
+    return _row_indices;
+  }
+
+  auto colIndices() const -> std::span<const SparseIndex> {
+    return _col_indices;
+  }
+
+  auto values() const -> std::span<const T> { return _values; }
+
+ public:
+  auto add(SizeType row, SizeType col, T value) -> void;
+
+  auto reserve(SizeType nnz) -> void;
+
+  // drops the triplets, keeps the shape
+  auto clear() -> void;
+
+ private:
+  SizeType _rows = 0;
+  SizeType _cols = 0;
+  std::vector<SparseIndex> _row_indices;
+  std::vector<SparseIndex> _col_indices;
+  std::vector<T> _values;
+};
+
+/**
+ * @brief Compressed sparse row matrix: the entries of row r are
+ * [rowOffsets()[r], rowOffsets()[r + 1]) of columns() and values(), in
+ * increasing column order. The pattern is fixed once built; the values may
+ * be changed in place.
+ */
+template <typename T>
+class CsrMatrix {
+ public:
+  using value_type = T;
+
+ public:
+  CsrMatrix() = default;
+
+  // sorts the triplets by position and sums repeated ones
+  explicit CsrMatrix(const CooMatrix<T> &coo);
+
+ public:
+  [[nodiscard]] auto rows() const -> SizeType { return _rows; }
+
+  [[nodiscard]] auto cols() const -> SizeType { return _cols; }
+
+  [[nodiscard]] auto nnz() const -> SizeType { return _values.size(); }
+
+  auto rowOffsets() const -> const Array<SizeType> & { return _row_offsets; }
+
+  auto columns() const -> const Array<SparseIndex> & { return _columns; }
+
+  auto values() const -> const Array<T> & { return _values; }
+
+  auto values() -> Array<T> & { return _values; }
+
+  /**
+   * @brief The entry at (row, col), zero where the pattern has none.
+   */
+  auto operator()(SizeType row, SizeType col) const -> T;
+
+ private:
+  SizeType _rows = 0;
+  SizeType _cols = 0;
+  Array<SizeType> _row_offsets = Array<SizeType>::zeros({1});
+  Array<SparseIndex> _columns;
+  Array<T> _values;
+};
+
+/**
+ * @brief SELL-C-sigma matrix with C = simd::SLICE_ROWS. Slot s holds row
+ * permutation()[s]; slice k is slots [k * C, (k + 1) * C), and entry j of
+ * its slot l is at sliceOffsets()[k] + j * C + l. Short rows are padded
+ * with zeros that repeat their last column, so the padding reads x where
+ * the row already does.
+ */
+template <typename T>
+class SellMatrix {
+ public:
+  using value_type = T;
+
+  static constexpr SizeType SLICE_ROWS = simd::SLICE_ROWS;
+
+ public:
+  SellMatrix() = default;
+
+  /**
+   * @brief Repack csr. Rows are sorted by decreasing length within windows
+   * of sigma rows, rounded up to whole slices; sigma = 1 keeps the row
+   * order, a sigma of at least rows() sorts them all.
+   */
+  explicit SellMatrix(const CsrMatrix<T> &csr,
+                      SizeType sigma = 8 * SLICE_ROWS);
+
+ public:
+  [[nodiscard]] auto rows() const -> SizeType { return _rows; }
+
+  [[nodiscard]] auto cols() const -> SizeType { return _cols; }
+
+  // nonzeros of the matrix, without the padding
+  [[nodiscard]] auto nnz() const -> SizeType { return _nnz; }
+
+  [[nodiscard]] auto slices() const -> SizeType {
+    return _slice_offsets.size() - 1;
+  }
+
+  auto sliceOffsets() const -> const Array<SizeType> & {
+    return _slice_offsets;
+  }
+
+  auto permutation() const -> const Array<SparseIndex> & {
+    return _permutation;
+  }
+
+  auto columns() const -> const Array<SparseIndex> & { return _columns; }
+
+  auto values() const -> const Array<T> & { return _values; }
+
+ private:
+  SizeType _rows = 0;
+  SizeType _cols = 0;
+  SizeType _nnz = 0;
+  Array<SizeType> _slice_offsets = Array<SizeType>::zeros({1});
+  Array<SparseIndex> _permutation;
+  Array<SparseIndex> _columns;
+  Array<T> _values;
+};
+
+namespace detail {
+
+inline auto checkSparseShape(SizeType rows, SizeType cols) -> void {
+  constexpr auto LIMIT =
+      static_cast<SizeType>(std::numeric_limits<SparseIndex>::max());
+  if (LIMIT < rows || LIMIT < cols) {
+    throw std::invalid_argument("Sparse matrix is too large for its indices");
+  }
+}
+
+// a dense operand as the products see it: element (i, j) of a rows x cols
+// matrix is at data + i * row_stride + j * col_stride; a vector is one
+// column
+template <typename T>
+struct DenseOperand {
+  T *data;
+  SizeType rows;
+  SizeType cols;
+  SizeType row_stride;
+  SizeType col_stride;
+
+  [[nodiscard]] auto columnMajor() const -> bool {
+    return row_stride == 1 || rows <= 1;
+  }
+
+  [[nodiscard]] auto rowMajor() const -> bool {
+    return col_stride == 1 || cols <= 1;
+  }
+};
+
+template <typename A>
+auto denseVector(A &arr, SizeType n) {
+  using T = std::remove_reference_t<decltype(*arr.data())>;
+  if constexpr (requires { arr.isContiguous(); }) {
+    if (!arr.isContiguous()) {
+      throw std::invalid_argument("Storage is not contiguous");
+    }
+  }
+  if (arr.size() != n) {
+    throw std::invalid_argument("Size mismatch");
+  }
+  return DenseOperand<T>{arr.data(), n, 1, 1, n};
+}
+
+template <typename A>
+auto denseMatrix(A &arr, SizeType rows) {
+  using T = std::remove_reference_t<decltype(*arr.data())>;
+  if (arr.shape().size() != 2 || arr.shape()[0] != rows) {
+    throw std::invalid_argument("Size mismatch");
+  }
+  return DenseOperand<T>{arr.data(), rows,
+                         static_cast<SizeType>(arr.shape()[1]),
+                         static_cast<SizeType>(arr.strides()[0]),
+                         static_cast<SizeType>(arr.strides()[1])};
+}
+
+// rows of a CSR matrix the column-major products take per right-hand side,
+// so the block is still in cache for the next one
+inline constexpr SizeType SPARSE_ROW_BLOCK = 256;
+
+enum class DenseLayout { kColumns, kRows };
+
+template <typename T, typename U>
+auto checkSparseOperands(const DenseOperand<T> &x,
+                         const DenseOperand<U> &y) -> DenseLayout {
+  if (x.cols != y.cols) {
+    throw std::invalid_argument("Size mismatch");
+  }
+  if (0 < y.rows * y.cols &&
+      static_cast<const void *>(x.data) == static_cast<const void *>(y.data)) {
+    throw std::invalid_argument("Sparse product output is also an input");
+  }
+  if (x.columnMajor() && y.columnMajor()) {
+    return DenseLayout::kColumns;
+  }
+  if (x.rowMajor() && y.rowMajor()) {
+    return DenseLayout::kRows;
+  }
+  throw std::invalid_argument(
+      "Dense operands must both be column-major or both row-major");
+}
+
+template <typename T, typename U>
+auto csrProduct(const CsrMatrix<T> &a, const DenseOperand<U> &x,
+                const DenseOperand<T> &y, const ParallelOptions &options)
+    -> void {
+  const auto layout = checkSparseOperands(x, y);
+  const auto *offsets = a.rowOffsets().data();
+  const auto *columns = a.columns().data();
+  const auto *values = a.values().data();
+  parallelFor(
+      0, a.rows(),
+      [&](SizeType lo, SizeType hi) {
+        if (layout == DenseLayout::kRows) {
+          for (auto row = lo; row < hi; ++row) {
+            simd::gatherAxpy(values + offsets[row], columns + offsets[row], 1,
+                             offsets[row + 1] - offsets[row], x.data,
+                             x.row_stride, y.cols,
+                             y.data + row * y.row_stride);
+          }
+          return;
+        }
+        for (auto first = lo; first < hi; first += SPARSE_ROW_BLOCK) {
+          const auto count = std::min(SPARSE_ROW_BLOCK, hi - first);
+          for (SizeType j = 0; j < y.cols; ++j) {
+            simd::gatherDot(values, columns, offsets + first, count,
+                            x.data + j * x.col_stride,
+                            y.data + first + j * y.col_stride);
+          }
+        }
+      },
+      options);
+}
+
+template <typename T, typename U>
+auto sellProduct(const SellMatrix<T> &a, const DenseOperand<U> &x,
+                 const DenseOperand<T> &y, const ParallelOptions &options)
+    -> void {
+  constexpr auto C = SellMatrix<T>::SLICE_ROWS;
+  const auto layout = checkSparseOperands(x, y);
+  const auto *offsets = a.sliceOffsets().data();
+  const auto *permutation = a.permutation().data();
+  const auto *columns = a.columns().data();
+  const auto *values = a.values().data();
+  parallelFor(
+      0, a.slices(),
+      [&](SizeType lo, SizeType hi) {
+        T result[C];
+        for (auto slice = lo; slice < hi; ++slice) {
+          const auto first = offsets[slice];
+          const auto width = (offsets[slice + 1] - first) / C;
+          const auto lanes = std::min(C, a.rows() - slice * C);
+          if (layout == DenseLayout::kRows) {
+            for (SizeType l = 0; l < lanes; ++l) {
+              const auto row =
+                  static_cast<SizeType>(permutation[slice * C + l]);
+              simd::gatherAxpy(values + first + l, columns + first + l, C,
+                               width, x.data, x.row_stride, y.cols,
+                               y.data + row * y.row_stride);
+            }
+            continue;
+          }
+          for (SizeType j = 0; j < y.cols; ++j) {
+            simd::sliceDot(values + first, columns + first, width,
+                           x.data + j * x.col_stride, result);
+            auto *out = y.data + j * y.col_stride;
+            for (SizeType l = 0; l < lanes; ++l) {
+              out[permutation[slice * C + l]] = result[l];
+            }
+          }
+        }
+      },
+      options);
+}
+
+}  // namespace detail
+
+/**
+ * @brief y = a * x for a contiguous vector x of a.cols() elements and y of
+ * a.rows(); y must not be x.
+ */
+template <typename T, typename X, typename Y>
+auto spmv(const CsrMatrix<T> &a, const X &x, Y &y,
+          const ParallelOptions &options = {}) -> void {
+  detail::csrProduct(a, detail::denseVector(x, a.cols()),
+                     detail::denseVector(y, a.rows()), options);
+}
+
+template <typename T, typename X, typename Y>
+auto spmv(const SellMatrix<T> &a, const X &x, Y &y,
+          const ParallelOptions &options = {}) -> void {
+  detail::sellProduct(a, detail::denseVector(x, a.cols()),
+                      detail::denseVector(y, a.rows()), options);
+}
+
+/**
+ * @brief Y = a * X for an a.cols() x k matrix X and a.rows() x k matrix Y,
+ * e.g. 2-D Arrays or slices of them. Both are column-major, and a is read
+ * once per block of rows for all k columns, or both are row-major and every
+ * entry of a scales a contiguous row of X; the latter suits scattered
+ * patterns, whose gathers from k separate columns miss the cache k times.
+ */
+template <typename T, typename X, typename Y>
+auto spmm(const CsrMatrix<T> &a, const X &x, Y &y,
+          const ParallelOptions &options = {}) -> void {
+  detail::csrProduct(a, detail::denseMatrix(x, a.cols()),
+                     detail::denseMatrix(y, a.rows()), options);
+}
+
+template <typename T, typename X, typename Y>
+auto spmm(const SellMatrix<T> &a, const X &x, Y &y,
+          const ParallelOptions &options = {}) -> void {
+  detail::sellProduct(a, detail::denseMatrix(x, a.cols()),
+                      detail::denseMatrix(y, a.rows()), options);
+}
+
+template <typename T>
+inline CooMatrix<T>::CooMatrix(SizeType rows, SizeType cols)
+    : _rows{rows}, _cols{cols} {
+  detail::checkSparseShape(rows, cols);
+}
+
+template <typename T>
+inline auto CooMatrix<T>::add(SizeType row, SizeType col, T value) -> void {
+  if (_rows <= row || _cols <= col) {
+    throw std::out_of_range("Index out of range");
+  }
+  _row_indices.push_back(static_cast<SparseIndex>(row));
+  _col_indices.push_back(static_cast<SparseIndex>(col));
+  _values.push_back(std::move(value));
+}
+
+template <typename T>
+inline auto CooMatrix<T>::reserve(SizeType nnz) -> void {
+  _row_indices.reserve(nnz);
+  _col_indices.reserve(nnz);
+  _values.reserve(nnz);
+}
+
+template <typename T>
+inline auto CooMatrix<T>::clear() -> void {
+  _row_indices.clear();
+  _col_indices.clear();
+  _values.clear();
+}
+
+template <typename T>
+inline CsrMatrix<T>::CsrMatrix(const CooMatrix<T> &coo)
+    : _rows{coo.rows()}, _cols{coo.cols()} {
+  const auto rows = coo.rowIndices();
+  const auto cols = coo.colIndices();
+  const auto values = coo.values();
+
+  // bucket the triplets by row, keeping their order within a row
+  std::vector<SizeType> offsets(_rows + 1, 0);
+  for (auto row : rows) {
+    ++offsets[row + 1];
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<std::pair<SparseIndex, T>> entries(coo.nnz());
+  {
+    std::vector<SizeType> next(offsets.begin(), offsets.end() - 1);
+    for (SizeType k = 0; k < coo.nnz(); ++k) {
+      entries[next[rows[k]]++] = {cols[k], values[k]};
+    }
+  }
+
+  // sort every row by column and sum repeated columns in assembly order
+  _row_offsets = Array<SizeType>::empty({_rows + 1});
+  SizeType count = 0;
+  for (SizeType row = 0; row < _rows; ++row) {
+    _row_offsets[row] = count;
+    const auto first =
+        entries.begin() + static_cast<std::ptrdiff_t>(offsets[row]);
+    const auto last =
+        entries.begin() + static_cast<std::ptrdiff_t>(offsets[row + 1]);
+    std::stable_sort(first, last, [](const auto &lhs, const auto &rhs) {
+      return lhs.first < rhs.first;
+    });
+    for (auto it = first; it != last; ++it) {
+      if (_row_offsets[row] < count && entries[count - 1].first == it->first) {
+        entries[count - 1].second += it->second;
+      } else {
+        if (entries.begin() + static_cast<std::ptrdiff_t>(count) != it) {
+          entries[count] = std::move(*it);
+        }
+        ++count;
+      }
+    }
+  }
+  _row_offsets[_rows] = count;
+
+  _columns = Array<SparseIndex>::empty({count});
+  _values = Array<T>::empty({count});
+  for (SizeType k = 0; k < count; ++k) {
+    _columns[k] = entries[k].first;
+    _values[k] = std::move(entries[k].second);
+  }
+}
+
+template <typename T>
+inline auto CsrMatrix<T>::operator()(SizeType row, SizeType col) const -> T {
+  if (_rows <= row || _cols <= col) {
+    throw std::out_of_range("Index out of range");
+  }
+  const auto *first = _columns.data() + _row_offsets[row];
+  const auto *last = _columns.data() + _row_offsets[row + 1];
+  const auto *it = std::lower_bound(first, last, static_cast<SparseIndex>(col));
+  return it == last || *it != static_cast<SparseIndex>(col)
+             ? T{}
+             : _values[static_cast<SizeType>(it - _columns.data())];
+}
+
+template <typename T>
+inline SellMatrix<T>::SellMatrix(const CsrMatrix<T> &csr, SizeType sigma)
+    : _rows{csr.rows()}, _cols{csr.cols()}, _nnz{csr.nnz()} {
+  constexpr auto C = SLICE_ROWS;
+  const auto *offsets = csr.rowOffsets().data();
+  auto length = [&](SizeType row) { return offsets[row + 1] - offsets[row]; };
+
+  const auto slices = (_rows + C - 1) / C;
+  _permutation = Array<SparseIndex>::empty({_rows});
+  std::iota(_permutation.begin(), _permutation.end(), SparseIndex{0});
+  if (1 < sigma) {
+    const auto window = (sigma + C - 1) / C * C;
+    for (SizeType lo = 0; lo < _rows; lo += window) {
+      std::stable_sort(_permutation.begin() + lo,
+                       _permutation.begin() + std::min(_rows, lo + window),
+                       [&](SparseIndex lhs, SparseIndex rhs) {
+                         return length(rhs) < length(lhs);
+                       });
+    }
+  }
+
+  // a slice is as wide as its longest row
+  _slice_offsets = Array<SizeType>::empty({slices + 1});
+  _slice_offsets[0] = 0;
+  for (SizeType slice = 0; slice < slices; ++slice) {
+    SizeType width = 0;
+    for (auto slot = slice * C; slot < std::min(_rows, (slice + 1) * C);
+         ++slot) {
+      width = std::max(width, length(_permutation[slot]));
+    }
+    _slice_offsets[slice + 1] = _slice_offsets[slice] + width * C;
+  }
+
+  _columns = Array<SparseIndex>::empty({_slice_offsets[slices]});
+  _values = Array<T>::empty({_slice_offsets[slices]});
+  const auto *csr_columns = csr.columns().data();
+  const auto *csr_values = csr.values().data();
+  parallelFor(0, slices, [&](SizeType slice) {
+    const auto first = _slice_offsets[slice];
+    const auto width = (_slice_offsets[slice + 1] - first) / C;
+    for (SizeType l = 0; l < C; ++l) {
+      const auto slot = slice * C + l;
+      const auto row = slot < _rows ? static_cast<SizeType>(_permutation[slot])
+                                    : _rows;
+      const auto begin = row < _rows ? offsets[row] : 0;
+      const auto n = row < _rows ? length(row) : 0;
+      for (SizeType j = 0; j < width; ++j) {
+        const auto k = first + j * C + l;
+        if (j < n) {
+          _columns[k] = csr_columns[begin + j];
+          _values[k] = csr_values[begin + j];
+        } else {
+          _columns[k] = n == 0 ? 0 : csr_columns[begin + n - 1];
+          _values[k] = T{};
+        }
+      }
+    }
+  });
+}
+
+}  // namespace fz
+
+#endif  // __FZ_SPARSE_H__
@@ -0,0 +1,547 @@
+/**
+ * @file tiled.hpp
+ * @brief Arrays stored as fixed-size bricks, for stencil sweeps that should
+ * stay in cache.
+ *
+ * A TiledArray<T, 3, 8> keeps each 8 x 8 x 8 brick of the grid in one
+ * contiguous 512-element block, so a brick and its neighbours are a few pages
+ * rather than a few planes of a linear layout. Element (i, j, k) is still
+ * arr(i, j, k); kernels that want the speed iterate brick by brick with
+ * tile() or forEachTile() and index inside the brick.
+ *
+ * Inside a brick the elements are either first index fastest
+ * (TileOrder::kLinear) or in Morton (Z) order, which keeps every 2 x 2 x 2
+ * sub-cube within a cache line or two.
+ */
+
+#ifndef __FZ_TILED_H__
+#define __FZ_TILED_H__
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "fz/allocator.hpp"
+#include "fz/array.hpp"
+#include "fz/array_base.hpp"
+#include "fz/parallel/parallel_for.hpp"
+
+namespace fz {
+
+enum class TileOrder { kLinear, kMorton };
+
+namespace detail {
+
+/**
+ * @brief Offset of local index x along dimension d within a Morton-ordered
+ * brick, for every x < Edge: the bits of x spread to every Rank-th position.
+ * The offset of a local multi-index is the sum over dimensions.
+ */
+template <SizeType Rank, SizeType Edge>
+inline constexpr auto MORTON_SPREAD = [] {
+  std::array<std::array<SizeType, Edge>, Rank> table{};
+  for (SizeType d = 0; d < Rank; ++d) {
+    for (SizeType x = 0; x < Edge; ++x) {
+      for (SizeType bit = 0; (x >> bit) != 0; ++bit) {
+        table[d][x] |= ((x >> bit) & 1U) << (bit * Rank + d);
+      }
+    }
+  }
+  return table;
+}();
+
+}  // namespace detail
+
+/**
+ * @brief One brick of a TiledArray: origin is the global index of its local
+ * element (0, 0, ...), extent how much of it lies inside the array (less
+ * than Edge along the far faces of a grid that is not a multiple of Edge).
+ */
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order>
+class Brick {
+ public:
+  using Index = std::array<SizeType, Rank>;
+
+  static constexpr SizeType VOLUME = [] {
+    SizeType volume = 1;
+    for (SizeType d = 0; d < Rank; ++d) {
+      volume *= Edge;
+    }
+    return volume;
+  }();
+
+ public:
+  Brick(T *data, Index origin, Index extent)
+      : _data{data}, _origin{origin}, _extent{extent} {}
+
+  [[nodiscard]] auto data() const -> T * { return _data; }
+
+  [[nodiscard]] auto origin() const -> const Index & { return _origin; }
+
+  [[nodiscard]] auto extent() const -> const Index & { return _extent; }
+
+  // offset of local element (args...) from data()
+  template <typename... Args>
+  static constexpr auto offset(Args... args) -> SizeType {
+    static_assert(sizeof...(Args) == Rank, "Invalid number of arguments");
+    return localOffset(std::make_index_sequence<Rank>{},
+                       static_cast<SizeType>(args)...);
+  }
+
+  // offset of local element x along dimension d alone, x * Edge^d in linear
+  // bricks; offset() is the sum of these, so kernels can hoist the outer
+  // dimensions out of inner loops
+  static constexpr auto spread(SizeType d, SizeType x) -> SizeType {
+    if constexpr (Order == TileOrder::kLinear) {
+      return x << (d * std::countr_zero(Edge));
+    } else {
+      return detail::MORTON_SPREAD<Rank, Edge>[d][x];
+    }
+  }
+
+  template <typename... Args>
+  auto operator()(Args... args) const -> T & {
+    return _data[offset(args...)];
+  }
+
+  /**
+   * @brief Call f(index, element) for the elements of the brick inside the
+   * array, with index the global multi-index.
+   */
+  template <typename F>
+  auto forEach(F &&f) const -> void {
+    for (SizeType d = 0; d < Rank; ++d) {
+      if (_extent[d] == 0) {
+        return;
+      }
+    }
+    Index local{};
+    Index global = _origin;
+    while (true) {
+      SizeType at = 0;
+      for (SizeType d = 0; d < Rank; ++d) {
+        at += spread(d, local[d]);
+      }
+      f(static_cast<const Index &>(global), _data[at]);
+      SizeType d = 0;
+      for (; d < Rank; ++d) {
+        ++global[d];
+        if (++local[d] < _extent[d]) {
+          break;
+        }
+        global[d] = _origin[d];
+        local[d] = 0;
+      }
+      if (d == Rank) {
+        return;
+      }
+    }
+  }
+
+ private:
+  T *_data;
+  Index _origin;
+  Index _extent;
+
+  template <std::size_t... Ds, typename... Args>
+  static constexpr auto localOffset(std::index_sequence<Ds...> /*dims*/,
+                                    Args... args) -> SizeType {
+    return (spread(Ds, args) + ...);
+  }
+};
+
+/**
+ * @brief Rank-dimensional array stored brick by brick. Bricks are Edge
+ * elements on a side (a power of two) and laid out first brick index
+ * fastest; the grid is padded up to whole bricks.
+ */
+template <typename T, SizeType Rank, SizeType Edge = 8,
+          TileOrder Order = TileOrder::kLinear, typename Alloc = Allocator<T>>
+class TiledArray {
+  static_assert(0 < Rank, "TiledArray needs at least one dimension");
+  static_assert(1 < Edge && std::has_single_bit(Edge),
+                "The brick edge must be a power of two");
+
+ public:
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+  using Index = std::array<SizeType, Rank>;
+  using Tile = Brick<T, Rank, Edge, Order>;
+  using ConstTile = Brick<const T, Rank, Edge, Order>;
+
+  static constexpr SizeType EDGE = Edge;
+  static constexpr SizeType VOLUME = Tile::VOLUME;
+
+ public:
+  static auto empty(const Index &shape, const Alloc &alloc = Alloc{})
+      -> TiledArray;
+
+  static auto zeros(const Index &shape, const Alloc &alloc = Alloc{})
+      -> TiledArray;
+
+  /**
+   * @brief Copy an Array, view or expression of the same rank into bricks.
+   */
+  template <ExpressionConcept E>
+  static auto from(const E &expr, const Alloc &alloc = Alloc{}) -> TiledArray;
+
+ public:
+  TiledArray() = default;
+
+  [[nodiscard]] auto size() const -> SizeType;
+
+  auto shape() const -> const Index & { return _shape; }
+
+  // bricks along each dimension
+  auto grid() const -> const Index & { return _grid; }
+
+  [[nodiscard]] auto tileCount() const -> SizeType;
+
+  template <typename... Args>
+  auto operator()(Args... args) -> T &;
+
+  template <typename... Args>
+  auto operator()(Args... args) const -> const T &;
+
+  auto element(const Index &index) const -> const T &;
+
+  auto tile(SizeType b) -> Tile;
+
+  auto tile(SizeType b) const -> ConstTile;
+
+  // brick b as a multi-index into grid()
+  auto tileIndex(SizeType b) const -> Index;
+
+  // the brick after b along dimension d is b + tileStrides()[d]
+  auto tileStrides() const -> const Index & { return _tile_strides; }
+
+  /**
+   * @brief Copy brick b and `halo` layers of its neighbours into out, a
+   * dense first-index-fastest block of (EDGE + 2 halo)^Rank elements whose
+   * element (halo, halo, ...) is the brick's origin. Stencil kernels then
+   * read the block with fixed strides. Parts of the block outside the array
+   * are left untouched. halo is at most EDGE. Without diagonals only the
+   * face neighbours are copied, which is all a star stencil (e.g. 7-point)
+   * reads; the edge and corner regions of the block are then untouched too.
+   */
+  auto gather(SizeType b, SizeType halo, T *out, bool diagonals = true) const
+      -> void;
+
+  /**
+   * @brief Call f(tile) for every brick, in parallel over bricks.
+   */
+  template <typename F>
+  auto forEachTile(F &&f, const ParallelOptions &options = {}) -> void;
+
+  template <typename F>
+  auto forEachTile(F &&f, const ParallelOptions &options = {}) const -> void;
+
+  /**
+   * @brief The elements in a dense column-major Array.
+   */
+  auto toArray() const -> FixedRankArray<T, Rank>;
+
+  // the padded brick storage, tileCount() * VOLUME elements
+  auto data() -> T * { return _storage.data(); }
+
+  auto data() const -> const T * { return _storage.data(); }
+
+ private:
+  static constexpr SizeType SHIFT = std::countr_zero(Edge);
+  static constexpr SizeType MASK = Edge - 1;
+
+  Index _shape{};
+  Index _grid{};
+  // brick b + 1 along dimension d is _tile_strides[d] bricks further on
+  Index _tile_strides{};
+  FixedRankArray<T, 1, Alloc> _storage;
+
+  // the brick grid for shape, with no storage yet; returns the brick count
+  auto setShape(const Index &shape) -> SizeType;
+
+  template <std::size_t... Ds, typename... Args>
+  auto offset(std::index_sequence<Ds...> /*dims*/, Args... args) const
+      -> SizeType;
+
+  auto brickAt(SizeType b) const -> std::pair<Index, Index>;
+};
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+auto TiledArray<T, Rank, Edge, Order, Alloc>::empty(const Index &shape,
+                                                    const Alloc &alloc)
+    -> TiledArray {
+  TiledArray arr;
+  const auto tiles = arr.setShape(shape);
+  arr._storage = FixedRankArray<T, 1, Alloc>::empty({tiles * VOLUME}, alloc);
+  return arr;
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+auto TiledArray<T, Rank, Edge, Order, Alloc>::zeros(const Index &shape,
+                                                    const Alloc &alloc)
+    -> TiledArray {
+  TiledArray arr;
+  const auto tiles = arr.setShape(shape);
+  arr._storage = FixedRankArray<T, 1, Alloc>::zeros({tiles * VOLUME}, alloc);
+  return arr;
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+template <ExpressionConcept E>
+auto TiledArray<T, Rank, Edge, Order, Alloc>::from(const E &expr,
+                                                   const Alloc &alloc)
+    -> TiledArray {
+  if (expr.shape().size() != Rank) {
+    throw std::invalid_argument("Invalid number of dimensions");
+  }
+  Index shape{};
+  std::copy(expr.shape().begin(), expr.shape().end(), shape.begin());
+  auto arr = zeros(shape, alloc);
+  arr.forEachTile([&](const Tile &tile) {
+    tile.forEach([&](const Index &index, T &value) {
+      value = static_cast<T>(expr.element(index));
+    });
+  });
+  return arr;
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::size() const -> SizeType {
+  SizeType n = 1;
+  for (auto extent : _shape) {
+    n *= extent;
+  }
+  return n;
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::tileCount() const
+    -> SizeType {
+  return _storage.size() / VOLUME;
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::setShape(
+    const Index &shape) -> SizeType {
+  _shape = shape;
+  SizeType tiles = 1;
+  for (SizeType d = 0; d < Rank; ++d) {
+    _grid[d] = (shape[d] + Edge - 1) >> SHIFT;
+    _tile_strides[d] = tiles;
+    tiles *= _grid[d];
+  }
+  return tiles;
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+template <std::size_t... Ds, typename... Args>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::offset(
+    std::index_sequence<Ds...> /*dims*/, Args... args) const -> SizeType {
+  const auto brick =
+      (((static_cast<SizeType>(args) >> SHIFT) * _tile_strides[Ds]) + ...);
+  return brick * VOLUME +
+         (Tile::spread(Ds, static_cast<SizeType>(args) & MASK) + ...);
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+template <typename... Args>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::operator()(Args... args)
+    -> T & {
+  static_assert(sizeof...(Args) == Rank, "Invalid number of arguments");
+  return _storage.data()[offset(std::make_index_sequence<Rank>{}, args...)];
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+template <typename... Args>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::operator()(
+    Args... args) const -> const T & {
+  static_assert(sizeof...(Args) == Rank, "Invalid number of arguments");
+  return _storage.data()[offset(std::make_index_sequence<Rank>{}, args...)];
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::element(
+    const Index &index) const -> const T & {
+  return std::apply([this](auto... i) -> const T & { return (*this)(i...); },
+                    index);
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::tileIndex(
+    SizeType b) const -> Index {
+  Index index{};
+  for (SizeType d = 0; d < Rank; ++d) {
+    index[d] = b % _grid[d];
+    b /= _grid[d];
+  }
+  return index;
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::brickAt(SizeType b) const
+    -> std::pair<Index, Index> {
+  auto origin = tileIndex(b);
+  Index extent{};
+  for (SizeType d = 0; d < Rank; ++d) {
+    origin[d] <<= SHIFT;
+    extent[d] = std::min(Edge, _shape[d] - origin[d]);
+  }
+  return {origin, extent};
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::tile(SizeType b)
+    -> Tile {
+  auto [origin, extent] = brickAt(b);
+  return Tile{_storage.data() + b * VOLUME, origin, extent};
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+inline auto TiledArray<T, Rank, Edge, Order, Alloc>::tile(SizeType b) const
+    -> ConstTile {
+  auto [origin, extent] = brickAt(b);
+  return ConstTile{_storage.data() + b * VOLUME, origin, extent};
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+auto TiledArray<T, Rank, Edge, Order, Alloc>::gather(SizeType b, SizeType halo,
+                                                     T *out,
+                                                     bool diagonals) const
+    -> void {
+  if (Edge < halo) {
+    throw std::invalid_argument("Halo wider than a brick");
+  }
+  const auto home = tileIndex(b);
+  const auto side = Edge + 2 * halo;
+
+  // the 3^Rank bricks around b, each contributing a box of its elements
+  std::array<int, Rank> dir{};
+  dir.fill(-1);
+  while (true) {
+    bool inside =
+        diagonals || std::count(dir.begin(), dir.end(), 0) + 1 >=
+                         static_cast<std::ptrdiff_t>(Rank);
+    SizeType brick = 0;
+    Index lo{};
+    Index hi{};
+    SizeType stride = 1;
+    SizeType dst_base = 0;
+    for (SizeType d = 0; d < Rank && inside; ++d) {
+      const auto t = static_cast<std::ptrdiff_t>(home[d]) + dir[d];
+      if (t < 0 || _grid[d] <= static_cast<SizeType>(t) ||
+          (halo == 0 && dir[d] != 0)) {
+        inside = false;
+        break;
+      }
+      const auto origin = static_cast<SizeType>(t) << SHIFT;
+      brick += static_cast<SizeType>(t) * _tile_strides[d];
+      lo[d] = dir[d] < 0 ? Edge - halo : 0;
+      hi[d] = std::min(dir[d] > 0 ? halo : Edge, _shape[d] - origin);
+      inside = lo[d] < hi[d];
+      // local x of this brick lands at x + halo + dir * Edge in out
+      dst_base +=
+          (lo[d] + halo + Edge * static_cast<SizeType>(dir[d] + 1) - Edge) *
+          stride;
+      stride *= side;
+    }
+
+    if (inside) {
+      const auto *src = _storage.data() + brick * VOLUME;
+      Index local = lo;
+      SizeType row = dst_base;
+      while (true) {
+        SizeType outer = 0;
+        for (SizeType d = 1; d < Rank; ++d) {
+          outer += Tile::spread(d, local[d]);
+        }
+        if constexpr (Order == TileOrder::kLinear) {
+          std::copy(src + outer + lo[0], src + outer + hi[0], out + row);
+        } else {
+          for (auto x = lo[0]; x < hi[0]; ++x) {
+            out[row + x - lo[0]] = src[outer + Tile::spread(0, x)];
+          }
+        }
+        SizeType d = 1;
+        SizeType step = side;
+        for (; d < Rank; ++d) {
+          row += step;
+          if (++local[d] < hi[d]) {
+            break;
+          }
+          row -= step * (hi[d] - lo[d]);
+          local[d] = lo[d];
+          step *= side;
+        }
+        if (d >= Rank) {
+          break;
+        }
+      }
+    }
+
+    SizeType d = 0;
+    for (; d < Rank; ++d) {
+      if (++dir[d] <= 1) {
+        break;
+      }
+      dir[d] = -1;
+    }
+    if (d == Rank) {
+      return;
+    }
+  }
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+template <typename F>
+auto TiledArray<T, Rank, Edge, Order, Alloc>::forEachTile(
+    F &&f, const ParallelOptions &options) -> void {
+  parallelFor(
+      0, tileCount(), [&](SizeType b) { f(tile(b)); }, options);
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+template <typename F>
+auto TiledArray<T, Rank, Edge, Order, Alloc>::forEachTile(
+    F &&f, const ParallelOptions &options) const -> void {
+  parallelFor(
+      0, tileCount(), [&](SizeType b) { f(tile(b)); }, options);
+}
+
+template <typename T, SizeType Rank, SizeType Edge, TileOrder Order,
+          typename Alloc>
+auto TiledArray<T, Rank, Edge, Order, Alloc>::toArray() const
+    -> FixedRankArray<T, Rank> {
+  auto arr = FixedRankArray<T, Rank>::empty(_shape);
+  forEachTile([&](const ConstTile &tile) {
+    tile.forEach([&](const Index &index, const T &value) {
+      arr.data()[detail::indexOffset(arr.strides(), index)] = value;
+    });
+  });
+  return arr;
+}
+
+}  // namespace fz
+
+#endif  // __FZ_TILED_H__
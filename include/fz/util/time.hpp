@@ -2,28 +2,239 @@
 #define __FZ_UTIL_TIME_H__
 
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <ratio>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define FZ_HAS_TSC 1
+#endif
+
 namespace fz {
 
-template <typename Func, typename... Args>
-inline auto measureTime(Func func, Args&&... args) {
-  using FuncReturnType = decltype(func(std::forward<Args>(args)...));
-  using TimeDuration = decltype(std::chrono::high_resolution_clock::now() -
-                                std::chrono::high_resolution_clock::now());
-
-  const auto start = std::chrono::high_resolution_clock::now();
-  if constexpr (std::is_same_v<void, FuncReturnType>) {
-    func(std::forward<Args>(args)...);
-    auto end = std::chrono::high_resolution_clock::now();
-    return (end - start);
+/**
+ * @brief Clock on the invariant time stamp counter, calibrated against
+ * steady_clock on first use (about 10 ms). Meets the chrono Clock
+ * requirements; without an invariant TSC (or off x86) it reads
+ * steady_clock instead.
+ *
+ * now() is fenced so that it neither drifts into nor out of the code it
+ * brackets; ticks() is the bare counter for hot paths that convert later.
+ */
+class TscClock {
+ public:
+  using rep = std::int64_t;
+  using period = std::nano;
+  using duration = std::chrono::duration<rep, period>;
+  using time_point = std::chrono::time_point<TscClock>;
+  static constexpr bool is_steady = true;
+
+  struct Calibration {
+    // false: ticks are steady_clock nanoseconds
+    bool tsc;
+    bool rdtscp;
+    double ns_per_tick;
+    std::int64_t origin;
+  };
+
+  static auto calibration() -> const Calibration&;
+
+  static auto now() noexcept -> time_point;
+
+  // unserialized counter: cheapest, may be reordered by a few dozen cycles
+  static auto ticks() noexcept -> std::int64_t;
+
+  // length of a span of ticks
+  static auto toDuration(std::int64_t ticks) noexcept -> duration;
+
+ private:
+  static auto calibrate() -> Calibration;
+
+#ifdef FZ_HAS_TSC
+  // counter and steady_clock at the same instant: the tightest of a few
+  // bracketed reads, so a preemption between the two does not skew the pair
+  static auto pairedRead() noexcept -> std::pair<std::int64_t, std::int64_t>;
+#endif
+
+  static auto steadyNs() noexcept -> std::int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+};
+
+#ifdef FZ_HAS_TSC
+inline auto TscClock::pairedRead() noexcept
+    -> std::pair<std::int64_t, std::int64_t> {
+  std::pair<std::int64_t, std::int64_t> best{};
+  auto best_gap = std::numeric_limits<std::int64_t>::max();
+  for (int k = 0; k < 5; ++k) {
+    const auto before = static_cast<std::int64_t>(__rdtsc());
+    const auto ns = steadyNs();
+    const auto after = static_cast<std::int64_t>(__rdtsc());
+    if (after - before < best_gap) {
+      best_gap = after - before;
+      best = {before + (after - before) / 2, ns};
+    }
+  }
+  return best;
+}
+#endif
+
+inline auto TscClock::calibrate() -> Calibration {
+#ifdef FZ_HAS_TSC
+  unsigned a = 0;
+  unsigned b = 0;
+  unsigned c = 0;
+  unsigned d = 0;
+  // CPUID.80000007H:EDX[8]: the TSC ticks at a constant rate in all states
+  const auto invariant = __get_cpuid(0x80000007, &a, &b, &c, &d) != 0 &&
+                         (d & (1U << 8)) != 0;
+  if (invariant) {
+    const auto rdtscp =
+        __get_cpuid(0x80000001, &a, &b, &c, &d) != 0 && (d & (1U << 27)) != 0;
+    const auto [tick0, ns0] = pairedRead();
+    auto tick1 = tick0;
+    auto ns1 = ns0;
+    while (ns1 - ns0 < 10'000'000) {
+      std::tie(tick1, ns1) = pairedRead();
+    }
+    return {true, rdtscp,
+            static_cast<double>(ns1 - ns0) / static_cast<double>(tick1 - tick0),
+            tick0};
+  }
+#endif
+  return {false, false, 1.0, 0};
+}
+
+inline auto TscClock::calibration() -> const Calibration& {
+  static const Calibration calibration = calibrate();
+  return calibration;
+}
+
+inline auto TscClock::ticks() noexcept -> std::int64_t {
+#ifdef FZ_HAS_TSC
+  if (calibration().tsc) {
+    return static_cast<std::int64_t>(__rdtsc());
+  }
+#endif
+  return steadyNs();
+}
+
+inline auto TscClock::toDuration(std::int64_t ticks) noexcept -> duration {
+  return duration{static_cast<rep>(
+      std::llround(static_cast<double>(ticks) * calibration().ns_per_tick))};
+}
+
+inline auto TscClock::now() noexcept -> time_point {
+  const auto& c = calibration();
+#ifdef FZ_HAS_TSC
+  if (c.tsc) {
+    std::int64_t t = 0;
+    if (c.rdtscp) {
+      // rdtscp waits for earlier instructions, the fence holds later ones
+      unsigned aux = 0;
+      t = static_cast<std::int64_t>(__rdtscp(&aux));
+    } else {
+      _mm_lfence();
+      t = static_cast<std::int64_t>(__rdtsc());
+    }
+    _mm_lfence();
+    return time_point{toDuration(t - c.origin)};
+  }
+#endif
+  return time_point{duration{steadyNs()}};
+}
+
+/**
+ * @brief Return value of a timed call next to its duration. The value is
+ * constructed in place from the call, and `auto [duration, value] = ...`
+ * binds to it without a copy or move.
+ */
+template <typename Duration, typename T>
+struct TimedResult {
+  template <typename F, typename Stop>
+  TimedResult(F&& f, Stop&& stop)
+      : value(std::invoke(std::forward<F>(f))), duration(stop()) {}
+
+  // declared first: initialized by the call, before the clock is read
+  T value;
+  Duration duration;
+
+  template <std::size_t I>
+  auto get() & -> decltype(auto) {
+    if constexpr (I == 0) {
+      return (duration);
+    } else {
+      return (value);
+    }
+  }
+
+  template <std::size_t I>
+  auto get() const& -> decltype(auto) {
+    if constexpr (I == 0) {
+      return (duration);
+    } else {
+      return (value);
+    }
+  }
+
+  template <std::size_t I>
+  auto get() && -> decltype(auto) {
+    if constexpr (I == 0) {
+      return std::move(duration);
+    } else {
+      return std::forward<T>(value);
+    }
+  }
+};
+
+/**
+ * @brief Time func(args...) on Clock. Returns the duration, or a
+ * TimedResult holding the duration and the return value.
+ */
+template <typename Clock = std::chrono::steady_clock, typename Func,
+          typename... Args>
+inline auto measureTime(Func&& func, Args&&... args) {
+  using FuncReturnType = std::invoke_result_t<Func, Args...>;
+
+  const auto start = Clock::now();
+  if constexpr (std::is_void_v<FuncReturnType>) {
+    std::invoke(std::forward<Func>(func), std::forward<Args>(args)...);
+    return Clock::now() - start;
   } else {
-    FuncReturnType ret = func(std::forward<Args>(args)...);
-    auto end = std::chrono::high_resolution_clock::now();
-    return std::tuple<TimeDuration, FuncReturnType>{(end - start), ret};
+    using TimeDuration = decltype(Clock::now() - start);
+    return TimedResult<TimeDuration, FuncReturnType>{
+        [&]() -> FuncReturnType {
+          return std::invoke(std::forward<Func>(func),
+                             std::forward<Args>(args)...);
+        },
+        [&start]() { return Clock::now() - start; }};
   }
 }
 
 }  // namespace fz
 
+template <typename Duration, typename T>
+struct std::tuple_size<fz::TimedResult<Duration, T>>
+    : std::integral_constant<std::size_t, 2> {};
+
+template <typename Duration, typename T>
+struct std::tuple_element<0, fz::TimedResult<Duration, T>> {
+  using type = Duration;
+};
+
+template <typename Duration, typename T>
+struct std::tuple_element<1, fz::TimedResult<Duration, T>> {
+  using type = T;
+};
+
 #endif  // __FZ_UTIL_TIME_H__
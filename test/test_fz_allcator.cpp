@@ -1,10 +1,85 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <complex>
+#include <cstdint>
 #include <random>
 #include <ranges>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "fz/allocator.hpp"
+#include "fz/array.hpp"
+
+namespace {
+
+// stateful allocator: two instances compare equal only with the same id
+template <typename T>
+struct TaggedAllocator {
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using is_always_equal = std::false_type;
+
+  int id = 0;
+
+  TaggedAllocator() = default;
+
+  explicit TaggedAllocator(int id) : id{id} {}
+
+  template <typename U>
+  TaggedAllocator(const TaggedAllocator<U>& other) : id{other.id} {}  // NOLINT
+
+  auto allocate(std::size_t n) -> T* {
+    return fz::Allocator<T>{}.allocate(n);
+  }
+
+  auto deallocate(T* p, std::size_t n) -> void {
+    fz::Allocator<T>{}.deallocate(p, n);
+  }
+
+  friend auto operator==(const TaggedAllocator& lhs, const TaggedAllocator& rhs)
+      -> bool {
+    return lhs.id == rhs.id;
+  }
+};
+
+// counts live instances; the copy that makes the limit-th one throws
+struct Counted {
+  static inline int live = 0;
+  static inline int limit = 1 << 30;
+
+  int value = 0;
+
+  explicit Counted(int value) : value{value} { ++live; }
+
+  Counted(const Counted& other) : value{other.value} {
+    if (live + 1 >= limit) {
+      throw std::runtime_error("copy");
+    }
+    ++live;
+  }
+
+  auto operator=(const Counted&) -> Counted& = default;
+
+  ~Counted() { --live; }
+};
+
+template <typename Array>
+auto allZero(const Array& arr) -> bool {
+  using T = typename Array::value_type;
+  return std::ranges::all_of(arr, [](const auto& x) { return x == T{}; });
+}
+
+template <typename T>
+auto isAligned(const T* p, std::size_t alignment) -> bool {
+  return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+}  // namespace
 
 TEST(Allocator, BasicBuildInType) {
   /*
@@ -14,6 +89,294 @@ TEST(Allocator, BasicBuildInType) {
     - deallocate
     - destroy
    */
+  fz::Allocator<int> alloc;
+  auto* p = alloc.allocate(16);
+  ASSERT_NE(p, nullptr);
+  for (int i = 0; i < 16; ++i) {
+    alloc.constructAt(p + i, i);
+  }
+  for (int i = 0; i < 16; ++i) {
+    EXPECT_EQ(p[i], i);
+    alloc.destroy(p + i);
+  }
+  alloc.deallocate(p, 16);
+
+  EXPECT_THROW(alloc.allocate(alloc.maxSize() + 1), std::bad_array_new_length);
+  EXPECT_TRUE(alloc == fz::Allocator<double>{});
+}
+
+TEST(Allocator, NonTrivialType) {
+  fz::Allocator<std::string> alloc;
+  auto* p = alloc.allocate(4);
+  for (int i = 0; i < 4; ++i) {
+    alloc.constructAt(p + i, std::string(32, static_cast<char>('a' + i)));
+  }
+  EXPECT_EQ(p[3], std::string(32, 'd'));
+  for (int i = 0; i < 4; ++i) {
+    alloc.destroy(p + i);
+  }
+  alloc.deallocate(p, 4);
+}
+
+TEST(Allocator, Aligned) {
+  fz::AlignedAllocator<double> alloc;
+  for (std::size_t n : {1, 3, 17, 1000}) {
+    auto* p = alloc.allocate(n);
+    EXPECT_TRUE(isAligned(p, FZ_DEFAULT_ALIGNMENT));
+    alloc.deallocate(p, n);
+  }
+
+  fz::AlignedAllocator<float, 4096> page;
+  auto* p = page.allocate(10);
+  EXPECT_TRUE(isAligned(p, 4096));
+  page.deallocate(p, 10);
+}
+
+TEST(Allocator, HugePage) {
+  fz::HugePageAllocator<double> alloc;
+
+  auto* small = alloc.allocate(100);
+  EXPECT_TRUE(isAligned(small, FZ_DEFAULT_ALIGNMENT));
+  alloc.deallocate(small, 100);
+
+  // 3 MiB: spans two huge pages
+  const std::size_t n = (std::size_t{3} << 20) / sizeof(double);
+  auto* large = alloc.allocate(n);
+  EXPECT_TRUE(isAligned(large, fz::HugePageAlloc::HUGE_PAGE_SIZE));
+  large[0] = 1.0;
+  large[n - 1] = 2.0;
+  EXPECT_EQ(large[0] + large[n - 1], 3.0);
+  alloc.deallocate(large, n);
+}
+
+TEST(Allocator, ArrayStorage) {
+  using AlignedArray =
+      fz::Array<float, std::vector<fz::SizeType>, std::vector<fz::SizeType>,
+                fz::AlignedAllocator<float>>;
+  auto a = AlignedArray::empty({7, 5});
+  EXPECT_TRUE(isAligned(a.data(), 64));
+  std::ranges::fill(a, 1.5F);
+  a.resize({9, 9});
+  EXPECT_TRUE(isAligned(a.data(), 64));
+
+  using HugeArray =
+      fz::FixedRankArray<double, 3, fz::HugePageAllocator<double>>;
+  auto h = HugeArray::empty({64, 64, 128});
+  EXPECT_TRUE(isAligned(h.data(), fz::HugePageAlloc::HUGE_PAGE_SIZE));
+  h(63, 63, 127) = 4.0;
+  auto copy = h;
+  EXPECT_EQ(copy(63, 63, 127), 4.0);
+
+  fz::Array<std::string> strings{"fz", "array"};
+  auto more = strings;
+  strings.resize({4});
+  EXPECT_EQ(more[1], "array");
+  EXPECT_TRUE(strings[3].empty());
+}
+
+TEST(Allocator, ZeroedStorage) {
+  fz::Allocator<double> alloc;
+  auto* p = alloc.allocateZeroed(100000);
+  EXPECT_TRUE(std::all_of(p, p + 100000, [](double x) { return x == 0; }));
+  alloc.deallocate(p, 100000);
+
+  fz::HugePageAllocator<float> huge;
+  for (std::size_t n : {std::size_t{100}, std::size_t{3} << 20}) {
+    auto* q = huge.allocateZeroed(n);
+    EXPECT_TRUE(std::all_of(q, q + n, [](float x) { return x == 0; }));
+    huge.deallocate(q, n);
+  }
+
+  // storage handed back dirty must still come out of zeros() as zeros
+  for (int round = 0; round < 2; ++round) {
+    auto dirty = fz::Array<double>::empty({300, 300});
+    std::ranges::fill(dirty, 7.0);
+    auto clean = fz::Array<double>::zeros({300, 300});
+    EXPECT_TRUE(allZero(clean));
+  }
+  EXPECT_TRUE(allZero(fz::Array<int>::zeros({3, 2})));
+  EXPECT_TRUE(allZero(fz::Array<std::complex<float>>::zeros({50, 50})));
+  EXPECT_TRUE(allZero(
+      fz::FixedRankArray<double, 3, fz::HugePageAllocator<double>>::zeros(
+          {64, 64, 128})));
+
+  using Tagged =
+      fz::Array<int, std::vector<fz::SizeType>, std::vector<fz::SizeType>,
+                TaggedAllocator<int>>;
+  EXPECT_TRUE(allZero(Tagged::zeros({40, 40}, TaggedAllocator<int>{1})));
+  auto strings = fz::Array<std::string>::zeros({20});
+  EXPECT_TRUE(std::ranges::all_of(strings, &std::string::empty));
+}
+
+TEST(Allocator, UninitializedCopyAndFill) {
+  fz::Allocator<int> ints;
+  const std::vector<int> source{1, 2, 3, 4, 5};
+  auto* p = ints.allocate(5);
+  EXPECT_EQ(fz::uninitializedCopy(source.data(), source.data() + 5, p), p + 5);
+  EXPECT_TRUE(std::equal(p, p + 5, source.begin()));
+  EXPECT_EQ(fz::uninitializedFillN(p, 5, -1), p + 5);
+  EXPECT_TRUE(std::all_of(p, p + 5, [](int x) { return x == -1; }));
+  fz::uninitializedFill(p, p + 5, 258);
+  EXPECT_TRUE(std::all_of(p, p + 5, [](int x) { return x == 258; }));
+  ints.deallocate(p, 5);
+
+  // a throwing copy destroys what was already built
+  fz::Allocator<Counted> alloc;
+  const std::vector<Counted> items(4, Counted{9});
+  auto* q = alloc.allocate(4);
+  fz::uninitializedCopy(items.begin(), items.end(), q);
+  EXPECT_EQ(q[3].value, 9);
+  EXPECT_EQ(Counted::live, 8);
+  fz::destroy(q, q + 4);
+
+  Counted::limit = Counted::live + 3;
+  EXPECT_THROW(fz::uninitializedCopy(items.begin(), items.end(), q),
+               std::runtime_error);
+  EXPECT_EQ(Counted::live, 4);
+  EXPECT_THROW(fz::uninitializedFillN(q, 4, items[0]), std::runtime_error);
+  EXPECT_EQ(Counted::live, 4);
+  Counted::limit = 1 << 30;
+  alloc.deallocate(q, 4);
+}
+
+TEST(Allocator, Propagation) {
+  using Tagged =
+      fz::Array<int, std::vector<fz::SizeType>, std::vector<fz::SizeType>,
+                TaggedAllocator<int>>;
+  auto a = Tagged::empty({3, 4}, TaggedAllocator<int>{7});
+  std::ranges::fill(a, 2);
+  EXPECT_EQ(a.getAllocator().id, 7);
+
+  Tagged copy = a;
+  EXPECT_EQ(copy.getAllocator().id, 7);
+  EXPECT_EQ(Tagged::emptyLike(a).getAllocator().id, 7);
+
+  Tagged b{{1, 2, 3}, TaggedAllocator<int>{9}};
+  b = a;
+  EXPECT_EQ(b.getAllocator().id, 7);
+  EXPECT_EQ(b(2, 3), 2);
+
+  auto* storage = a.data();
+  Tagged moved = std::move(a);
+  EXPECT_EQ(moved.getAllocator().id, 7);
+  EXPECT_EQ(moved.data(), storage);
+
+  Tagged c{{1}, TaggedAllocator<int>{3}};
+  c = std::move(moved);
+  EXPECT_EQ(c.getAllocator().id, 7);
+  EXPECT_EQ(c.data(), storage);
+}
+
+TEST(Allocator, MonotonicArena) {
+  fz::MonotonicArena arena{1024};
+  auto* a = arena.allocate(100);
+  auto* b = arena.allocate(8, 64);
+  EXPECT_TRUE(isAligned(static_cast<char*>(b), 64));
+  EXPECT_GE(static_cast<char*>(b) - static_cast<char*>(a), 100);
+
+  auto mark = arena.mark();
+  auto used = arena.used();
+  arena.allocate(4096);  // bigger than a chunk
+  arena.allocate(512);
+  EXPECT_GT(arena.used(), used + 4096);
+  auto capacity = arena.capacity();
+
+  arena.rewind(mark);
+  EXPECT_EQ(arena.used(), used);
+  // the chunks are reused, not reallocated
+  arena.allocate(4096);
+  arena.allocate(512);
+  EXPECT_EQ(arena.capacity(), capacity);
+
+  arena.release();
+  EXPECT_EQ(arena.capacity(), 0);
+  EXPECT_EQ(arena.used(), 0);
+}
+
+TEST(Allocator, ArenaScope) {
+  using Scratch =
+      fz::Array<double, std::vector<fz::SizeType>, std::vector<fz::SizeType>,
+                fz::ArenaAllocator<double>>;
+  EXPECT_EQ(fz::ArenaScope::active(), nullptr);
+  auto& arena = fz::ArenaScope::threadArena();
+  auto base = arena.used();
+
+  Scratch result;
+  {
+    fz::ArenaScope scope;
+    EXPECT_EQ(fz::ArenaScope::active(), &arena);
+
+    auto a = Scratch::empty({16, 16});
+    std::ranges::fill(a, 1.0);
+    EXPECT_TRUE(isAligned(a.data(), 64));
+    EXPECT_GE(arena.used(), base + 16 * 16 * sizeof(double));
+    {
+      fz::ArenaScope inner;
+      auto b = Scratch::emptyLike(a);
+      auto inner_used = arena.used();
+      EXPECT_GT(inner_used, base + 16 * 16 * sizeof(double));
+    }
+    EXPECT_LT(arena.used(), base + 2 * 16 * 16 * sizeof(double));
+    EXPECT_EQ(fz::ArenaScope::active(), &arena);
+
+    // result was made outside the scope, so it keeps heap storage
+    result = a;
+    EXPECT_EQ(result.getAllocator().arena(), nullptr);
+  }
+  EXPECT_EQ(fz::ArenaScope::active(), nullptr);
+  EXPECT_EQ(arena.used(), base);
+  EXPECT_EQ(result(15, 15), 1.0);
+}
+
+TEST(Allocator, BufferCacheSizeClasses) {
+  using fz::BufferCache;
+  EXPECT_EQ(BufferCache::sizeClass(1), 0);
+  EXPECT_EQ(BufferCache::classSize(0), 64);
+  for (std::size_t n : {65UL, 100UL, 128UL, 129UL, 4097UL, 1UL << 30}) {
+    auto c = BufferCache::sizeClass(n);
+    EXPECT_GE(BufferCache::classSize(c), n);
+    EXPECT_LT(BufferCache::classSize(c - 1), n);
+    // at most a quarter wasted
+    EXPECT_LE(BufferCache::classSize(c), n + n / 4 + 1);
+  }
+}
+
+TEST(Allocator, BufferCache) {
+  using Pooled =
+      fz::Array<double, std::vector<fz::SizeType>, std::vector<fz::SizeType>,
+                fz::CachingAllocator<double>>;
+  auto& cache = fz::BufferCache::instance();
+  cache.trim();
+  cache.resetStats();
+
+  auto a = Pooled::empty({64, 64});
+  EXPECT_TRUE(isAligned(a.data(), 64));
+  auto* storage = a.data();
+  EXPECT_EQ(cache.stats().misses, 1);
+  a.resize({32, 32});
+  a.resize({64, 64});
+  // the first buffer comes back from the thread cache
+  EXPECT_EQ(a.data(), storage);
+  EXPECT_EQ(cache.stats().hits, 1);
+  {
+    auto b = Pooled::emptyLike(a);
+    EXPECT_EQ(cache.stats().misses, 3);
+  }
+  auto c = Pooled::emptyLike(a);
+  EXPECT_EQ(cache.stats().hits, 2);
+
+  // buffers freed by another thread reach this one through the depot
+  std::thread{[] { auto d = Pooled::empty({100, 100}); }}.join();
+  auto e = Pooled::empty({100, 100});
+  EXPECT_EQ(cache.stats().hits, 3);
 
+  cache.trim();
+  EXPECT_EQ(cache.stats().cached_bytes, 0);
 
+  // nothing is kept beyond the cap
+  auto capacity = cache.capacity();
+  cache.setCapacity(1024);
+  { auto big = Pooled::empty({1024}); }
+  EXPECT_EQ(cache.stats().cached_bytes, 0);
+  cache.setCapacity(capacity);
 }
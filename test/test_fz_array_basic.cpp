@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <iostream>
 #include <numeric>
 #include <ranges>
@@ -62,3 +63,41 @@ TEST(Array, Basic) {
     std::cout << i << '\n';
   }
 }
+
+TEST(Array, FixedRank) {
+  using fz::Array;
+  using fz::FixedRankArray;
+
+  auto dynamic_arr = Array<int>::empty({2, 3, 4});
+  auto fixed_arr = FixedRankArray<int, 3>::empty({2, 3, 4});
+  std::iota(dynamic_arr.begin(), dynamic_arr.end(), 0);
+  std::iota(fixed_arr.begin(), fixed_arr.end(), 0);
+
+  EXPECT_EQ(fixed_arr.size(), dynamic_arr.size());
+  EXPECT_TRUE(std::ranges::equal(fixed_arr.strides(), dynamic_arr.strides()));
+  for (std::size_t k = 0; k < 4; ++k) {
+    for (std::size_t j = 0; j < 3; ++j) {
+      for (std::size_t i = 0; i < 2; ++i) {
+        EXPECT_EQ(fixed_arr(i, j, k), dynamic_arr(i, j, k));
+      }
+    }
+  }
+  EXPECT_EQ(fixed_arr.at(1, 2, 3), 23);
+
+  fixed_arr.reshape({4, 3, 2});
+  EXPECT_EQ(fixed_arr(3, 2, 1), 23);
+  EXPECT_THROW(fixed_arr.reshape({4, 4, 2}), std::invalid_argument);
+
+  fixed_arr.resize({5, 5, 5});
+  EXPECT_EQ(fixed_arr.size(), 125);
+  EXPECT_EQ(fixed_arr.strides()[2], 25);
+
+  FixedRankArray<double, 1> vec = {1.0, 2.0, 3.0};
+  EXPECT_EQ(vec.shape()[0], 3);
+  EXPECT_EQ(vec(2), 3.0);
+
+  // shape, strides, storage, the layout tag and room for small arrays'
+  // elements; nothing on the heap
+  static_assert(sizeof(FixedRankArray<int, 3>) ==
+                7 * sizeof(std::size_t) + 2 * sizeof(int*) + FZ_INLINE_BYTES);
+}
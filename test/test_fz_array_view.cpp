@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "fz/array.hpp"
+
+static_assert(fz::ArrayConcept<fz::Array<int>>);
+static_assert(fz::ArrayConcept<fz::ArrayView<int>>);
+static_assert(fz::ArrayConcept<fz::ArrayView<const int>>);
+static_assert(std::forward_iterator<fz::ArrayView<int>::Iterator>);
+
+TEST(ArrayView, SharesStorage) {
+  auto arr = fz::Array<int>::empty({3, 4});
+  std::iota(arr.begin(), arr.end(), 0);
+
+  auto view = arr.view();
+  EXPECT_EQ(view.data(), arr.data());
+  EXPECT_TRUE(view.isContiguous());
+  EXPECT_TRUE(std::equal(view.begin(), view.end(), arr.begin()));
+
+  view(1, 2) = -1;
+  EXPECT_EQ(arr(1, 2), -1);
+
+  const auto& const_arr = arr;
+  fz::ArrayView<const int> const_view = const_arr.view();
+  EXPECT_EQ(const_view(1, 2), -1);
+}
+
+TEST(ArrayView, Slice) {
+  auto arr = fz::Array<int>::empty({6, 4});
+  std::iota(arr.begin(), arr.end(), 0);
+
+  // every second row, columns 1..3
+  auto view = arr.view().slice(0, 1, 6, 2).slice(1, 1, 3);
+  ASSERT_EQ(view.shape(), (std::vector<std::size_t>{3, 2}));
+  EXPECT_FALSE(view.isContiguous());
+  for (std::size_t j = 0; j < 2; ++j) {
+    for (std::size_t i = 0; i < 3; ++i) {
+      EXPECT_EQ(view(i, j), arr(1 + 2 * i, 1 + j));
+    }
+  }
+
+  std::vector<int> visited(view.begin(), view.end());
+  EXPECT_EQ(visited, (std::vector<int>{7, 9, 11, 13, 15, 17}));
+
+  EXPECT_THROW(arr.view().slice(2, 0, 1), std::out_of_range);
+  EXPECT_THROW(arr.view().slice(0, 0, 7), std::invalid_argument);
+  EXPECT_THROW(view.at(3, 0), std::out_of_range);
+}
+
+TEST(ArrayView, TransposePermuteSqueeze) {
+  auto arr = fz::Array<int>::empty({2, 3, 4});
+  std::iota(arr.begin(), arr.end(), 0);
+
+  auto transposed = arr.view().transpose();
+  ASSERT_EQ(transposed.shape(), (std::vector<std::size_t>{4, 3, 2}));
+  EXPECT_EQ(transposed(3, 2, 1), arr(1, 2, 3));
+
+  auto permuted = arr.view().permute({1, 2, 0});
+  ASSERT_EQ(permuted.shape(), (std::vector<std::size_t>{3, 4, 2}));
+  EXPECT_EQ(permuted(2, 3, 1), arr(1, 2, 3));
+  EXPECT_THROW(arr.view().permute({0, 0, 1}), std::invalid_argument);
+
+  auto plane = arr.view().slice(1, 2, 3).squeeze();
+  ASSERT_EQ(plane.shape(), (std::vector<std::size_t>{2, 4}));
+  EXPECT_EQ(plane(1, 3), arr(1, 2, 3));
+}
+
+TEST(ArrayView, BlockOfFixedRank) {
+  auto arr = fz::FixedRankArray<double, 3>::empty({8, 8, 8});
+  std::fill(arr.begin(), arr.end(), 0.0);
+
+  // writing through the interior block leaves the one-cell halo untouched
+  auto interior = arr.view().block({1, 1, 1}, {7, 7, 7});
+  std::fill(interior.begin(), interior.end(), 1.0);
+  EXPECT_EQ(std::reduce(arr.begin(), arr.end()), 6.0 * 6.0 * 6.0);
+  EXPECT_EQ(arr(0, 3, 3), 0.0);
+  EXPECT_EQ(arr(1, 3, 3), 1.0);
+  EXPECT_EQ(arr(7, 3, 3), 0.0);
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "fz/bench/harness.hpp"
+
+TEST(Bench, StateRunsTheLoop) {
+  fz::bench::State state{1000, 7};
+  fz::SizeType count = 0;
+  for (auto _ : state) {
+    ++count;
+  }
+  EXPECT_EQ(count, 1000);
+  EXPECT_EQ(state.arg(), 7);
+
+  // paused spans are not measured
+  fz::bench::State paused{1, 0};
+  for (auto _ : paused) {
+    paused.pauseTiming();
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    paused.resumeTiming();
+  }
+  EXPECT_LT(paused.profile().duration(), std::chrono::milliseconds{10});
+}
+
+TEST(Bench, Stats) {
+  std::vector<double> samples;
+  for (int i = 100; 0 < i; --i) {
+    samples.push_back(i);
+  }
+  auto stats = fz::bench::computeStats("s", samples, 10, 400);
+  EXPECT_EQ(stats.samples, 100);
+  EXPECT_DOUBLE_EQ(stats.min_ns, 1.0);
+  EXPECT_DOUBLE_EQ(stats.median_ns, 50.5);
+  EXPECT_DOUBLE_EQ(stats.mean_ns, 50.5);
+  EXPECT_DOUBLE_EQ(stats.p90_ns, 90.1);
+  EXPECT_DOUBLE_EQ(stats.p99_ns, 99.01);
+  EXPECT_NEAR(stats.stddev_ns, 29.011, 1e-3);
+  EXPECT_DOUBLE_EQ(stats.bytes_per_second, 400 / 50.5 * 1e9);
+
+  auto single = fz::bench::computeStats("s", {3.0}, 1, 0);
+  EXPECT_EQ(single.p99_ns, 3.0);
+  EXPECT_EQ(single.stddev_ns, 0.0);
+  EXPECT_EQ(single.bytes_per_second, 0.0);
+}
+
+TEST(Bench, BaselineRoundTrip) {
+  std::vector<fz::bench::Stats> results{
+      {.name = "a/16", .median_ns = 12.5, .stddev_ns = 0.25},
+      {.name = "b", .median_ns = 1e6, .stddev_ns = 100.0},
+      {.name = "c", .skipped = "not here"}};
+  std::ostringstream json;
+  fz::bench::writeJson(json, results, {});
+  std::ostringstream csv;
+  fz::bench::writeCsv(csv, results);
+  for (const auto& text : {json.str(), csv.str()}) {
+    auto baseline = fz::bench::parseBaseline(text);
+    ASSERT_EQ(baseline.size(), 2);
+    EXPECT_EQ(baseline["a/16"].first, 12.5);
+    EXPECT_EQ(baseline["a/16"].second, 0.25);
+    EXPECT_EQ(baseline["b"].first, 1e6);
+  }
+}
+
+TEST(Bench, Regression) {
+  fz::bench::Stats current{.name = "a", .median_ns = 110.0, .stddev_ns = 1.0};
+  EXPECT_TRUE(fz::bench::isRegression(current, 100.0, 1.0, 0.05));
+  // within the threshold
+  EXPECT_FALSE(fz::bench::isRegression(current, 106.0, 1.0, 0.05));
+  // within the noise
+  EXPECT_FALSE(fz::bench::isRegression(current, 100.0, 6.0, 0.05));
+  // faster
+  EXPECT_FALSE(fz::bench::isRegression(current, 200.0, 1.0, 0.05));
+
+  std::ostringstream os;
+  EXPECT_EQ(fz::bench::compare(os, {current}, {{"a", {100.0, 1.0}}}, 0.05), 1);
+  EXPECT_NE(os.str().find("REGRESSION"), std::string::npos);
+}
+
+TEST(Bench, CounterColumns) {
+  fz::CounterSample counters;
+  counters.set(fz::PerfEvent::kCycles, 200.0);
+  counters.set(fz::PerfEvent::kInstructions, 500.0);
+  std::vector<fz::bench::Stats> results{{.name = "k",
+                                         .median_ns = 100.0,
+                                         .bytes_per_second = 8e9,
+                                         .counters = counters}};
+  std::ostringstream json;
+  fz::bench::writeJson(json, results, {});
+  EXPECT_NE(json.str().find("\"cycles\": 200, \"instructions\": 500, "
+                            "\"ipc\": 2.5, \"bytes_per_cycle\": 4, "
+                            "\"bottleneck\": \"compute\""),
+            std::string::npos);
+
+  std::ostringstream csv;
+  fz::bench::writeCsv(csv, results);
+  EXPECT_NE(csv.str().find(",ipc,bytes_per_cycle,bottleneck\n"),
+            std::string::npos);
+  EXPECT_NE(csv.str().find(",2.5,4,compute\n"), std::string::npos);
+  EXPECT_EQ(fz::bench::parseBaseline(csv.str()).at("k").first, 100.0);
+}
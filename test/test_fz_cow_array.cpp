@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/cow_array.hpp"
+#include "fz/expression.hpp"
+
+namespace {
+
+// element storage comes from CountingAllocator, so a test sees every buffer
+// a copy makes
+std::atomic<std::size_t> allocations{0};
+
+template <typename T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U> & /*other*/) {}  // NOLINT
+
+  auto allocate(std::size_t n) -> T * {
+    ++allocations;
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  auto deallocate(T *p, std::size_t n) -> void {
+    std::allocator<T>{}.deallocate(p, n);
+  }
+
+  friend auto operator==(const CountingAllocator & /*lhs*/,
+                         const CountingAllocator & /*rhs*/) -> bool {
+    return true;
+  }
+};
+
+using Cow = fz::CowArray<double, fz::ShapeVector, fz::ShapeVector,
+                         CountingAllocator<double>>;
+
+auto sum(Cow arr) -> double {
+  double total = 0;
+  for (auto x : std::as_const(arr)) {
+    total += x;
+  }
+  return total;
+}
+
+}  // namespace
+
+TEST(CowArray, CopiesShareUntilWritten) {
+  auto original = Cow::zeros({100, 100});
+  std::fill(original.begin(), original.end(), 1.0);
+
+  const auto before = allocations.load();
+  std::vector<Cow> snapshots;
+  for (int i = 0; i < 8; ++i) {
+    snapshots.push_back(original);
+  }
+  Cow assigned;
+  assigned = original;
+  EXPECT_EQ(sum(original), 10000.0);
+  const auto &reader = snapshots[3];
+  EXPECT_EQ(reader(99, 99), 1.0);
+  EXPECT_EQ(reader.view()(5, 5), 1.0);
+  EXPECT_EQ(allocations.load(), before);
+  EXPECT_EQ(original.useCount(), 10U);
+  EXPECT_EQ(std::as_const(snapshots[0]).data(), std::as_const(original).data());
+
+  // the first write copies the buffer once, it is private from then on
+  snapshots[3](0, 0) = 5.0;
+  EXPECT_EQ(allocations.load(), before + 1);
+  snapshots[3](1, 0) = 6.0;
+  snapshots[3].view()(2, 0) = 7.0;
+  EXPECT_EQ(allocations.load(), before + 1);
+  EXPECT_FALSE(snapshots[3].isShared());
+  EXPECT_EQ(original.useCount(), 9U);
+  EXPECT_EQ(std::as_const(original)(0, 0), 1.0);
+  EXPECT_EQ(std::as_const(snapshots[0])(0, 0), 1.0);
+  EXPECT_EQ(std::as_const(snapshots[3])(2, 0), 7.0);
+
+  // once the others are gone the original is written in place
+  snapshots.clear();
+  assigned = Cow{};
+  EXPECT_FALSE(original.isShared());
+  const auto *storage = std::as_const(original).data();
+  original(3, 3) = 2.0;
+  EXPECT_EQ(std::as_const(original).data(), storage);
+  EXPECT_EQ(allocations.load(), before + 1);
+}
+
+TEST(CowArray, ExpressionsAndViews) {
+  fz::CowArray<double> a = fz::Array<double>{1.0, 2.0, 3.0, 4.0, 5.0};
+  const auto b = a;
+
+  // expressions read CowArrays without copying them
+  fz::Array<double> c = a + b * 2.0;
+  EXPECT_EQ(c(4), 15.0);
+
+  // assigning to a shared CowArray leaves the other owners alone
+  a = a * 10.0;
+  EXPECT_EQ(std::as_const(a)(1), 20.0);
+  EXPECT_EQ(b(1), 2.0);
+  EXPECT_FALSE(a.isShared());
+
+  // from a view, and back into views
+  auto grid = fz::Array<double>::zeros({4, 3});
+  std::iota(grid.begin(), grid.end(), 0.0);
+  fz::CowArray<double> column = grid.view().slice(1, 2, 3);
+  EXPECT_EQ(column.shape(), (std::vector<fz::SizeType>{4, 1}));
+  EXPECT_EQ(std::as_const(column)(3, 0), 11.0);
+  auto shared = column;
+  column.view().assign(fz::Array<double>::zeros({4, 1}));
+  EXPECT_EQ(std::as_const(column)(3, 0), 0.0);
+  EXPECT_EQ(shared(3, 0), 11.0);
+
+  // a const view follows the buffer it was taken from
+  const auto keeper = shared;
+  const auto snapshot = keeper.view();
+  shared(0, 0) = -1.0;
+  EXPECT_EQ(snapshot(0, 0), 8.0);
+  EXPECT_EQ(std::as_const(shared)(0, 0), -1.0);
+
+  // reshape and resize of a shared buffer
+  auto flat = b;
+  flat.reshape({5, 1});
+  EXPECT_EQ(b.shape(), (std::vector<fz::SizeType>{5}));
+  EXPECT_THROW(flat.reshape({2, 2}), std::invalid_argument);
+  auto grown = b;
+  grown.resize({7});
+  EXPECT_EQ(grown.size(), 7U);
+  EXPECT_EQ(b.size(), 5U);
+}
+
+TEST(CowArray, ThreadsShareOneBuffer) {
+  const auto source = fz::CowArray<int>::zeros({1 << 12});
+  std::vector<std::thread> threads;
+  std::vector<int> totals(8);
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int round = 0; round < 50; ++round) {
+        auto copy = source;
+        if (round % 2 == 0) {
+          copy[t] = t + 1;
+          totals[t] += copy[t];
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(source.useCount(), 1U);
+  EXPECT_TRUE(std::all_of(source.begin(), source.end(),
+                          [](int x) { return x == 0; }));
+  for (int t = 0; t < 8; ++t) {
+    EXPECT_EQ(totals[t], 25 * (t + 1));
+  }
+}
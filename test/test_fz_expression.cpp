@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "fz/expression.hpp"
+
+TEST(Expression, FusedArithmetic) {
+  using fz::Array;
+
+  auto b = Array<double>::empty({4, 5});
+  auto c = Array<double>::empty({4, 5});
+  auto d = Array<double>::empty({4, 5});
+  auto e = Array<double>::empty({4, 5});
+  std::iota(b.begin(), b.end(), 1.0);
+  std::iota(c.begin(), c.end(), 2.0);
+  std::iota(d.begin(), d.end(), 3.0);
+  std::iota(e.begin(), e.end(), 4.0);
+
+  Array<double> a = b * c + d * e;
+  ASSERT_EQ(a.shape(), b.shape());
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(a.flat(i), b.flat(i) * c.flat(i) + d.flat(i) * e.flat(i));
+  }
+
+  // shapes match: storage is reused
+  const auto* storage = a.data();
+  a = (b - c) / 2.0 + 1.0 - -d;
+  EXPECT_EQ(a.data(), storage);
+  EXPECT_EQ(a(3, 4), (b(3, 4) - c(3, 4)) / 2.0 + 1.0 + d(3, 4));
+
+  a += b;
+  a *= 2;
+  EXPECT_EQ(a.data(), storage);
+  EXPECT_EQ(a(3, 4), 2 * ((b(3, 4) - c(3, 4)) / 2.0 + 1.0 + d(3, 4) + b(3, 4)));
+
+  auto mismatched = Array<double>::empty({5, 4});
+  EXPECT_THROW(b + mismatched, std::invalid_argument);
+
+  // a new shape evaluates into new storage: a slice of a may feed a
+  a = b;
+  a = 2.0 * a.view().slice(1, 1, 3);
+  ASSERT_EQ(a.shape(), (fz::ShapeVector{4, 2}));
+  EXPECT_EQ(a(3, 1), 2 * b(3, 2));
+  EXPECT_EQ(a(0, 0), 2 * b(0, 1));
+  // same size, new shape: the old strides must not be overwritten mid-read
+  a = b;
+  a = a.view().transpose() + 0.0;
+  ASSERT_EQ(a.shape(), (fz::ShapeVector{5, 4}));
+  EXPECT_EQ(a(4, 1), b(1, 4));
+  EXPECT_EQ(a(2, 3), b(3, 2));
+}
+
+TEST(Expression, MathAndWhere) {
+  using fz::Array;
+
+  Array<double> x = {-4.0, -1.0, 0.0, 1.0, 4.0};
+  Array<double> y = fz::where(x > 0.0, fz::sqrt(x), -fz::abs(x));
+  EXPECT_EQ(std::vector<double>(y.begin(), y.end()),
+            (std::vector<double>{-4.0, -1.0, -0.0, 1.0, 2.0}));
+
+  Array<double> z = fz::exp(fz::log(fz::abs(x) + 1.0)) - 1.0;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    EXPECT_NEAR(z(i), std::abs(x(i)), 1e-12);
+  }
+
+  Array<float> squared = fz::pow(x, 2);
+  EXPECT_EQ(squared(0), 16.0F);
+}
+
+TEST(Expression, Views) {
+  using fz::Array;
+
+  auto field = Array<double>::empty({6, 6});
+  std::iota(field.begin(), field.end(), 0.0);
+  auto next = Array<double>::zeros({6, 6});
+  std::fill(next.begin(), next.end(), 0.0);
+
+  // interior update from shifted neighbours, written in place
+  auto interior = next.view().block({1, 1}, {5, 5});
+  auto west = field.view().block({0, 1}, {4, 5});
+  auto east = field.view().block({2, 1}, {6, 5});
+  interior.assign(0.5 * (west + east));
+  for (std::size_t j = 1; j < 5; ++j) {
+    for (std::size_t i = 1; i < 5; ++i) {
+      EXPECT_EQ(next(i, j), field(i, j));
+    }
+  }
+  EXPECT_EQ(next(0, 0), 0.0);
+
+  // transposed operand goes through the strided path
+  Array<double> sum = field + field.view().transpose();
+  EXPECT_EQ(sum(1, 2), field(1, 2) + field(2, 1));
+}
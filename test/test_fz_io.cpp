@@ -0,0 +1,517 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/io.hpp"
+
+namespace {
+
+class TempPath {
+ public:
+  explicit TempPath(const std::string& name)
+      : _path{(std::filesystem::temp_directory_path() /
+               ("fz_" + std::to_string(::getpid()) + "_" + name))
+                  .string()} {}
+
+  ~TempPath() { std::filesystem::remove(_path); }
+
+  [[nodiscard]] auto str() const -> const std::string& { return _path; }
+
+ private:
+  std::string _path;
+};
+
+// what numpy.save writes for np.arange(6, dtype='<i4').reshape(2, 3)
+auto writeCOrderFile(const std::string& path) -> void {
+  std::string dict =
+      "{'descr': '<i4', 'fortran_order': False, 'shape': (2, 3), }";
+  dict.resize(128 - 10 - 1, ' ');
+  dict += '\n';
+  std::string bytes = "\x93NUMPY\x01";
+  bytes += '\0';
+  bytes += static_cast<char>(dict.size());
+  bytes += '\0';
+  bytes += dict;
+  for (std::int32_t v = 0; v < 6; ++v) {
+    bytes.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  }
+  fz::File file{path, fz::File::Mode::kCreate};
+  file.writeAt(bytes.data(), bytes.size(), 0);
+}
+
+}  // namespace
+
+TEST(Npy, RoundTrip) {
+  const TempPath path{"round_trip.npy"};
+  auto arr = fz::Array<double>::empty({7, 5, 3});
+  std::iota(arr.begin(), arr.end(), 0.5);
+  fz::saveNpy(path.str(), arr, {.sync = true});
+
+  const auto header = fz::readNpyHeader(path.str());
+  EXPECT_EQ(header.descr, "<f8");
+  EXPECT_TRUE(header.fortran_order);
+  EXPECT_EQ(header.shape, (std::vector<fz::SizeType>{7, 5, 3}));
+  EXPECT_EQ(header.data_offset % fz::NPY_DATA_ALIGNMENT, 0U);
+  EXPECT_EQ(std::filesystem::file_size(path.str()),
+            header.data_offset + arr.size() * sizeof(double));
+
+  const auto loaded = fz::loadNpy<double>(path.str());
+  EXPECT_EQ(loaded.shape(), arr.shape());
+  EXPECT_TRUE(std::equal(arr.begin(), arr.end(), loaded.begin()));
+
+  using Shape = std::array<fz::SizeType, 3>;
+  const auto fixed = fz::loadNpy<double, Shape>(path.str());
+  EXPECT_EQ(fixed(6, 4, 2), arr(6, 4, 2));
+  EXPECT_THROW((fz::loadNpy<double, std::array<fz::SizeType, 2>>(path.str())),
+               std::runtime_error);
+
+  auto complex = fz::Array<std::complex<float>>{{1, 2}, {3, -4}};
+  fz::saveNpy(path.str(), complex);
+  EXPECT_EQ(fz::readNpyHeader(path.str()).shape,
+            (std::vector<fz::SizeType>{2}));
+  EXPECT_EQ(fz::loadNpy<std::complex<float>>(path.str())[1],
+            std::complex<float>(3, -4));
+}
+
+TEST(Npy, StridedViews) {
+  const TempPath path{"strided.npy"};
+  auto arr = fz::Array<std::int16_t>::empty({6, 4});
+  std::iota(arr.begin(), arr.end(), std::int16_t{0});
+  auto view = arr.view().slice(0, 1, 6, 2).transpose();
+  fz::saveNpy(path.str(), view);
+
+  const auto loaded = fz::loadNpy<std::int16_t>(path.str());
+  ASSERT_EQ(loaded.shape(), (std::vector<fz::SizeType>{4, 3}));
+  for (fz::SizeType i = 0; i < 4; ++i) {
+    for (fz::SizeType j = 0; j < 3; ++j) {
+      EXPECT_EQ(loaded(i, j), view(i, j));
+    }
+  }
+}
+
+TEST(Npy, COrder) {
+  const TempPath path{"c_order.npy"};
+  writeCOrderFile(path.str());
+
+  const auto loaded = fz::loadNpy<std::int32_t>(path.str());
+  ASSERT_EQ(loaded.shape(), (std::vector<fz::SizeType>{2, 3}));
+  const auto mapped = fz::mapNpy<const std::int32_t>(path.str());
+  EXPECT_FALSE(mapped.fortranOrder());
+  for (fz::SizeType i = 0; i < 2; ++i) {
+    for (fz::SizeType j = 0; j < 3; ++j) {
+      EXPECT_EQ(loaded(i, j), static_cast<std::int32_t>(3 * i + j));
+      EXPECT_EQ(mapped.view()(i, j), loaded(i, j));
+    }
+  }
+}
+
+TEST(Npy, Mapped) {
+  const TempPath path{"mapped.npy"};
+  auto arr = fz::Array<float>::empty({100, 30});
+  std::iota(arr.begin(), arr.end(), 1.0F);
+  fz::saveNpy(path.str(), arr);
+
+  {
+    const auto mapped = fz::mapNpy<const float>(path.str());
+    EXPECT_EQ(mapped.shape(), arr.shape());
+    EXPECT_TRUE(mapped.view().isContiguous());
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(mapped.data()) % 4096, 0U);
+    EXPECT_TRUE(std::equal(arr.begin(), arr.end(), mapped.data()));
+  }
+  {
+    // private pages: the file keeps its contents
+    auto mapped = fz::mapNpy<float>(path.str(), fz::MapMode::kPrivate);
+    mapped.view()(3, 4) = -1.0F;
+    EXPECT_EQ(mapped.view()(3, 4), -1.0F);
+  }
+  EXPECT_EQ(fz::loadNpy<float>(path.str())(3, 4), arr(3, 4));
+  {
+    auto mapped = fz::mapNpy<float>(path.str());
+    auto moved = std::move(mapped);
+    moved.view()(3, 4) = -1.0F;
+    moved.sync();
+  }
+  EXPECT_EQ(fz::loadNpy<float>(path.str())(3, 4), -1.0F);
+}
+
+TEST(Npy, Errors) {
+  const TempPath path{"errors.npy"};
+  fz::saveNpy(path.str(), fz::Array<double>{1.0, 2.0});
+  EXPECT_THROW(fz::loadNpy<float>(path.str()), std::runtime_error);
+  EXPECT_THROW(fz::mapNpy<const std::int64_t>(path.str()), std::runtime_error);
+  EXPECT_THROW(fz::loadNpy<double>(path.str() + ".missing"),
+               std::runtime_error);
+
+  std::filesystem::resize_file(path.str(), fz::NPY_DATA_ALIGNMENT + 8);
+  EXPECT_THROW(fz::loadNpy<double>(path.str()), std::runtime_error);
+  EXPECT_THROW(fz::mapNpy<const double>(path.str()), std::runtime_error);
+}
+
+TEST(Chunked, RoundTrip) {
+  const TempPath path{"round_trip.fzc"};
+  auto arr = fz::Array<double>::empty({37, 23, 5});
+  std::iota(arr.begin(), arr.end(), 0.0);
+  fz::saveChunked(path.str(), arr, {8, 8, 5});
+
+  const auto chunked = fz::ChunkedArray<double>::open(path.str());
+  EXPECT_EQ(chunked.shape(), arr.shape());
+  EXPECT_EQ(chunked.grid(), (std::vector<fz::SizeType>{5, 3, 1}));
+  EXPECT_EQ(chunked.chunkCount(), 15U);
+  EXPECT_EQ(chunked.chunkOrigin(14), (std::vector<fz::SizeType>{32, 16, 0}));
+  EXPECT_EQ(chunked.chunkExtent(14), (std::vector<fz::SizeType>{5, 7, 5}));
+
+  const auto last = chunked.readChunk(14);
+  EXPECT_EQ(last(4, 6, 4), arr(36, 22, 4));
+  EXPECT_EQ(last(0, 0, 0), arr(32, 16, 0));
+
+  const auto loaded = fz::loadChunked<double>(path.str());
+  EXPECT_EQ(loaded.shape(), arr.shape());
+  EXPECT_TRUE(std::equal(arr.begin(), arr.end(), loaded.begin()));
+
+  // a strided view goes through the same path
+  auto transposed = arr.view().transpose();
+  fz::saveChunked(path.str(), transposed, {2, 7, 16});
+  const auto back = fz::loadChunked<double>(path.str());
+  EXPECT_EQ(back(4, 22, 36), arr(36, 22, 4));
+  EXPECT_EQ(back(1, 3, 20), arr(20, 3, 1));
+}
+
+TEST(Chunked, Stream) {
+  const TempPath path{"stream.fzc"};
+  auto arr = fz::Array<std::int64_t>::empty({100, 60});
+  std::iota(arr.begin(), arr.end(), std::int64_t{0});
+  fz::saveChunked(path.str(), arr, {16, 16});
+  const auto chunked = fz::ChunkedArray<std::int64_t>::open(path.str());
+
+  for (fz::SizeType depth : {2, 3}) {
+    fz::SizeType expected_index = 0;
+    std::int64_t sum = 0;
+    fz::forEachChunk(
+        chunked,
+        [&](const fz::Chunk<std::int64_t>& chunk) {
+          EXPECT_EQ(chunk.index, expected_index++);
+          const auto& origin = chunk.origin;
+          EXPECT_EQ(chunk.view(0, 0), arr(origin[0], origin[1]));
+          for (auto v : chunk.view) {
+            sum += v;
+          }
+        },
+        depth);
+    EXPECT_EQ(expected_index, chunked.chunkCount());
+    EXPECT_EQ(sum, std::accumulate(arr.begin(), arr.end(), std::int64_t{0}));
+  }
+
+  // leaving early stops the prefetch
+  fz::ChunkReader<std::int64_t> reader{chunked, 3};
+  EXPECT_EQ(reader.next()->index, 0U);
+  EXPECT_EQ(reader.next()->index, 1U);
+}
+
+TEST(Chunked, Transform) {
+  const TempPath in_path{"transform_in.fzc"};
+  const TempPath out_path{"transform_out.fzc"};
+  auto arr = fz::Array<float>::empty({50, 40, 3});
+  std::iota(arr.begin(), arr.end(), 0.0F);
+  fz::saveChunked(in_path.str(), arr, {32, 8, 3});
+
+  const auto in = fz::ChunkedArray<float>::open(in_path.str());
+  auto out = fz::ChunkedArray<double>::create(out_path.str(), in.shape(),
+                                              in.chunkShape());
+  fz::transformChunks(
+      in, out,
+      [](const fz::Chunk<float>& source, fz::Chunk<double>& target) {
+        auto t = target.view.begin();
+        for (auto v : source.view) {
+          *t++ = 2.0 * v;
+        }
+      },
+      3);
+
+  const auto result = fz::loadChunked<double>(out_path.str());
+  for (fz::SizeType i = 0; i < arr.size(); ++i) {
+    EXPECT_EQ(result.data()[i], 2.0 * arr.data()[i]);
+  }
+}
+
+TEST(Chunked, Errors) {
+  const TempPath path{"errors.fzc"};
+  auto arr = fz::Array<double>::zeros({64, 64});
+  fz::saveChunked(path.str(), arr, {16, 64});
+  EXPECT_THROW(fz::ChunkedArray<float>::open(path.str()), std::runtime_error);
+
+  auto chunked = fz::ChunkedArray<double>::open(path.str(), true);
+  EXPECT_THROW(chunked.writeChunk(0, fz::Array<double>::zeros({16, 16})),
+               std::invalid_argument);
+  EXPECT_THROW(
+      fz::ChunkedArray<double>::create(path.str() + "2", {4, 4}, {4}),
+      std::invalid_argument);
+
+  // a header filling its whole block is not terminated
+  {
+    const TempPath unterminated{"unterminated.fzc"};
+    fz::saveChunked(unterminated.str(), arr, {16, 64});
+    fz::File file{unterminated.str(), fz::File::Mode::kReadWrite};
+    std::string header(fz::CHUNK_ALIGNMENT, '\0');
+    file.readAt(header.data(), header.size(), 0);
+    std::replace(header.begin(), header.end(), '\0', ' ');
+    file.writeAt(header.data(), header.size(), 0);
+    EXPECT_THROW(fz::ChunkedArray<double>::open(unterminated.str()),
+                 std::runtime_error);
+  }
+
+  // a read failing on the I/O thread surfaces in the caller
+  std::filesystem::resize_file(path.str(), 2 * fz::CHUNK_ALIGNMENT);
+  fz::ChunkReader<double> reader{chunked};
+  EXPECT_THROW(
+      {
+        while (reader.next() != nullptr) {
+        }
+      },
+      std::runtime_error);
+}
+
+TEST(AsyncIo, Backends) {
+  for (auto backend : {fz::IoBackend::kAuto, fz::IoBackend::kThreads}) {
+    fz::AsyncIo io{{.backend = backend, .queue_depth = 4}};
+    EXPECT_NE(io.backend(), fz::IoBackend::kAuto);
+
+    const TempPath path{"async.bin"};
+    fz::File file{path.str(), fz::File::Mode::kCreate};
+    std::vector<std::int32_t> data(100000);
+    std::iota(data.begin(), data.end(), 0);
+    // more pieces than queue slots
+    std::vector<fz::IoWrite> writes;
+    for (fz::SizeType i = 0; i < 10; ++i) {
+      writes.push_back({data.data() + i * 10000, 10000 * sizeof(std::int32_t),
+                        i * 10000 * sizeof(std::int32_t)});
+    }
+    bool completed = false;
+    auto handle = io.write(file, writes, [&](std::exception_ptr error) {
+      completed = error == nullptr;
+    });
+    handle.wait();
+    EXPECT_TRUE(handle.ready());
+    EXPECT_TRUE(completed);
+
+    std::vector<std::int32_t> back(data.size());
+    io.read(file, back.data(), back.size() * sizeof(std::int32_t), 0).wait();
+    EXPECT_EQ(back, data);
+
+    // reading past the end fails on the I/O side and throws in wait()
+    auto past = io.read(file, back.data(), 16, data.size() * sizeof(int));
+    EXPECT_THROW(past.wait(), std::runtime_error);
+  }
+}
+
+TEST(AsyncIo, ContinuationMayWaitForIo) {
+  for (auto backend : {fz::IoBackend::kAuto, fz::IoBackend::kThreads}) {
+    fz::AsyncIo io{{.backend = backend, .threads = 1}};
+    const TempPath path{"continuation.bin"};
+    fz::File file{path.str(), fz::File::Mode::kCreate};
+    const std::array<char, 4> data{'a', 'b', 'c', 'd'};
+    std::array<char, 4> back{};
+    // the read completes on the reaping side while the continuation blocks,
+    // so it must not run there; bounded, so a regression fails, not hangs
+    bool read_done = false;
+    io.write(file, data.data(), data.size(), 0).wait();
+    io.write(file, {{data.data(), data.size(), 4}},
+             [&](std::exception_ptr) {
+               auto read = io.read(file, back.data(), back.size(), 0);
+               const auto deadline =
+                   std::chrono::steady_clock::now() + std::chrono::seconds{10};
+               while (!read.ready() &&
+                      std::chrono::steady_clock::now() < deadline) {
+                 std::this_thread::sleep_for(std::chrono::milliseconds{1});
+               }
+               read_done = read.ready();
+             })
+        .wait();
+    EXPECT_TRUE(read_done);
+    EXPECT_EQ(back, data);
+  }
+}
+
+TEST(AsyncIo, SaveNpy) {
+  const TempPath path{"async.npy"};
+  fz::AsyncIo io;
+  auto arr = fz::Array<double>::empty({300, 70});
+  std::iota(arr.begin(), arr.end(), 0.0);
+  auto handle = fz::saveNpyAsync(io, path.str(), arr);
+  handle.wait();
+  EXPECT_FALSE(std::filesystem::exists(path.str() + ".tmp"));
+  const auto loaded = fz::loadNpy<double>(path.str());
+  EXPECT_TRUE(std::equal(arr.begin(), arr.end(), loaded.begin()));
+
+  // the gathered copy of a strided view lives as long as the writes
+  fz::saveNpyAsync(io, path.str(), arr.view().transpose()).wait();
+  EXPECT_EQ(fz::loadNpy<double>(path.str())(5, 7), arr(7, 5));
+}
+
+TEST(AsyncIo, Direct) {
+  const TempPath path{"direct.npy"};
+  using Aligned = fz::AlignedAllocator<float, fz::DIRECT_IO_ALIGNMENT>;
+  using Shape = std::vector<fz::SizeType>;
+  // not a whole number of blocks: the tail takes the bounce path
+  auto arr = fz::Array<float, Shape, Shape, Aligned>::empty({1000, 3});
+  std::iota(arr.begin(), arr.end(), 0.0F);
+  fz::AsyncIo io;
+  try {
+    fz::saveNpyAsync(io, path.str(), arr, {.direct = true}).wait();
+  } catch (const std::runtime_error& e) {
+    GTEST_SKIP() << "no O_DIRECT here: " << e.what();
+  }
+  EXPECT_EQ(std::filesystem::file_size(path.str()),
+            fz::NPY_DATA_ALIGNMENT + arr.size() * sizeof(float));
+  const auto loaded = fz::loadNpy<float>(path.str());
+  EXPECT_TRUE(std::equal(arr.begin(), arr.end(), loaded.begin()));
+
+  fz::File file{path.str(), fz::File::Mode::kRead, true};
+  std::vector<char> unaligned(100);
+  EXPECT_THROW(io.read(file, unaligned.data(), 100, 0), std::invalid_argument);
+}
+
+TEST(Text, CsvRoundTrip) {
+  auto arr = fz::Array<double>::empty({40, 7});
+  for (fz::SizeType i = 0; i < arr.size(); ++i) {
+    arr.data()[i] = std::sqrt(static_cast<double>(i)) / 3.0 - 1e-7;
+  }
+  const TempPath path{"text.csv"};
+  fz::saveCsv(path.str(), arr);
+  const auto loaded = fz::loadCsv<double>(path.str());
+  ASSERT_EQ(loaded.shape(), arr.shape());
+  EXPECT_TRUE(std::equal(arr.begin(), arr.end(), loaded.begin()));
+
+  // rank 3 flattens the trailing dimensions, first fastest; views keep
+  // their strides
+  auto cube = fz::Array<std::int32_t>::empty({2, 2, 3});
+  std::iota(cube.begin(), cube.end(), -5);
+  std::ostringstream os;
+  fz::writeCsv(os, cube);
+  EXPECT_EQ(os.str(), "-5,-3,-1,1,3,5\n-4,-2,0,2,4,6\n");
+  os.str("");
+  fz::writeCsv(os, cube.view().transpose().slice(0, 0, 3, 2));
+  EXPECT_EQ(os.str(), "-5,-3,-4,-2\n3,5,4,6\n");
+}
+
+TEST(Text, CsvFormat) {
+  auto arr = fz::Array<double>::empty({2, 2});
+  arr(0, 0) = 1.0 / 3.0;
+  arr(1, 0) = 2.5;
+  arr(0, 1) = -1e10;
+  arr(1, 1) = 0.0;
+  std::ostringstream os;
+  fz::writeCsv(os, arr,
+               {.precision = 3,
+                .notation = std::chars_format::scientific,
+                .delimiter = "; "});
+  EXPECT_EQ(os.str(), "3.333e-01; -1.000e+10\n2.500e+00; 0.000e+00\n");
+
+  auto z = fz::Array<std::complex<float>>::empty({2});
+  z(0) = {1.5F, -2.0F};
+  z(1) = {0.0F, 0.25F};
+  os.str("");
+  fz::writeCsv(os, z);
+  EXPECT_EQ(os.str(), "1.5-2j\n0+0.25j\n");
+  const auto parsed = fz::parseCsv<std::complex<float>>(os.str());
+  EXPECT_EQ(parsed(0, 0), z(0));
+  EXPECT_EQ(parsed(1, 0), z(1));
+
+  const auto padded = fz::parseCsv<int>(" 1;\t+2 \r\n\n3; 4\n", ';');
+  ASSERT_EQ(padded.shape(), (std::vector<fz::SizeType>{2, 2}));
+  EXPECT_EQ(padded(0, 1), 2);
+  EXPECT_EQ(padded(1, 0), 3);
+}
+
+TEST(Text, FixedNotationExtremes) {
+  // fixed notation spells out every digit: hundreds for these
+  const auto fixed = fz::TextFormat{.notation = std::chars_format::fixed};
+  auto arr = fz::Array<double>::empty({4});
+  arr(0) = 1e200;
+  arr(1) = -std::numeric_limits<double>::max();
+  arr(2) = std::numeric_limits<double>::denorm_min();
+  arr(3) = 0.5;
+  std::ostringstream os;
+  fz::writeCsv(os, arr, fixed);
+  const auto text = os.str();
+  EXPECT_EQ(text.find('\0'), std::string::npos);
+  EXPECT_EQ(text.rfind("99999999999999996973", 0), 0U);
+  EXPECT_NE(text.find("\n-1797693"), std::string::npos);
+  const auto parsed = fz::parseCsv<double>(text);
+  for (fz::SizeType i = 0; i < arr.size(); ++i) {
+    EXPECT_EQ(parsed(i, 0), arr(i));
+  }
+
+  auto precise = fixed;
+  precise.precision = 2;
+  // 1e200 rounds to the 200-digit double just below it
+  EXPECT_EQ(fz::toString(fz::Array<double>{1e200}, precise).find(".00]"),
+            201U);
+
+  auto z = fz::Array<std::complex<float>>::empty({1});
+  z(0) = {std::numeric_limits<float>::max(), -1e38F};
+  os.str("");
+  fz::writeCsv(os, z, fixed);
+  EXPECT_EQ(fz::parseCsv<std::complex<float>>(os.str())(0, 0), z(0));
+}
+
+TEST(Text, CsvParallel) {
+  auto arr = fz::Array<float>::empty({200000, 3});
+  std::iota(arr.begin(), arr.end(), 0.5F);
+  std::ostringstream serial;
+  fz::ThreadPool single{1};
+  fz::writeCsv(serial, arr, {}, {.pool = &single});
+  std::ostringstream parallel;
+  fz::ThreadPool pool{4};
+  fz::writeCsv(parallel, arr, {}, {.pool = &pool});
+  EXPECT_EQ(serial.str(), parallel.str());
+  const auto loaded = fz::parseCsv<float>(parallel.str());
+  EXPECT_TRUE(std::equal(arr.begin(), arr.end(), loaded.begin()));
+}
+
+TEST(Text, CsvErrors) {
+  EXPECT_THROW(fz::parseCsv<int>("1,2\n3\n"), std::runtime_error);
+  EXPECT_THROW(fz::parseCsv<int>("1,2\n3,4,5\n"), std::runtime_error);
+  EXPECT_THROW(fz::parseCsv<int>("1,x\n"), std::runtime_error);
+  EXPECT_THROW(fz::parseCsv<int>("1 2\n"), std::runtime_error);
+  EXPECT_THROW(fz::parseCsv<std::uint8_t>("300\n"), std::runtime_error);
+  EXPECT_EQ(fz::parseCsv<int>("").size(), 0);
+
+  std::ostringstream os;
+  const auto scalar = fz::Array<double>::zeros({});
+  EXPECT_THROW(fz::writeCsv(os, scalar), std::invalid_argument);
+  EXPECT_TRUE(os.str().empty());
+}
+
+TEST(Text, ToString) {
+  auto m = fz::Array<int>::empty({2, 3});
+  std::iota(m.begin(), m.end(), -2);
+  EXPECT_EQ(fz::toString(m), "[[-2,  0,  2],\n [-1,  1,  3]]");
+  std::ostringstream os;
+  os << m.view().slice(1, 0, 3, 2);
+  EXPECT_EQ(os.str(), "[[-2,  2],\n [-1,  3]]");
+
+  auto cube = fz::Array<int>::empty({2, 1, 2});
+  std::iota(cube.begin(), cube.end(), 0);
+  EXPECT_EQ(fz::toString(cube), "[[[0, 2]],\n\n [[1, 3]]]");
+
+  auto big = fz::Array<double>::empty({2000});
+  std::iota(big.begin(), big.end(), 0.0);
+  EXPECT_EQ(fz::toString(big, {.edge_items = 2}),
+            "[   0,    1, ..., 1998, 1999]");
+  EXPECT_EQ(fz::toString(big, {.threshold = 2000}).size(),
+            2000 * 4 + 1999 * 2 + 2);
+}
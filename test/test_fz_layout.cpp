@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/expression.hpp"
+#include "fz/io.hpp"
+#include "fz/layout.hpp"
+
+using fz::Layout;
+
+namespace {
+
+using Shape = std::vector<std::size_t>;
+
+// element (i, j, k) = 10000 i + 100 j + k, whatever the layout
+auto numbered(const Shape& shape, Layout layout) -> fz::Array<int> {
+  auto arr = fz::Array<int>::empty(shape, layout);
+  for (std::size_t i = 0; i < shape[0]; ++i) {
+    for (std::size_t j = 0; j < shape[1]; ++j) {
+      if (shape.size() == 2) {
+        arr(i, j) = static_cast<int>(10000 * i + 100 * j);
+        continue;
+      }
+      for (std::size_t k = 0; k < shape[2]; ++k) {
+        arr(i, j, k) = static_cast<int>(10000 * i + 100 * j + k);
+      }
+    }
+  }
+  return arr;
+}
+
+auto expectNumbered(const fz::Array<int>& arr) -> void {
+  const auto& shape = arr.shape();
+  for (std::size_t i = 0; i < shape[0]; ++i) {
+    for (std::size_t j = 0; j < shape[1]; ++j) {
+      if (shape.size() == 2) {
+        ASSERT_EQ(arr(i, j), static_cast<int>(10000 * i + 100 * j));
+        continue;
+      }
+      for (std::size_t k = 0; k < shape[2]; ++k) {
+        ASSERT_EQ(arr(i, j, k), static_cast<int>(10000 * i + 100 * j + k));
+      }
+    }
+  }
+}
+
+// transposed: element (k, j, i) of the result is element (i, j, k) of arr
+auto expectTransposed(const fz::Array<int>& arr, const Shape& shape) -> void {
+  ASSERT_EQ(arr.shape(), (Shape(shape.rbegin(), shape.rend())));
+  for (std::size_t i = 0; i < shape[0]; ++i) {
+    for (std::size_t j = 0; j < shape[1]; ++j) {
+      if (shape.size() == 2) {
+        ASSERT_EQ(arr(j, i), static_cast<int>(10000 * i + 100 * j));
+        continue;
+      }
+      for (std::size_t k = 0; k < shape[2]; ++k) {
+        ASSERT_EQ(arr(k, j, i), static_cast<int>(10000 * i + 100 * j + k));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(Layout, RowMajor) {
+  auto arr = fz::Array<int>::empty({2, 3, 4}, Layout::kRowMajor);
+  EXPECT_EQ(arr.layout(), Layout::kRowMajor);
+  EXPECT_EQ(arr.strides(), (Shape{12, 4, 1}));
+  EXPECT_FALSE(arr.isContiguous());
+  std::iota(arr.begin(), arr.end(), 0);
+  EXPECT_EQ(arr(1, 2, 3), 23);
+  EXPECT_EQ(arr(0, 1, 0), 4);
+
+  arr.reshape({4, 6});
+  EXPECT_EQ(arr.strides(), (Shape{6, 1}));
+  EXPECT_EQ(arr(3, 5), 23);
+  arr.resize({5, 2});
+  EXPECT_EQ(arr.layout(), Layout::kRowMajor);
+  EXPECT_EQ(arr.strides(), (Shape{2, 1}));
+
+  // copies keep the layout, expressions read across layouts
+  auto col = numbered({3, 5}, Layout::kColumnMajor);
+  auto row = numbered({3, 5}, Layout::kRowMajor);
+  const fz::Array<int> copy = row;
+  EXPECT_EQ(copy.layout(), Layout::kRowMajor);
+  fz::Array<int> sum = col + row;
+  EXPECT_EQ(sum.layout(), Layout::kColumnMajor);
+  EXPECT_EQ(sum(2, 4), 2 * 20400);
+  row = col * 2 - row;
+  EXPECT_EQ(row.layout(), Layout::kRowMajor);
+  expectNumbered(row);
+
+  auto fixed = fz::FixedRankArray<double, 2>::zeros({3, 2}, Layout::kRowMajor);
+  EXPECT_EQ(fixed.strides(), (std::array<std::size_t, 2>{2, 1}));
+  EXPECT_THROW(fixed.reshape({4, 2}, Layout::kColumnMajor),
+               std::invalid_argument);
+  EXPECT_EQ(fixed.layout(), Layout::kRowMajor);
+  fixed.reshape({2, 3}, Layout::kColumnMajor);
+  EXPECT_EQ(fixed.strides(), (std::array<std::size_t, 2>{1, 2}));
+}
+
+TEST(Layout, Transpose) {
+  for (const auto& shape : {Shape{37, 70}, Shape{64, 64}, Shape{33, 5, 41}}) {
+    for (auto layout : {Layout::kColumnMajor, Layout::kRowMajor}) {
+      const auto arr = numbered(shape, layout);
+      const auto out = fz::transpose(arr);
+      EXPECT_EQ(out.layout(), layout);
+      expectTransposed(out, shape);
+
+      auto in_place = arr;
+      fz::transposeInPlace(in_place);
+      EXPECT_EQ(in_place.strides(), out.strides());
+      EXPECT_TRUE(std::equal(in_place.begin(), in_place.end(), out.begin()));
+    }
+  }
+}
+
+TEST(Layout, Relayout) {
+  for (const auto& shape : {Shape{37, 70}, Shape{48, 48}, Shape{6, 1, 9}}) {
+    auto arr = numbered(shape, Layout::kColumnMajor);
+    const auto row = fz::toLayout(arr, Layout::kRowMajor);
+    EXPECT_EQ(row.layout(), Layout::kRowMajor);
+    expectNumbered(row);
+
+    fz::relayout(arr, Layout::kRowMajor);
+    EXPECT_EQ(arr.layout(), Layout::kRowMajor);
+    EXPECT_TRUE(std::equal(arr.begin(), arr.end(), row.begin()));
+    fz::relayout(arr, Layout::kColumnMajor);
+    expectNumbered(arr);
+  }
+
+  // views gather through the same blocked copy
+  const auto arr = numbered({40, 50}, Layout::kColumnMajor);
+  const auto gathered = fz::toLayout(
+      arr.view().transpose().slice(0, 3, 50, 2), Layout::kRowMajor);
+  for (std::size_t j = 0; j < 24; ++j) {
+    for (std::size_t i = 0; i < 40; ++i) {
+      ASSERT_EQ(gathered(j, i), arr(i, 3 + 2 * j));
+    }
+  }
+  auto target = fz::Array<int>::empty({50, 40}, Layout::kRowMajor);
+  target.view().assign(arr.view().transpose());
+  expectTransposed(target, {40, 50});
+}
+
+TEST(Layout, Io) {
+  const auto path = (std::filesystem::temp_directory_path() /
+                     ("fz_layout_" + std::to_string(::getpid()) + ".npy"))
+                        .string();
+  const auto row = numbered({7, 11, 3}, Layout::kRowMajor);
+  fz::saveNpy(path, row);
+  EXPECT_FALSE(fz::readNpyHeader(path).fortran_order);
+  expectNumbered(fz::loadNpy<int>(path));
+  const auto loaded = fz::loadNpy<int>(path, Layout::kRowMajor);
+  EXPECT_EQ(loaded.layout(), Layout::kRowMajor);
+  EXPECT_TRUE(std::equal(loaded.begin(), loaded.end(), row.begin()));
+
+  fz::saveNpy(path, fz::toLayout(row, Layout::kColumnMajor));
+  EXPECT_TRUE(fz::readNpyHeader(path).fortran_order);
+  expectNumbered(fz::loadNpy<int>(path, Layout::kRowMajor));
+  std::filesystem::remove(path);
+
+  std::ostringstream row_csv;
+  fz::writeCsv(row_csv, row);
+  std::ostringstream col_csv;
+  fz::writeCsv(col_csv, fz::toLayout(row, Layout::kColumnMajor));
+  EXPECT_EQ(row_csv.str(), col_csv.str());
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/parallel/numa.hpp"
+#include "fz/parallel/numeric.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/parallel/thread_pool.hpp"
+
+using fz::NumaPolicy;
+
+namespace {
+
+constexpr fz::SizeType N = 1 << 18;
+
+auto pagesOf(fz::SizeType bytes) -> fz::SizeType {
+  const auto page = fz::numa::pageSize();
+  return (bytes + page - 1) / page;
+}
+
+auto placed(const fz::PagePlacement& placement) -> fz::SizeType {
+  return placement.total() - placement.unplaced;
+}
+
+}  // namespace
+
+TEST(Numa, Topology) {
+  EXPECT_EQ(fz::detail::parseCpuList("0-3,8,10-11\n"),
+            (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_TRUE(fz::detail::parseCpuList("").empty());
+
+  EXPECT_LE(1, fz::numa::nodeCount());
+  EXPECT_FALSE(fz::numa::cpusOfNode(0).empty());
+  EXPECT_LT(0, fz::numa::pageSize());
+}
+
+TEST(Numa, Policies) {
+  fz::ThreadPool pool{4};
+  for (auto policy :
+       {NumaPolicy::kFirstTouch, NumaPolicy::kInterleave, NumaPolicy::kBind}) {
+    const fz::NumaAllocator<double> alloc{{.policy = policy, .pool = &pool}};
+    auto arr = fz::NumaArray<double>::zeros({512, N / 512}, alloc);
+    EXPECT_TRUE(std::ranges::all_of(arr, [](double x) { return x == 0; }));
+    EXPECT_EQ(arr.getAllocator(), alloc);
+
+    // a static sweep and reduction over the placed pages
+    fz::parallelFor(
+        0, arr.size(),
+        [&](fz::SizeType i) { arr.data()[i] = static_cast<double>(i % 7); },
+        {.pool = &pool, .schedule = fz::Schedule::kStatic});
+    const auto sum = fz::reduce(
+        arr, 0.0, std::plus<>{},
+        {.pool = &pool, .schedule = fz::Schedule::kStatic});
+    double expected = 0;
+    for (fz::SizeType i = 0; i < arr.size(); ++i) {
+      expected += static_cast<double>(i % 7);
+    }
+    EXPECT_EQ(sum, expected);
+
+    // copies keep the policy
+    auto copy = arr;
+    EXPECT_EQ(copy.getAllocator().options().policy, policy);
+    EXPECT_EQ(copy(511, N / 512 - 1), arr(511, N / 512 - 1));
+  }
+
+  EXPECT_THROW(fz::NumaAllocator<double>(
+                   {.policy = NumaPolicy::kBind,
+                    .node = fz::numa::nodeCount()}),
+               std::invalid_argument);
+}
+
+TEST(Numa, PagePlacement) {
+  fz::ThreadPool pool{2};
+  fz::numa::pinThreads(pool);
+
+  // first touch places every page at allocation
+  auto touched = fz::NumaArray<float>::empty(
+      {N}, fz::NumaAllocator<float>{{.pool = &pool}});
+  const auto placement = fz::numa::pagePlacement(touched);
+  EXPECT_EQ(placement.total(), pagesOf(N * sizeof(float)));
+  EXPECT_EQ(placement.pages.size(), fz::numa::nodeCount());
+  if (placement.unplaced == placement.total()) {
+    GTEST_SKIP() << "move_pages is not available";
+  }
+  EXPECT_EQ(placed(placement), placement.total());
+
+  // interleaved pages only exist once written
+  auto lazy = fz::NumaArray<float>::empty(
+      {N}, fz::NumaAllocator<float>{{.policy = NumaPolicy::kInterleave}});
+  EXPECT_EQ(placed(fz::numa::pagePlacement(lazy)), 0);
+  std::fill(lazy.begin(), lazy.begin() + N / 2, 1.0F);
+  const auto half = fz::numa::pagePlacement(lazy);
+  EXPECT_EQ(placed(half), pagesOf(N / 2 * sizeof(float)));
+
+  std::ostringstream os;
+  os << half;
+  EXPECT_NE(os.str().find("node 0: "), std::string::npos);
+}
@@ -0,0 +1,327 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/parallel/parallel_for.hpp"
+#include "fz/parallel/thread_pool.hpp"
+
+TEST(Parallel, DequeOwnerAndThieves) {
+  fz::WorkStealingDeque<int*> deque{2};
+  std::vector<int> items(10);
+  for (auto& item : items) {
+    deque.push(&item);
+  }
+  // owner pops LIFO, thieves take FIFO
+  EXPECT_EQ(deque.pop(), &items[9]);
+  EXPECT_EQ(deque.steal(), &items[0]);
+
+  constexpr int N = 100000;
+  std::vector<int> values(N);
+  std::vector<std::atomic<int>> taken(N);
+  std::atomic<bool> done{false};
+  auto record = [&](int* p) { taken[p - values.data()].fetch_add(1); };
+
+  std::vector<std::thread> thieves;
+  for (int t = 0; t < 3; ++t) {
+    thieves.emplace_back([&]() {
+      while (!done.load()) {
+        if (auto* p = deque.steal(); p != nullptr) {
+          if (p < values.data() || values.data() + N <= p) {
+            continue;  // one of the items pushed above
+          }
+          record(p);
+        }
+      }
+    });
+  }
+  for (int i = 0; i < N; ++i) {
+    deque.push(&values[i]);
+    if (i % 3 == 0) {
+      if (auto* p = deque.pop(); p != nullptr && values.data() <= p &&
+                                 p < values.data() + N) {
+        record(p);
+      }
+    }
+  }
+  while (auto* p = deque.pop()) {
+    if (values.data() <= p && p < values.data() + N) {
+      record(p);
+    }
+  }
+  done.store(true);
+  for (auto& thief : thieves) {
+    thief.join();
+  }
+  EXPECT_TRUE(std::ranges::all_of(taken, [](auto& n) { return n == 1; }));
+}
+
+TEST(Parallel, ForCoversRangeOnce) {
+  for (fz::SizeType threads : {1, 2, 4}) {
+    fz::ThreadPool pool{threads};
+    for (fz::SizeType grain : {0, 1, 7, 1000}) {
+      std::vector<std::atomic<int>> hits(10007);
+      fz::parallelFor(
+          3, hits.size(), [&](fz::SizeType i) { hits[i].fetch_add(1); },
+          {.grain = grain, .pool = &pool});
+      EXPECT_EQ(hits[0] + hits[1] + hits[2], 0);
+      EXPECT_TRUE(std::all_of(hits.begin() + 3, hits.end(),
+                              [](auto& n) { return n == 1; }));
+    }
+  }
+}
+
+TEST(Parallel, ForChunksAndReuse) {
+  fz::ThreadPool pool{4};
+  EXPECT_EQ(pool.concurrency(), 4);
+  std::mutex mutex;
+  std::set<std::thread::id> ids;
+  std::atomic<fz::SizeType> total{0};
+  for (int call = 0; call < 50; ++call) {
+    fz::parallelFor(
+        0, 1 << 16,
+        [&](fz::SizeType lo, fz::SizeType hi) {
+          EXPECT_LE(hi - lo, 256);
+          total += hi - lo;
+          std::lock_guard lock{mutex};
+          ids.insert(std::this_thread::get_id());
+        },
+        {.grain = 256, .pool = &pool});
+  }
+  EXPECT_EQ(total, 50 << 16);
+  // the same threads serve every call
+  EXPECT_LE(ids.size(), 4);
+}
+
+TEST(Parallel, NestedDoesNotDeadlock) {
+  fz::ThreadPool pool{2};
+  std::atomic<int> count{0};
+  fz::parallelFor(
+      0, 16,
+      [&](fz::SizeType) {
+        fz::parallelFor(
+            0, 64,
+            [&](fz::SizeType) {
+              fz::parallelFor(0, 4, [&](fz::SizeType) { ++count; },
+                              {.grain = 1, .pool = &pool});
+            },
+            {.grain = 1, .pool = &pool});
+      },
+      {.grain = 1, .pool = &pool});
+  EXPECT_EQ(count, 16 * 64 * 4);
+}
+
+TEST(Parallel, Exceptions) {
+  fz::ThreadPool pool{4};
+  EXPECT_THROW(fz::parallelFor(
+                   0, 1000,
+                   [](fz::SizeType i) {
+                     if (i == 567) {
+                       throw std::runtime_error("boom");
+                     }
+                   },
+                   {.grain = 10, .pool = &pool}),
+               std::runtime_error);
+  // the pool is still usable
+  std::atomic<int> count{0};
+  fz::parallelFor(0, 100, [&](fz::SizeType) { ++count; }, {.pool = &pool});
+  EXPECT_EQ(count, 100);
+}
+
+TEST(Parallel, Broadcast) {
+  fz::ThreadPool pool{4};
+  std::vector<std::thread::id> ids(4);
+  std::vector<int> calls(4);
+  pool.broadcast([&](fz::SizeType rank) {
+    ids[rank] = std::this_thread::get_id();
+    ++calls[rank];
+  });
+  EXPECT_EQ(calls, (std::vector<int>{1, 1, 1, 1}));
+  EXPECT_EQ(ids[0], std::this_thread::get_id());
+  EXPECT_EQ(std::set<std::thread::id>(ids.begin(), ids.end()).size(), 4);
+
+  // a rank is always the same thread
+  for (int round = 0; round < 20; ++round) {
+    pool.broadcast([&](fz::SizeType rank) {
+      EXPECT_EQ(ids[rank], std::this_thread::get_id());
+    });
+  }
+
+  EXPECT_THROW(pool.broadcast([](fz::SizeType rank) {
+    if (rank == 2) {
+      throw std::runtime_error("rank 2");
+    }
+  }),
+               std::runtime_error);
+
+  // from inside the pool the ranks run on the caller
+  std::atomic<int> nested{0};
+  fz::parallelFor(
+      0, 8,
+      [&](fz::SizeType) { pool.broadcast([&](fz::SizeType) { ++nested; }); },
+      {.grain = 1, .pool = &pool});
+  EXPECT_EQ(nested, 8 * 4);
+}
+
+TEST(Parallel, StaticSchedule) {
+  using Part = std::pair<fz::SizeType, fz::SizeType>;
+  EXPECT_EQ(fz::staticPartition(0, 10, 0, 4), Part(0, 3));
+  EXPECT_EQ(fz::staticPartition(0, 10, 1, 4), Part(3, 6));
+  EXPECT_EQ(fz::staticPartition(0, 10, 3, 4), Part(8, 10));
+  EXPECT_EQ(fz::staticPartition(5, 7, 3, 4), Part(7, 7));
+
+  fz::ThreadPool pool{4};
+  const fz::ParallelOptions options{.pool = &pool,
+                                    .schedule = fz::Schedule::kStatic};
+  std::vector<std::atomic<int>> hits(10003);
+  std::vector<std::thread::id> owner(hits.size());
+  fz::parallelFor(
+      0, hits.size(),
+      [&](fz::SizeType i) {
+        hits[i].fetch_add(1);
+        owner[i] = std::this_thread::get_id();
+      },
+      options);
+  EXPECT_TRUE(std::ranges::all_of(hits, [](auto& n) { return n == 1; }));
+  // the same index goes to the same thread on every call
+  std::atomic<int> moved{0};
+  for (int round = 0; round < 10; ++round) {
+    fz::parallelFor(
+        0, hits.size(),
+        [&](fz::SizeType i) {
+          if (owner[i] != std::this_thread::get_id()) {
+            ++moved;
+          }
+        },
+        options);
+  }
+  EXPECT_EQ(moved, 0);
+
+  // blocks cut the outermost dimension, one per thread
+  auto arr = fz::FixedRankArray<int, 3>::zeros({5, 6, 1});
+  std::atomic<int> blocks{0};
+  fz::parallelFor(
+      fz::BlockedRange{arr.shape()},
+      [&](const auto& block) {
+        ++blocks;
+        EXPECT_EQ(block.extent(0), 5);
+        block.forEach([&](const auto& index) { ++arr(index[0], index[1], 0); });
+      },
+      options);
+  EXPECT_EQ(blocks, 4);
+  EXPECT_TRUE(std::ranges::all_of(arr, [](int n) { return n == 1; }));
+}
+
+TEST(Parallel, BlockedRangeSplitsOuterDimension) {
+  fz::BlockedRange<std::vector<fz::SizeType>> range{{8, 6, 1}};
+  EXPECT_EQ(range.size(), 48);
+  EXPECT_EQ(range.splitDimension(), 1);
+  auto upper = range.split();
+  EXPECT_EQ(range.end(), (std::vector<fz::SizeType>{8, 3, 1}));
+  EXPECT_EQ(upper.begin(), (std::vector<fz::SizeType>{0, 3, 0}));
+
+  std::vector<std::vector<fz::SizeType>> visited;
+  upper.forEach([&](const auto& index) { visited.push_back(index); });
+  ASSERT_EQ(visited.size(), 24);
+  EXPECT_EQ(visited[1], (std::vector<fz::SizeType>{1, 3, 0}));
+  EXPECT_EQ(visited.back(), (std::vector<fz::SizeType>{7, 5, 0}));
+}
+
+TEST(Parallel, BlockedRangeFollowsStrides) {
+  auto arr = fz::Array<int>::zeros({8, 6, 3}, fz::Layout::kRowMajor);
+  fz::BlockedRange range{arr};
+  EXPECT_EQ(range.order(), (fz::ShapeVector{2, 1, 0}));
+  EXPECT_EQ(range.splitDimension(), 0);
+  auto upper = range.split();
+  EXPECT_EQ(upper.begin(), (fz::ShapeVector{4, 0, 0}));
+  EXPECT_EQ(upper.order(), range.order());
+
+  // last index fastest: every step is the next element in memory
+  std::vector<const int*> visited;
+  upper.forEach([&](const auto& index) {
+    visited.push_back(&arr(index[0], index[1], index[2]));
+  });
+  ASSERT_EQ(visited.size(), 72);
+  for (fz::SizeType i = 0; i < visited.size(); ++i) {
+    EXPECT_EQ(visited[i], arr.data() + 72 + i);
+  }
+
+  // a static schedule cuts the slowest dimension too and keeps the order
+  fz::ThreadPool pool{4};
+  std::atomic<int> blocks{0};
+  fz::parallelFor(
+      fz::BlockedRange{arr},
+      [&](const auto& block) {
+        ++blocks;
+        EXPECT_EQ(block.order(), range.order());
+        EXPECT_EQ(block.extent(1) * block.extent(2), 18);
+        block.forEach(
+            [&](const auto& index) { ++arr(index[0], index[1], index[2]); });
+      },
+      {.pool = &pool, .schedule = fz::Schedule::kStatic});
+  EXPECT_EQ(blocks, 4);
+  EXPECT_TRUE(std::ranges::all_of(arr, [](int n) { return n == 1; }));
+
+  // a transposed view of it is first index fastest again
+  EXPECT_EQ(fz::BlockedRange{arr.view().transpose()}.order(),
+            (fz::ShapeVector{0, 1, 2}));
+}
+
+TEST(Parallel, ForOverArray) {
+  fz::ThreadPool pool{4};
+  auto arr = fz::FixedRankArray<double, 3>::empty({17, 9, 33});
+  fz::BlockedRange range{arr.shape()};
+  std::atomic<int> blocks{0};
+  fz::parallelFor(
+      range,
+      [&](const auto& block) {
+        ++blocks;
+        // outer-dimension blocks keep the inner ones whole
+        EXPECT_EQ(block.extent(0), 17);
+        block.forEach([&](const auto& index) {
+          arr(index[0], index[1], index[2]) =
+              static_cast<double>(index[0] + 17 * (index[1] + 9 * index[2]));
+        });
+      },
+      {.grain = 17 * 9, .pool = &pool});
+  EXPECT_GT(blocks, 1);
+  for (fz::SizeType i = 0; i < arr.size(); ++i) {
+    EXPECT_EQ(arr.data()[i], static_cast<double>(i));
+  }
+}
+
+TEST(Parallel, ForOverArrayOfEitherLayout) {
+  fz::ThreadPool pool{4};
+  for (auto layout : {fz::Layout::kColumnMajor, fz::Layout::kRowMajor}) {
+    auto arr = fz::Array<double>::zeros({17, 9, 33}, layout);
+    const auto inner = layout == fz::Layout::kColumnMajor ? 0 : 2;
+    std::atomic<int> blocks{0};
+    fz::parallelFor(
+        arr,
+        [&](const auto& block) {
+          ++blocks;
+          // blocks keep the fastest dimension whole and walk it in order
+          EXPECT_EQ(block.extent(inner), arr.shape()[inner]);
+          const double* last = nullptr;
+          block.forEach([&](const auto& index) {
+            auto& v = arr(index[0], index[1], index[2]);
+            if (last != nullptr && index[inner] != 0) {
+              EXPECT_EQ(&v, last + 1);
+            }
+            last = &v;
+            v += 1;
+          });
+        },
+        {.grain = 17 * 9, .pool = &pool});
+    EXPECT_GT(blocks, 1);
+    EXPECT_TRUE(std::ranges::all_of(arr, [](double v) { return v == 1; }));
+  }
+}
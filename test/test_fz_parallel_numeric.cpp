@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/parallel/numeric.hpp"
+#include "fz/simd/cpu.hpp"
+
+namespace {
+
+auto randomArray(fz::SizeType n, unsigned seed) -> fz::Array<double> {
+  std::mt19937 gen{seed};
+  std::uniform_real_distribution<double> dist{-1.0, 1.0};
+  auto arr = fz::Array<double>::empty({n});
+  for (auto& v : arr) {
+    v = dist(gen) * std::pow(10.0, dist(gen) * 8);
+  }
+  return arr;
+}
+
+auto sameBits(double a, double b) -> bool {
+  return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+}  // namespace
+
+TEST(ParallelNumeric, Reduce) {
+  auto arr = fz::Array<long>::empty({37, 41, 13});
+  std::iota(arr.begin(), arr.end(), -5000L);
+  const auto expected = std::accumulate(arr.begin(), arr.end(), 7L);
+  for (fz::SizeType threads : {1, 3, 4}) {
+    fz::ThreadPool pool{threads};
+    EXPECT_EQ(fz::reduce(arr, 7L, std::plus<>{}, {.grain = 100, .pool = &pool}),
+              expected);
+    EXPECT_EQ(fz::reduce(arr, 7L, std::plus<>{}, {.pool = &pool}), expected);
+    EXPECT_EQ(fz::reduce(arr, 7L, std::plus<>{},
+                         {.pool = &pool, .schedule = fz::Schedule::kStatic}),
+              expected);
+  }
+
+  // op is only assumed associative: order is kept
+  auto words = fz::Array<std::string>{"a", "b", "c", "d", "e", "f", "g"};
+  fz::ThreadPool pool{4};
+  EXPECT_EQ(fz::reduce(words, std::string{">"}, std::plus<>{},
+                       {.grain = 2, .pool = &pool}),
+            ">abcdefg");
+  EXPECT_EQ(fz::reduce(words, std::string{">"}, std::plus<>{},
+                       {.pool = &pool, .schedule = fz::Schedule::kStatic}),
+            ">abcdefg");
+
+  auto empty = fz::Array<double>::empty({0});
+  EXPECT_EQ(fz::reduce(empty, 1.5), 1.5);
+}
+
+TEST(ParallelNumeric, ReduceViews) {
+  auto arr = fz::Array<int>::empty({6, 5, 4});
+  std::iota(arr.begin(), arr.end(), 0);
+  fz::ThreadPool pool{3};
+
+  auto transposed = arr.view().transpose();
+  EXPECT_EQ(
+      fz::reduce(transposed, 0, std::plus<>{}, {.grain = 7, .pool = &pool}),
+      std::accumulate(arr.begin(), arr.end(), 0));
+
+  auto sliced = arr.view().slice(0, 1, 6, 2);
+  int expected = 0;
+  for (auto v : sliced) {
+    expected += v;
+  }
+  EXPECT_EQ(fz::reduce(sliced, 0, std::plus<>{}, {.grain = 5, .pool = &pool}),
+            expected);
+  EXPECT_EQ(fz::transformReduce(
+                sliced, 0, std::plus<>{}, [](int v) { return v * v; },
+                {.grain = 3, .pool = &pool}),
+            fz::transformReduce(sliced, sliced, 0));
+}
+
+TEST(ParallelNumeric, RowMajor) {
+  fz::ThreadPool pool{3};
+  const fz::ParallelOptions options{.grain = 7, .pool = &pool};
+  auto rows = fz::Array<double>::empty({9, 11}, fz::Layout::kRowMajor);
+  std::iota(rows.data(), rows.data() + rows.size(), 1.0);
+  auto cols = fz::Array<double>::empty({9, 11});
+  cols.view().assign(rows);
+  EXPECT_EQ(fz::reduce(rows, 0.5, std::plus<>{}, options), 0.5 + 99 * 50);
+
+  // the fold follows memory, last index fastest
+  auto words = fz::Array<std::string>::empty({2, 3}, fz::Layout::kRowMajor);
+  for (fz::SizeType i = 0; i < words.size(); ++i) {
+    words.data()[i] = std::string(1, static_cast<char>('a' + i));
+  }
+  EXPECT_EQ(fz::reduce(words, std::string{">"}, std::plus<>{},
+                       {.grain = 2, .pool = &pool}),
+            ">abcdef");
+
+  // dot products pair elements by index, whichever way each side is stored
+  double expected = 0;
+  for (fz::SizeType i = 0; i < 9; ++i) {
+    for (fz::SizeType j = 0; j < 11; ++j) {
+      expected += rows(i, j) * cols(i, j);
+    }
+  }
+  EXPECT_EQ(fz::transformReduce(rows, rows, 0.0, std::plus<>{},
+                                std::multiplies<>{}, options),
+            expected);
+  EXPECT_EQ(fz::transformReduce(rows, cols, 0.0, std::plus<>{},
+                                std::multiplies<>{}, options),
+            expected);
+  EXPECT_EQ(fz::transformReduce(cols, rows, 0.0, std::plus<>{},
+                                std::multiplies<>{}, options),
+            expected);
+
+  // scans run in the memory order of x and land at the matching positions
+  auto out = fz::Array<double>::emptyLike(rows);
+  fz::inclusiveScan(rows, out, std::plus<>{}, options);
+  for (fz::SizeType k = 0; k < out.size(); ++k) {
+    EXPECT_EQ(out.data()[k], static_cast<double>((k + 1) * (k + 2) / 2));
+  }
+  auto mixed = fz::Array<double>::empty({9, 11});
+  fz::exclusiveScan(rows, mixed, 0.0, std::plus<>{}, options);
+  for (fz::SizeType i = 0; i < 9; ++i) {
+    for (fz::SizeType j = 0; j < 11; ++j) {
+      EXPECT_EQ(mixed(i, j), out(i, j) - rows(i, j));
+    }
+  }
+  fz::inclusiveScan(rows, rows, std::plus<>{}, options);
+  EXPECT_TRUE(std::equal(rows.begin(), rows.end(), out.begin()));
+}
+
+TEST(ParallelNumeric, DeterministicAcrossThreadCounts) {
+  const auto x = randomArray(1000003, 1);
+  const auto y = randomArray(1000003, 2);
+  const auto initial = fz::simd::activeIsa();
+
+  fz::ThreadPool one{1};
+  const auto sum = fz::reduce(x, 0.0, std::plus<>{},
+                              {.pool = &one, .deterministic = true});
+  const auto dot = fz::transformReduce(x, y, 0.0, std::plus<>{},
+                                       std::multiplies<>{},
+                                       {.pool = &one, .deterministic = true});
+  for (fz::SizeType threads : {2, 3, 4, 7}) {
+    fz::ThreadPool pool{threads};
+    for (auto isa : {fz::simd::Isa::kScalar, fz::simd::Isa::kSse2,
+                     fz::simd::Isa::kAvx2, fz::simd::Isa::kAvx512}) {
+      fz::simd::setActiveIsa(isa);
+      EXPECT_TRUE(sameBits(fz::reduce(x, 0.0, std::plus<>{},
+                                      {.pool = &pool, .deterministic = true}),
+                           sum));
+      EXPECT_TRUE(sameBits(
+          fz::transformReduce(x, y, 0.0, std::plus<>{}, std::multiplies<>{},
+                              {.pool = &pool, .deterministic = true}),
+          dot));
+    }
+  }
+  fz::simd::setActiveIsa(initial);
+
+  // fast mode agrees up to rounding
+  fz::ThreadPool pool{4};
+  auto fast = fz::reduce(x, 0.0, std::plus<>{}, {.pool = &pool});
+  auto scale = fz::transformReduce(x, 0.0, std::plus<>{},
+                                   [](double v) { return std::abs(v); });
+  EXPECT_NEAR(fast, sum, 1e-12 * scale);
+}
+
+TEST(ParallelNumeric, Scans) {
+  auto arr = fz::Array<long>::empty({1000, 7});
+  std::iota(arr.begin(), arr.end(), -300L);
+  std::vector<long> inclusive(arr.size());
+  std::vector<long> exclusive(arr.size());
+  std::inclusive_scan(arr.begin(), arr.end(), inclusive.begin());
+  std::exclusive_scan(arr.begin(), arr.end(), exclusive.begin(), 11L);
+
+  fz::ThreadPool pool{4};
+  for (fz::SizeType grain : {1, 13, 4096, 100000}) {
+    auto out = fz::Array<long>::emptyLike(arr);
+    fz::inclusiveScan(arr, out, std::plus<>{}, {.grain = grain, .pool = &pool});
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), inclusive.begin()));
+    fz::exclusiveScan(arr, out, 11L, std::plus<>{},
+                      {.grain = grain, .pool = &pool});
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), exclusive.begin()));
+  }
+
+  // in place, and with an op that has no zero to start from
+  auto values = fz::Array<long>{3, 1, 4, 1, 5, 9, 2, 6};
+  fz::inclusiveScan(values, values, std::multiplies<>{},
+                    {.grain = 3, .pool = &pool});
+  EXPECT_EQ(values[7], 3L * 1 * 4 * 1 * 5 * 9 * 2 * 6);
+  EXPECT_EQ(values[2], 12);
+
+  // strided output
+  auto grid = fz::Array<int>::empty({4, 3});
+  std::fill(grid.begin(), grid.end(), 1);
+  auto target = fz::Array<int>::empty({3, 4});
+  fz::exclusiveScan(grid.view(), target.view().transpose(), 0, std::plus<>{},
+                    {.grain = 5, .pool = &pool});
+  EXPECT_EQ(target(2, 3), 11);
+  EXPECT_EQ(target(1, 0), 4);
+
+  EXPECT_THROW(fz::inclusiveScan(grid, target), std::invalid_argument);
+}
+
+TEST(ParallelNumeric, DeterministicScan) {
+  const auto x = randomArray(100001, 3);
+  auto reference = fz::Array<double>::emptyLike(x);
+  fz::ThreadPool one{1};
+  fz::inclusiveScan(x, reference, std::plus<>{},
+                    {.pool = &one, .deterministic = true});
+  for (fz::SizeType threads : {2, 5}) {
+    fz::ThreadPool pool{threads};
+    auto out = fz::Array<double>::emptyLike(x);
+    fz::inclusiveScan(x, out, std::plus<>{},
+                      {.pool = &pool, .deterministic = true});
+    EXPECT_EQ(std::memcmp(out.data(), reference.data(),
+                          x.size() * sizeof(double)),
+              0);
+  }
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include <numeric>
+#include <vector>
+
+#include "fz/parallel/perf_counters.hpp"
+#include "fz/parallel/performance.hpp"
+
+TEST(PerfCounters, DerivedMetrics) {
+  fz::CounterSample sample;
+  EXPECT_TRUE(sample.empty());
+  EXPECT_EQ(sample.ipc(), 0.0);
+  EXPECT_EQ(sample.bottleneck(), "-");
+
+  sample.set(fz::PerfEvent::kCycles, 1000.0);
+  sample.set(fz::PerfEvent::kInstructions, 3000.0);
+  EXPECT_FALSE(sample.empty());
+  EXPECT_DOUBLE_EQ(sample.ipc(), 3.0);
+  EXPECT_DOUBLE_EQ(sample.bytesPerCycle(8000.0), 8.0);
+  EXPECT_EQ(sample.bottleneck(), "compute");
+
+  auto twice = sample;
+  twice += sample;
+  EXPECT_DOUBLE_EQ(twice.get(fz::PerfEvent::kCycles), 2000.0);
+  EXPECT_DOUBLE_EQ(twice.scaled(0.5).get(fz::PerfEvent::kInstructions),
+                   3000.0);
+  EXPECT_FALSE(twice.has(fz::PerfEvent::kLlcMisses));
+
+  // streaming 8 KB with a DRAM line fetched for each 64 B
+  auto streaming = sample;
+  streaming.set(fz::PerfEvent::kLlcMisses, 125.0);
+  EXPECT_EQ(streaming.bottleneck(8000.0), "memory bandwidth");
+
+  auto branchy = sample;
+  branchy.set(fz::PerfEvent::kBranchMisses, 60.0);
+  EXPECT_DOUBLE_EQ(branchy.perKiloInstruction(fz::PerfEvent::kBranchMisses),
+                   20.0);
+  EXPECT_EQ(branchy.bottleneck(), "branch mispredicts");
+
+  auto stalled = sample;
+  stalled.set(fz::PerfEvent::kInstructions, 500.0);
+  EXPECT_EQ(stalled.bottleneck(), "latency");
+}
+
+TEST(PerfCounters, DegradeGracefully) {
+  fz::PerfCounters counters;
+  EXPECT_NE(counters.available(), !counters.error().empty());
+
+  fz::Performance::ExecutionProfile profile;
+  const auto enabled = profile.enableCounters();
+  EXPECT_EQ(enabled, counters.available());
+
+  std::vector<double> values(1 << 20, 1.0);
+  auto sum = profile.execute([&values]() {
+    return std::accumulate(values.begin(), values.end(), 0.0);
+  });
+  EXPECT_EQ(sum, static_cast<double>(values.size()));
+  EXPECT_LT(0, profile.duration().count());
+  if (!enabled) {
+    EXPECT_TRUE(profile.counters().empty());
+    EXPECT_FALSE(profile.countersError().empty());
+    GTEST_SKIP() << profile.countersError();
+  }
+  EXPECT_GT(profile.counters().get(fz::PerfEvent::kCycles), 0.0);
+  if (counters.counting(fz::PerfEvent::kInstructions)) {
+    EXPECT_GT(profile.counters().get(fz::PerfEvent::kInstructions),
+              static_cast<double>(values.size()));
+  }
+}
@@ -0,0 +1,173 @@
+#define FZ_PROFILE
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iomanip>
+#include <ios>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fz/parallel/profiler.hpp"
+
+namespace {
+
+auto spin(std::chrono::microseconds duration) -> void {
+  const auto end = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+auto updateE() -> void {
+  FZ_PROFILE_SCOPE("update_e");
+  spin(std::chrono::microseconds{200});
+}
+
+auto updateH() -> void {
+  FZ_PROFILE_SCOPE("update_h");
+  spin(std::chrono::microseconds{100});
+}
+
+auto step() -> void {
+  FZ_PROFILE_SCOPE("step");
+  updateE();
+  updateH();
+  updateH();
+  spin(std::chrono::microseconds{50});
+}
+
+auto find(const fz::ProfileNode& node, const std::string& name)
+    -> const fz::ProfileNode* {
+  for (const auto& child : node.children) {
+    if (child.name == name) {
+      return &child;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST(Profiler, CallTree) {
+  auto& profiler = fz::Profiler::instance();
+  profiler.clear();
+  for (int i = 0; i < 10; ++i) {
+    step();
+  }
+  updateH();  // also at the top level
+
+  auto root = profiler.summary();
+  ASSERT_EQ(root.children.size(), 2);
+  const auto* step_node = find(root, "step");
+  ASSERT_NE(step_node, nullptr);
+  EXPECT_EQ(step_node->count, 10);
+  ASSERT_EQ(step_node->children.size(), 2);
+  // heaviest child first
+  EXPECT_GE(step_node->children[0].total_ns, step_node->children[1].total_ns);
+  const auto* update_e = find(*step_node, "update_e");
+  const auto* update_h = find(*step_node, "update_h");
+  ASSERT_NE(update_e, nullptr);
+  ASSERT_NE(update_h, nullptr);
+  EXPECT_EQ(update_e->count, 10);
+  EXPECT_EQ(update_h->count, 20);
+  EXPECT_EQ(find(root, "update_h")->count, 1);
+
+  EXPECT_EQ(step_node->self_ns,
+            step_node->total_ns - update_e->total_ns - update_h->total_ns);
+  EXPECT_GE(step_node->self_ns, 10 * 50'000);
+  EXPECT_GE(update_e->p50_ns, 200'000);
+  EXPECT_LE(update_e->p50_ns, update_e->p90_ns);
+  EXPECT_LE(update_e->p90_ns, update_e->p99_ns);
+
+  std::ostringstream report;
+  report << std::scientific << std::setprecision(9);
+  profiler.report(report);
+  EXPECT_NE(report.str().find("  update_e"), std::string::npos);
+  // the caller's formatting survives
+  EXPECT_EQ(report.precision(), 9);
+  EXPECT_EQ(report.flags() & std::ios_base::floatfield,
+            std::ios_base::scientific);
+  EXPECT_EQ(report.flags() & std::ios_base::adjustfield,
+            std::ios_base::fmtflags{});
+}
+
+TEST(Profiler, OpenParentZone) {
+  auto& profiler = fz::Profiler::instance();
+  profiler.clear();
+  FZ_PROFILE_SCOPE("main");
+  for (int i = 0; i < 4; ++i) {
+    step();
+  }
+
+  // main is still open: its steps are siblings at the top, not nested
+  auto root = profiler.summary();
+  ASSERT_EQ(root.children.size(), 1);
+  const auto* step_node = find(root, "step");
+  ASSERT_NE(step_node, nullptr);
+  EXPECT_EQ(step_node->count, 4);
+  EXPECT_EQ(find(*step_node, "step"), nullptr);
+  EXPECT_EQ(find(*step_node, "update_h")->count, 8);
+  EXPECT_EQ(step_node->self_ns, step_node->total_ns -
+                                    find(*step_node, "update_e")->total_ns -
+                                    find(*step_node, "update_h")->total_ns);
+  EXPECT_GE(step_node->self_ns, 4 * 50'000);
+}
+
+TEST(Profiler, Threads) {
+  auto& profiler = fz::Profiler::instance();
+  profiler.clear();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < 1000; ++i) {
+        FZ_PROFILE_SCOPE("outer");
+        FZ_PROFILE_SCOPE("inner");
+      }
+    });
+  }
+  // collect while the threads are recording
+  profiler.collect();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto root = profiler.summary();
+  ASSERT_EQ(root.children.size(), 1);
+  EXPECT_EQ(root.children[0].count, 4000);
+  ASSERT_EQ(root.children[0].children.size(), 1);
+  EXPECT_EQ(root.children[0].children[0].count, 4000);
+  EXPECT_EQ(profiler.dropped(), 0);
+}
+
+TEST(Profiler, FullBufferDrops) {
+  auto& profiler = fz::Profiler::instance();
+  profiler.clear();
+  const auto n = fz::ProfileBuffer::CAPACITY + 10;
+  for (fz::SizeType i = 0; i < n; ++i) {
+    FZ_PROFILE_SCOPE("zone");
+  }
+  EXPECT_EQ(profiler.dropped(), 10);
+  EXPECT_EQ(profiler.events().size(), fz::ProfileBuffer::CAPACITY);
+  // room again after collecting
+  {
+    FZ_PROFILE_SCOPE("zone");
+  }
+  EXPECT_EQ(profiler.events().size(), fz::ProfileBuffer::CAPACITY + 1);
+}
+
+TEST(Profiler, ChromeTrace) {
+  auto& profiler = fz::Profiler::instance();
+  profiler.clear();
+  step();
+  std::ostringstream os;
+  profiler.writeChromeTrace(os);
+  EXPECT_EQ(os.precision(), 6);
+  EXPECT_EQ(os.flags() & std::ios_base::floatfield, std::ios_base::fmtflags{});
+  const auto json = os.str();
+  EXPECT_EQ(json.find("{\"displayTimeUnit\""), 0);
+  EXPECT_NE(json.find("{\"name\": \"update_e\", \"ph\": \"X\""),
+            std::string::npos);
+  EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+}
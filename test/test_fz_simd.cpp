@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/simd/simd.hpp"
+
+namespace {
+
+auto supportedIsas() -> std::vector<fz::simd::Isa> {
+  std::vector<fz::simd::Isa> isas;
+  for (auto isa : {fz::simd::Isa::kScalar, fz::simd::Isa::kSse2,
+                   fz::simd::Isa::kAvx2, fz::simd::Isa::kAvx512}) {
+    if (isa <= fz::simd::detectedIsa()) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+template <typename T>
+auto randomValues(std::size_t n) -> std::vector<T> {
+  std::mt19937 gen{42};
+  std::uniform_real_distribution<T> dist{-1.0, 1.0};
+  std::vector<T> values(n);
+  for (auto& v : values) {
+    v = dist(gen) * std::pow(T{10}, static_cast<T>(gen() % 8));
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST(Simd, KernelsOnEveryIsa) {
+  const auto initial = fz::simd::activeIsa();
+  // odd sizes exercise the remainder loops
+  for (std::size_t n : {0UL, 1UL, 7UL, 33UL, 1001UL}) {
+    auto x = fz::Array<double>::empty({n});
+    auto y = fz::Array<double>::empty({n});
+    std::iota(x.begin(), x.end(), 1.0);
+    std::iota(y.begin(), y.end(), -3.0);
+    const auto expected_dot = std::inner_product(x.begin(), x.end(),
+                                                 y.begin(), 0.0);
+
+    for (auto isa : supportedIsas()) {
+      SCOPED_TRACE(std::string{fz::simd::isaName(fz::simd::setActiveIsa(isa))});
+      EXPECT_EQ(fz::simd::sum(x), n * (n + 1) / 2.0);
+      EXPECT_EQ(fz::simd::sum(x, fz::simd::Reduction::kReproducible),
+                n * (n + 1) / 2.0);
+      EXPECT_EQ(fz::simd::dot(x, y), expected_dot);
+      EXPECT_NEAR(fz::simd::norm(x), std::sqrt(fz::simd::dot(x, x)), 1e-9);
+      if (0 < n) {
+        EXPECT_EQ(fz::simd::min(y), -3.0);
+        EXPECT_EQ(fz::simd::max(y), n - 4.0);
+      }
+
+      auto z = fz::Array<double>::empty({n});
+      fz::simd::fill(z, 2.0);
+      fz::simd::axpy(0.5, x, z);
+      fz::simd::scale(z, 2.0);
+      for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(z(i), 4.0 + x(i));
+      }
+      fz::simd::copy(y, z);
+      EXPECT_TRUE(std::equal(y.begin(), y.end(), z.begin()));
+    }
+  }
+  fz::simd::setActiveIsa(initial);
+  EXPECT_THROW(fz::simd::min(fz::Array<double>{}), std::invalid_argument);
+}
+
+TEST(Simd, ReproducibleAcrossIsas) {
+  const auto initial = fz::simd::activeIsa();
+  auto x = randomValues<double>(100003);
+  auto y = randomValues<double>(100003);
+  auto xf = randomValues<float>(100003);
+
+  fz::simd::setActiveIsa(fz::simd::Isa::kScalar);
+  const auto sum = fz::simd::sum(x.data(), x.size(),
+                                 fz::simd::Reduction::kReproducible);
+  const auto dot = fz::simd::dot(x.data(), y.data(), x.size(),
+                                 fz::simd::Reduction::kReproducible);
+  const auto sumf = fz::simd::sum(xf.data(), xf.size(),
+                                  fz::simd::Reduction::kReproducible);
+
+  for (auto isa : supportedIsas()) {
+    SCOPED_TRACE(std::string{fz::simd::isaName(fz::simd::setActiveIsa(isa))});
+    auto other = fz::simd::sum(x.data(), x.size(),
+                               fz::simd::Reduction::kReproducible);
+    EXPECT_EQ(std::memcmp(&sum, &other, sizeof(sum)), 0);
+    other = fz::simd::dot(x.data(), y.data(), x.size(),
+                          fz::simd::Reduction::kReproducible);
+    EXPECT_EQ(std::memcmp(&dot, &other, sizeof(dot)), 0);
+    auto otherf = fz::simd::sum(xf.data(), xf.size(),
+                                fz::simd::Reduction::kReproducible);
+    EXPECT_EQ(std::memcmp(&sumf, &otherf, sizeof(sumf)), 0);
+  }
+  fz::simd::setActiveIsa(initial);
+}
+
+TEST(Simd, ContiguousViewsOnly) {
+  auto arr = fz::Array<double>::empty({4, 4});
+  std::iota(arr.begin(), arr.end(), 0.0);
+
+  EXPECT_EQ(fz::simd::sum(arr.view().slice(1, 1, 2)), 4.0 + 5 + 6 + 7);
+  EXPECT_THROW(fz::simd::sum(arr.view().slice(0, 1, 2)),
+               std::invalid_argument);
+}
+
+TEST(Simd, RowMajorStorage) {
+  // 1 + 2 + ... + 12 in row-major order
+  auto x = fz::Array<double>::empty({3, 4}, fz::Layout::kRowMajor);
+  std::iota(x.begin(), x.end(), 1.0);
+  ASSERT_FALSE(x.isContiguous());
+
+  // kernels that treat the elements as a set take any dense layout
+  EXPECT_EQ(fz::simd::sum(x), 78.0);
+  EXPECT_EQ(fz::simd::min(x), 1.0);
+  EXPECT_EQ(fz::simd::max(x), 12.0);
+  EXPECT_NEAR(fz::simd::norm(x), std::sqrt(650.0), 1e-12);
+  auto y = fz::Array<double>::empty({3, 4}, fz::Layout::kRowMajor);
+  fz::simd::fill(y, 1.0);
+  EXPECT_EQ(y(2, 3), 1.0);
+  fz::simd::scale(y, 2.0);
+  EXPECT_EQ(y(1, 0), 2.0);
+  EXPECT_EQ(fz::simd::sum(x.view().transpose()), 78.0);
+  EXPECT_THROW(fz::simd::sum(x.view().slice(1, 0, 2)), std::invalid_argument);
+
+  // pairwise kernels match elements by offset, so the orders must agree
+  fz::simd::axpy(1.0, x, y);
+  EXPECT_EQ(y(2, 3), 14.0);
+  EXPECT_EQ(fz::simd::dot(x, x), 650.0);
+  auto z = fz::Array<double>::empty({3, 4}, fz::Layout::kRowMajor);
+  fz::simd::copy(x, z);
+  EXPECT_EQ(z(1, 2), x(1, 2));
+  EXPECT_EQ(fz::simd::dot(x.view().transpose(), z.view().transpose()), 650.0);
+
+  auto column_major = fz::Array<double>::zeros({3, 4});
+  EXPECT_THROW(fz::simd::copy(x, column_major), std::invalid_argument);
+  EXPECT_THROW(fz::simd::axpy(1.0, column_major, y), std::invalid_argument);
+  EXPECT_THROW(fz::simd::dot(x, column_major), std::invalid_argument);
+  auto flat = fz::Array<double>::zeros({12});
+  EXPECT_THROW(fz::simd::dot(flat, x), std::invalid_argument);
+  // a transposed 4 x 3 column-major array has the offsets of x
+  auto tall = fz::Array<double>::zeros({4, 3});
+  auto tall_t = tall.view().transpose();
+  fz::simd::copy(x, tall_t);
+  EXPECT_EQ(tall(2, 1), x(1, 2));
+}
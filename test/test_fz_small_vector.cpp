@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/expression.hpp"
+#include "fz/small_vector.hpp"
+
+// every operator new in this binary is counted; the Array tests below also
+// check that element storage sits inside the object, since the default
+// allocator takes it from malloc
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+}  // namespace
+
+auto operator new(std::size_t n) -> void * {
+  ++allocations;
+  if (auto *p = std::malloc(n == 0 ? 1 : n)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+auto operator delete(void *p) noexcept -> void { std::free(p); }
+
+auto operator delete(void *p, std::size_t /*n*/) noexcept -> void {
+  std::free(p);
+}
+
+namespace {
+
+using Small = fz::SmallVector<std::size_t, 4>;
+
+template <typename A>
+auto storedInside(const A &arr) -> bool {
+  const auto *p = reinterpret_cast<const std::byte *>(arr.data());
+  const auto *self = reinterpret_cast<const std::byte *>(&arr);
+  return self <= p && p < self + sizeof(A);
+}
+
+}  // namespace
+
+TEST(SmallVector, Basics) {
+  Small v{3, 4, 5};
+  EXPECT_TRUE(v.isInline());
+  EXPECT_EQ(v, (std::vector<std::size_t>{3, 4, 5}));
+  v.push_back(6);
+  EXPECT_TRUE(v.isInline());
+  v.push_back(v[0]);
+  EXPECT_FALSE(v.isInline());
+  EXPECT_EQ(v, (std::vector<std::size_t>{3, 4, 5, 6, 3}));
+
+  v.insert(v.begin() + 1, 9);
+  v.erase(v.begin());
+  EXPECT_EQ(v, (std::vector<std::size_t>{9, 4, 5, 6, 3}));
+  v.resize(2);
+  EXPECT_EQ(v.back(), 4U);
+  EXPECT_THROW(static_cast<void>(v.at(2)), std::out_of_range);
+
+  // copies and moves of both representations
+  const Small heap{1, 2, 3, 4, 5, 6};
+  const Small inline_copy = Small(heap.begin(), heap.begin() + 3);
+  auto moved_heap = heap;
+  auto taken = std::move(moved_heap);
+  EXPECT_EQ(taken, heap);
+  EXPECT_TRUE(moved_heap.empty());
+  auto moved_inline = inline_copy;
+  taken = std::move(moved_inline);
+  EXPECT_TRUE(taken.isInline());
+  EXPECT_EQ(taken, (std::vector<std::size_t>{1, 2, 3}));
+  EXPECT_TRUE(inline_copy < heap);
+
+  // from other ranges, and back
+  const std::vector<std::size_t> shape{7, 8};
+  const Small converted = shape;
+  EXPECT_EQ(converted, shape);
+  EXPECT_EQ(shape, converted);
+  EXPECT_EQ(Small(3, 1), (std::vector<std::size_t>{1, 1, 1}));
+}
+
+TEST(SmallVector, ArrayAllocations) {
+  const auto before = allocations.load();
+  {
+    fz::Array<double> vec{1.0, 2.0, 3.0};
+    auto tensor = fz::Array<double>::empty({3, 3});
+    std::fill(tensor.begin(), tensor.end(), 2.0);
+    fz::Array<double> sum = vec + vec;
+    auto copy = tensor;
+    auto moved = std::move(copy);
+    copy = moved;
+    tensor.reshape({9});
+    tensor.reshape({3, 3}, fz::Layout::kRowMajor);
+
+    EXPECT_TRUE(storedInside(vec));
+    EXPECT_TRUE(storedInside(moved));
+    EXPECT_EQ(sum(2), 6.0);
+    EXPECT_EQ(moved(2, 1), 2.0);
+    EXPECT_EQ(copy(0, 2), 2.0);
+  }
+  EXPECT_EQ(allocations.load(), before);
+
+  // beyond the thresholds: rank 5 metadata and a 10-element double array
+  auto high_rank = fz::Array<int>::empty({1, 1, 1, 1, 2});
+  EXPECT_LT(before, allocations.load());
+  EXPECT_TRUE(storedInside(high_rank));
+  auto big = fz::Array<double>::empty({10});
+  EXPECT_FALSE(storedInside(big));
+  const auto *storage = big.data();
+  auto big_moved = std::move(big);
+  EXPECT_EQ(big_moved.data(), storage);
+
+  // an inline array moves its elements; the source is left empty
+  fz::Array<double> small{4.0, 5.0};
+  auto small_moved = std::move(small);
+  EXPECT_EQ(small.size(), 0U);  // NOLINT(bugprone-use-after-move)
+  EXPECT_EQ(small_moved(1), 5.0);
+  small = std::move(small_moved);
+  EXPECT_EQ(small(0), 4.0);
+
+  // non-trivial elements are constructed and destroyed in place
+  fz::Array<std::string> words{std::string(40, 'a'), "b"};
+  EXPECT_TRUE(storedInside(words));
+  auto words_copy = words;
+  auto words_moved = std::move(words);
+  EXPECT_EQ(words_moved(0), std::string(40, 'a'));
+  EXPECT_EQ(words_copy(1), "b");
+
+  // other allocators keep their own storage
+  auto aligned =
+      fz::Array<double, fz::ShapeVector, fz::ShapeVector,
+                fz::AlignedAllocator<double, 64>>::empty({3});
+  EXPECT_FALSE(storedInside(aligned));
+}
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/parallel/thread_pool.hpp"
+#include "fz/simd/cpu.hpp"
+#include "fz/sparse.hpp"
+
+namespace {
+
+auto supportedIsas() -> std::vector<fz::simd::Isa> {
+  std::vector<fz::simd::Isa> isas;
+  for (auto isa : {fz::simd::Isa::kScalar, fz::simd::Isa::kSse2,
+                   fz::simd::Isa::kAvx2, fz::simd::Isa::kAvx512}) {
+    if (isa <= fz::simd::detectedIsa()) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+// small integer values, so every summation order gives the exact result;
+// some rows stay empty and some positions are added twice
+template <typename T>
+auto randomCoo(fz::SizeType rows, fz::SizeType cols, unsigned seed)
+    -> fz::CooMatrix<T> {
+  std::mt19937 gen{seed};
+  fz::CooMatrix<T> coo{rows, cols};
+  for (fz::SizeType row = 0; row < rows; ++row) {
+    const auto count = row % 5 == 3 ? 0 : gen() % 24;
+    for (fz::SizeType k = 0; k < count; ++k) {
+      coo.add(row, gen() % cols, static_cast<T>(gen() % 7) - 3);
+    }
+  }
+  return coo;
+}
+
+// the product through a dense copy of the triplets
+template <typename T>
+auto denseProduct(const fz::CooMatrix<T> &coo, const fz::Array<T> &x)
+    -> fz::Array<T> {
+  auto dense = fz::Array<T>::zeros({coo.rows(), coo.cols()});
+  for (fz::SizeType k = 0; k < coo.nnz(); ++k) {
+    dense(coo.rowIndices()[k], coo.colIndices()[k]) += coo.values()[k];
+  }
+  const auto k = x.size() / coo.cols();
+  auto y = fz::Array<T>::zeros({coo.rows(), k});
+  for (fz::SizeType j = 0; j < k; ++j) {
+    for (fz::SizeType col = 0; col < coo.cols(); ++col) {
+      for (fz::SizeType row = 0; row < coo.rows(); ++row) {
+        y(row, j) += dense(row, col) * x.data()[col + j * coo.cols()];
+      }
+    }
+  }
+  return y;
+}
+
+template <typename T>
+auto checkProducts() -> void {
+  fz::ThreadPool pool{4};
+  const fz::ParallelOptions parallel{.grain = 3, .pool = &pool};
+  for (auto [rows, cols] : {std::pair<fz::SizeType, fz::SizeType>{1, 1},
+                            {37, 50},
+                            {100, 9},
+                            {300, 300}}) {
+    SCOPED_TRACE(std::to_string(rows) + " x " + std::to_string(cols));
+    const auto coo = randomCoo<T>(rows, cols, 7);
+    const fz::CsrMatrix<T> csr{coo};
+    const fz::SellMatrix<T> sell{csr};
+    const fz::SellMatrix<T> unsorted{csr, 1};
+
+    auto x = fz::Array<T>::empty({cols, 3});
+    for (fz::SizeType i = 0; i < x.size(); ++i) {
+      x.data()[i] = static_cast<T>(i % 11) - 5;
+    }
+    const auto expected = denseProduct(coo, x);
+    const auto x0 = fz::Array<T>(x.view().slice(1, 0, 1));
+    const auto expected0 = fz::Array<T>(expected.view().slice(1, 0, 1));
+
+    for (auto isa : supportedIsas()) {
+      SCOPED_TRACE(std::string{fz::simd::isaName(fz::simd::setActiveIsa(isa))});
+      auto y = fz::Array<T>::empty({rows});
+      fz::spmv(csr, x0, y, parallel);
+      EXPECT_TRUE(std::equal(y.begin(), y.end(), expected0.begin()));
+      std::fill(y.begin(), y.end(), T{99});
+      fz::spmv(sell, x0, y, parallel);
+      EXPECT_TRUE(std::equal(y.begin(), y.end(), expected0.begin()));
+      std::fill(y.begin(), y.end(), T{99});
+      fz::spmv(unsorted, x0, y);
+      EXPECT_TRUE(std::equal(y.begin(), y.end(), expected0.begin()));
+
+      auto yy = fz::Array<T>::empty({rows, 3});
+      fz::spmm(csr, x, yy, parallel);
+      EXPECT_TRUE(std::equal(yy.begin(), yy.end(), expected.begin()));
+      std::fill(yy.begin(), yy.end(), T{99});
+      fz::spmm(sell, x, yy, parallel);
+      EXPECT_TRUE(std::equal(yy.begin(), yy.end(), expected.begin()));
+
+      // row-major operands scale rows of x instead of gathering columns
+      auto x_rows = fz::Array<T>::empty({cols, 3}, fz::Layout::kRowMajor);
+      x_rows.view().assign(x);
+      auto y_rows = fz::Array<T>::empty({rows, 3}, fz::Layout::kRowMajor);
+      auto matches = [&]() {
+        for (fz::SizeType row = 0; row < rows; ++row) {
+          for (fz::SizeType j = 0; j < 3; ++j) {
+            if (y_rows(row, j) != expected(row, j)) {
+              return false;
+            }
+          }
+        }
+        return true;
+      };
+      fz::spmm(csr, x_rows, y_rows, parallel);
+      EXPECT_TRUE(matches());
+      fz::spmm(sell, x_rows, y_rows, parallel);
+      EXPECT_TRUE(matches());
+      std::fill(y_rows.begin(), y_rows.end(), T{99});
+      fz::spmm(unsorted, x_rows, y_rows, parallel);
+      EXPECT_TRUE(matches());
+
+      // column slices of wider arrays are strided matrices
+      auto wide = fz::Array<T>::zeros({rows, 5});
+      auto out = wide.view().slice(1, 1, 3);
+      fz::spmm(sell, x.view().slice(1, 1, 3), out, parallel);
+      for (fz::SizeType row = 0; row < rows; ++row) {
+        EXPECT_EQ(wide(row, 0), T{});
+        EXPECT_EQ(wide(row, 1), expected(row, 1));
+        EXPECT_EQ(wide(row, 2), expected(row, 2));
+        EXPECT_EQ(wide(row, 4), T{});
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(Sparse, Assembly) {
+  fz::CooMatrix<double> coo{3, 4};
+  coo.add(2, 3, 1.0);
+  coo.add(0, 2, 2.0);
+  coo.add(2, 0, 3.0);
+  coo.add(0, 2, 4.0);
+  coo.add(0, 0, 5.0);
+  EXPECT_EQ(coo.nnz(), 5U);
+  EXPECT_THROW(coo.add(3, 0, 1.0), std::out_of_range);
+  EXPECT_THROW(coo.add(0, 4, 1.0), std::out_of_range);
+
+  // rows sorted by column, the repeated (0, 2) summed
+  const fz::CsrMatrix<double> csr{coo};
+  EXPECT_EQ(csr.nnz(), 4U);
+  EXPECT_EQ(std::vector<fz::SizeType>(csr.rowOffsets().begin(),
+                                      csr.rowOffsets().end()),
+            (std::vector<fz::SizeType>{0, 2, 2, 4}));
+  EXPECT_EQ(std::vector<fz::SparseIndex>(csr.columns().begin(),
+                                         csr.columns().end()),
+            (std::vector<fz::SparseIndex>{0, 2, 0, 3}));
+  EXPECT_EQ(csr(0, 2), 6.0);
+  EXPECT_EQ(csr(2, 0), 3.0);
+  EXPECT_EQ(csr(1, 1), 0.0);
+  EXPECT_THROW(csr(0, 4), std::out_of_range);
+
+  // longest rows first, padding with zeros on the last column
+  const fz::SellMatrix<double> sell{csr};
+  EXPECT_EQ(sell.nnz(), 4U);
+  EXPECT_EQ(sell.slices(), 1U);
+  EXPECT_EQ(sell.values().size(), 2 * fz::SellMatrix<double>::SLICE_ROWS);
+  EXPECT_EQ(sell.permutation()[2], 1);
+  EXPECT_EQ(sell.values()[fz::SellMatrix<double>::SLICE_ROWS], 6.0);
+
+  const fz::CsrMatrix<double> none{fz::CooMatrix<double>{0, 0}};
+  const fz::SellMatrix<double> empty{none};
+  EXPECT_EQ(empty.slices(), 0U);
+  auto nothing = fz::Array<double>::empty({0});
+  fz::spmv(empty, nothing, nothing);
+
+  EXPECT_THROW(fz::CooMatrix<float>(fz::SizeType{1} << 31, 1),
+               std::invalid_argument);
+}
+
+TEST(Sparse, ProductsOnEveryIsa) {
+  const auto initial = fz::simd::activeIsa();
+  checkProducts<double>();
+  checkProducts<float>();
+  fz::simd::setActiveIsa(initial);
+  checkProducts<int>();
+}
+
+TEST(Sparse, ProductErrors) {
+  const fz::CsrMatrix<double> a{randomCoo<double>(10, 8, 1)};
+  auto x = fz::Array<double>::zeros({8});
+  auto y = fz::Array<double>::zeros({10});
+  EXPECT_THROW(fz::spmv(a, y, y), std::invalid_argument);
+  EXPECT_THROW(fz::spmv(a, x, x), std::invalid_argument);
+
+  // y = a * y would read y while writing it
+  const fz::CsrMatrix<double> square{randomCoo<double>(8, 8, 2)};
+  EXPECT_THROW(fz::spmv(square, x, x), std::invalid_argument);
+
+  auto xx = fz::Array<double>::zeros({8, 2});
+  auto yy = fz::Array<double>::zeros({10, 3});
+  EXPECT_THROW(fz::spmm(a, xx, yy), std::invalid_argument);
+  auto row_major = fz::Array<double>::zeros({10, 2}, fz::Layout::kRowMajor);
+  EXPECT_THROW(fz::spmm(a, xx, row_major), std::invalid_argument);
+  auto strided = fz::Array<double>::zeros({16});
+  EXPECT_THROW(fz::spmv(a, strided.view().slice(0, 0, 16, 2), y),
+               std::invalid_argument);
+}
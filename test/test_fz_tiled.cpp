@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "fz/array.hpp"
+#include "fz/tiled.hpp"
+
+using fz::TileOrder;
+
+namespace {
+
+// element (i, j, k) = 10000 i + 100 j + k
+template <typename Tiled>
+auto numbered(const typename Tiled::Index& shape) -> Tiled {
+  auto arr = Tiled::empty(shape);
+  for (std::size_t k = 0; k < shape[2]; ++k) {
+    for (std::size_t j = 0; j < shape[1]; ++j) {
+      for (std::size_t i = 0; i < shape[0]; ++i) {
+        arr(i, j, k) = static_cast<double>(10000 * i + 100 * j + k);
+      }
+    }
+  }
+  return arr;
+}
+
+template <typename Tiled>
+auto checkLayout() -> void {
+  // every brick slot is used exactly once
+  std::vector<std::size_t> offsets;
+  for (std::size_t k = 0; k < Tiled::EDGE; ++k) {
+    for (std::size_t j = 0; j < Tiled::EDGE; ++j) {
+      for (std::size_t i = 0; i < Tiled::EDGE; ++i) {
+        offsets.push_back(Tiled::Tile::offset(i, j, k));
+      }
+    }
+  }
+  std::sort(offsets.begin(), offsets.end());
+  for (std::size_t n = 0; n < offsets.size(); ++n) {
+    ASSERT_EQ(offsets[n], n);
+  }
+
+  // a grid that is not a multiple of the brick edge
+  const auto arr = numbered<Tiled>({19, 8, 10});
+  EXPECT_EQ(arr.grid(), (typename Tiled::Index{3, 1, 2}));
+  EXPECT_EQ(arr.tileCount(), 6U);
+  EXPECT_EQ(arr.size(), 19U * 8 * 10);
+
+  const auto dense = arr.toArray();
+  for (std::size_t k = 0; k < 10; ++k) {
+    for (std::size_t j = 0; j < 8; ++j) {
+      for (std::size_t i = 0; i < 19; ++i) {
+        ASSERT_EQ(dense(i, j, k), arr(i, j, k));
+      }
+    }
+  }
+  const auto copy = Tiled::from(dense);
+  EXPECT_TRUE(std::equal(copy.data(), copy.data() + 19, arr.data()));
+  EXPECT_EQ(copy(18, 7, 9), arr(18, 7, 9));
+
+  const auto last = arr.tile(5);
+  EXPECT_EQ(last.origin(), (typename Tiled::Index{16, 0, 8}));
+  EXPECT_EQ(last.extent(), (typename Tiled::Index{3, 8, 2}));
+  EXPECT_EQ(last(2, 7, 1), arr(18, 7, 9));
+  std::atomic<std::size_t> visited = 0;
+  arr.forEachTile([&](const typename Tiled::ConstTile& tile) {
+    tile.forEach([&](const auto& index, const double& value) {
+      EXPECT_EQ(value, arr(index[0], index[1], index[2]));
+    });
+    ++visited;
+  });
+  EXPECT_EQ(visited, arr.tileCount());
+}
+
+}  // namespace
+
+TEST(Tiled, Linear) { checkLayout<fz::TiledArray<double, 3, 8>>(); }
+
+TEST(Tiled, Morton) {
+  using Tiled = fz::TiledArray<double, 3, 8, TileOrder::kMorton>;
+  checkLayout<Tiled>();
+  // the eight corners of a 2 x 2 x 2 cube sit side by side
+  EXPECT_EQ(Tiled::Tile::offset(1, 1, 1), 7U);
+  EXPECT_EQ(Tiled::Tile::offset(2, 0, 0), 8U);
+}
+
+TEST(Tiled, Gather) {
+  using Tiled = fz::TiledArray<double, 3, 4, TileOrder::kMorton>;
+  const auto arr = numbered<Tiled>({10, 9, 6});
+  constexpr std::size_t HALO = 2;
+  constexpr std::size_t SIDE = Tiled::EDGE + 2 * HALO;
+  std::vector<double> block(SIDE * SIDE * SIDE);
+  for (std::size_t b = 0; b < arr.tileCount(); ++b) {
+    std::fill(block.begin(), block.end(), -1.0);
+    arr.gather(b, HALO, block.data());
+    const auto origin = arr.tile(b).origin();
+    for (std::size_t z = 0; z < SIDE; ++z) {
+      for (std::size_t y = 0; y < SIDE; ++y) {
+        for (std::size_t x = 0; x < SIDE; ++x) {
+          // unsigned wrap-around puts the low side out of range as well
+          const std::array<std::size_t, 3> index{
+              origin[0] + x - HALO, origin[1] + y - HALO, origin[2] + z - HALO};
+          const bool inside = index[0] < 10 && index[1] < 9 && index[2] < 6;
+          ASSERT_EQ(block[x + SIDE * (y + SIDE * z)],
+                    inside ? arr(index[0], index[1], index[2]) : -1.0)
+              << "brick " << b << " at " << x << ", " << y << ", " << z;
+        }
+      }
+    }
+  }
+  EXPECT_THROW(arr.gather(0, 5, block.data()), std::invalid_argument);
+
+  // faces only: the edges and corners of the block keep their old values
+  std::fill(block.begin(), block.end(), -1.0);
+  arr.gather(0, 1, block.data(), false);
+  constexpr std::size_t S = Tiled::EDGE + 2;
+  EXPECT_EQ(block[1 + S * (1 + S * 1)], arr(0, 0, 0));
+  EXPECT_EQ(block[5 + S * (1 + S * 1)], arr(4, 0, 0));
+  EXPECT_EQ(block[5 + S * (5 + S * 1)], -1.0);
+  EXPECT_EQ(block[5 + S * (5 + S * 5)], -1.0);
+}
+
+TEST(Tiled, Rank2) {
+  auto dense = fz::FixedRankArray<int, 2>::empty({13, 6});
+  std::iota(dense.begin(), dense.end(), 0);
+  const auto arr = fz::TiledArray<int, 2, 4>::from(dense);
+  EXPECT_EQ(arr.tileCount(), 8U);
+  EXPECT_EQ(arr(12, 5), dense(12, 5));
+  EXPECT_TRUE(std::equal(dense.begin(), dense.end(), arr.toArray().begin()));
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "fz/parallel/performance.hpp"
+#include "fz/util/time.hpp"
+
+namespace {
+
+// can only be constructed in place
+struct Pinned {
+  explicit Pinned(int v) : value{v} {}
+  Pinned(const Pinned&) = delete;
+  Pinned(Pinned&&) = delete;
+
+  int value;
+};
+
+}  // namespace
+
+TEST(Time, TscClock) {
+  static_assert(std::chrono::is_clock_v<fz::TscClock>);
+  static_assert(fz::TscClock::is_steady);
+
+  auto previous = fz::TscClock::now();
+  for (int i = 0; i < 1000; ++i) {
+    const auto now = fz::TscClock::now();
+    EXPECT_LE(previous, now);
+    previous = now;
+  }
+
+  // agrees with steady_clock; a preemption between the two reads of a pair
+  // skews one attempt by a time slice, so the best of three counts
+  double error = 1.0;
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    const auto tsc0 = fz::TscClock::now();
+    const auto steady0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    const auto tsc = fz::TscClock::now() - tsc0;
+    const auto steady = std::chrono::steady_clock::now() - steady0;
+    error = std::min(error, std::abs(static_cast<double>(tsc.count()) /
+                                         static_cast<double>(steady.count()) -
+                                     1.0));
+  }
+  EXPECT_LT(error, 0.01);
+
+  const auto t0 = fz::TscClock::ticks();
+  std::this_thread::sleep_for(std::chrono::milliseconds{5});
+  EXPECT_GE(fz::TscClock::toDuration(fz::TscClock::ticks() - t0),
+            std::chrono::milliseconds{5});
+}
+
+TEST(Time, MeasureTime) {
+  auto sleep = [](int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{ms});
+  };
+  const auto elapsed = fz::measureTime(sleep, 5);
+  EXPECT_GE(elapsed, std::chrono::milliseconds{5});
+
+  auto [duration, text] = fz::measureTime<fz::TscClock>(
+      [](const char* s) { return std::string{s}; }, "abc");
+  static_assert(std::is_same_v<decltype(duration), fz::TscClock::duration>);
+  EXPECT_EQ(text, "abc");
+  EXPECT_GE(duration.count(), 0);
+
+  // neither copied nor moved on the way out
+  auto [pinned_duration, pinned] =
+      fz::measureTime([]() { return Pinned{42}; });
+  EXPECT_EQ(pinned.value, 42);
+  EXPECT_GE(pinned_duration.count(), 0);
+
+  // references stay references
+  int target = 0;
+  auto timed = fz::measureTime([&target]() -> int& { return target; });
+  timed.get<1>() = 7;
+  EXPECT_EQ(target, 7);
+}
+
+TEST(Time, ExecutionProfileClock) {
+  fz::Performance::BasicExecutionProfile<fz::TscClock> profile;
+  const auto pinned = profile.execute([](int v) { return Pinned{v}; }, 3);
+  EXPECT_EQ(pinned.value, 3);
+
+  profile.execute(
+      []() { std::this_thread::sleep_for(std::chrono::milliseconds{2}); });
+  const auto slept = profile.duration();
+  EXPECT_GE(slept, std::chrono::milliseconds{2});
+  // spans accumulate, execute replaces
+  profile.start();
+  profile.stop();
+  EXPECT_GE(profile.duration(), slept);
+  profile.execute([]() {});
+  EXPECT_LT(profile.duration(), slept);
+}